@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "circularbuffer.h"
+#include "corpus.h"
+
+// Copies chunks in with writeFromBytes and releases them with consume,
+// keeping the buffer about half full. Args: capacity, chunk size
+static void BM_CircularBufferWriteConsume(benchmark::State &state) {
+  CircularBuffer buffer(static_cast<size_t>(state.range(0)),
+                        BufferMode::Mirrored);
+  std::string chunk(static_cast<size_t>(state.range(1)), 'x');
+  while (buffer.dataSize() + chunk.size() <= buffer.capacity() / 2) {
+    buffer.writeFromBytes(chunk.data(), chunk.size());
+  }
+  uint64_t bytes = 0;
+  uint64_t start = corpus::cycles();
+  for (auto _ : state) {
+    buffer.writeFromBytes(chunk.data(), chunk.size());
+    size_t at = 0;
+    char *data = nullptr;
+    size_t length = 0;
+    buffer.getReadView(at, data, length);
+    benchmark::DoNotOptimize(data[0]);
+    buffer.consume(chunk.size());
+    bytes += chunk.size();
+  }
+  corpus::reportBytes(state, bytes, corpus::cycles() - start);
+}
+BENCHMARK(BM_CircularBufferWriteConsume)
+    ->ArgsProduct({{4 << 10, 64 << 10, 1 << 20}, {64, 1024, 16384}})
+    ->ArgNames({"capacity", "chunk"});
+
+// Writes in place through getWriteView/commit, the path workers use for
+// responses. Args: capacity, chunk size
+static void BM_CircularBufferWriteViewCommit(benchmark::State &state) {
+  CircularBuffer buffer(static_cast<size_t>(state.range(0)),
+                        BufferMode::Mirrored);
+  size_t chunk = static_cast<size_t>(state.range(1));
+  uint64_t bytes = 0;
+  uint64_t start = corpus::cycles();
+  for (auto _ : state) {
+    char *data = nullptr;
+    size_t space = 0;
+    buffer.getWriteView(data, space);
+    std::memset(data, 'y', chunk);
+    buffer.commit(chunk);
+    buffer.consume(chunk);
+    bytes += chunk;
+  }
+  corpus::reportBytes(state, bytes, corpus::cycles() - start);
+}
+BENCHMARK(BM_CircularBufferWriteViewCommit)
+    ->ArgsProduct({{4 << 10, 64 << 10, 1 << 20}, {64, 1024}})
+    ->ArgNames({"capacity", "chunk"});
+
+// One chunk written and read back at a fixed position relative to the end
+// of the storage; offset 0 never wraps, the others straddle the wrap.
+// Heap buffers split both copies in two, mirrored ones do not.
+// Args: chunk bytes before the wrap point, mirrored
+static void BM_CircularBufferAcrossWrap(benchmark::State &state) {
+  constexpr size_t CAPACITY = 64 << 10;
+  constexpr size_t CHUNK = 1024;
+  size_t before = static_cast<size_t>(state.range(0));
+  CircularBuffer buffer(CAPACITY, state.range(1) ? BufferMode::Mirrored
+                                                 : BufferMode::Heap);
+  std::string chunk(CHUNK, 'w');
+  char out[CHUNK];
+  size_t skip = before == 0 ? 0 : buffer.capacity() - before;
+  uint64_t bytes = 0;
+  uint64_t start = corpus::cycles();
+  for (auto _ : state) {
+    // Moving both ends to the start position is O(1)
+    buffer.reset();
+    buffer.commit(skip);
+    buffer.consume(skip);
+    // Through the iovec segments, as readv and writev see the buffer; a
+    // heap buffer has two of them past the wrap, a mirrored one only one
+    iovec free[2];
+    int parts = buffer.getWriteSegments(free);
+    size_t written = 0;
+    for (int i = 0; i < parts && written < CHUNK; ++i) {
+      size_t length = std::min(free[i].iov_len, CHUNK - written);
+      std::memcpy(free[i].iov_base, chunk.data() + written, length);
+      buffer.commit(length);
+      written += length;
+    }
+    iovec segments[2];
+    int count = buffer.getReadSegments(segments);
+    size_t copied = 0;
+    for (int i = 0; i < count; ++i) {
+      std::memcpy(out + copied, segments[i].iov_base, segments[i].iov_len);
+      copied += segments[i].iov_len;
+    }
+    buffer.consume(copied);
+    benchmark::DoNotOptimize(out);
+    bytes += CHUNK;
+  }
+  corpus::reportBytes(state, bytes, corpus::cycles() - start);
+}
+BENCHMARK(BM_CircularBufferAcrossWrap)
+    ->ArgsProduct({{0, 16, 512, 1008}, {0, 1}})
+    ->ArgNames({"before_wrap", "mirrored"});
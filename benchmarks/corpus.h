@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include "fixencoder.h"
+
+/**
+ * @brief Realistic FIX frames shared by the benchmarks
+ */
+namespace corpus {
+
+inline std::string encode(std::string_view msgType, uint64_t seqNum,
+                          std::string_view sender, std::string_view target,
+                          auto &&fields) {
+  FixSessionHeader header("FIX.4.2", sender, target);
+  std::string out(4096, '\0');
+  FixEncoder encoder(out.data(), out.size());
+  encoder.begin(header, msgType, seqNum);
+  fields(encoder);
+  out.resize(encoder.finish());
+  return out;
+}
+
+inline std::string logon(std::string_view sender = "CLIENT1",
+                         std::string_view target = "EXECUTOR") {
+  return encode("A", 1, sender, target, [](FixEncoder &e) {
+    e.field(52, "20250314-15:24:42.191").field(98, "0").field(108, "30");
+  });
+}
+
+inline std::string newOrderSingle(std::string_view sender = "CLIENT1",
+                                  std::string_view target = "EXECUTOR") {
+  return encode("D", 2, sender, target, [](FixEncoder &e) {
+    e.field(52, "20250314-15:24:42.191")
+        .field(11, "ORD-000000123456")
+        .field(21, "1")
+        .field(55, "AAPL")
+        .field(54, "1")
+        .field(60, "20250314-15:24:42.191")
+        .field(38, "100")
+        .field(40, "2")
+        .field(44, "187.25")
+        .field(59, "0");
+  });
+}
+
+// 60 tags in all, as a venue's fill report
+inline std::string executionReport() {
+  return encode("8", 3, "EXECUTOR", "CLIENT1", [](FixEncoder &e) {
+    e.field(52, "20250314-15:24:42.191")
+        .field(37, "EX-98765432")
+        .field(11, "ORD-000000123456")
+        .field(17, "FILL-0000001")
+        .field(150, "F")
+        .field(39, "2")
+        .field(55, "AAPL")
+        .field(54, "1")
+        .field(38, "100")
+        .field(44, "187.25")
+        .field(32, "100")
+        .field(31, "187.25")
+        .field(151, "0")
+        .field(14, "100")
+        .field(6, "187.25")
+        .field(60, "20250314-15:24:42.191");
+    // Venue specific fields fill it up to 60 tags with the header
+    for (int tag = 5000; tag < 5038; ++tag) {
+      e.field(tag, "VALUE-" + std::to_string(tag));
+    }
+  });
+}
+
+/**
+ * @brief Time stamp counter, for bytes per cycle; 0 where there is none
+ */
+inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief Reports bytes processed and, where measurable, bytes per cycle
+ */
+inline void reportBytes(benchmark::State &state, uint64_t bytes,
+                        uint64_t elapsedCycles) {
+  state.SetBytesProcessed(static_cast<int64_t>(bytes));
+  if (elapsedCycles != 0) {
+    state.counters["bytes_per_cycle"] =
+        static_cast<double>(bytes) / static_cast<double>(elapsedCycles);
+  }
+}
+
+} // namespace corpus
@@ -0,0 +1,188 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "circularbuffer.h"
+#include "corpus.h"
+#include "fixschema.h"
+#include "message.h"
+
+namespace {
+
+const std::vector<std::string> &frames() {
+  static const std::vector<std::string> all = {
+      corpus::logon(), corpus::newOrderSingle(), corpus::executionReport()};
+  return all;
+}
+
+// Parses and releases every complete frame in the buffer
+size_t parseAll(CircularBuffer &buffer, Message &message) {
+  size_t parsed = 0;
+  while (Message::parseFixMessage(buffer, message) == ParseResult::FINISHED) {
+    benchmark::DoNotOptimize(message.msgType.data());
+    buffer.consume(message.frameLength);
+    message.reset();
+    ++parsed;
+  }
+  message.reset();
+  return parsed;
+}
+
+// What an order handler reads of NewOrderSingle and ExecutionReport
+using OrderSchema = FixSchema<"D", fix::ClOrdID, fix::Symbol, fix::Side,
+                              fix::OrderQty, fix::Price, fix::TransactTime>;
+using FillSchema = FixSchema<"8", fix::ClOrdID, fix::Symbol, fix::Side,
+                             fix::OrderQty, fix::Price, fix::TransactTime>;
+using OrderDispatch = FixDispatch<OrderSchema, FillSchema>;
+
+} // namespace
+
+// Whole frames already buffered, as after a large read.
+// Args: corpus index (logon, NewOrderSingle, 60-tag ExecutionReport)
+static void BM_ParseFixMessage(benchmark::State &state) {
+  const std::string &frame = frames()[static_cast<size_t>(state.range(0))];
+  state.SetLabel(std::to_string(frame.size()) + " byte frames");
+  CircularBuffer buffer(64 << 10, BufferMode::Mirrored);
+  Message message;
+  uint64_t bytes = 0;
+  uint64_t start = corpus::cycles();
+  for (auto _ : state) {
+    buffer.writeFromBytes(frame.data(), frame.size());
+    if (parseAll(buffer, message) != 1) {
+      state.SkipWithError("frame did not parse");
+      break;
+    }
+    bytes += frame.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  corpus::reportBytes(state, bytes, corpus::cycles() - start);
+}
+BENCHMARK(BM_ParseFixMessage)->DenseRange(0, 2)->ArgName("corpus");
+
+// A frame trickling in over several reads: every partial read is framed
+// again until the frame is complete. Args: corpus index, bytes per read
+static void BM_ParseFixMessageSplitAcrossReads(benchmark::State &state) {
+  const std::string &frame = frames()[static_cast<size_t>(state.range(0))];
+  size_t step = static_cast<size_t>(state.range(1));
+  CircularBuffer buffer(64 << 10, BufferMode::Mirrored);
+  Message message;
+  uint64_t bytes = 0;
+  uint64_t start = corpus::cycles();
+  for (auto _ : state) {
+    size_t parsed = 0;
+    for (size_t pos = 0; pos < frame.size(); pos += step) {
+      buffer.writeFromBytes(frame.data() + pos,
+                            std::min(step, frame.size() - pos));
+      parsed += parseAll(buffer, message);
+    }
+    if (parsed != 1) {
+      state.SkipWithError("frame did not parse");
+      break;
+    }
+    bytes += frame.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  corpus::reportBytes(state, bytes, corpus::cycles() - start);
+}
+BENCHMARK(BM_ParseFixMessageSplitAcrossReads)
+    ->ArgsProduct({{0, 1, 2}, {16, 64, 256}})
+    ->ArgNames({"corpus", "read"});
+
+// A frame straddling the end of the buffer storage, which the mirrored
+// mapping presents as one linear span. Args: corpus index
+static void BM_ParseFixMessageAcrossWrap(benchmark::State &state) {
+  const std::string &frame = frames()[static_cast<size_t>(state.range(0))];
+  CircularBuffer buffer(64 << 10, BufferMode::Mirrored);
+  size_t skip = buffer.capacity() - frame.size() / 2;
+  Message message;
+  uint64_t bytes = 0;
+  uint64_t start = corpus::cycles();
+  for (auto _ : state) {
+    buffer.reset();
+    buffer.commit(skip);
+    buffer.consume(skip);
+    buffer.writeFromBytes(frame.data(), frame.size());
+    if (parseAll(buffer, message) != 1) {
+      state.SkipWithError("frame did not parse");
+      break;
+    }
+    bytes += frame.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  corpus::reportBytes(state, bytes, corpus::cycles() - start);
+}
+BENCHMARK(BM_ParseFixMessageAcrossWrap)->DenseRange(0, 2)->ArgName("corpus");
+
+// A burst of mixed frames parsed from one read
+static void BM_ParseFixMessageMixedBurst(benchmark::State &state) {
+  std::string burst;
+  size_t count = 0;
+  while (burst.size() < 32 << 10) {
+    for (const std::string &frame : frames()) {
+      burst += frame;
+      ++count;
+    }
+  }
+  CircularBuffer buffer(64 << 10, BufferMode::Mirrored);
+  Message message;
+  uint64_t bytes = 0;
+  uint64_t start = corpus::cycles();
+  for (auto _ : state) {
+    buffer.writeFromBytes(burst.data(), burst.size());
+    if (parseAll(buffer, message) != count) {
+      state.SkipWithError("burst did not parse");
+      break;
+    }
+    bytes += burst.size();
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+  corpus::reportBytes(state, bytes, corpus::cycles() - start);
+}
+BENCHMARK(BM_ParseFixMessageMixedBurst);
+
+// The six fields an order handler needs, read through the full field table
+// with typed gets. Args: corpus index (NewOrderSingle, ExecutionReport)
+static void BM_TypedGetAfterFullParse(benchmark::State &state) {
+  const std::string &frame = frames()[static_cast<size_t>(state.range(0))];
+  Message message;
+  for (auto _ : state) {
+    if (Message::parseFixMessage(frame.data(), frame.size(), message) !=
+        ParseResult::FINISHED) {
+      state.SkipWithError("frame did not parse");
+      break;
+    }
+    benchmark::DoNotOptimize(message.get<fix::ClOrdID>());
+    benchmark::DoNotOptimize(message.get<fix::Symbol>());
+    benchmark::DoNotOptimize(message.get<fix::Side>());
+    benchmark::DoNotOptimize(message.get<fix::OrderQty>());
+    benchmark::DoNotOptimize(message.get<fix::Price>());
+    benchmark::DoNotOptimize(message.get<fix::TransactTime>());
+    message.reset();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TypedGetAfterFullParse)->DenseRange(1, 2)->ArgName("corpus");
+
+// The same six fields captured by a schema after framing, skipping the rest
+static void BM_SchemaDispatch(benchmark::State &state) {
+  const std::string &frame = frames()[static_cast<size_t>(state.range(0))];
+  int64_t price = 0;
+  auto handler = [&price](const auto &values) {
+    price += values.template get<fix::Price>()->units;
+  };
+  for (auto _ : state) {
+    size_t frameLength;
+    size_t checksum;
+    if (Message::frameFixMessage(frame.data(), frame.size(), frameLength,
+                                 checksum) != ParseResult::FINISHED ||
+        OrderDispatch::dispatch(std::string_view(frame.data(), frameLength),
+                                handler) != DispatchResult::Handled) {
+      state.SkipWithError("frame did not parse");
+      break;
+    }
+    benchmark::DoNotOptimize(price);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SchemaDispatch)->DenseRange(1, 2)->ArgName("corpus");
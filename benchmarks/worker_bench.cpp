@@ -0,0 +1,165 @@
+#include <benchmark/benchmark.h>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "corpus.h"
+#include "router.h"
+#include "worker.h"
+
+namespace {
+
+// A WorkerThread on its own thread with one client over a socketpair,
+// handed over the way the acceptor does
+class Loopback {
+public:
+  Loopback(IoEngineType engine, bool routed) {
+    worker_ = std::make_unique<WorkerThread>(shutdown_, engine);
+    if (routed) {
+      worker_->attachRouter(router_, 0);
+    }
+    thread_ = std::jthread([this]() { worker_->run(); });
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      throw std::runtime_error("socketpair failed");
+    }
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    client_ = fds[0];
+    worker_->handOff(fds[1]);
+  }
+
+  ~Loopback() {
+    shutdown_ = true;
+    worker_->wake();
+    thread_.join();
+    close(client_);
+  }
+
+  void send(const std::string &bytes) {
+    for (size_t sent = 0; sent < bytes.size();) {
+      ssize_t n = write(client_, bytes.data() + sent, bytes.size() - sent);
+      if (n <= 0) {
+        throw std::runtime_error("write to worker failed");
+      }
+      sent += static_cast<size_t>(n);
+    }
+  }
+
+  /**
+   * Reads until count more frames have arrived
+   * @return Bytes received, 0 on timeout
+   */
+  size_t receive(size_t count) {
+    size_t bytes = 0;
+    while (count > 0) {
+      pollfd pfd{client_, POLLIN, 0};
+      if (::poll(&pfd, 1, 3000) != 1) {
+        return 0;
+      }
+      ssize_t n = read(client_, chunk_, sizeof(chunk_));
+      if (n <= 0) {
+        return 0;
+      }
+      bytes += static_cast<size_t>(n);
+      // Frames end in "10=NNN<SOH>"; keep three bytes of context so a
+      // marker split between two reads is still found
+      carry_.append(chunk_, static_cast<size_t>(n));
+      for (size_t pos = carry_.find("\x01" "10=");
+           pos != std::string::npos && count > 0;
+           pos = carry_.find("\x01" "10=", pos + 1)) {
+        --count;
+      }
+      carry_.erase(0, carry_.size() > 3 ? carry_.size() - 3 : 0);
+    }
+    return bytes;
+  }
+
+private:
+  std::atomic<bool> shutdown_{false};
+  Router router_{1};
+  std::unique_ptr<WorkerThread> worker_;
+  std::jthread thread_;
+  int client_ = -1;
+  char chunk_[65536];
+  std::string carry_;
+};
+
+std::string burstOf(const std::string &frame, size_t count) {
+  std::string burst;
+  burst.reserve(frame.size() * count);
+  for (size_t i = 0; i < count; ++i) {
+    burst += frame;
+  }
+  return burst;
+}
+
+// Sends bursts of frames and waits for one response per frame; reports
+// ns per message and processed bytes per cycle next to the usual rates
+void runLoopback(benchmark::State &state, Loopback &loop,
+                 const std::string &frame) {
+  size_t batch = static_cast<size_t>(state.range(1));
+  std::string burst = burstOf(frame, batch);
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+  uint64_t startCycles = corpus::cycles();
+  auto start = std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    loop.send(burst);
+    size_t received = loop.receive(batch);
+    if (received == 0) {
+      state.SkipWithError("worker stopped answering");
+      break;
+    }
+    messages += batch;
+    bytes += burst.size() + received;
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  state.SetItemsProcessed(static_cast<int64_t>(messages));
+  state.counters["ns_per_msg"] =
+      messages == 0
+          ? 0
+          : static_cast<double>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count()) /
+                static_cast<double>(messages);
+  corpus::reportBytes(state, bytes, corpus::cycles() - startCycles);
+}
+
+} // namespace
+
+// Logon requests answered by the worker: parse, encode response, write.
+// Args: engine (0 epoll, 1 io_uring), frames per burst
+static void BM_WorkerLogonLoopback(benchmark::State &state) {
+  Loopback loop(static_cast<IoEngineType>(state.range(0)), false);
+  runLoopback(state, loop, corpus::logon());
+}
+BENCHMARK(BM_WorkerLogonLoopback)
+    ->ArgsProduct({{static_cast<int64_t>(IoEngineType::Epoll),
+                    static_cast<int64_t>(IoEngineType::IoUring)},
+                   {1, 16, 256}})
+    ->ArgNames({"engine", "burst"})
+    ->UseRealTime();
+
+// NewOrderSingles the session addresses to itself, so each one is parsed,
+// resolved by the router and rewritten into the same connection.
+// Args: engine (0 epoll, 1 io_uring), frames per burst
+static void BM_WorkerRoutedLoopback(benchmark::State &state) {
+  Loopback loop(static_cast<IoEngineType>(state.range(0)), true);
+  loop.send(corpus::logon("BENCH", "HUB"));
+  if (loop.receive(1) == 0) {
+    state.SkipWithError("logon not answered");
+    return;
+  }
+  runLoopback(state, loop, corpus::newOrderSingle("BENCH", "BENCH"));
+}
+BENCHMARK(BM_WorkerRoutedLoopback)
+    ->ArgsProduct({{static_cast<int64_t>(IoEngineType::Epoll),
+                    static_cast<int64_t>(IoEngineType::IoUring)},
+                   {1, 16, 256}})
+    ->ArgNames({"engine", "burst"})
+    ->UseRealTime();
@@ -0,0 +1,615 @@
+// Multi-session load generator and end-to-end latency benchmark.
+//
+// Opens many FIX sessions against GeneralRouter across several epoll
+// threads. Each session logs on as <prefix><n> and sends orders addressed
+// to itself, or with --pairs to its partner session, so every message makes
+// a full trip through the router. The send time travels in tag 9990 and is
+// subtracted from the receive time; both ends share one steady clock.
+//
+// Open loop (default) sends at --rate messages per second no matter how the
+// server keeps up. With --co-safe the timestamp is the time the message
+// was scheduled, not the time it finally left, so a stalled server shows up
+// in the latencies instead of being hidden by a pause in sending
+// (coordinated omission). Closed loop (--window N) keeps N messages in
+// flight per session and measures the round trip only.
+#include "../src/circularbuffer.h"
+#include "../src/fixencoder.h"
+#include "../src/histogram.h"
+#include "../src/message.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <latch>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int TIMESTAMP_TAG = 9990;
+constexpr size_t SESSION_BUFFER = 256 * 1024;
+constexpr size_t MAX_FRAME = 4096;
+constexpr size_t MAX_BURST = 256; // Sends between two epoll_wait calls
+constexpr std::string_view SYMBOLS[] = {"AAPL", "MSFT", "AMZN", "GOOG",
+                                        "META", "NVDA", "TSLA", "NFLX"};
+
+struct Options {
+  std::string host = "127.0.0.1";
+  uint16_t port = 8080;
+  int sessions = 100;
+  int threads = 4;
+  double rate = 10000;    // Messages per second over all sessions
+  unsigned window = 0;    // In flight per session, 0 = open loop
+  double duration = 10;   // Seconds of measured load
+  double warmup = 2;      // Seconds sent before measuring
+  size_t pad = 0;         // Text (58) bytes added to every message
+  bool coSafe = false;
+  bool pairs = false;
+  std::string prefix = "LG";
+  std::vector<std::string> mix{"D"}; // MsgType cycle, weights expanded
+};
+
+int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string_view number(char (&buffer)[24], uint64_t value) {
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  return std::string_view(buffer, result.ptr - buffer);
+}
+
+struct Session {
+  int fd = -1;
+  std::string compID;
+  FixSessionHeader header;
+  CircularBuffer in{SESSION_BUFFER, BufferMode::Mirrored};
+  CircularBuffer out{SESSION_BUFFER, BufferMode::Mirrored};
+  Message message;
+  Session *sender = this; // Session whose messages arrive here
+  uint64_t seqNum = 1;
+  bool loggedOn = false;
+  bool failed = false;
+};
+
+/**
+ * One epoll thread driving a contiguous block of sessions
+ */
+class LoadThread {
+public:
+  LoadThread(const Options &options, int first, int count)
+      : options_(options), mixCursor_(static_cast<size_t>(first)) {
+    for (int i = 0; i < count; ++i) {
+      sessions_.push_back(std::make_unique<Session>());
+      sessions_.back()->compID = options.prefix + std::to_string(first + i);
+    }
+    for (int i = 0; i < count; ++i) {
+      // Pairs never straddle threads, see main()
+      Session &session = *sessions_[i];
+      Session &target = options.pairs ? *sessions_[i ^ 1] : session;
+      session.header = FixSessionHeader("FIX.4.2", session.compID,
+                                        target.compID);
+      target.sender = &session;
+    }
+    threadRate_ = options.rate * count / options.sessions;
+  }
+
+  ~LoadThread() {
+    for (auto &session : sessions_) {
+      if (session->fd != -1) {
+        close(session->fd);
+      }
+    }
+    if (epoll_ != -1) {
+      close(epoll_);
+    }
+  }
+
+  /**
+   * Connects and logs on every session, then waits for the start time
+   */
+  void run(std::latch &ready, std::atomic<int64_t> &start) {
+    epoll_ = epoll_create1(0);
+    for (auto &session : sessions_) {
+      connect(*session);
+    }
+    int64_t deadline = nowNs() + 10'000'000'000;
+    while (loggedOn_ + failed_ < sessions_.size() && nowNs() < deadline) {
+      poll(10'000'000);
+    }
+    for (auto &session : sessions_) {
+      if (!session->loggedOn && !session->failed) {
+        fail(*session, "no logon response");
+      }
+    }
+    ready.count_down();
+    start.wait(0);
+    load(start.load());
+  }
+
+  const LatencyHistogram &histogram() const { return histogram_; }
+  size_t loggedOn() const { return loggedOn_; }
+  std::atomic<uint64_t> sent{0};
+  std::atomic<uint64_t> received{0};
+
+private:
+  void connect(Session &session) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options_.port);
+    if (inet_pton(AF_INET, options_.host.c_str(), &addr.sin_addr) != 1) {
+      fail(session, "bad host address");
+      return;
+    }
+    session.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (session.fd == -1 ||
+        ::connect(session.fd, reinterpret_cast<sockaddr *>(&addr),
+                  sizeof(addr)) == -1) {
+      fail(session, strerror(errno));
+      return;
+    }
+    int one = 1;
+    setsockopt(session.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(session.fd, F_SETFL, fcntl(session.fd, F_GETFL) | O_NONBLOCK);
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    event.data.ptr = &session;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, session.fd, &event);
+
+    // 141=Y restarts the sequence numbers of a journaling server
+    char *out = nullptr;
+    size_t space = 0;
+    session.out.getWriteView(out, space);
+    FixEncoder encoder(out, space);
+    encoder.begin(session.header, "A", session.seqNum++)
+        .field(98, "0")
+        .field(108, "30")
+        .field(141, "Y");
+    session.out.commit(encoder.finish());
+    flush(session);
+  }
+
+  void fail(Session &session, const char *reason) {
+    if (session.failed) {
+      return;
+    }
+    std::fprintf(stderr, "session %s: %s\n", session.compID.c_str(), reason);
+    session.failed = true;
+    ++failed_;
+    if (session.fd != -1) {
+      close(session.fd);
+      session.fd = -1;
+    }
+  }
+
+  bool canSend(const Session &session) const {
+    return session.loggedOn && !session.failed &&
+           session.out.availableSpace() >= MAX_FRAME + options_.pad;
+  }
+
+  // Encodes the next message of the mix straight into the write buffer
+  void send(Session &session, int64_t timestamp) {
+    char *out = nullptr;
+    size_t space = 0;
+    session.out.getWriteView(out, space);
+    uint64_t seqNum = session.seqNum++;
+    char seq[24], stamp[24];
+    std::string clOrdID = session.compID;
+    clOrdID.push_back('-');
+    clOrdID.append(number(seq, seqNum));
+
+    FixEncoder encoder(out, space);
+    encoder
+        .begin(session.header, options_.mix[mixCursor_++ % options_.mix.size()],
+               seqNum)
+        .field(11, clOrdID)
+        .field(55, SYMBOLS[seqNum % std::size(SYMBOLS)])
+        .field(54, seqNum % 2 ? "1" : "2")
+        .field(38, "100")
+        .field(40, "2")
+        .field(44, "101.25")
+        .field(TIMESTAMP_TAG, number(stamp, static_cast<uint64_t>(timestamp)));
+    if (!padding_.empty()) {
+      encoder.field(58, padding_);
+    }
+    session.out.commit(encoder.finish());
+    sent.fetch_add(1, std::memory_order_relaxed);
+    if (!session.out.empty()) {
+      dirty_.push_back(&session);
+    }
+  }
+
+  void flush(Session &session) {
+    while (!session.failed && !session.out.empty()) {
+      if (session.out.readToSocketV(session.fd) < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          fail(session, strerror(errno));
+        }
+        return; // EPOLLOUT resumes
+      }
+    }
+  }
+
+  void receive(Session &session, int64_t measureFrom, bool sending) {
+    while (!session.failed) {
+      ssize_t bytes = session.in.writeFromSocketV(session.fd);
+      if (bytes == 0) {
+        fail(session, "closed by server");
+        return;
+      }
+      if (bytes < 0 && !session.in.full()) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          fail(session, strerror(errno));
+        }
+        return;
+      }
+      while (true) {
+        Message &message = session.message;
+        ParseResult result = Message::parseFixMessage(session.in, message);
+        if (result == ParseResult::CONTINUE) {
+          break;
+        }
+        if (result == ParseResult::ERROR && message.frameLength == 0) {
+          fail(session, "garbled FIX stream");
+          return;
+        }
+        if (result == ParseResult::FINISHED) {
+          handle(session, message, measureFrom, sending);
+        }
+        session.in.consume(message.frameLength);
+        message.reset();
+      }
+    }
+  }
+
+  void handle(Session &session, const Message &message, int64_t measureFrom,
+              bool sending) {
+    if (message.msgType == "A") {
+      if (!session.loggedOn) {
+        session.loggedOn = true;
+        ++loggedOn_;
+      }
+      return;
+    }
+    std::string_view stamp = message.get(TIMESTAMP_TAG);
+    uint64_t sentAt;
+    if (std::from_chars(stamp.data(), stamp.data() + stamp.size(), sentAt)
+            .ec != std::errc()) {
+      return; // Not one of ours, such as a heartbeat
+    }
+    int64_t now = nowNs();
+    received.fetch_add(1, std::memory_order_relaxed);
+    if (static_cast<int64_t>(sentAt) >= measureFrom) {
+      histogram_.record(static_cast<uint64_t>(now - static_cast<int64_t>(sentAt)));
+    }
+    if (options_.window > 0 && sending && canSend(*session.sender)) {
+      send(*session.sender, now);
+    }
+  }
+
+  // Waits up to timeoutNs for socket events and handles them
+  void poll(int64_t timeoutNs, int64_t measureFrom = 0, bool sending = false) {
+    epoll_event events[64];
+    // epoll_pwait2 sleeps until the next scheduled send to the nanosecond,
+    // where a millisecond epoll_wait timeout would send in lumps
+    timespec timeout{static_cast<time_t>(timeoutNs / 1'000'000'000),
+                     static_cast<long>(timeoutNs % 1'000'000'000)};
+    int count = epoll_pwait2(epoll_, events, 64, &timeout, nullptr);
+    for (int i = 0; i < count; ++i) {
+      Session &session = *static_cast<Session *>(events[i].data.ptr);
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        receive(session, measureFrom, sending);
+      }
+      if (events[i].events & EPOLLOUT) {
+        flush(session);
+      }
+    }
+    for (Session *session : dirty_) {
+      flush(*session);
+    }
+    dirty_.clear();
+  }
+
+  Session *nextWritable() {
+    for (size_t tried = 0; tried < sessions_.size(); ++tried) {
+      Session &session = *sessions_[cursor_++ % sessions_.size()];
+      if (canSend(session)) {
+        return &session;
+      }
+    }
+    return nullptr;
+  }
+
+  void load(int64_t start) {
+    padding_.assign(options_.pad, 'x');
+    int64_t measureFrom = start + static_cast<int64_t>(options_.warmup * 1e9);
+    int64_t end = measureFrom + static_cast<int64_t>(options_.duration * 1e9);
+    double interval = 1e9 / threadRate_; // Nanoseconds between two sends
+    uint64_t scheduled = 0;
+
+    if (options_.window > 0) {
+      for (auto &session : sessions_) {
+        for (unsigned i = 0; i < options_.window && canSend(*session); ++i) {
+          send(*session, nowNs());
+        }
+      }
+    }
+
+    for (int64_t now = nowNs(); now < end; now = nowNs()) {
+      int64_t timeout = 100'000'000;
+      if (options_.window == 0) {
+        // Catch up with the schedule; without --co-safe a late message
+        // is stamped when it finally goes out, hiding the delay
+        for (size_t burst = 0; burst < MAX_BURST; ++burst) {
+          int64_t due = start + static_cast<int64_t>(scheduled * interval);
+          if (due > now) {
+            break;
+          }
+          Session *session = nextWritable();
+          if (session == nullptr) {
+            break; // Every write buffer is full; the schedule waits
+          }
+          send(*session, options_.coSafe ? due : nowNs());
+          ++scheduled;
+        }
+        int64_t next = start + static_cast<int64_t>(scheduled * interval);
+        timeout = std::clamp<int64_t>(next - nowNs(), 0, timeout);
+      }
+      poll(timeout, measureFrom, true);
+    }
+
+    // Collect the replies still in flight
+    int64_t drainEnd = nowNs() + 1'000'000'000;
+    while (received.load() < sent.load() && nowNs() < drainEnd) {
+      poll(10'000'000, measureFrom, false);
+    }
+  }
+
+  const Options &options_;
+  std::vector<std::unique_ptr<Session>> sessions_;
+  std::vector<Session *> dirty_;
+  LatencyHistogram histogram_;
+  std::string padding_;
+  double threadRate_;
+  size_t mixCursor_;
+  size_t cursor_ = 0;
+  size_t loggedOn_ = 0;
+  size_t failed_ = 0;
+  int epoll_ = -1;
+};
+
+void usage(const char *program) {
+  std::printf(
+      "usage: %s [options]\n"
+      "  -H, --host ADDR      server address (127.0.0.1)\n"
+      "  -p, --port N         server port (8080)\n"
+      "  -s, --sessions N     FIX sessions (100)\n"
+      "  -t, --threads N      epoll threads (4)\n"
+      "  -r, --rate N         open loop: messages per second in total (10000)\n"
+      "  -w, --window N       closed loop: messages in flight per session\n"
+      "  -d, --duration S     measured seconds (10)\n"
+      "  -W, --warmup S       seconds before measuring (2)\n"
+      "  -m, --mix LIST       MsgType weights, e.g. D=70,F=20,G=10 (D)\n"
+      "  -P, --pad N          bytes of Text (58) added to each message (0)\n"
+      "  -c, --co-safe        measure from the scheduled send time\n"
+      "  -x, --pairs          session 2n and 2n+1 send to each other\n"
+      "  -n, --prefix TEXT    SenderCompID prefix (LG)\n",
+      program);
+}
+
+bool parseMix(std::string_view text, std::vector<std::string> &mix) {
+  mix.clear();
+  while (!text.empty()) {
+    size_t comma = text.find(',');
+    std::string_view item = text.substr(0, comma);
+    text = comma == std::string_view::npos ? std::string_view()
+                                           : text.substr(comma + 1);
+    size_t eq = item.find('=');
+    unsigned weight = 1;
+    if (eq != std::string_view::npos) {
+      std::string_view digits = item.substr(eq + 1);
+      if (std::from_chars(digits.data(), digits.data() + digits.size(), weight)
+                  .ptr != digits.data() + digits.size() ||
+          weight == 0 || weight > 1000) {
+        return false;
+      }
+    }
+    std::string msgType(item.substr(0, eq));
+    if (msgType.empty() || msgType == "A" || msgType == "2") {
+      return false; // Session messages are handled by the router itself
+    }
+    mix.insert(mix.end(), weight, msgType);
+  }
+  // Interleave the types so every window of the cycle follows the weights
+  std::vector<std::string> spread(mix.size());
+  for (size_t i = 0, stride = 7; i < mix.size(); ++i) {
+    while (std::gcd(stride, mix.size()) != 1) {
+      ++stride;
+    }
+    spread[(i * stride) % mix.size()] = mix[i];
+  }
+  mix = std::move(spread);
+  return !mix.empty();
+}
+
+double us(uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  static const option longOptions[] = {
+      {"host", required_argument, nullptr, 'H'},
+      {"port", required_argument, nullptr, 'p'},
+      {"sessions", required_argument, nullptr, 's'},
+      {"threads", required_argument, nullptr, 't'},
+      {"rate", required_argument, nullptr, 'r'},
+      {"window", required_argument, nullptr, 'w'},
+      {"duration", required_argument, nullptr, 'd'},
+      {"warmup", required_argument, nullptr, 'W'},
+      {"mix", required_argument, nullptr, 'm'},
+      {"pad", required_argument, nullptr, 'P'},
+      {"co-safe", no_argument, nullptr, 'c'},
+      {"pairs", no_argument, nullptr, 'x'},
+      {"prefix", required_argument, nullptr, 'n'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "H:p:s:t:r:w:d:W:m:P:cxn:h",
+                            longOptions, nullptr)) != -1) {
+    switch (opt) {
+    case 'H':
+      options.host = optarg;
+      break;
+    case 'p':
+      options.port = static_cast<uint16_t>(std::atoi(optarg));
+      break;
+    case 's':
+      options.sessions = std::atoi(optarg);
+      break;
+    case 't':
+      options.threads = std::atoi(optarg);
+      break;
+    case 'r':
+      options.rate = std::atof(optarg);
+      break;
+    case 'w':
+      options.window = static_cast<unsigned>(std::atoi(optarg));
+      break;
+    case 'd':
+      options.duration = std::atof(optarg);
+      break;
+    case 'W':
+      options.warmup = std::atof(optarg);
+      break;
+    case 'm':
+      if (!parseMix(optarg, options.mix)) {
+        std::fprintf(stderr, "invalid message mix %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'P':
+      options.pad = static_cast<size_t>(std::atol(optarg));
+      break;
+    case 'c':
+      options.coSafe = true;
+      break;
+    case 'x':
+      options.pairs = true;
+      break;
+    case 'n':
+      options.prefix = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (options.sessions <= 0 || options.threads <= 0 || options.port == 0 ||
+      options.rate <= 0 || options.duration <= 0 || options.warmup < 0 ||
+      options.pad > SESSION_BUFFER / 4 || (options.pairs && options.sessions % 2)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (options.window > 0 && options.coSafe) {
+    std::fprintf(stderr, "--co-safe needs a send schedule, ignored in closed "
+                         "loop\n");
+  }
+  options.threads = std::min(options.threads, options.sessions);
+
+  // Contiguous blocks, even-sized so both sessions of a pair share a thread
+  std::vector<std::unique_ptr<LoadThread>> loaders;
+  int block = (options.sessions + options.threads - 1) / options.threads;
+  block += options.pairs && block % 2;
+  for (int first = 0; first < options.sessions; first += block) {
+    loaders.push_back(std::make_unique<LoadThread>(
+        options, first, std::min(block, options.sessions - first)));
+  }
+
+  std::latch ready(static_cast<std::ptrdiff_t>(loaders.size()));
+  std::atomic<int64_t> start{0};
+  std::vector<std::jthread> threads;
+  for (auto &loader : loaders) {
+    threads.emplace_back([&, loader = loader.get()]() { loader->run(ready, start); });
+  }
+  ready.wait();
+
+  size_t loggedOn = 0;
+  for (auto &loader : loaders) {
+    loggedOn += loader->loggedOn();
+  }
+  std::printf("%zu of %d sessions logged on, %zu threads, %s\n", loggedOn,
+              options.sessions, loaders.size(),
+              options.window > 0 ? "closed loop"
+              : options.coSafe   ? "open loop, coordinated-omission safe"
+                                 : "open loop");
+  if (loggedOn == 0) {
+    start = 1; // Releases the threads, which have nothing to send
+    start.notify_all();
+    return 1;
+  }
+
+  start = nowNs();
+  start.notify_all();
+
+  // One progress line per second while the load runs
+  auto totals = [&](uint64_t &sent, uint64_t &received) {
+    sent = received = 0;
+    for (auto &loader : loaders) {
+      sent += loader->sent.load(std::memory_order_relaxed);
+      received += loader->received.load(std::memory_order_relaxed);
+    }
+  };
+  uint64_t lastReceived = 0;
+  double total = options.warmup + options.duration;
+  for (int second = 1; second <= static_cast<int>(total); ++second) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    uint64_t sent, received;
+    totals(sent, received);
+    std::printf("%4ds sent %10llu received %10llu %10llu msg/s\n", second,
+                static_cast<unsigned long long>(sent),
+                static_cast<unsigned long long>(received),
+                static_cast<unsigned long long>(received - lastReceived));
+    std::fflush(stdout);
+    lastReceived = received;
+  }
+  threads.clear();
+
+  LatencyHistogram histogram;
+  for (auto &loader : loaders) {
+    histogram.merge(loader->histogram());
+  }
+  uint64_t sent, received;
+  totals(sent, received);
+  std::printf("sent %llu, received %llu, lost %llu\n",
+              static_cast<unsigned long long>(sent),
+              static_cast<unsigned long long>(received),
+              static_cast<unsigned long long>(sent - std::min(sent, received)));
+  std::printf("measured %llu messages, %.0f msg/s\n",
+              static_cast<unsigned long long>(histogram.count()),
+              static_cast<double>(histogram.count()) / options.duration);
+  std::printf("latency us: min %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f "
+              "p99.99 %.1f max %.1f mean %.1f\n",
+              us(histogram.min()), us(histogram.percentile(50)),
+              us(histogram.percentile(90)), us(histogram.percentile(99)),
+              us(histogram.percentile(99.9)), us(histogram.percentile(99.99)),
+              us(histogram.max()), histogram.mean() / 1000.0);
+  return 0;
+}
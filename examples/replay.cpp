@@ -0,0 +1,172 @@
+// Replays capture files through a worker's parser and handlers.
+//
+// A GeneralRouter started with --capture DIR keeps the raw bytes each
+// worker read from its sockets in DIR/worker-<n>.capture. This tool maps
+// the files given, merges their reads by time (fds are unique across the
+// workers of a process, and sessions routed between workers need both
+// sides) and feeds every read, in order, to one WorkerThread through
+// WorkerThread::replay(): frames are parsed from the same read buffers,
+// handled by the same session and routing code and written out through the
+// same gathering writes as live, into /dev/null instead of sockets. The
+// original pacing between reads is kept unless --fast is given, so a
+// production burst can be rerun as it happened or as fast as the worker
+// goes, for regression runs on real traffic.
+#include "../src/capture.h"
+#include "../src/histogram.h"
+#include "../src/router.h"
+#include "../src/worker.h"
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::vector<std::string> paths;
+  bool fast = false;   // Ignore the captured pacing
+  int repeat = 1;      // Passes over the file
+  bool routed = true;  // Route between replayed sessions
+  std::string journal; // Journal directory, empty = off
+};
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "usage: %s [--fast] [--repeat N] [--no-route] [--journal DIR] "
+               "FILE...\n",
+               program);
+}
+
+double us(uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+// One captured read, pointing into the mapping of its file
+struct Read {
+  double ns; // Since the capture's clock origin
+  int fd;
+  std::string_view bytes;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  static const option longOptions[] = {
+      {"fast", no_argument, nullptr, 'f'},
+      {"repeat", required_argument, nullptr, 'r'},
+      {"no-route", no_argument, nullptr, 'n'},
+      {"journal", required_argument, nullptr, 'j'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "fr:nj:h", longOptions, nullptr)) !=
+         -1) {
+    switch (opt) {
+    case 'f':
+      options.fast = true;
+      break;
+    case 'r':
+      options.repeat = std::atoi(optarg);
+      break;
+    case 'n':
+      options.routed = false;
+      break;
+    case 'j':
+      options.journal = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind == argc || options.repeat <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  options.paths.assign(argv + optind, argv + argc);
+
+  std::vector<std::unique_ptr<CaptureFile>> files;
+  std::vector<Read> reads;
+  bool intact = true;
+  try {
+    for (const std::string &path : options.paths) {
+      files.push_back(std::make_unique<CaptureFile>(path));
+      const CaptureFile &file = *files.back();
+      intact = file.forEach([&](const CaptureRecord &record,
+                                std::string_view bytes) {
+        reads.push_back(Read{static_cast<double>(record.ticks) *
+                                 file.nsPerTick(),
+                             record.fd, bytes});
+      }) && intact;
+    }
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  std::stable_sort(reads.begin(), reads.end(),
+                   [](const Read &a, const Read &b) { return a.ns < b.ns; });
+
+  std::atomic<bool> shutdown{false};
+  Router router(1);
+  WorkerThread worker(shutdown);
+  if (options.routed) {
+    worker.attachRouter(router, 0);
+  }
+  JournalOptions journal;
+  journal.directory = options.journal;
+  worker.setJournal(journal);
+
+  uint64_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < options.repeat; ++pass) {
+    // Each pass starts over with the connections of the capture
+    auto passStart = std::chrono::steady_clock::now();
+    for (const Read &read : reads) {
+      if (!options.fast) {
+        std::this_thread::sleep_until(
+            passStart + std::chrono::nanoseconds(
+                            static_cast<int64_t>(read.ns - reads.front().ns)));
+      }
+      worker.replay(read.fd, read.bytes);
+      bytes += read.bytes.size();
+    }
+    worker.endReplay();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  const WorkerMetrics &metrics = worker.getMetrics();
+  double seconds = static_cast<double>(elapsed.count()) / 1e9;
+  std::printf("%zu files: %llu reads, %llu bytes in %.3f s%s\n", files.size(),
+              static_cast<unsigned long long>(reads.size() * options.repeat),
+              static_cast<unsigned long long>(bytes), seconds,
+              intact ? "" : " (a file ends in a damaged record)");
+  std::printf("messages in %llu, out %llu, invalid %llu, garbled streams "
+              "%llu, route drops %llu\n",
+              static_cast<unsigned long long>(metrics.messagesIn.load()),
+              static_cast<unsigned long long>(metrics.messagesOut.load()),
+              static_cast<unsigned long long>(metrics.invalidMessages.load() +
+                                              metrics.checksumErrors.load()),
+              static_cast<unsigned long long>(metrics.garbledStreams.load()),
+              static_cast<unsigned long long>(metrics.routeDrops.load()));
+  std::printf("%.0f msg/s, %.1f MB/s\n",
+              static_cast<double>(metrics.messagesIn.load()) / seconds,
+              static_cast<double>(bytes) / seconds / 1e6);
+
+  LatencyHistogram flush;
+  metrics.parseToFlush.snapshot(flush, MetricsClock::nsPerTick());
+  if (flush.count() > 0) {
+    std::printf("parse to flush us: p50 %.2f p99 %.2f p99.9 %.2f max %.2f\n",
+                us(flush.percentile(50)), us(flush.percentile(99)),
+                us(flush.percentile(99.9)), us(flush.max()));
+  }
+  return intact ? 0 : 1;
+}
@@ -9,9 +9,9 @@ int main() {
     // Create TCP client instance
     TCPClient client;
 
-    // Set up message handler
-    client.setMessageHandler([](const std::string& msg) {
-        std::cout << "Received: " << msg << std::endl;
+    // Set up frame handler, called once per complete FIX message
+    client.setFrameHandler([](const Message& msg) {
+        std::cout << "Received " << msg.msgType << ": " << msg.frame << std::endl;
     });
 
     // Connect to server
@@ -1,23 +1,277 @@
+#include "logger.h"
 #include "tcpserver.h"
+#include <charconv>
 #include <cstdlib>
-#include <iostream>
+#include <cstring>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+
+static void usage(const char *program) {
+  LOG_INFO("usage: {} [port] [acceptor|reuseport|reuseport-cpu] "
+           "[epoll|io_uring|io_uring-sqpoll] [zero-copy bytes] "
+           "[--workers N] [--cpus LIST] [--acceptor-cpu N] [--backlog N] "
+           "[--no-numa] [--spin-us N] [--busy-poll-us N] [--journal DIR] "
+           "[--journal-sync none|async|sync] [--journal-sync-ms N] "
+           "[--metrics-port N] [--high-watermark BYTES] "
+           "[--low-watermark BYTES] [--slow-consumer pause|disconnect] "
+           "[--timer-ms N] [--idle-timeout-ms N] [--capture DIR] "
+           "[--capture-mb N] [--rebalance RATIO] [--shutdown-ms N]",
+           program);
+}
+
+static TcpServer *runningServer = nullptr;
+
+static void onSignal(int) { runningServer->stop(); }
+
+static bool parseNumber(const char *text, long long &value) {
+  const char *end = text + strlen(text);
+  return *text != '\0' && std::from_chars(text, end, value).ptr == end;
+}
 
 int main(int argc, char *argv[]) {
-  int port = 8080;
-  if (argc >= 2) {
-    port = std::from_chars(argv[1], argv[1] + strlen(argv[1]), port).ptr ==
-                   argv[1] + strlen(argv[1])
-               ? port
-               : 8080;
-    if (port <= 0 || port > 65535) {
-      std::cerr << "Invalid port number. Port must be between 1 and 65535. use "
-                   "8080 as default"
-                << std::endl;
-      port = 8080;
+  ServerConfig config;
+
+  // Topology options, positional arguments keep their order below
+  static const option options[] = {
+      {"workers", required_argument, nullptr, 'w'},
+      {"cpus", required_argument, nullptr, 'c'},
+      {"acceptor-cpu", required_argument, nullptr, 'a'},
+      {"backlog", required_argument, nullptr, 'b'},
+      {"no-numa", no_argument, nullptr, 'n'},
+      {"spin-us", required_argument, nullptr, 's'},
+      {"busy-poll-us", required_argument, nullptr, 'p'},
+      {"journal", required_argument, nullptr, 'j'},
+      {"journal-sync", required_argument, nullptr, 'y'},
+      {"journal-sync-ms", required_argument, nullptr, 'i'},
+      {"metrics-port", required_argument, nullptr, 'm'},
+      {"high-watermark", required_argument, nullptr, 'H'},
+      {"low-watermark", required_argument, nullptr, 'L'},
+      {"slow-consumer", required_argument, nullptr, 'S'},
+      {"timer-ms", required_argument, nullptr, 'T'},
+      {"idle-timeout-ms", required_argument, nullptr, 'I'},
+      {"capture", required_argument, nullptr, 'C'},
+      {"capture-mb", required_argument, nullptr, 'M'},
+      {"rebalance", required_argument, nullptr, 'R'},
+      {"shutdown-ms", required_argument, nullptr, 'D'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+  int opt;
+  long long number;
+  while ((opt = getopt_long(argc, argv, "w:c:a:b:ns:p:j:y:i:m:H:L:S:T:I:C:M:R:D:h", options, nullptr)) != -1) {
+    switch (opt) {
+    case 'w':
+      if (!parseNumber(optarg, number) || number <= 0 || number > 4096) {
+        LOG_WARN("Invalid worker count {}, use one per CPU", optarg);
+      } else {
+        config.workers = static_cast<int>(number);
+      }
+      break;
+    case 'c':
+      if (!CpuTopology::parseCpuList(optarg, config.workerCpus)) {
+        LOG_WARN("Invalid CPU list {}, workers stay unpinned", optarg);
+        config.workerCpus.clear();
+      }
+      break;
+    case 'a':
+      if (!parseNumber(optarg, number) || number < 0) {
+        LOG_WARN("Invalid acceptor CPU {}, acceptor stays unpinned", optarg);
+      } else {
+        config.acceptorCpu = static_cast<int>(number);
+      }
+      break;
+    case 'b':
+      if (!parseNumber(optarg, number) || number <= 0) {
+        LOG_WARN("Invalid backlog {}, use {}", optarg, config.backlog);
+      } else {
+        config.backlog = static_cast<int>(number);
+      }
+      break;
+    case 'n':
+      config.numaLocal = false;
+      break;
+    case 's':
+      if (!parseNumber(optarg, number) || number < 0) {
+        LOG_WARN("Invalid spin time {}, workers block for events", optarg);
+      } else {
+        config.poll.spin = std::chrono::microseconds(number);
+      }
+      break;
+    case 'p':
+      if (!parseNumber(optarg, number) || number < 0 || number > INT32_MAX) {
+        LOG_WARN("Invalid busy poll time {}, SO_BUSY_POLL stays off", optarg);
+      } else {
+        config.poll.socketBusyPollUs = static_cast<int>(number);
+      }
+      break;
+    case 'j':
+      config.journal.directory = optarg;
+      break;
+    case 'y':
+      if (std::string_view(optarg) == "async") {
+        config.journal.sync = JournalSync::Async;
+      } else if (std::string_view(optarg) == "sync") {
+        config.journal.sync = JournalSync::Sync;
+      } else if (std::string_view(optarg) != "none") {
+        LOG_WARN("Unknown journal sync {}, use none as default", optarg);
+      }
+      break;
+    case 'i':
+      if (!parseNumber(optarg, number) || number < 0) {
+        LOG_WARN("Invalid journal sync interval {}, sync every batch", optarg);
+      } else {
+        config.journal.syncInterval = std::chrono::milliseconds(number);
+      }
+      break;
+    case 'm':
+      if (!parseNumber(optarg, number) || number <= 0 || number > 65535) {
+        LOG_WARN("Invalid metrics port {}, metrics stay off", optarg);
+      } else {
+        config.metricsPort = static_cast<uint16_t>(number);
+      }
+      break;
+    case 'H':
+      if (!parseNumber(optarg, number) || number <= 0) {
+        LOG_WARN("Invalid high watermark {}, use {}", optarg,
+                 config.flowControl.highWatermark);
+      } else {
+        config.flowControl.highWatermark = static_cast<size_t>(number);
+      }
+      break;
+    case 'L':
+      if (!parseNumber(optarg, number) || number < 0) {
+        LOG_WARN("Invalid low watermark {}, use {}", optarg,
+                 config.flowControl.lowWatermark);
+      } else {
+        config.flowControl.lowWatermark = static_cast<size_t>(number);
+      }
+      break;
+    case 'S':
+      if (std::string_view(optarg) == "disconnect") {
+        config.flowControl.overflow = FlowControl::Overflow::Disconnect;
+      } else if (std::string_view(optarg) != "pause") {
+        LOG_WARN("Unknown slow consumer policy {}, use pause as default",
+                 optarg);
+      }
+      break;
+    case 'T':
+      if (!parseNumber(optarg, number) || number <= 0) {
+        LOG_WARN("Invalid timer resolution {}, use {} ms", optarg,
+                 config.timers.resolution.count());
+      } else {
+        config.timers.resolution = std::chrono::milliseconds(number);
+      }
+      break;
+    case 'I':
+      if (!parseNumber(optarg, number) || number < 0) {
+        LOG_WARN("Invalid idle timeout {}, idle connections stay open", optarg);
+      } else {
+        config.timers.idleTimeout = std::chrono::milliseconds(number);
+      }
+      break;
+    case 'C':
+      config.capture.directory = optarg;
+      break;
+    case 'M':
+      if (!parseNumber(optarg, number) || number <= 0 || number > 1 << 20) {
+        LOG_WARN("Invalid capture size {}, use {} MB", optarg,
+                 config.capture.ringBytes >> 20);
+      } else {
+        config.capture.ringBytes = static_cast<size_t>(number) << 20;
+      }
+      break;
+    case 'R': {
+      char *end;
+      double ratio = std::strtod(optarg, &end);
+      if (*optarg == '\0' || *end != '\0' || !(ratio == 0 || ratio > 1)) {
+        LOG_WARN("Invalid rebalance ratio {}, use {}", optarg,
+                 config.balance.imbalance);
+      } else {
+        config.balance.imbalance = ratio;
+      }
+      break;
+    }
+    case 'D':
+      if (!parseNumber(optarg, number) || number < 0) {
+        LOG_WARN("Invalid shutdown timeout {}, use {} ms", optarg,
+                 config.shutdownTimeout.count());
+      } else {
+        config.shutdownTimeout = std::chrono::milliseconds(number);
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (config.flowControl.lowWatermark > config.flowControl.highWatermark) {
+    LOG_WARN("Low watermark {} above the high watermark, use {}",
+             config.flowControl.lowWatermark,
+             config.flowControl.highWatermark / 4);
+    config.flowControl.lowWatermark = config.flowControl.highWatermark / 4;
+  }
+  char **args = argv + optind;
+  int count = argc - optind;
+
+  if (count >= 1) {
+    if (!parseNumber(args[0], number) || number <= 0 || number > 65535) {
+      LOG_WARN("Invalid port number. Port must be between 1 and 65535. use "
+               "8080 as default");
+    } else {
+      config.port = static_cast<uint16_t>(number);
+    }
+  }
+
+  // Optional second argument selects how connections are accepted
+  if (count >= 2) {
+    std::string_view name = args[1];
+    if (name == "reuseport") {
+      config.acceptMode = AcceptMode::ReusePort;
+    } else if (name == "reuseport-cpu") {
+      config.acceptMode = AcceptMode::ReusePortCpu;
+    } else if (name != "acceptor") {
+      LOG_WARN("Unknown accept mode {}, use acceptor as default", name);
+    }
+  }
+
+  // Optional third argument selects the event loop of the workers
+  if (count >= 3) {
+    std::string_view name = args[2];
+    if (name == "io_uring") {
+      config.engine = IoEngineType::IoUring;
+    } else if (name == "io_uring-sqpoll") {
+      config.engine = IoEngineType::IoUringSqPoll;
+    } else if (name != "epoll") {
+      LOG_WARN("Unknown I/O engine {}, use epoll as default", name);
+    }
+  }
+
+  // Optional fourth argument enables zero-copy sends from that many bytes
+  if (count >= 4) {
+    if (!parseNumber(args[3], number) || number < 0) {
+      LOG_WARN("Invalid zero-copy threshold {}, zero-copy stays off", args[3]);
+    } else {
+      config.zeroCopyMinBytes = static_cast<size_t>(number);
     }
   }
 
-  TcpServer server(port);
+  // Only this thread takes SIGINT and SIGTERM: the workers inherit the
+  // blocked mask, so the signal interrupts the accept loop's wait
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  TcpServer server(config);
+  runningServer = &server;
+  struct sigaction action {};
+  action.sa_handler = onSignal;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
   server.run();
+  // The server flushes its connections on the way out
+  LOG_INFO("Shutting down");
   return 0;
-}
\ No newline at end of file
+}
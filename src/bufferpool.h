@@ -0,0 +1,204 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "circularbuffer.h"
+#include "logger.h"
+
+/**
+ * @brief Per-worker cache of mirrored CircularBuffers grouped by size class
+ *
+ * Size classes grow by a factor of four from minSize to maxSize (4 KB, 16 KB,
+ * 64 KB, 256 KB and 1 MB by default). Connections start without buffers,
+ * take the smallest class on first use and move up one class at a time only
+ * when a buffer actually fills. Released buffers are kept on per-class free
+ * lists, so steady-state churn never maps or unmaps memory.
+ *
+ * A pool is owned by a single worker thread and is not thread-safe.
+ */
+class BufferPool {
+public:
+  struct Options {
+    size_t minSize = 4 * 1024;        // Smallest size class
+    size_t maxSize = 1024 * 1024;     // Largest size class
+    size_t maxCachedBytes = 64 << 20; // Free-list budget across classes
+    bool hugePages = false; // Back classes of 2 MB and up with hugetlbfs
+  };
+
+  BufferPool() : BufferPool(Options()) {}
+
+  explicit BufferPool(const Options &options)
+      : options_(options),
+        pageSize_(static_cast<size_t>(sysconf(_SC_PAGESIZE))) {
+    if (options_.minSize == 0 || options_.maxSize < options_.minSize) {
+      throw std::invalid_argument("Invalid buffer pool size classes");
+    }
+    for (size_t size = options_.minSize;; size *= GROWTH) {
+      classSizes_.push_back(std::min(size, options_.maxSize));
+      if (size >= options_.maxSize) {
+        break;
+      }
+    }
+    freeLists_.resize(classSizes_.size());
+  }
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+  BufferPool(BufferPool &&) = default;
+  BufferPool &operator=(BufferPool &&) = default;
+
+  /**
+   * @brief Returns an empty buffer of the smallest class holding minCapacity
+   * @throws runtime_error if minCapacity exceeds the largest class or the
+   * mapping fails
+   */
+  CircularBuffer acquire(size_t minCapacity) {
+    size_t index = classIndex(minCapacity);
+    if (index == classSizes_.size()) {
+      throw std::runtime_error("Requested buffer exceeds largest size class");
+    }
+    return acquireClass(index);
+  }
+
+  /**
+   * @brief Returns a buffer to its class free list
+   *
+   * The buffer is left without storage. Buffers that do not belong to a
+   * class of this pool, that exceed the cache budget or that still have
+   * bytes pinned by a zero-copy send are unmapped; the kernel keeps its own
+   * references to pinned pages, so they must never be handed out again.
+   */
+  void release(CircularBuffer &buffer) {
+    if (buffer.capacity() == 0) {
+      return;
+    }
+    size_t index = classIndex(buffer.capacity());
+    if (buffer.pinnedSize() == 0 && index < classSizes_.size() &&
+        buffer.capacity() == mappedSize(index) &&
+        cachedBytes_ + buffer.capacity() <= options_.maxCachedBytes) {
+      buffer.reset();
+      cachedBytes_ += buffer.capacity();
+      freeLists_[index].push_back(std::move(buffer));
+    }
+    buffer = CircularBuffer();
+  }
+
+  /**
+   * @brief Makes sure a buffer has storage, taking the smallest class
+   */
+  void ensureAllocated(CircularBuffer &buffer) {
+    if (buffer.capacity() == 0) {
+      buffer = acquireClass(0);
+    }
+  }
+
+  /**
+   * @brief Replaces a buffer with one of the next class, keeping its data
+   * @return false if the buffer already is of the largest class or has
+   * bytes pinned by a zero-copy send
+   */
+  bool grow(CircularBuffer &buffer) {
+    if (buffer.capacity() == 0) {
+      buffer = acquireClass(0);
+      return true;
+    }
+    size_t index = classIndex(buffer.capacity());
+    if (index + 1 >= classSizes_.size()) {
+      return false;
+    }
+    CircularBuffer larger = acquireClass(index + 1);
+    if (!buffer.transferTo(larger)) {
+      release(larger); // Pinned bytes keep the buffer in place for now
+      return false;
+    }
+    release(buffer);
+    buffer = std::move(larger);
+    return true;
+  }
+
+  /**
+   * @brief Grows a buffer until at least bytes of free space are available
+   * @return false if even the largest class cannot hold them
+   */
+  bool ensureSpace(CircularBuffer &buffer, size_t bytes) {
+    ensureAllocated(buffer);
+    while (buffer.availableSpace() < bytes) {
+      if (!grow(buffer)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Gives the storage of an empty buffer back to the pool
+   * @return true if the buffer was released
+   */
+  bool trim(CircularBuffer &buffer) {
+    if (buffer.capacity() == 0 || !buffer.empty() ||
+        buffer.pinnedSize() > 0) {
+      return false;
+    }
+    release(buffer);
+    return true;
+  }
+
+  size_t minSize() const { return classSizes_.front(); }
+  size_t maxSize() const { return classSizes_.back(); }
+  size_t cachedBytes() const { return cachedBytes_; }
+
+private:
+  static constexpr size_t GROWTH = 4;
+  static constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+  Options options_;
+  size_t pageSize_;
+  std::vector<size_t> classSizes_;
+  std::vector<std::vector<CircularBuffer>> freeLists_;
+  size_t cachedBytes_ = 0;
+
+  /**
+   * @brief Index of the smallest class of at least capacity bytes
+   */
+  size_t classIndex(size_t capacity) const {
+    size_t index = 0;
+    while (index < classSizes_.size() && mappedSize(index) < capacity) {
+      ++index;
+    }
+    return index;
+  }
+
+  bool useHugePages(size_t index) const {
+    return options_.hugePages && classSizes_[index] >= HUGE_PAGE;
+  }
+
+  /**
+   * @brief Actual capacity of buffers in a class after page rounding
+   */
+  size_t mappedSize(size_t index) const {
+    size_t page = useHugePages(index) ? HUGE_PAGE : pageSize_;
+    return (classSizes_[index] + page - 1) / page * page;
+  }
+
+  CircularBuffer acquireClass(size_t index) {
+    std::vector<CircularBuffer> &freeList = freeLists_[index];
+    if (!freeList.empty()) {
+      CircularBuffer buffer = std::move(freeList.back());
+      freeList.pop_back();
+      cachedBytes_ -= buffer.capacity();
+      return buffer;
+    }
+    if (useHugePages(index)) {
+      try {
+        return CircularBuffer(classSizes_[index],
+                              BufferMode::MirroredHugePages);
+      } catch (const std::runtime_error &e) {
+        LOG_WARN("Hugepage buffer unavailable, using regular pages: {}",
+                 e.what());
+      }
+    }
+    return CircularBuffer(classSizes_[index], BufferMode::Mirrored);
+  }
+};
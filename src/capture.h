@@ -0,0 +1,316 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mappedfile.h"
+
+/**
+ * @brief Settings of the inbound byte capture, one ring file per worker
+ */
+struct CaptureOptions {
+  std::string directory;                // Empty = capture off
+  size_t ringBytes = 256 * 1024 * 1024; // Captured bytes kept per worker
+};
+
+/**
+ * @brief Header of one record in a capture ring
+ * The bytes of the read follow it; records start on 8-byte boundaries.
+ */
+struct CaptureRecord {
+  static constexpr int32_t PADDING = -1; // Fills the ring up to its end
+
+  uint64_t ticks = 0; // MetricsClock ticks when the read completed
+  int32_t fd = 0;     // Connection the bytes were read from
+  uint32_t length = 0; // Bytes read, 0 when the connection was closed
+};
+static_assert(sizeof(CaptureRecord) == 16);
+
+/**
+ * @brief Layout of a capture file: a header page, then the ring
+ *
+ * head and tail count bytes ever written and dropped from the ring; the
+ * records between them, at (offset % capacity), are the ones still held.
+ */
+struct CaptureFileHeader {
+  static constexpr char MAGIC[8] = {'G', 'R', 'C', 'A', 'P', 'T', '0', '1'};
+  static constexpr size_t SIZE = 4096; // The ring starts on the next page
+
+  char magic[8] = {};
+  uint64_t capacity = 0; // Ring bytes, a multiple of 8
+  double nsPerTick = 1;  // Converts record ticks to nanoseconds
+  uint64_t tail = 0;     // Oldest record still in the ring
+  uint64_t head = 0;     // End of the newest complete record
+};
+
+/**
+ * @brief Memory-mapped ring of the raw bytes a worker read from its sockets
+ *
+ * Every read is appended as a (ticks, fd, length) record followed by its
+ * bytes, straight into the shared mapping of a pre-allocated file, so the
+ * capture costs one memcpy per read and never a system call; the kernel
+ * writes the pages back. When the ring is full the oldest records are
+ * dropped, so the file always holds the latest ringBytes of traffic. The
+ * header's head is advanced only after a record is complete, so a file
+ * left by a crashed process still reads back up to its last whole read.
+ *
+ * Owned by a single worker thread.
+ */
+class CaptureLog {
+public:
+  static constexpr size_t MIN_RING_BYTES = 4 * 1024 * 1024;
+
+  /**
+   * @brief Creates (or truncates) "<directory>/worker-<index>.capture"
+   * @param nsPerTick Nanoseconds per record tick, stored for replays
+   * @throws runtime_error if the file cannot be created or mapped
+   */
+  CaptureLog(const CaptureOptions &options, uint32_t index, double nsPerTick)
+      : capacity_(std::max(options.ringBytes, MIN_RING_BYTES) & ~size_t(7)) {
+    if (mkdir(options.directory.c_str(), 0755) == -1 && errno != EEXIST) {
+      fail("mkdir " + options.directory);
+    }
+    path_ = options.directory + "/worker-" + std::to_string(index) + ".capture";
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ == -1) {
+      fail("open " + path_);
+    }
+    size_t bytes = CaptureFileHeader::SIZE + capacity_;
+    if (!allocateFile(fd_, bytes)) {
+      int error = errno;
+      ::close(fd_);
+      unlink(path_.c_str());
+      errno = error;
+      fail("allocate " + path_);
+    }
+    void *address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd_, 0);
+    if (address == MAP_FAILED) {
+      ::close(fd_);
+      fail("mmap " + path_);
+    }
+    mapping_ = static_cast<char *>(address);
+    header_ = new (mapping_) CaptureFileHeader();
+    header_->capacity = capacity_;
+    header_->nsPerTick = nsPerTick;
+    ring_ = mapping_ + CaptureFileHeader::SIZE;
+    // Written last, so a reader never takes a half-set header for valid
+    std::memcpy(header_->magic, CaptureFileHeader::MAGIC, sizeof(header_->magic));
+  }
+
+  ~CaptureLog() {
+    munmap(mapping_, CaptureFileHeader::SIZE + capacity_);
+    ::close(fd_);
+  }
+
+  CaptureLog(const CaptureLog &) = delete;
+  CaptureLog &operator=(const CaptureLog &) = delete;
+
+  /**
+   * @brief Appends one read, given as consecutive parts
+   * @return false if the read is too large for the ring and was dropped
+   */
+  bool append(uint64_t ticks, int fd, std::span<const std::string_view> parts) {
+    size_t length = 0;
+    for (std::string_view part : parts) {
+      length += part.size();
+    }
+    size_t size = recordSize(length);
+    if (size > capacity_ / 2) {
+      ++dropped_;
+      return false;
+    }
+    char *out = reserve(size);
+    CaptureRecord record{ticks, fd, static_cast<uint32_t>(length)};
+    std::memcpy(out, &record, sizeof(record));
+    out += sizeof(record);
+    for (std::string_view part : parts) {
+      std::memcpy(out, part.data(), part.size());
+      out += part.size();
+    }
+    publish(size);
+    return true;
+  }
+
+  bool append(uint64_t ticks, int fd, std::string_view bytes) {
+    return append(ticks, fd, std::span<const std::string_view>(&bytes, 1));
+  }
+
+  /**
+   * @brief Records that a connection was closed, so a replay drops it too
+   */
+  void closed(uint64_t ticks, int fd) {
+    append(ticks, fd, std::span<const std::string_view>());
+  }
+
+  /** @brief Reads dropped for not fitting the ring */
+  uint64_t dropped() const { return dropped_; }
+
+  const std::string &path() const { return path_; }
+
+  static size_t recordSize(size_t length) {
+    return (sizeof(CaptureRecord) + length + 7) & ~size_t(7);
+  }
+
+private:
+  // Makes room for size contiguous bytes at the head, dropping old records
+  char *reserve(size_t size) {
+    size_t at = head_ % capacity_;
+    if (capacity_ - at < size) {
+      size_t rest = capacity_ - at;
+      makeRoom(rest);
+      // A filler too short for a header is implied by its length
+      if (rest >= sizeof(CaptureRecord)) {
+        CaptureRecord padding{0, CaptureRecord::PADDING,
+                              static_cast<uint32_t>(rest - sizeof(CaptureRecord))};
+        std::memcpy(ring_ + at, &padding, sizeof(padding));
+      }
+      publish(rest);
+      at = 0;
+    }
+    makeRoom(size);
+    return ring_ + at;
+  }
+
+  void makeRoom(size_t size) {
+    while (head_ + size - tail_ > capacity_) {
+      size_t at = tail_ % capacity_;
+      size_t rest = capacity_ - at;
+      if (rest < sizeof(CaptureRecord)) {
+        tail_ += rest;
+        continue;
+      }
+      CaptureRecord record;
+      std::memcpy(&record, ring_ + at, sizeof(record));
+      tail_ += recordSize(record.length);
+    }
+    header_->tail = tail_;
+  }
+
+  void publish(size_t size) {
+    head_ += size;
+    header_->head = head_;
+  }
+
+  [[noreturn]] static void fail(const std::string &what) {
+    throw std::runtime_error("Capture " + what + ": " + strerror(errno));
+  }
+
+  size_t capacity_;
+  std::string path_;
+  int fd_ = -1;
+  char *mapping_ = nullptr;
+  CaptureFileHeader *header_ = nullptr;
+  char *ring_ = nullptr;
+  uint64_t head_ = 0;
+  uint64_t tail_ = 0;
+  uint64_t dropped_ = 0;
+};
+
+/**
+ * @brief Read-only view of a capture file, for replays
+ */
+class CaptureFile {
+public:
+  /**
+   * @throws runtime_error if the file cannot be mapped or is no capture
+   */
+  explicit CaptureFile(const std::string &path) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ == -1) {
+      fail("open " + path);
+    }
+    struct stat info;
+    if (fstat(fd_, &info) == -1) {
+      ::close(fd_);
+      fail("stat " + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ < CaptureFileHeader::SIZE) {
+      ::close(fd_);
+      throw std::runtime_error("Capture " + path + " is truncated");
+    }
+    void *address = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (address == MAP_FAILED) {
+      ::close(fd_);
+      fail("mmap " + path);
+    }
+    mapping_ = static_cast<const char *>(address);
+    std::memcpy(&header_, mapping_, sizeof(header_));
+    if (std::memcmp(header_.magic, CaptureFileHeader::MAGIC,
+                    sizeof(header_.magic)) != 0 ||
+        header_.capacity % 8 != 0 ||
+        header_.capacity > size_ - CaptureFileHeader::SIZE ||
+        header_.head < header_.tail ||
+        header_.head - header_.tail > header_.capacity) {
+      munmap(const_cast<char *>(mapping_), size_);
+      ::close(fd_);
+      throw std::runtime_error("Capture " + path + " has no valid header");
+    }
+  }
+
+  ~CaptureFile() {
+    munmap(const_cast<char *>(mapping_), size_);
+    ::close(fd_);
+  }
+
+  CaptureFile(const CaptureFile &) = delete;
+  CaptureFile &operator=(const CaptureFile &) = delete;
+
+  double nsPerTick() const { return header_.nsPerTick; }
+
+  /** @brief Captured bytes held, record headers included */
+  uint64_t size() const { return header_.head - header_.tail; }
+
+  /**
+   * @brief Calls f(const CaptureRecord &, std::string_view bytes) for every
+   * record, oldest first
+   * @return false if a record is damaged; the ones before it were passed
+   */
+  template <typename F> bool forEach(F &&f) const {
+    const char *ring = mapping_ + CaptureFileHeader::SIZE;
+    uint64_t capacity = header_.capacity;
+    for (uint64_t offset = header_.tail; offset < header_.head;) {
+      size_t at = static_cast<size_t>(offset % capacity);
+      size_t rest = static_cast<size_t>(capacity) - at;
+      if (rest < sizeof(CaptureRecord)) {
+        offset += rest;
+        continue;
+      }
+      CaptureRecord record;
+      std::memcpy(&record, ring + at, sizeof(record));
+      size_t size = CaptureLog::recordSize(record.length);
+      if (size > rest || offset + size > header_.head) {
+        return false;
+      }
+      if (record.fd != CaptureRecord::PADDING) {
+        f(static_cast<const CaptureRecord &>(record),
+          std::string_view(ring + at + sizeof(record), record.length));
+      }
+      offset += size;
+    }
+    return true;
+  }
+
+private:
+  [[noreturn]] static void fail(const std::string &what) {
+    throw std::runtime_error("Capture " + what + ": " + strerror(errno));
+  }
+
+  int fd_ = -1;
+  size_t size_ = 0;
+  const char *mapping_ = nullptr;
+  CaptureFileHeader header_;
+};
@@ -0,0 +1,469 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Distance between atomics written by different threads
+constexpr size_t CACHE_LINE = 64;
+
+/**
+ * @brief Rounds a capacity up to the next power of two
+ */
+constexpr size_t roundUpPow2(size_t n) {
+  size_t result = 1;
+  while (result < n) {
+    result <<= 1;
+  }
+  return result;
+}
+
+/**
+ * @brief eventfd doorbell that wakes a consumer blocked in epoll or io_uring
+ *
+ * Producers only write to the eventfd on the transition from "nothing
+ * pending" to "something pending"; further notify() calls before the
+ * consumer has called clear() are a load and a fence. The consumer calls
+ * clear() before it drains its queues, so an item pushed while it drains
+ * either is seen by the drain or rings the bell again.
+ */
+class EventSignal {
+public:
+  EventSignal() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (fd_ == -1) {
+      throw std::runtime_error(std::string("eventfd failed: ") +
+                               strerror(errno));
+    }
+  }
+
+  EventSignal(const EventSignal &) = delete;
+  EventSignal &operator=(const EventSignal &) = delete;
+
+  ~EventSignal() { close(fd_); }
+
+  int fd() const { return fd_; }
+
+  /**
+   * @brief Wakes the consumer unless a wakeup is already pending
+   * Call after publishing the item the consumer should see.
+   */
+  void notify() {
+    // Orders the publication before the flag check; pairs with clear()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (pending_.load(std::memory_order_relaxed) ||
+        pending_.exchange(true, std::memory_order_acq_rel)) {
+      return;
+    }
+    uint64_t one = 1;
+    while (write(fd_, &one, sizeof(one)) == -1 && errno == EINTR) {
+    }
+  }
+
+  /**
+   * @brief Resets the eventfd, to be called before draining
+   */
+  void clear() {
+    uint64_t count;
+    while (read(fd_, &count, sizeof(count)) == -1 && errno == EINTR) {
+    }
+    pending_.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+private:
+  int fd_;
+  alignas(CACHE_LINE) std::atomic<bool> pending_{false};
+};
+
+/**
+ * @brief Lock-free single-producer single-consumer ring of byte records
+ *
+ * Records are variable-sized and always contiguous: a record that does not
+ * fit before the end of the ring is preceded by a padding record and placed
+ * at the start. Head and tail are free-running counters masked with the
+ * power-of-two capacity. Each side keeps a cached copy of the other side's
+ * counter on its own cache line and only reloads it when the cached value
+ * says the ring is full (producer) or empty (consumer).
+ */
+class alignas(CACHE_LINE) SpscRing {
+public:
+  /**
+   * @param capacity Ring size in bytes, rounded up to a power of two
+   */
+  explicit SpscRing(size_t capacity)
+      : capacity_(roundUpPow2(capacity < 64 ? 64 : capacity)),
+        mask_(capacity_ - 1), data_(new char[capacity_]) {}
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * @brief Largest record that can ever be written
+   */
+  size_t maxRecord() const { return capacity_ / 2 - HEADER; }
+
+  /**
+   * @brief Reserves a contiguous record of bytes, producer side
+   * @return Start of the record or nullptr if the ring is too full. The
+   * record becomes visible to the consumer with commit().
+   */
+  char *reserve(size_t bytes) {
+    if (bytes > maxRecord()) {
+      return nullptr;
+    }
+    size_t record = align(HEADER + bytes);
+    size_t pos = tail_ & mask_;
+    size_t padding = pos + record > capacity_ ? capacity_ - pos : 0;
+    if (!hasRoom(padding + record)) {
+      return nullptr;
+    }
+    if (padding > 0) {
+      writeHeader(pos, PADDING);
+      pos = 0;
+    }
+    writeHeader(pos, static_cast<uint32_t>(bytes));
+    pendingTail_ = tail_ + padding + record;
+    return data_.get() + pos + HEADER;
+  }
+
+  /**
+   * @brief Publishes the record returned by the last reserve()
+   */
+  void commit() {
+    tail_ = pendingTail_;
+    publishedTail_.store(tail_, std::memory_order_release);
+  }
+
+  /**
+   * @brief Copies bytes into a new record and publishes it
+   * @return false if the ring is too full
+   */
+  bool push(std::string_view bytes) {
+    char *record = reserve(bytes.size());
+    if (record == nullptr) {
+      return false;
+    }
+    std::memcpy(record, bytes.data(), bytes.size());
+    commit();
+    return true;
+  }
+
+  /**
+   * @brief Returns the oldest record, consumer side
+   * @return false if the ring is empty
+   */
+  bool front(std::string_view &record) {
+    while (true) {
+      if (head_ == cachedTail_) {
+        cachedTail_ = publishedTail_.load(std::memory_order_acquire);
+        if (head_ == cachedTail_) {
+          return false;
+        }
+      }
+      size_t pos = head_ & mask_;
+      uint32_t size;
+      std::memcpy(&size, data_.get() + pos, sizeof(size));
+      if (size == PADDING) {
+        head_ += capacity_ - pos;
+        continue;
+      }
+      record = std::string_view(data_.get() + pos + HEADER, size);
+      return true;
+    }
+  }
+
+  /**
+   * @brief Releases the record returned by front()
+   */
+  void pop() {
+    uint32_t size;
+    std::memcpy(&size, data_.get() + (head_ & mask_), sizeof(size));
+    head_ += align(HEADER + size);
+    publishedHead_.store(head_, std::memory_order_release);
+  }
+
+  /**
+   * @brief Bytes published and not yet released, padding and headers
+   * included; callable from any thread, approximate while either side runs
+   */
+  size_t queuedBytes() const {
+    size_t head = publishedHead_.load(std::memory_order_relaxed);
+    size_t tail = publishedTail_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  /**
+   * @brief Checks for published records, safe from the consumer only
+   */
+  bool empty() const {
+    return head_ == publishedTail_.load(std::memory_order_acquire);
+  }
+
+private:
+  static constexpr size_t HEADER = 8; // uint32_t size, padded for alignment
+  static constexpr uint32_t PADDING = UINT32_MAX;
+
+  static size_t align(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+  bool hasRoom(size_t bytes) {
+    if (tail_ + bytes - cachedHead_ <= capacity_) {
+      return true;
+    }
+    cachedHead_ = publishedHead_.load(std::memory_order_acquire);
+    return tail_ + bytes - cachedHead_ <= capacity_;
+  }
+
+  void writeHeader(size_t pos, uint32_t size) {
+    std::memcpy(data_.get() + pos, &size, sizeof(size));
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<char[]> data_;
+
+  // Producer line
+  alignas(CACHE_LINE) size_t tail_ = 0;
+  size_t pendingTail_ = 0;
+  size_t cachedHead_ = 0;
+  alignas(CACHE_LINE) std::atomic<size_t> publishedTail_{0};
+  // Consumer line
+  alignas(CACHE_LINE) size_t head_ = 0;
+  size_t cachedTail_ = 0;
+  alignas(CACHE_LINE) std::atomic<size_t> publishedHead_{0};
+};
+
+/**
+ * @brief Lock-free multi-producer single-consumer ring of byte records
+ *
+ * Records are laid out as in SpscRing. Producers claim space by advancing
+ * the shared tail with a CAS, copy their bytes in and publish the record by
+ * storing its size into the header with release order. Until then the
+ * header reads zero and the consumer stops in front of it, so records come
+ * out in the order their space was claimed. The consumer zeroes consumed
+ * space before handing it back, which keeps every unpublished header zero.
+ */
+class alignas(CACHE_LINE) MpscByteRing {
+public:
+  /**
+   * @param capacity Ring size in bytes, rounded up to a power of two
+   */
+  explicit MpscByteRing(size_t capacity)
+      : capacity_(roundUpPow2(capacity < 64 ? 64 : capacity)),
+        mask_(capacity_ - 1), data_(new char[capacity_]()) {}
+
+  MpscByteRing(const MpscByteRing &) = delete;
+  MpscByteRing &operator=(const MpscByteRing &) = delete;
+
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * @brief Largest record that can ever be written
+   */
+  size_t maxRecord() const { return capacity_ / 2 - HEADER; }
+
+  /**
+   * @brief Copies bytes into a new record, callable from any thread
+   * @return false if the ring is too full or bytes exceeds maxRecord()
+   */
+  bool push(std::string_view bytes) {
+    if (bytes.empty()) {
+      return true;
+    }
+    if (bytes.size() > maxRecord()) {
+      return false;
+    }
+    size_t record = align(HEADER + bytes.size());
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t pos;
+    size_t padding;
+    do {
+      pos = tail & mask_;
+      padding = pos + record > capacity_ ? capacity_ - pos : 0;
+      if (tail + padding + record - head_.load(std::memory_order_acquire) >
+          capacity_) {
+        return false;
+      }
+    } while (!tail_.compare_exchange_weak(tail, tail + padding + record,
+                                          std::memory_order_relaxed));
+    if (padding > 0) {
+      header(pos).store(PADDING, std::memory_order_release);
+      pos = 0;
+    }
+    std::memcpy(data_.get() + pos + HEADER, bytes.data(), bytes.size());
+    header(pos).store(static_cast<uint32_t>(bytes.size()),
+                      std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Returns up to count of the oldest published records, consumer
+   * side, without releasing them
+   * @return Number of records stored in records
+   */
+  size_t peek(std::string_view *records, size_t count) {
+    size_t found = 0;
+    size_t position = readHead_;
+    while (found < count) {
+      size_t pos = position & mask_;
+      uint32_t size = header(pos).load(std::memory_order_acquire);
+      if (size == 0) {
+        break;
+      }
+      if (size == PADDING) {
+        position += capacity_ - pos;
+        continue;
+      }
+      records[found++] = std::string_view(data_.get() + pos + HEADER, size);
+      position += align(HEADER + size);
+    }
+    return found;
+  }
+
+  /**
+   * @brief Returns the oldest published record, consumer side
+   * @return false if there is none
+   */
+  bool front(std::string_view &record) { return peek(&record, 1) == 1; }
+
+  /**
+   * @brief Releases the count oldest records returned by peek()
+   */
+  void pop(size_t count = 1) {
+    if (count == 0) {
+      return;
+    }
+    size_t start = readHead_;
+    while (count > 0) {
+      size_t pos = readHead_ & mask_;
+      uint32_t size = header(pos).load(std::memory_order_relaxed);
+      if (size == PADDING) {
+        readHead_ += capacity_ - pos;
+        continue;
+      }
+      readHead_ += align(HEADER + size);
+      --count;
+    }
+    // Zero the space in at most two pieces before producers may reuse it
+    size_t begin = start & mask_;
+    size_t length = readHead_ - start;
+    size_t first = std::min(length, capacity_ - begin);
+    std::memset(data_.get() + begin, 0, first);
+    std::memset(data_.get(), 0, length - first);
+    head_.store(readHead_, std::memory_order_release);
+  }
+
+  /**
+   * @brief Checks for published records, safe from the consumer only
+   */
+  bool empty() {
+    std::string_view record;
+    return !front(record);
+  }
+
+private:
+  static constexpr size_t HEADER = 8; // uint32_t size, padded for alignment
+  static constexpr uint32_t PADDING = UINT32_MAX;
+
+  static size_t align(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+  std::atomic_ref<uint32_t> header(size_t pos) {
+    return std::atomic_ref<uint32_t>(
+        *reinterpret_cast<uint32_t *>(data_.get() + pos));
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<char[]> data_; // Pointer from new, so 8-byte aligned
+  alignas(CACHE_LINE) std::atomic<size_t> tail_{0};
+  alignas(CACHE_LINE) std::atomic<size_t> head_{0};
+  size_t readHead_ = 0; // Consumer only, equals head_ between pops
+};
+
+/**
+ * @brief Bounded lock-free multi-producer single-consumer queue
+ *
+ * Each slot carries a sequence number telling producers whether it is free
+ * for the current lap and the consumer whether it has been filled, so
+ * producers only contend on the tail counter and never wait for each other.
+ */
+template <typename T> class MpscQueue {
+public:
+  /**
+   * @param capacity Number of slots, rounded up to a power of two
+   */
+  explicit MpscQueue(size_t capacity)
+      : capacity_(roundUpPow2(capacity < 2 ? 2 : capacity)),
+        mask_(capacity_ - 1), slots_(new Slot[capacity_]) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * @brief Appends a value, callable from any thread
+   * @return false if the queue is full
+   */
+  bool tryPush(T value) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = slots_[pos & mask_];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      auto lag = static_cast<std::ptrdiff_t>(sequence - pos);
+      if (lag == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          slot.value = std::move(value);
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false; // The consumer has not freed this slot yet
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief Removes the oldest value, consumer thread only
+   * @return false if the queue is empty
+   */
+  bool tryPop(T &value) {
+    Slot &slot = slots_[head_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+      return false;
+    }
+    value = std::move(slot.value);
+    slot.sequence.store(head_ + capacity_, std::memory_order_release);
+    ++head_;
+    return true;
+  }
+
+private:
+  struct alignas(CACHE_LINE) Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(CACHE_LINE) std::atomic<size_t> tail_{0};
+  alignas(CACHE_LINE) size_t head_ = 0;
+};
@@ -1,28 +1,66 @@
 #pragma once
 #include <cstring>
 #include <errno.h>
-#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <vector>
 
+#include "logger.h"
+
+/**
+ * @brief Storage layout used by a CircularBuffer
+ */
+enum class BufferMode {
+  Heap,             // Single heap allocation, views stop at the wrap point
+  Mirrored,         // Same pages mapped twice back to back, views never split
+  MirroredHugePages // Mirrored, backed by hugetlbfs pages
+};
+
 /**
  * @brief A zero-copy circular buffer implementation for efficient network I/O
  *
  * This class implements a circular (ring) buffer that provides zero-copy
  * read/write operations for network socket data. The buffer automatically
  * handles wrapping around when reaching the end of its capacity.
+ *
+ * In BufferMode::Mirrored the physical pages are mapped twice in a row, so
+ * buffer_[i] and buffer_[i + capacity_] alias the same byte. Every readable
+ * or writable region is then contiguous in virtual memory regardless of
+ * where head_ and tail_ sit relative to the wrap point.
  */
 class CircularBuffer {
 public:
+  /**
+   * @brief Constructs an empty buffer without storage
+   *
+   * Used for lazily allocated buffers; capacity() is 0 until a real buffer
+   * is moved in.
+   */
+  CircularBuffer()
+      : buffer_(nullptr), capacity_(0), head_(0), tail_(0), pinned_(0),
+        full_(false), mirrored_(false) {}
+
   /**
    * @brief Constructs a circular buffer with specified capacity
-   * @param capacity The size of the buffer in bytes
+   * @param capacity The size of the buffer in bytes. In mirrored modes it is
+   * rounded up to a multiple of the (huge) page size.
+   * @param mode Storage layout, see BufferMode
    * @throw std::bad_alloc if memory allocation fails
+   * @throw runtime_error if the mirrored mapping cannot be established
    */
-  explicit CircularBuffer(size_t capacity)
-      : buffer_(new char[capacity]), capacity_(capacity), head_(0), tail_(0),
-        full_(false) {
+  explicit CircularBuffer(size_t capacity, BufferMode mode = BufferMode::Heap)
+      : buffer_(nullptr), capacity_(capacity), head_(0), tail_(0), pinned_(0),
+        full_(false), mirrored_(mode != BufferMode::Heap) {
+    if (mirrored_) {
+      bool huge = mode == BufferMode::MirroredHugePages;
+      capacity_ = roundToPageSize(capacity, huge);
+      buffer_ = mapMirrored(capacity_, huge);
+    } else {
+      buffer_ = new char[capacity];
+    }
     if (!buffer_) {
       throw std::bad_alloc();
     }
@@ -35,26 +73,33 @@ public:
   // Add move operations
   CircularBuffer(CircularBuffer &&other) noexcept
       : buffer_(other.buffer_), capacity_(other.capacity_), head_(other.head_),
-        tail_(other.tail_), full_(other.full_) {
+        tail_(other.tail_), pinned_(other.pinned_), full_(other.full_),
+        mirrored_(other.mirrored_) {
     other.buffer_ = nullptr;
     other.capacity_ = 0;
+    other.head_ = other.tail_ = other.pinned_ = 0;
+    other.full_ = false;
   }
 
   CircularBuffer &operator=(CircularBuffer &&other) noexcept {
     if (this != &other) {
-      delete[] buffer_;
+      release();
       buffer_ = other.buffer_;
       capacity_ = other.capacity_;
       head_ = other.head_;
       tail_ = other.tail_;
+      pinned_ = other.pinned_;
       full_ = other.full_;
+      mirrored_ = other.mirrored_;
       other.buffer_ = nullptr;
       other.capacity_ = 0;
+      other.head_ = other.tail_ = other.pinned_ = 0;
+      other.full_ = false;
     }
     return *this;
   }
 
-  ~CircularBuffer() { delete[] buffer_; }
+  ~CircularBuffer() { release(); }
 
   /**
    * @brief Reads data from socket into buffer using zero-copy operations
@@ -73,7 +118,7 @@ public:
     }
 
     // Calculate optimal write size
-    size_t writeSize = std::min(available, capacity_ - tail_);
+    size_t writeSize = contiguousSpace(available);
     ssize_t bytesRead = read(socketFd, buffer_ + tail_, writeSize);
 
     if (bytesRead > 0) {
@@ -89,6 +134,34 @@ public:
     return bytesRead;
   }
 
+  /**
+   * @brief Reads data from socket into both free segments with one readv
+   * @param socketFd The socket file descriptor to read from
+   * @return Number of bytes read, -1 on error or when the buffer is full, 0
+   * on connection closed
+   * @note Near the wrap point this fills the tail and the head segment in a
+   * single system call instead of two separate reads
+   */
+  ssize_t writeFromSocketV(int socketFd) {
+    if (!buffer_) {
+      throw std::runtime_error("Buffer not initialized");
+    }
+
+    iovec iov[2];
+    int count = getWriteSegments(iov);
+    if (count == 0) {
+      return -1; // Buffer full
+    }
+
+    ssize_t bytesRead = readv(socketFd, iov, count);
+    if (bytesRead > 0) {
+      tail_ = (tail_ + bytesRead) % capacity_;
+      full_ = (tail_ == head_);
+    }
+
+    return bytesRead;
+  }
+
   /**
    * @brief Reads data from buffer into a string
    * @param length Number of bytes to read
@@ -109,16 +182,16 @@ public:
   ssize_t writeFromBytes(const char *data, size_t length) {
     size_t available = availableSpace();
     if (available <= 0) {
-      std::cerr << "Buffer full (capacity=" << capacity_ << ", head=" << head_
-                << ", tail=" << tail_ << ")" << std::endl;
+      LOG_WARN("Buffer full (capacity={}, head={}, tail={})", capacity_, head_,
+               tail_);
       return -1;
     }
 
     // Calculate contiguous writable space
-    size_t writeSize = std::min(available, capacity_ - tail_);
+    size_t writeSize = contiguousSpace(available);
     if (writeSize < length) {
-      std::cerr << "Data too large for buffer (data=" << length
-                << ", available=" << writeSize << ")" << std::endl;
+      LOG_WARN("Data too large for buffer (data={}, available={})", length,
+               writeSize);
       length = writeSize;
     }
 
@@ -126,7 +199,7 @@ public:
     tail_ = (tail_ + length) % capacity_;
     full_ = (tail_ == head_);
 
-    std::cout << "Wrote " << length << " bytes into buffer" << std::endl;
+    LOG_TRACE("Wrote {} bytes into buffer", length);
     return length;
   }
 
@@ -139,8 +212,8 @@ public:
   ssize_t writeFromByte(char data) {
     size_t available = availableSpace();
     if (available <= 0) {
-      std::cerr << "Buffer full (capacity=" << capacity_ << ", head=" << head_
-                << ", tail=" << tail_ << ")" << std::endl;
+      LOG_WARN("Buffer full (capacity={}, head={}, tail={})", capacity_, head_,
+               tail_);
       return -1;
     }
 
@@ -148,7 +221,7 @@ public:
     tail_ = (tail_ + 1) % capacity_;
     full_ = (tail_ == head_);
 
-    std::cout << "Wrote 1 byte into buffer" << std::endl;
+    LOG_TRACE("Wrote 1 byte into buffer");
     return 1;
   }
 
@@ -165,25 +238,93 @@ public:
   ssize_t readToSocket(int socketFd) {
     size_t available = dataSize();
     if (available <= 0) {
-      std::cerr << "Buffer empty, nothing to read" << std::endl;
+      LOG_DEBUG("Buffer empty, nothing to read");
       return -1;
     }
 
     // Calculate contiguous readable space
-    size_t readSize = std::min(available, capacity_ - head_);
+    size_t readSize = contiguousData(available);
     ssize_t bytesWritten = write(socketFd, buffer_ + head_, readSize);
 
     if (bytesWritten > 0) {
-      std::cout << "Wrote " << bytesWritten << " bytes to socket" << std::endl;
+      LOG_TRACE("Wrote {} bytes to socket", bytesWritten);
       head_ = (head_ + bytesWritten) % capacity_;
       full_ = false;
     } else if (bytesWritten < 0) {
-      std::cerr << "Socket write error: " << strerror(errno) << std::endl;
+      LOG_DEBUG("Socket write error: {}", strerror(errno));
     }
 
     return bytesWritten;
   }
 
+  /**
+   * @brief Drains both data segments to the socket with one writev
+   * @param socketFd The socket file descriptor to write to
+   * @return Number of bytes written, or -1 on error or empty buffer
+   * @note Only the bytes accepted by the socket are consumed
+   */
+  ssize_t readToSocketV(int socketFd) {
+    iovec iov[2];
+    int count = getReadSegments(iov);
+    if (count == 0) {
+      LOG_DEBUG("Buffer empty, nothing to read");
+      return -1;
+    }
+
+    ssize_t bytesWritten = writev(socketFd, iov, count);
+    if (bytesWritten > 0) {
+      LOG_TRACE("Wrote {} bytes to socket", bytesWritten);
+      head_ = (head_ + bytesWritten) % capacity_;
+      full_ = false;
+    } else if (bytesWritten < 0) {
+      LOG_DEBUG("Socket write error: {}", strerror(errno));
+    }
+
+    return bytesWritten;
+  }
+
+  /**
+   * @brief Describes the readable bytes as at most two iovec segments
+   * @param iov Output array receiving the segments in stream order
+   * @return Number of segments filled, 0 if the buffer is empty
+   */
+  int getReadSegments(iovec (&iov)[2]) const {
+    size_t available = dataSize();
+    if (available == 0) {
+      return 0;
+    }
+    size_t first = contiguousData(available);
+    iov[0].iov_base = buffer_ + head_;
+    iov[0].iov_len = first;
+    if (first == available) {
+      return 1;
+    }
+    iov[1].iov_base = buffer_;
+    iov[1].iov_len = available - first;
+    return 2;
+  }
+
+  /**
+   * @brief Describes the free space as at most two iovec segments
+   * @param iov Output array receiving the segments in stream order
+   * @return Number of segments filled, 0 if the buffer is full
+   */
+  int getWriteSegments(iovec (&iov)[2]) const {
+    size_t available = availableSpace();
+    if (available == 0) {
+      return 0;
+    }
+    size_t first = contiguousSpace(available);
+    iov[0].iov_base = buffer_ + tail_;
+    iov[0].iov_len = first;
+    if (first == available) {
+      return 1;
+    }
+    iov[1].iov_base = buffer_;
+    iov[1].iov_len = available - first;
+    return 2;
+  }
+
   /**
    * @brief Returns current amount of data in the buffer
    * @return Number of bytes available for reading
@@ -198,7 +339,65 @@ public:
    * @brief Checks if the buffer is empty
    * @return true if buffer is empty, false otherwise
    */
-  bool empty() const { return head_ == tail_; };
+  bool empty() const { return head_ == tail_ && !full_; };
+
+  /**
+   * @brief Checks if the buffer has no free space left
+   */
+  bool full() const { return full_; }
+
+  /**
+   * @brief Returns the total capacity of the buffer in bytes
+   */
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * @brief Calculates available space for writing
+   * @return Number of bytes available for writing
+   */
+  size_t availableSpace() const {
+    if (full_)
+      return 0;
+    size_t free =
+        (tail_ >= head_) ? (capacity_ - (tail_ - head_)) : (head_ - tail_);
+    return free - pinned_; // Consumed bytes the kernel still reads from
+  }
+
+  /**
+   * @brief Discards all buffered data, keeping the storage
+   */
+  void reset() {
+    head_ = 0;
+    tail_ = 0;
+    pinned_ = 0;
+    full_ = false;
+  }
+
+  /**
+   * @brief Moves all buffered data to the end of another buffer
+   * @param destination Buffer receiving the data, must have enough space
+   * @return true if everything was moved, false if destination is too small
+   * or bytes of this buffer are still pinned
+   */
+  bool transferTo(CircularBuffer &destination) {
+    if (pinned_ > 0 || destination.availableSpace() < dataSize()) {
+      return false;
+    }
+    iovec iov[2];
+    int count = getReadSegments(iov);
+    for (int i = 0; i < count; ++i) {
+      destination.writeFromBytes(static_cast<const char *>(iov[i].iov_base),
+                                 iov[i].iov_len);
+    }
+    reset();
+    return true;
+  }
+
+  /**
+   * @brief Checks whether the buffer uses the double-mapped layout
+   * @return true if every view is contiguous across the wrap point
+   */
+  bool isMirrored() const { return mirrored_; }
 
   /**
    * @brief Gets a read-only view of the buffer data without copying
@@ -209,19 +408,53 @@ public:
    */
   bool getReadView(size_t &start, char *&data, size_t &length) const {
     if (dataSize() == 0) {
-      std::cout << "Buffer empty, no data to read" << std::endl;
+      LOG_TRACE("Buffer empty, no data to read");
       return false;
     }
 
     start = head_;
     data = buffer_ + head_;
-    length = (tail_ >= head_) ? (tail_ - head_) : (capacity_ - head_);
+    length = contiguousData(dataSize());
+
+    LOG_TRACE("Provided read view: offset={}, length={}", start, length);
+    return true;
+  }
 
-    std::cout << "Provided read view: offset=" << start << ", length=" << length
-              << std::endl;
+  /**
+   * @brief Gets the free space after the write position as one span
+   *
+   * In mirrored mode this is all free space, even across the wrap. Bytes
+   * written there become readable once passed to commit().
+   * @param data Output parameter for the write position
+   * @param length Output parameter for the writable length
+   * @return true if there is free space, false if the buffer is full
+   */
+  bool getWriteView(char *&data, size_t &length) const {
+    size_t available = availableSpace();
+    if (available == 0) {
+      return false;
+    }
+    data = buffer_ + tail_;
+    length = contiguousSpace(available);
     return true;
   }
 
+  /**
+   * @brief Appends bytes written in place through getWriteView()
+   * @param bytes Number of bytes to publish, at most the view length
+   */
+  void commit(size_t bytes) {
+    size_t available = contiguousSpace(availableSpace());
+    if (bytes > available) {
+      throw std::runtime_error("Commit exceeds write view");
+    }
+    if (bytes == 0) {
+      return;
+    }
+    tail_ = (tail_ + bytes) % capacity_;
+    full_ = (tail_ == head_);
+  }
+
   /**
    * @brief Marks data as consumed, moving the read pointer forward
    * @param bytes Number of bytes to consume
@@ -229,33 +462,160 @@ public:
   void consume(size_t bytes) {
     size_t available = dataSize();
     if (bytes > available) {
-      std::cerr << "Warning: Attempting to consume more bytes than available"
-                << " (requested=" << bytes << ", available=" << available << ")"
-                << std::endl;
+      LOG_WARN("Attempting to consume more bytes than available (requested={}, "
+               "available={})",
+               bytes, available);
       bytes = available;
     }
 
     head_ = (head_ + bytes) % capacity_;
     full_ = false;
 
-    std::cout << "Consumed " << bytes << " bytes, new head=" << head_
-              << std::endl;
+    LOG_TRACE("Consumed {} bytes, new head={}", bytes, head_);
+  }
+
+  /**
+   * @brief Consumes bytes whose storage the kernel still references
+   *
+   * For MSG_ZEROCOPY sends: the bytes leave the readable range, but their
+   * space stays unavailable for writing until releasePinned().
+   * @param bytes Number of bytes handed to the kernel
+   */
+  void consumePinned(size_t bytes) {
+    size_t available = dataSize();
+    bytes = std::min(bytes, available);
+    consume(bytes);
+    pinned_ += bytes;
   }
 
+  /**
+   * @brief Returns the oldest pinned bytes to the free space
+   * @param bytes Number of bytes the kernel reported as completed
+   */
+  void releasePinned(size_t bytes) { pinned_ -= std::min(bytes, pinned_); }
+
+  /**
+   * @brief Returns the number of consumed bytes still pinned by the kernel
+   */
+  size_t pinnedSize() const { return pinned_; }
+
 private:
   char *buffer_;    // Underlying buffer storage
   size_t capacity_; // Total buffer capacity
   size_t head_;     // Read position
   size_t tail_;     // Write position
+  size_t pinned_;   // Consumed bytes before head_ still in use by the kernel
   bool full_;       // Buffer full flag
+  bool mirrored_;   // Double-mapped storage (BufferMode::Mirrored)
 
   /**
-   * @brief Calculates available space for writing
-   * @return Number of bytes available for writing
+   * @brief Returns how many of the available bytes are readable in one span
+   * @param available Total number of readable bytes
    */
-  size_t availableSpace() const {
-    if (full_)
-      return 0;
-    return (tail_ >= head_) ? (capacity_ - (tail_ - head_)) : (head_ - tail_);
+  size_t contiguousData(size_t available) const {
+    return mirrored_ ? available : std::min(available, capacity_ - head_);
+  }
+
+  /**
+   * @brief Returns how many of the free bytes are writable in one span
+   * @param available Total number of writable bytes
+   */
+  size_t contiguousSpace(size_t available) const {
+    return mirrored_ ? available : std::min(available, capacity_ - tail_);
+  }
+
+  /**
+   * @brief Frees the storage according to the buffer mode
+   */
+  void release() noexcept {
+    if (!buffer_) {
+      return;
+    }
+    if (mirrored_) {
+      munmap(buffer_, capacity_ * 2);
+    } else {
+      delete[] buffer_;
+    }
+    buffer_ = nullptr;
+  }
+
+  static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  /**
+   * @brief Rounds a size up to a whole number of pages
+   */
+  static size_t roundToPageSize(size_t size, bool huge = false) {
+    const size_t page =
+        huge ? HUGE_PAGE_SIZE : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if (size == 0) {
+      return page;
+    }
+    return (size + page - 1) / page * page;
+  }
+
+  /**
+   * @brief Maps an anonymous memfd twice into adjacent virtual ranges
+   *
+   * A 2 * capacity region is reserved first so the two fixed mappings are
+   * guaranteed to land back to back without racing other mmap callers.
+   *
+   * @param capacity Size of the physical backing, must be page aligned
+   * @param huge Back the buffer with hugetlbfs pages
+   * @return Start of the first mapping
+   * @throws runtime_error if any of the system calls fail
+   */
+  static char *mapMirrored(size_t capacity, bool huge = false) {
+    int fd = memfd_create("circularbuffer",
+                          MFD_CLOEXEC | (huge ? MFD_HUGETLB : 0u));
+    if (fd == -1) {
+      throw std::runtime_error(std::string("memfd_create failed: ") +
+                               strerror(errno));
+    }
+    if (ftruncate(fd, static_cast<off_t>(capacity)) == -1) {
+      close(fd);
+      throw std::runtime_error(std::string("ftruncate failed: ") +
+                               strerror(errno));
+    }
+
+    // Hugetlb mappings must start on a huge page boundary, so over-reserve
+    // and trim the unaligned head and tail
+    size_t slack = huge ? HUGE_PAGE_SIZE : 0;
+    void *reserved = mmap(nullptr, capacity * 2 + slack, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error(std::string("mmap reserve failed: ") +
+                               strerror(errno));
+    }
+    char *base = static_cast<char *>(reserved);
+    if (huge) {
+      uintptr_t address = reinterpret_cast<uintptr_t>(base);
+      char *aligned = reinterpret_cast<char *>(
+          (address + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+      if (aligned != base) {
+        munmap(base, static_cast<size_t>(aligned - base));
+      }
+      size_t tail = slack - static_cast<size_t>(aligned - base);
+      if (tail) {
+        munmap(aligned + capacity * 2, tail);
+      }
+      base = aligned;
+    }
+
+    char *first = base;
+    if (mmap(first, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+             fd, 0) == MAP_FAILED ||
+        mmap(first + capacity, capacity, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      int err = errno;
+      munmap(base, capacity * 2);
+      close(fd);
+      throw std::runtime_error(std::string("mmap mirror failed: ") +
+                               strerror(err));
+    }
+
+    // The mappings keep the memory alive, the descriptor is no longer needed
+    close(fd);
+    return first;
   }
 };
@@ -1,12 +1,162 @@
 #pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "circularbuffer.h"
-#include "message.h"
+#include "fixencoder.h"
+#include "journal.h"
+#include "sharedframe.h"
+#include "timerwheel.h"
+
+// MSG_ZEROCOPY sends of one socket still awaiting their completion
+// notification. The kernel numbers zero-copy sends consecutively per socket
+// and reports completed ranges of those numbers, so only byte counts in send
+// order need to be kept.
+class ZeroCopyTracker {
+public:
+  static constexpr size_t CAPACITY = 32;
+
+  bool full() const { return count_ == CAPACITY; }
+  bool empty() const { return count_ == 0; }
+
+  /** @brief Records a successful zero-copy send of bytes */
+  void push(size_t bytes) {
+    bytes_[(first_ + count_) % CAPACITY] = bytes;
+    ++count_;
+  }
+
+  /**
+   * @brief Retires every send numbered up to and including lastId
+   * @return Number of bytes whose storage the kernel released
+   */
+  size_t complete(uint32_t lastId) {
+    size_t released = 0;
+    while (count_ > 0 && static_cast<int32_t>(lastId - firstId_) >= 0) {
+      released += bytes_[first_];
+      first_ = (first_ + 1) % CAPACITY;
+      ++firstId_;
+      --count_;
+    }
+    return released;
+  }
+
+  void reset() { *this = ZeroCopyTracker(); }
+
+private:
+  std::array<size_t, CAPACITY> bytes_{};
+  size_t first_ = 0;     // Slot of the oldest pending send
+  size_t count_ = 0;     // Pending sends
+  uint32_t firstId_ = 0; // Kernel number of the oldest pending send
+};
 
 // Represents a single client connection with read/write buffers
-class Connection {
+//
+// The fields touched on every socket event come first and share the leading
+// cache lines. Frames are parsed into the worker's batch, so a connection
+// holds no Message of its own.
+class alignas(64) Connection {
 public:
-  Connection(size_t capacity) : readBuffer(capacity), writeBuffer(capacity) {};
-  Message message;
+  // Buffers start without storage and are sized by the worker's BufferPool
+  Connection() : lastActive(std::chrono::steady_clock::now()) {}
+  Connection(size_t capacity)
+      : readBuffer(capacity, BufferMode::Mirrored),
+        writeBuffer(capacity, BufferMode::Mirrored),
+        lastActive(std::chrono::steady_clock::now()) {};
+
+  bool isOpen() const { return fd != -1; }
+
+  /** @brief Unsent output, buffered and spliced */
+  size_t outputSize() const { return writeBuffer.dataSize() + splices.bytes(); }
+
+  /**
+   * @brief Resets the per-socket state for a newly accepted socket
+   * Buffers are left as they are; a recycled connection has none.
+   */
+  void open(int socketFd) {
+    fd = socketFd;
+    lastActive = std::chrono::steady_clock::now();
+    outputArmed = false;
+    readPaused = false;
+    replayed = false;
+    migrateTo = -1;
+    adoptedFrom = -1;
+    recentMessages = 0;
+    zeroCopyState = ZeroCopy::Untried;
+    zeroCopySends.reset();
+    sendsInFlight = 0;
+    sentBytes = 0;
+    recvArmed = false;
+    heldRecvs.clear();
+    splices.clear();
+    closing = false;
+    flushPending = false;
+    sessionHeader = FixSessionHeader();
+    nextOutSeqNum = 1;
+    sessionId = 0;
+    compID.clear();
+    journal.reset();
+    syncQueued = false;
+    resendNext = 0;
+    resendEnd = 0;
+    readTick = 0;
+    outputTick = 0;
+    unflushed = 0;
+    timer = TimerNode(); // The worker unschedules it on close
+    timer.owner = this;
+    lastInTick = 0;
+    lastOutTick = 0;
+    testRequestTick = 0;
+    heartbeatTicks = 0;
+  }
+
+  enum class ZeroCopy : uint8_t { Untried, Enabled, Disabled };
+
+  int fd = -1;                // Socket, -1 once the connection is closed
   CircularBuffer readBuffer;  // Buffer for incoming data
   CircularBuffer writeBuffer; // Buffer for outgoing data
-};
\ No newline at end of file
+  SpliceQueue splices;        // Shared frames sent between writeBuffer bytes
+  std::chrono::steady_clock::time_point lastActive; // Last socket activity
+  bool outputArmed = false;   // EPOLLOUT registered, epoll engine only
+  bool readPaused = false;    // Output above the high watermark
+  bool replayed = false;      // Fed by WorkerThread::replay(), not polled
+  // Moves between workers; see WorkerThread::migrate()
+  int32_t migrateTo = -1;   // Worker it is handed over to once quiescent
+  int32_t adoptedFrom = -1; // Worker still forwarding frames to it
+  uint64_t recentMessages = 0; // Frames parsed since the last move choice
+  ZeroCopy zeroCopyState = ZeroCopy::Untried; // SO_ZEROCOPY on the socket
+  // io_uring engine state; a closing connection is recycled once the kernel
+  // has completed every operation that references it
+  uint32_t sendsInFlight = 0; // Send SQEs and zero-copy notifications pending
+  size_t sentBytes = 0;       // Sent by the current send chain
+  bool recvArmed = false;     // Multishot recv outstanding
+  // Provided buffers (id, length) received while paused, in arrival order
+  std::vector<std::pair<uint16_t, uint32_t>> heldRecvs;
+  bool closing = false;       // Shut down, waiting for outstanding operations
+  ZeroCopyTracker zeroCopySends; // MSG_ZEROCOPY sends, epoll engine only
+  bool flushPending = false;  // Routed output queued, flushed after the batch
+  // Latency metrics, in MetricsClock ticks
+  uint64_t readTick = 0;   // Last read that delivered bytes
+  uint64_t outputTick = 0; // Parse of the oldest unflushed response
+  uint32_t unflushed = 0;  // Responses written since the last full flush
+  // Session timers, in TimerWheel ticks; traffic only moves the last*Tick
+  // stamps and the timer catches up with them when it fires
+  TimerNode timer;              // Earliest heartbeat, TestRequest or idle
+                                // deadline
+  uint64_t lastInTick = 0;      // Last read that delivered bytes
+  uint64_t lastOutTick = 0;     // Last frame written
+  uint64_t testRequestTick = 0; // Unanswered TestRequest sent, 0 = none
+  uint32_t heartbeatTicks = 0;  // HeartBtInt (108) of the session, 0 = none
+  FixSessionHeader sessionHeader; // Outbound header, set at logon
+  uint64_t nextOutSeqNum = 1;     // MsgSeqNum of the next outbound message
+  uint64_t sessionId = 0;         // Router session id, 0 before logon
+  std::string compID;             // CompID the router knows this session by
+  std::unique_ptr<SessionJournal> journal; // Outbound frames, from logon on
+  bool syncQueued = false;        // Listed for syncing after the batch
+  uint64_t resendNext = 0;        // Next MsgSeqNum to resend, 0 = none
+  uint64_t resendEnd = 0;         // Last MsgSeqNum to resend
+};
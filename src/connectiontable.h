@@ -0,0 +1,148 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "connection.h"
+
+/**
+ * @brief fd-indexed table of the connections owned by one worker
+ *
+ * The kernel hands out the lowest free descriptor, so indexing by fd keeps
+ * the table dense and makes get() a single array load. Connection objects
+ * have stable addresses and are meant to be stored in epoll_event.data.ptr,
+ * letting the event loop reach a connection without any lookup.
+ *
+ * Closing is deferred: close() marks the connection closed and parks it
+ * until reclaim(), so a pointer taken from an event earlier in the same
+ * epoll_wait batch never dangles. Reclaimed objects are kept for reuse, so
+ * churn neither allocates the cache-aligned object with its embedded timer
+ * node nor regrows the capacity of its vectors and strings. The mirrored
+ * buffers are not kept here: they go back to the worker's BufferPool.
+ *
+ * A table is owned by a single worker thread and is not thread-safe.
+ */
+class ConnectionTable {
+public:
+  ConnectionTable() = default;
+  ConnectionTable(const ConnectionTable &) = delete;
+  ConnectionTable &operator=(const ConnectionTable &) = delete;
+  ConnectionTable(ConnectionTable &&) = default;
+  ConnectionTable &operator=(ConnectionTable &&) = default;
+
+  /**
+   * @brief Creates the connection for a newly accepted socket
+   * @return The connection, or nullptr if fd is already in use
+   */
+  Connection *open(int fd) {
+    if (fd < 0) {
+      return nullptr;
+    }
+    if (static_cast<size_t>(fd) >= slots_.size()) {
+      slots_.resize(static_cast<size_t>(fd) + 1);
+    }
+    if (slots_[fd]) {
+      return nullptr;
+    }
+    std::unique_ptr<Connection> conn;
+    if (!free_.empty()) {
+      conn = std::move(free_.back());
+      free_.pop_back();
+    } else {
+      conn = std::make_unique<Connection>();
+    }
+    conn->open(fd);
+    slots_[fd] = std::move(conn);
+    ++size_;
+    return slots_[fd].get();
+  }
+
+  /**
+   * @brief Returns the open connection for fd or nullptr
+   */
+  Connection *get(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= slots_.size()) {
+      return nullptr;
+    }
+    return slots_[fd].get();
+  }
+
+  /**
+   * @brief Removes a connection from the table
+   *
+   * The object stays valid, with isOpen() returning false, until the next
+   * reclaim(). Its buffers must already have been released.
+   */
+  void close(Connection &conn) {
+    if (!conn.isOpen()) {
+      return;
+    }
+    std::unique_ptr<Connection> &slot = slots_[conn.fd];
+    conn.fd = -1;
+    closed_.push_back(std::move(slot));
+    --size_;
+  }
+
+  /**
+   * @brief Takes an open connection out of the table, to move it to
+   * another worker
+   * The connection stays open and keeps its fd and buffers.
+   */
+  std::unique_ptr<Connection> detach(Connection &conn) {
+    --size_;
+    return std::move(slots_[conn.fd]);
+  }
+
+  /**
+   * @brief Takes over an open connection detached from another table
+   * @return false, leaving conn as it is, if its fd is already in use
+   */
+  bool attach(std::unique_ptr<Connection> &conn) {
+    int fd = conn->fd;
+    if (get(fd) != nullptr) {
+      return false;
+    }
+    if (static_cast<size_t>(fd) >= slots_.size()) {
+      slots_.resize(static_cast<size_t>(fd) + 1);
+    }
+    slots_[fd] = std::move(conn);
+    ++size_;
+    return true;
+  }
+
+  /**
+   * @brief Recycles the connections closed since the last call
+   * Call once no pointers from the current event batch remain in use.
+   */
+  void reclaim() {
+    for (std::unique_ptr<Connection> &conn : closed_) {
+      if (free_.size() < MAX_FREE) {
+        free_.push_back(std::move(conn));
+      }
+    }
+    closed_.clear();
+  }
+
+  /**
+   * @brief Calls f(Connection &) for every open connection
+   * f may close the connection it is given.
+   */
+  template <typename F> void forEach(F &&f) {
+    for (size_t fd = 0; fd < slots_.size(); ++fd) {
+      if (slots_[fd]) {
+        f(*slots_[fd]);
+      }
+    }
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+private:
+  static constexpr size_t MAX_FREE = 1024; // Recycled objects kept for reuse
+
+  std::vector<std::unique_ptr<Connection>> slots_;  // Indexed by fd
+  std::vector<std::unique_ptr<Connection>> closed_; // Awaiting reclaim()
+  std::vector<std::unique_ptr<Connection>> free_;   // Ready for reuse
+  size_t size_ = 0;
+};
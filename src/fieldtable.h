@@ -0,0 +1,195 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief A single tag=value pair referencing the receive buffer
+ */
+struct FixField {
+  int tag;
+  std::string_view value;
+};
+
+/**
+ * @brief Tag-indexed storage for the fields of one FIX message
+ *
+ * Fields are kept in arrival order in an inline array of InlineCapacity
+ * entries, so a message of up to that many fields never touches the heap.
+ * Larger messages spill into a vector whose capacity is retained across
+ * clear(), so it only grows during the first oversized messages.
+ *
+ * Lookup by tag is O(1): tags below DIRECT_TAGS index a flat array, higher
+ * (user-defined) tags go through a small open-addressing map. Only the
+ * first occurrence of a tag is indexed; repeated tags inside repeating
+ * groups remain reachable through iteration.
+ */
+template <size_t InlineCapacity> class FieldTable {
+public:
+  static constexpr int DIRECT_TAGS = 1024;
+
+  /**
+   * @brief Forward iterator over the fields in arrival order
+   */
+  class const_iterator {
+  public:
+    const_iterator(const FieldTable *table, size_t index)
+        : table_(table), index_(index) {}
+    const FixField &operator*() const { return (*table_)[index_]; }
+    const FixField *operator->() const { return &(*table_)[index_]; }
+    const_iterator &operator++() {
+      ++index_;
+      return *this;
+    }
+    bool operator==(const const_iterator &other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return index_ != other.index_;
+    }
+
+  private:
+    const FieldTable *table_;
+    size_t index_;
+  };
+
+  FieldTable() {
+    direct_.fill(0);
+    clearSlots();
+  }
+
+  /**
+   * @brief Appends a field and indexes it if its tag is new
+   * @param tag Numeric tag, must be positive
+   * @param value Field value
+   */
+  void insert(int tag, std::string_view value) {
+    size_t position = size_;
+    if (position < InlineCapacity) {
+      inline_[position] = FixField{tag, value};
+    } else {
+      spill_.push_back(FixField{tag, value});
+    }
+    ++size_;
+
+    if (position + 1 > UINT16_MAX) {
+      return; // Unindexed, found by the linear fallback
+    }
+    uint16_t entry = static_cast<uint16_t>(position + 1);
+    if (tag < DIRECT_TAGS) {
+      if (direct_[tag] == 0) {
+        direct_[tag] = entry;
+      }
+      return;
+    }
+    if (largeCount_ >= SLOTS / 2) {
+      largeOverflow_ = true; // Keep the load factor at or below one half
+      return;
+    }
+    for (size_t i = hash(tag);; i = (i + 1) & (SLOTS - 1)) {
+      if (slots_[i].entry == 0) {
+        slots_[i] = Slot{tag, entry};
+        ++largeCount_;
+        return;
+      }
+      if (slots_[i].tag == tag) {
+        return;
+      }
+    }
+  }
+
+  /**
+   * @brief Returns the first field with the given tag
+   * @return Pointer to the field or nullptr if the tag is absent
+   */
+  const FixField *find(int tag) const {
+    if (tag <= 0) {
+      return nullptr;
+    }
+    if (tag < DIRECT_TAGS) {
+      return direct_[tag] ? &(*this)[direct_[tag] - 1] : nullptr;
+    }
+    for (size_t i = hash(tag);; i = (i + 1) & (SLOTS - 1)) {
+      if (slots_[i].entry == 0) {
+        break;
+      }
+      if (slots_[i].tag == tag) {
+        return &(*this)[slots_[i].entry - 1];
+      }
+    }
+    if (largeOverflow_ || size_ > UINT16_MAX) {
+      for (const FixField &field : *this) {
+        if (field.tag == tag) {
+          return &field;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * @brief Returns the field at the given arrival position
+   */
+  const FixField &operator[](size_t index) const {
+    return index < InlineCapacity ? inline_[index]
+                                  : spill_[index - InlineCapacity];
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size_); }
+
+  /**
+   * @brief Removes all fields, touching only the index entries in use
+   */
+  void clear() {
+    for (size_t i = 0; i < size_; ++i) {
+      int tag = (*this)[i].tag;
+      if (tag > 0 && tag < DIRECT_TAGS) {
+        direct_[tag] = 0;
+      }
+    }
+    if (largeCount_ > 0) {
+      clearSlots();
+    }
+    spill_.clear();
+    size_ = 0;
+    largeCount_ = 0;
+    largeOverflow_ = false;
+  }
+
+private:
+  static constexpr size_t roundUpPow2(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  // Open-addressing slots for tags >= DIRECT_TAGS
+  static constexpr size_t SLOTS =
+      roundUpPow2(InlineCapacity < 8 ? 16 : InlineCapacity * 2);
+
+  struct Slot {
+    int tag;
+    uint16_t entry; // Arrival position + 1, 0 marks an empty slot
+  };
+
+  static size_t hash(int tag) {
+    return (static_cast<uint32_t>(tag) * 2654435761u) & (SLOTS - 1);
+  }
+
+  void clearSlots() { slots_.fill(Slot{0, 0}); }
+
+  std::array<FixField, InlineCapacity> inline_;
+  std::vector<FixField> spill_;
+  std::array<uint16_t, DIRECT_TAGS> direct_;
+  std::array<Slot, SLOTS> slots_;
+  size_t size_ = 0;
+  size_t largeCount_ = 0;
+  bool largeOverflow_ = false;
+};
@@ -0,0 +1,236 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "fixscan.h"
+#include "message.h"
+
+/**
+ * @brief Pre-serialized standard header fields of one outbound session
+ *
+ * BeginString, SenderCompID and TargetCompID never change within a
+ * session, so they are rendered once, together with their byte sums, and
+ * copied into every message with a single memcpy each.
+ */
+class FixSessionHeader {
+public:
+  FixSessionHeader() = default;
+
+  FixSessionHeader(std::string_view beginString, std::string_view senderCompID,
+                   std::string_view targetCompID) {
+    prefix_.reserve(Message::BeginString.size() + beginString.size() + 1);
+    prefix_.append(Message::BeginString).append(beginString);
+    prefix_.push_back(Message::SOH);
+
+    compIDs_.append(Message::SenderCompID).append(senderCompID);
+    compIDs_.push_back(Message::SOH);
+    compIDs_.append(Message::TargetCompID).append(targetCompID);
+    compIDs_.push_back(Message::SOH);
+
+    const FixScanner::Kernel &scan = FixScanner::kernel();
+    prefixSum_ = scan.checksum(prefix_.data(), prefix_.size());
+    compIDsSum_ = scan.checksum(compIDs_.data(), compIDs_.size());
+  }
+
+  bool empty() const { return prefix_.empty(); }
+
+  /** @brief "8=<BeginString><SOH>" */
+  std::string_view prefix() const { return prefix_; }
+  /** @brief "49=<SenderCompID><SOH>56=<TargetCompID><SOH>" */
+  std::string_view compIDs() const { return compIDs_; }
+  uint32_t prefixSum() const { return prefixSum_; }
+  uint32_t compIDsSum() const { return compIDsSum_; }
+
+private:
+  std::string prefix_;
+  std::string compIDs_;
+  uint32_t prefixSum_ = 0;
+  uint32_t compIDsSum_ = 0;
+};
+
+/**
+ * @brief Single-pass FIX message writer over a contiguous output span
+ *
+ * Fields are formatted straight into the span, integers included, while
+ * the byte sum for CheckSum is accumulated as they are written. BodyLength
+ * is only known at the end: begin() leaves room for the widest BodyLength
+ * the parser accepts, and finish() writes the real digits and closes the
+ * few bytes of slack by moving the body down, so the output carries no
+ * padding. finish() then appends the CheckSum trailer.
+ *
+ * If the span is too small, every further call is ignored and finish()
+ * returns 0; nothing in the span may be published in that case.
+ */
+class FixEncoder {
+public:
+  FixEncoder(char *data, size_t capacity) : data_(data), capacity_(capacity) {}
+
+  /**
+   * @brief Writes the standard header of a new message
+   * @param header Session header template
+   * @param msgType MsgType (35)
+   * @param seqNum MsgSeqNum (34)
+   */
+  FixEncoder &begin(const FixSessionHeader &header, std::string_view msgType,
+                    uint64_t seqNum) {
+    pos_ = 0;
+    sum_ = 0;
+    overflow_ = false;
+    header_ = &header;
+
+    // 8=...<SOH>9= followed by the reserved BodyLength digits and SOH
+    raw(header.prefix());
+    raw(Message::BodyLength);
+    if (!reserve(MAX_BODY_LENGTH_DIGITS + 1)) {
+      return *this;
+    }
+    pos_ += MAX_BODY_LENGTH_DIGITS + 1;
+    bodyStart_ = pos_;
+    sum_ = 0; // The body sum is tracked separately from the prefix
+
+    field(35, msgType);
+    if (reserve(header.compIDs().size())) {
+      std::memcpy(data_ + pos_, header.compIDs().data(),
+                  header.compIDs().size());
+      pos_ += header.compIDs().size();
+      sum_ += header.compIDsSum();
+    }
+    field(34, seqNum);
+    return *this;
+  }
+
+  /**
+   * @brief Appends tag=value<SOH>
+   */
+  FixEncoder &field(int tag, std::string_view value) {
+    if (!reserve(MAX_TAG_DIGITS + 2 + value.size())) {
+      return *this;
+    }
+    appendTag(tag);
+    std::memcpy(data_ + pos_, value.data(), value.size());
+    sum_ += FixScanner::kernel().checksum(value.data(), value.size());
+    pos_ += value.size();
+    appendByte(Message::SOH);
+    return *this;
+  }
+
+  /**
+   * @brief Appends tag=value<SOH>, formatting the integer in place
+   */
+  template <typename T>
+  std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                       !std::is_same_v<T, char>,
+                   FixEncoder &>
+  field(int tag, T value) {
+    if (!reserve(MAX_TAG_DIGITS + 2 + MAX_INT_CHARS)) {
+      return *this;
+    }
+    appendTag(tag);
+    appendDigits(value);
+    appendByte(Message::SOH);
+    return *this;
+  }
+
+  /**
+   * @brief Writes BodyLength and the CheckSum trailer
+   * @return Length of the complete message, 0 if the span was too small
+   * or the body is longer than Message::MAX_BODY_LENGTH
+   */
+  size_t finish() {
+    if (overflow_ || header_ == nullptr) {
+      return 0;
+    }
+
+    // Render BodyLength right before the body, then close the gap
+    size_t bodyLength = pos_ - bodyStart_;
+    if (bodyLength > Message::MAX_BODY_LENGTH) {
+      return 0; // Longer than the parser would accept
+    }
+    char digits[MAX_BODY_LENGTH_DIGITS];
+    auto result = std::to_chars(digits, digits + sizeof(digits), bodyLength);
+    size_t digitCount = static_cast<size_t>(result.ptr - digits);
+    size_t gap = MAX_BODY_LENGTH_DIGITS - digitCount;
+    size_t lengthPos = header_->prefix().size() + Message::BodyLength.size();
+    if (gap > 0) {
+      std::memmove(data_ + bodyStart_ - gap, data_ + bodyStart_, bodyLength);
+      pos_ -= gap;
+    }
+    uint32_t headSum = header_->prefixSum() + '9' + '=' + Message::SOH;
+    for (size_t i = 0; i < digitCount; ++i) {
+      data_[lengthPos + i] = digits[i];
+      headSum += static_cast<unsigned char>(digits[i]);
+    }
+    data_[lengthPos + digitCount] = Message::SOH;
+
+    // 10=NNN<SOH>
+    unsigned checksum = (headSum + sum_) % 256;
+    char *t = data_ + pos_;
+    t[0] = '1';
+    t[1] = '0';
+    t[2] = '=';
+    t[3] = static_cast<char>('0' + checksum / 100);
+    t[4] = static_cast<char>('0' + checksum / 10 % 10);
+    t[5] = static_cast<char>('0' + checksum % 10);
+    t[6] = Message::SOH;
+    pos_ += TRAILER_LENGTH;
+    return pos_;
+  }
+
+  bool overflowed() const { return overflow_; }
+
+private:
+  static constexpr size_t MAX_BODY_LENGTH_DIGITS = 7; // Room reserved in begin()
+  static constexpr size_t MAX_TAG_DIGITS = 10;
+  static constexpr size_t MAX_INT_CHARS = 20; // -9223372036854775808
+  static constexpr size_t TRAILER_LENGTH = 7; // "10=NNN" + SOH
+
+  char *data_;
+  size_t capacity_;
+  size_t pos_ = 0;
+  size_t bodyStart_ = 0;
+  uint32_t sum_ = 0; // Byte sum of the body written so far
+  bool overflow_ = false;
+  const FixSessionHeader *header_ = nullptr;
+
+  /**
+   * @brief Checks that bytes more fit, keeping room for the trailer
+   */
+  bool reserve(size_t bytes) {
+    if (overflow_ || pos_ + bytes + TRAILER_LENGTH > capacity_) {
+      overflow_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  void raw(std::string_view bytes) {
+    if (reserve(bytes.size())) {
+      std::memcpy(data_ + pos_, bytes.data(), bytes.size());
+      pos_ += bytes.size();
+    }
+  }
+
+  void appendByte(char c) {
+    data_[pos_++] = c;
+    sum_ += static_cast<unsigned char>(c);
+  }
+
+  template <typename T> void appendDigits(T value) {
+    char *begin = data_ + pos_;
+    auto result = std::to_chars(begin, begin + MAX_INT_CHARS, value);
+    for (char *p = begin; p != result.ptr; ++p) {
+      sum_ += static_cast<unsigned char>(*p);
+    }
+    pos_ += static_cast<size_t>(result.ptr - begin);
+  }
+
+  void appendTag(int tag) {
+    appendDigits(tag);
+    appendByte('=');
+  }
+};
@@ -0,0 +1,323 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GR_FIXSCAN_X86 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GR_FIXSCAN_NEON 1
+#endif
+
+/**
+ * @brief Vectorized byte-scanning kernels used by the FIX parser
+ *
+ * Each kernel set provides the three primitives the parser needs: locating a
+ * delimiter, validating that a tag consists only of digits and summing the
+ * bytes of a frame for the mod-256 CheckSum. The best kernel set for the
+ * running CPU is chosen once at first use; the scalar set is kept as the
+ * reference implementation and as the fallback.
+ *
+ * Vector loads may read up to one vector past the end of the input, but
+ * never across a page boundary, so they cannot fault. Bytes past the end are
+ * masked out of every result.
+ */
+class FixScanner {
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  /**
+   * @brief Function table for one instruction set
+   */
+  struct Kernel {
+    const char *name;
+    // Offset of the first occurrence of c in [data, data + length) or npos
+    size_t (*find)(const char *data, size_t length, char c);
+    // true if every byte in [data, data + length) is an ASCII digit
+    bool (*allDigits)(const char *data, size_t length);
+    // Sum of all bytes in [data, data + length)
+    uint32_t (*checksum)(const char *data, size_t length);
+  };
+
+  /**
+   * @brief Returns the kernel set selected for this CPU
+   */
+  static const Kernel &kernel() {
+    static const Kernel &selected = select();
+    return selected;
+  }
+
+  /** @brief Returns the portable reference kernel set */
+  static const Kernel &scalar() {
+    static constexpr Kernel k{"scalar", &findScalar, &allDigitsScalar,
+                              &checksumScalar};
+    return k;
+  }
+
+#if defined(GR_FIXSCAN_X86)
+  static const Kernel &sse2() {
+    static constexpr Kernel k{"sse2", &findSse2, &allDigitsSse2,
+                              &checksumSse2};
+    return k;
+  }
+
+  static const Kernel &avx2() {
+    static constexpr Kernel k{"avx2", &findAvx2, &allDigitsAvx2,
+                              &checksumAvx2};
+    return k;
+  }
+#elif defined(GR_FIXSCAN_NEON)
+  static const Kernel &neon() {
+    static constexpr Kernel k{"neon", &findNeon, &allDigitsNeon,
+                              &checksumNeon};
+    return k;
+  }
+#endif
+
+private:
+  static const Kernel &select() {
+#if defined(GR_FIXSCAN_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return avx2();
+    }
+    return sse2();
+#elif defined(GR_FIXSCAN_NEON)
+    return neon();
+#else
+    return scalar();
+#endif
+  }
+
+  /**
+   * @brief Checks whether width bytes starting at p lie within one page
+   */
+  static bool samePage(const char *p, size_t width) {
+    return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - width;
+  }
+
+  /** @brief Mask with the low n bits set, n <= 32 */
+  static uint32_t lowBits(size_t n) {
+    return n >= 32 ? 0xffffffffu : ((1u << n) - 1);
+  }
+
+  static size_t findScalar(const char *data, size_t length, char c) {
+    for (size_t i = 0; i < length; ++i) {
+      if (data[i] == c) {
+        return i;
+      }
+    }
+    return npos;
+  }
+
+  static bool allDigitsScalar(const char *data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+      if (data[i] < '0' || data[i] > '9') {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static uint32_t checksumScalar(const char *data, size_t length) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < length; ++i) {
+      sum += static_cast<unsigned char>(data[i]);
+    }
+    return sum;
+  }
+
+#if defined(GR_FIXSCAN_X86)
+  static size_t findSse2(const char *data, size_t length, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    size_t i = 0;
+    while (i < length) {
+      const char *p = data + i;
+      size_t remaining = length - i;
+      if (remaining < 16 && !samePage(p, 16)) {
+        size_t tail = findScalar(p, remaining, c);
+        return tail == npos ? npos : i + tail;
+      }
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      uint32_t mask = static_cast<uint32_t>(
+                          _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle))) &
+                      lowBits(remaining);
+      if (mask) {
+        return i + static_cast<size_t>(__builtin_ctz(mask));
+      }
+      i += 16;
+    }
+    return npos;
+  }
+
+  static bool allDigitsSse2(const char *data, size_t length) {
+    // Shift '0'..'9' to the bottom of the signed range so one signed compare
+    // both rejects bytes below '0' and bytes above '9'
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80 - '0'));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(-128 + 9));
+    size_t i = 0;
+    while (i < length) {
+      const char *p = data + i;
+      size_t remaining = length - i;
+      if (remaining < 16 && !samePage(p, 16)) {
+        return allDigitsScalar(p, remaining);
+      }
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i shifted = _mm_add_epi8(chunk, bias);
+      uint32_t bad = static_cast<uint32_t>(
+                         _mm_movemask_epi8(_mm_cmpgt_epi8(shifted, limit))) &
+                     lowBits(remaining);
+      if (bad) {
+        return false;
+      }
+      i += 16;
+    }
+    return true;
+  }
+
+  static uint32_t checksumSse2(const char *data, size_t length) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+      __m128i chunk =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(chunk, zero));
+    }
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi64(acc, acc));
+    uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+    return sum + checksumScalar(data + i, length - i);
+  }
+
+  __attribute__((target("avx2"))) static size_t
+  findAvx2(const char *data, size_t length, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    size_t i = 0;
+    while (i < length) {
+      const char *p = data + i;
+      size_t remaining = length - i;
+      if (remaining < 32 && !samePage(p, 32)) {
+        size_t tail = findSse2(p, remaining, c);
+        return tail == npos ? npos : i + tail;
+      }
+      __m256i chunk =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+                          _mm256_cmpeq_epi8(chunk, needle))) &
+                      lowBits(remaining);
+      if (mask) {
+        return i + static_cast<size_t>(__builtin_ctz(mask));
+      }
+      i += 32;
+    }
+    return npos;
+  }
+
+  __attribute__((target("avx2"))) static bool
+  allDigitsAvx2(const char *data, size_t length) {
+    const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80 - '0'));
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(-128 + 9));
+    size_t i = 0;
+    while (i < length) {
+      const char *p = data + i;
+      size_t remaining = length - i;
+      if (remaining < 32 && !samePage(p, 32)) {
+        return allDigitsSse2(p, remaining);
+      }
+      __m256i chunk =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      __m256i shifted = _mm256_add_epi8(chunk, bias);
+      uint32_t bad = static_cast<uint32_t>(_mm256_movemask_epi8(
+                         _mm256_cmpgt_epi8(shifted, limit))) &
+                     lowBits(remaining);
+      if (bad) {
+        return false;
+      }
+      i += 32;
+    }
+    return true;
+  }
+
+  __attribute__((target("avx2"))) static uint32_t
+  checksumAvx2(const char *data, size_t length) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+      __m256i chunk =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(chunk, zero));
+    }
+    __m128i folded = _mm_add_epi64(_mm256_castsi256_si128(acc),
+                                   _mm256_extracti128_si256(acc, 1));
+    folded = _mm_add_epi64(folded, _mm_unpackhi_epi64(folded, folded));
+    uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(folded));
+    return sum + checksumSse2(data + i, length - i);
+  }
+#elif defined(GR_FIXSCAN_NEON)
+  /** @brief Packs a byte compare result into 4 bits per lane */
+  static uint64_t nibbleMask(uint8x16_t cmp) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+  }
+
+  static uint64_t lowNibbles(size_t n) {
+    return n >= 16 ? ~0ull : ((1ull << (n * 4)) - 1);
+  }
+
+  static size_t findNeon(const char *data, size_t length, char c) {
+    const uint8x16_t needle = vdupq_n_u8(static_cast<uint8_t>(c));
+    size_t i = 0;
+    while (i < length) {
+      const char *p = data + i;
+      size_t remaining = length - i;
+      if (remaining < 16 && !samePage(p, 16)) {
+        size_t tail = findScalar(p, remaining, c);
+        return tail == npos ? npos : i + tail;
+      }
+      uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+      uint64_t mask =
+          nibbleMask(vceqq_u8(chunk, needle)) & lowNibbles(remaining);
+      if (mask) {
+        return i + static_cast<size_t>(__builtin_ctzll(mask) >> 2);
+      }
+      i += 16;
+    }
+    return npos;
+  }
+
+  static bool allDigitsNeon(const char *data, size_t length) {
+    const uint8x16_t zero = vdupq_n_u8('0');
+    const uint8x16_t nine = vdupq_n_u8(9);
+    size_t i = 0;
+    while (i < length) {
+      const char *p = data + i;
+      size_t remaining = length - i;
+      if (remaining < 16 && !samePage(p, 16)) {
+        return allDigitsScalar(p, remaining);
+      }
+      uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+      uint8x16_t bad = vcgtq_u8(vsubq_u8(chunk, zero), nine);
+      if (nibbleMask(bad) & lowNibbles(remaining)) {
+        return false;
+      }
+      i += 16;
+    }
+    return true;
+  }
+
+  static uint32_t checksumNeon(const char *data, size_t length) {
+    uint32_t sum = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+      // Pairwise widening adds rather than vaddlvq_u8, which is AArch64 only
+      uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(data + i));
+      uint64x2_t halves = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(chunk)));
+      sum += static_cast<uint32_t>(vgetq_lane_u64(halves, 0) +
+                                   vgetq_lane_u64(halves, 1));
+    }
+    return sum + checksumScalar(data + i, length - i);
+  }
+#endif
+};
@@ -0,0 +1,341 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "fixscan.h"
+#include "fixtypes.h"
+#include "message.h"
+
+/**
+ * @brief String literal usable as a template argument, such as a MsgType
+ */
+template <size_t N> struct FixLiteral {
+  char text[N]{};
+
+  constexpr FixLiteral(const char (&literal)[N]) {
+    std::copy_n(literal, N, text);
+  }
+  constexpr std::string_view view() const { return {text, N - 1}; }
+};
+
+/**
+ * @brief The tags a handler reads from one MsgType, fixed at compile time
+ *
+ * parse() captures only the declared tags while walking a frame, converting
+ * each to its FixTag type, and stops as soon as all of them were seen. No
+ * field table is built and nothing else is converted, so a handler of a
+ * 40-tag message that needs six of them pays for six.
+ *
+ * @code
+ * using NewOrderSingle = FixSchema<"D", fix::ClOrdID, fix::Symbol,
+ *                                  fix::Side, fix::OrderQty, fix::Price>;
+ * NewOrderSingle::Values order;
+ * if (NewOrderSingle::parse(message.frame, order) &&
+ *     order.get<fix::Price>()) { ... }
+ * @endcode
+ */
+template <FixLiteral MsgTypeValue, typename... Tags> class FixSchema {
+public:
+  static constexpr std::string_view msgType = MsgTypeValue.view();
+  static constexpr uint64_t code = FixMsgType::code(msgType);
+  static constexpr size_t TAGS = sizeof...(Tags);
+
+  static_assert(code != 0, "MsgType must have 1 to 8 characters");
+  static_assert(TAGS <= 64, "A schema captures at most 64 tags");
+
+  /**
+   * @brief The captured values of one frame
+   */
+  class Values {
+  public:
+    /** @brief Value of a declared tag, nullopt if the frame lacked it */
+    template <typename Tag>
+    const std::optional<typename Tag::type> &get() const {
+      static_assert(indexOf<Tag>() < TAGS, "Tag is not declared by the schema");
+      return std::get<indexOf<Tag>()>(values_);
+    }
+
+    /** @brief Whether the frame carried a declared tag */
+    template <typename Tag> bool has() const {
+      return get<Tag>().has_value();
+    }
+
+  private:
+    friend class FixSchema;
+
+    std::tuple<std::optional<typename Tags::type>...> values_;
+    uint64_t seen_ = 0; // Bit per declared tag, in declaration order
+  };
+
+  /**
+   * @brief Captures the declared tags of a frame
+   *
+   * Only the first occurrence of a tag is captured. The frame is expected to
+   * have been located and verified by Message::frameFixMessage.
+   * @param frame Whole frame, 8= to the CheckSum trailer
+   * @param values Output, cleared first
+   * @return false if a field is garbled or a declared one does not convert
+   */
+  static bool parse(std::string_view frame, Values &values) {
+    std::apply([](auto &...value) { (value.reset(), ...); }, values.values_);
+    values.seen_ = 0;
+    const FixScanner::Kernel &scan = FixScanner::kernel();
+    const char *data = frame.data();
+    size_t length = frame.size();
+    size_t pos = 0;
+    while (pos < length && values.seen_ != ALL) {
+      size_t tagStart = pos;
+      int tag = 0;
+      while (pos < length && pos - tagStart < MAX_TAG_DIGITS &&
+             data[pos] >= '0' && data[pos] <= '9') {
+        tag = tag * 10 + (data[pos++] - '0');
+      }
+      if (pos == tagStart || pos == length || data[pos] != '=') {
+        return false;
+      }
+      ++pos;
+      size_t soh = scan.find(data + pos, length - pos, Message::SOH);
+      if (soh == FixScanner::npos) {
+        return false;
+      }
+      std::string_view value(data + pos, soh);
+      pos += soh + 1;
+      if (!capture(tag, value, values, std::index_sequence_for<Tags...>{})) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Position of Tag among the declared tags
+   */
+  template <typename Tag> static constexpr size_t indexOf() {
+    constexpr std::array<bool, TAGS> matches{std::is_same_v<Tag, Tags>...};
+    size_t index = 0;
+    while (index < TAGS && !matches[index]) {
+      ++index;
+    }
+    return index;
+  }
+
+private:
+  static constexpr size_t MAX_TAG_DIGITS = 9;
+  static constexpr uint64_t ALL =
+      TAGS == 64 ? ~uint64_t(0) : (uint64_t(1) << TAGS) - 1;
+
+  static constexpr bool distinctTags() {
+    constexpr std::array<int, TAGS> tags{Tags::tag...};
+    for (size_t i = 0; i < TAGS; ++i) {
+      for (size_t j = i + 1; j < TAGS; ++j) {
+        if (tags[i] == tags[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  static_assert(distinctTags(), "A tag is declared twice");
+
+  // Unrolled into one comparison per declared tag
+  template <size_t... I>
+  static bool capture(int tag, std::string_view text, Values &values,
+                      std::index_sequence<I...>) {
+    bool converted = true;
+    ((tag == Tags::tag ? (converted = captureAt<I>(text, values), true)
+                       : false) ||
+     ...);
+    return converted;
+  }
+
+  template <size_t I>
+  static bool captureAt(std::string_view text, Values &values) {
+    constexpr uint64_t bit = uint64_t(1) << I;
+    if (values.seen_ & bit) {
+      return true; // Repeated tag, keep the first
+    }
+    values.seen_ |= bit;
+    using T = std::tuple_element_t<I, std::tuple<typename Tags::type...>>;
+    T value{};
+    if (!FixValue<T>::parse(text, value)) {
+      return false;
+    }
+    std::get<I>(values.values_) = value;
+    return true;
+  }
+};
+
+/**
+ * @brief Outcome of FixDispatch::dispatch
+ */
+enum class DispatchResult {
+  Handled,   // A schema matched and the handler ran
+  NoSchema,  // No schema declares the frame's MsgType
+  Malformed, // The MsgType matched but its declared fields did not parse
+};
+
+/**
+ * @brief Routes frames to schema handlers by MsgType through a perfect hash
+ *
+ * The hash is searched at compile time: a multiplier for which
+ * (code * multiplier) >> (64 - bits) puts every schema's MsgType code in
+ * its own slot of a table no larger than 8 slots per schema. A lookup is
+ * then one multiplication, one table load and one comparison, and calls
+ * the handler through a table of functions generated per schema.
+ *
+ * The handler is called with the schema's Values, so it typically is an
+ * overload set:
+ * @code
+ * using Orders = FixDispatch<NewOrderSingle, OrderCancelRequest>;
+ * Orders::dispatch(message.frame, overloaded{
+ *     [&](const NewOrderSingle::Values &order) { ... },
+ *     [&](const OrderCancelRequest::Values &cancel) { ... }});
+ * @endcode
+ */
+template <typename... Schemas> class FixDispatch {
+public:
+  static constexpr size_t COUNT = sizeof...(Schemas);
+  static constexpr std::array<uint64_t, COUNT> codes{Schemas::code...};
+
+  static_assert(COUNT > 0 && COUNT < 255, "Dispatch needs 1 to 254 schemas");
+
+  /**
+   * @brief Index of the schema declaring a MsgType code, COUNT if none
+   */
+  static constexpr size_t find(uint64_t code) {
+    size_t index = slots_[slotOf(code, HASH)];
+    return index < COUNT && codes[index] == code ? index : COUNT;
+  }
+
+  /**
+   * @brief MsgType of a frame, the third field after BeginString and
+   * BodyLength, or an empty view if it is not there
+   */
+  static constexpr std::string_view msgTypeOf(std::string_view frame) {
+    size_t first = frame.find(Message::SOH);
+    size_t second = frame.find(Message::SOH, first + 1);
+    if (first == std::string_view::npos || second == std::string_view::npos ||
+        frame.substr(second + 1, Message::MsgType.size()) != Message::MsgType) {
+      return {};
+    }
+    size_t start = second + 1 + Message::MsgType.size();
+    size_t end = frame.find(Message::SOH, start);
+    if (end == std::string_view::npos) {
+      return {};
+    }
+    return frame.substr(start, end - start);
+  }
+
+  /**
+   * @brief Parses a verified frame with the schema of its MsgType and calls
+   * handler(const Schema::Values &)
+   */
+  template <typename Handler>
+  static DispatchResult dispatch(std::string_view frame, Handler &&handler) {
+    size_t index = find(FixMsgType::code(msgTypeOf(frame)));
+    if (index == COUNT) {
+      return DispatchResult::NoSchema;
+    }
+    return invokers<std::remove_reference_t<Handler>>[index](frame, handler);
+  }
+
+  /** @brief Table bits of the hash found, for tests */
+  static constexpr unsigned tableBits() { return HASH.bits; }
+
+private:
+  struct Hash {
+    uint64_t multiplier = 0;
+    unsigned bits = 0;
+  };
+
+  static constexpr unsigned minimumBits() {
+    unsigned bits = 0;
+    while ((size_t(1) << bits) < COUNT) {
+      ++bits;
+    }
+    return bits;
+  }
+
+  static constexpr unsigned MAX_BITS = minimumBits() + 3;
+  static constexpr unsigned ATTEMPTS = 4096;
+
+  static constexpr size_t slotOf(uint64_t code, Hash hash) {
+    return hash.bits == 0
+               ? 0
+               : static_cast<size_t>((code * hash.multiplier) >>
+                                     (64 - hash.bits));
+  }
+
+  static constexpr bool distinctCodes() {
+    for (size_t i = 0; i < COUNT; ++i) {
+      for (size_t j = i + 1; j < COUNT; ++j) {
+        if (codes[i] == codes[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  static_assert(distinctCodes(), "Two schemas declare the same MsgType");
+
+  // Smallest table first, then odd multipliers from a fixed sequence
+  static constexpr Hash search() {
+    for (unsigned bits = minimumBits(); bits <= MAX_BITS; ++bits) {
+      uint64_t candidate = 0x9e3779b97f4a7c15; // 2^64 / golden ratio
+      for (unsigned attempt = 0; attempt < ATTEMPTS; ++attempt) {
+        Hash hash{candidate | 1, bits};
+        std::array<bool, size_t(1) << MAX_BITS> used{};
+        bool collision = false;
+        for (size_t i = 0; i < COUNT && !collision; ++i) {
+          size_t slot = slotOf(codes[i], hash);
+          collision = used[slot];
+          used[slot] = true;
+        }
+        if (!collision) {
+          return hash;
+        }
+        candidate = candidate * 6364136223846793005 + 1442695040888963407;
+      }
+    }
+    return Hash{};
+  }
+
+  static constexpr Hash HASH = search();
+  static_assert(HASH.multiplier != 0, "No perfect hash found for MsgTypes");
+
+  static constexpr std::array<uint8_t, size_t(1) << HASH.bits> buildSlots() {
+    std::array<uint8_t, size_t(1) << HASH.bits> slots{};
+    slots.fill(static_cast<uint8_t>(COUNT));
+    for (size_t i = 0; i < COUNT; ++i) {
+      slots[slotOf(codes[i], HASH)] = static_cast<uint8_t>(i);
+    }
+    return slots;
+  }
+
+  static constexpr std::array<uint8_t, size_t(1) << HASH.bits> slots_ =
+      buildSlots();
+
+  template <typename Handler>
+  using Invoker = DispatchResult (*)(std::string_view, Handler &);
+
+  template <typename Schema, typename Handler>
+  static DispatchResult invoke(std::string_view frame, Handler &handler) {
+    typename Schema::Values values;
+    if (!Schema::parse(frame, values)) {
+      return DispatchResult::Malformed;
+    }
+    handler(static_cast<const typename Schema::Values &>(values));
+    return DispatchResult::Handled;
+  }
+
+  template <typename Handler>
+  static constexpr std::array<Invoker<Handler>, COUNT> invokers{
+      &invoke<Schemas, Handler>...};
+};
@@ -0,0 +1,272 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * @brief Fixed-point decimal for FIX Price, Qty and Amt fields
+ *
+ * Holds the value in units of 10^-8, exact for any price a venue sends and
+ * comparable without rounding. Values need at most 8 fraction digits and
+ * at most 10 integer digits.
+ */
+struct FixDecimal {
+  static constexpr unsigned FRACTION_DIGITS = 8;
+  static constexpr int64_t ONE = 100000000; // 10^FRACTION_DIGITS
+
+  int64_t units = 0;
+
+  static constexpr FixDecimal fromUnits(int64_t units) {
+    return FixDecimal{units};
+  }
+  double toDouble() const {
+    return static_cast<double>(units) / static_cast<double>(ONE);
+  }
+  constexpr auto operator<=>(const FixDecimal &) const = default;
+};
+
+/**
+ * @brief FIX UTCTimestamp as nanoseconds since the Unix epoch
+ */
+struct FixTimestamp {
+  int64_t nanos = 0;
+
+  constexpr auto operator<=>(const FixTimestamp &) const = default;
+};
+
+/**
+ * @brief Text to typed value conversion of one FIX data type
+ *
+ * Specialised for int64_t (int, SeqNum, Length), FixDecimal (Price, Qty,
+ * Amt), FixTimestamp (UTCTimestamp), bool (Boolean, Y/N), char and char
+ * based enums (char fields such as Side) and std::string_view (String).
+ * parse() accepts the whole of text or fails; it never allocates.
+ */
+template <typename T> struct FixValue;
+
+template <> struct FixValue<std::string_view> {
+  static constexpr bool parse(std::string_view text, std::string_view &value) {
+    value = text;
+    return true;
+  }
+};
+
+template <> struct FixValue<int64_t> {
+  static bool parse(std::string_view text, int64_t &value) {
+    const char *end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return !text.empty() && ec == std::errc() && ptr == end;
+  }
+};
+
+template <> struct FixValue<bool> {
+  static constexpr bool parse(std::string_view text, bool &value) {
+    if (text.size() != 1 || (text[0] != 'Y' && text[0] != 'N')) {
+      return false;
+    }
+    value = text[0] == 'Y';
+    return true;
+  }
+};
+
+template <> struct FixValue<char> {
+  static constexpr bool parse(std::string_view text, char &value) {
+    if (text.size() != 1) {
+      return false;
+    }
+    value = text[0];
+    return true;
+  }
+};
+
+template <typename T>
+  requires(std::is_enum_v<T> &&
+           std::is_same_v<std::underlying_type_t<T>, char>)
+struct FixValue<T> {
+  static constexpr bool parse(std::string_view text, T &value) {
+    if (text.size() != 1) {
+      return false;
+    }
+    value = static_cast<T>(text[0]);
+    return true;
+  }
+};
+
+template <> struct FixValue<FixDecimal> {
+  static constexpr unsigned MAX_INTEGER_DIGITS = 10;
+
+  static constexpr bool parse(std::string_view text, FixDecimal &value) {
+    size_t pos = 0;
+    bool negative = !text.empty() && text[0] == '-';
+    pos += negative;
+    int64_t units = 0;
+    unsigned integerDigits = 0;
+    while (pos < text.size() && isDigit(text[pos])) {
+      if (++integerDigits > MAX_INTEGER_DIGITS) {
+        return false;
+      }
+      units = units * 10 + (text[pos++] - '0');
+    }
+    unsigned fractionDigits = 0;
+    if (pos < text.size() && text[pos] == '.') {
+      ++pos;
+      while (pos < text.size() && isDigit(text[pos])) {
+        if (++fractionDigits > FixDecimal::FRACTION_DIGITS) {
+          return false;
+        }
+        units = units * 10 + (text[pos++] - '0');
+      }
+    }
+    if (pos != text.size() || integerDigits + fractionDigits == 0) {
+      return false;
+    }
+    for (unsigned i = fractionDigits; i < FixDecimal::FRACTION_DIGITS; ++i) {
+      units *= 10;
+    }
+    value.units = negative ? -units : units;
+    return true;
+  }
+
+private:
+  static constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+};
+
+template <> struct FixValue<FixTimestamp> {
+  /**
+   * @brief Parses YYYYMMDD-HH:MM:SS with optional .sss, .ssssss or
+   * .sssssssss
+   */
+  static constexpr bool parse(std::string_view text, FixTimestamp &value) {
+    if (text.size() < 17 || text[8] != '-' || text[11] != ':' ||
+        text[14] != ':') {
+      return false;
+    }
+    int64_t year = 0;
+    int64_t month = 0;
+    int64_t day = 0;
+    int64_t hour = 0;
+    int64_t minute = 0;
+    int64_t second = 0;
+    if (!digits(text, 0, 4, year) || !digits(text, 4, 2, month) ||
+        !digits(text, 6, 2, day) || !digits(text, 9, 2, hour) ||
+        !digits(text, 12, 2, minute) || !digits(text, 15, 2, second) ||
+        month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 ||
+        minute > 59 || second > 60) {
+      return false;
+    }
+    int64_t fraction = 0;
+    size_t fractionDigits = text.size() - 17;
+    if (fractionDigits != 0) {
+      fractionDigits -= 1;
+      if (text[17] != '.' ||
+          (fractionDigits != 3 && fractionDigits != 6 && fractionDigits != 9) ||
+          !digits(text, 18, fractionDigits, fraction)) {
+        return false;
+      }
+      for (size_t i = fractionDigits; i < 9; ++i) {
+        fraction *= 10;
+      }
+    }
+    int64_t seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 +
+                      minute * 60 + second;
+    value.nanos = seconds * 1000000000 + fraction;
+    return true;
+  }
+
+  /**
+   * @brief Days since 1970-01-01 of a proleptic Gregorian date
+   */
+  static constexpr int64_t daysFromCivil(int64_t year, int64_t month,
+                                         int64_t day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 +
+                        day - 1;
+    int64_t dayOfEra =
+        yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+  }
+
+private:
+  static constexpr bool digits(std::string_view text, size_t at, size_t count,
+                               int64_t &value) {
+    value = 0;
+    for (size_t i = at; i < at + count; ++i) {
+      if (text[i] < '0' || text[i] > '9') {
+        return false;
+      }
+      value = value * 10 + (text[i] - '0');
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief A FIX tag together with the type its values are read as
+ */
+template <int Tag, typename T> struct FixTag {
+  static constexpr int tag = Tag;
+  using type = T;
+};
+
+/**
+ * @brief Side (54) values
+ */
+enum class FixSide : char {
+  Buy = '1',
+  Sell = '2',
+  SellShort = '5',
+};
+
+/**
+ * @brief Tags of the standard header, session and common order messages
+ */
+namespace fix {
+using BeginSeqNo = FixTag<7, int64_t>;
+using BodyLength = FixTag<9, int64_t>;
+using ClOrdID = FixTag<11, std::string_view>;
+using EndSeqNo = FixTag<16, int64_t>;
+using MsgSeqNum = FixTag<34, int64_t>;
+using MsgType = FixTag<35, std::string_view>;
+using NewSeqNo = FixTag<36, int64_t>;
+using OrderQty = FixTag<38, FixDecimal>;
+using OrdType = FixTag<40, char>;
+using PossDupFlag = FixTag<43, bool>;
+using Price = FixTag<44, FixDecimal>;
+using SenderCompID = FixTag<49, std::string_view>;
+using SendingTime = FixTag<52, FixTimestamp>;
+using Side = FixTag<54, FixSide>;
+using Symbol = FixTag<55, std::string_view>;
+using TargetCompID = FixTag<56, std::string_view>;
+using TimeInForce = FixTag<59, char>;
+using TransactTime = FixTag<60, FixTimestamp>;
+using EncryptMethod = FixTag<98, int64_t>;
+using HeartBtInt = FixTag<108, int64_t>;
+using TestReqID = FixTag<112, std::string_view>;
+using GapFillFlag = FixTag<123, bool>;
+using ResetSeqNumFlag = FixTag<141, bool>;
+} // namespace fix
+
+/**
+ * @brief MsgType (35) values as integers, for switch statements
+ *
+ * code() packs up to eight characters into a 64-bit integer, one byte per
+ * character, which no two MsgTypes share; it is constexpr, so
+ * `case FixMsgType::code("AE"):` compiles to a plain integer case.
+ * Longer or empty MsgTypes map to 0.
+ */
+struct FixMsgType {
+  static constexpr uint64_t code(std::string_view msgType) {
+    if (msgType.empty() || msgType.size() > 8) {
+      return 0;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < msgType.size(); ++i) {
+      value |= static_cast<uint64_t>(static_cast<unsigned char>(msgType[i]))
+               << (8 * i);
+    }
+    return value;
+  }
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @brief Bucket layout of a log-linear histogram, HDR style
+ *
+ * Values below 2^precisionBits get a bucket each. Above that, every
+ * power-of-two range is split into 2^(precisionBits-1) equal buckets, so a
+ * bucket's highest value is never more than 2^-(precisionBits-1) above any
+ * sample it holds, anywhere in the 64-bit range.
+ */
+class HistogramBuckets {
+public:
+  /**
+   * @throw std::invalid_argument unless 2 <= precisionBits <= 20
+   */
+  explicit HistogramBuckets(unsigned precisionBits)
+      : bits_(precisionBits), half_(size_t(1) << (precisionBits - 1)) {
+    if (precisionBits < 2 || precisionBits > 20) {
+      throw std::invalid_argument("Histogram precision out of range");
+    }
+  }
+
+  unsigned precisionBits() const { return bits_; }
+
+  // Shifts 0 .. 64 - bits, each covering half_ buckets past the first
+  size_t count() const { return (65 - bits_) * half_ + half_; }
+
+  /**
+   * @brief Bucket of a value: a bit scan and a shift
+   */
+  size_t indexOf(uint64_t value) const {
+    unsigned width = static_cast<unsigned>(std::bit_width(value));
+    unsigned shift = width > bits_ ? width - bits_ : 0;
+    return (static_cast<size_t>(shift) * half_) + (value >> shift);
+  }
+
+  /**
+   * @brief Largest value that falls into bucket index
+   */
+  uint64_t highestOf(size_t index) const {
+    if (index < 2 * half_) {
+      return index;
+    }
+    size_t shift = index / half_ - 1;
+    uint64_t sub = index - shift * half_;
+    uint64_t next = (sub + 1) << shift;
+    return next == 0 ? std::numeric_limits<uint64_t>::max() : next - 1;
+  }
+
+private:
+  unsigned bits_;
+  size_t half_; // Buckets per power of two above the exact range
+};
+
+/**
+ * @brief Log-linear histogram of non-negative integer samples, HDR style
+ *
+ * Samples are counted in the buckets of HistogramBuckets, so a reported
+ * value is never more than 2^-(precisionBits-1) above the sample it stands
+ * for. Recording is a bit scan, a shift and an increment; merging adds
+ * bucket counts.
+ */
+class LatencyHistogram {
+public:
+  /**
+   * @param precisionBits Exact range and resolution, 10 gives 0.2%
+   * @throw std::invalid_argument unless 2 <= precisionBits <= 20
+   */
+  explicit LatencyHistogram(unsigned precisionBits = 10)
+      : buckets_(precisionBits), counts_(buckets_.count(), 0) {}
+
+  /**
+   * @brief Counts one sample
+   */
+  void record(uint64_t value) { record(value, 1); }
+
+  /**
+   * @brief Counts the same sample several times
+   */
+  void record(uint64_t value, uint64_t count) {
+    counts_[buckets_.indexOf(value)] += count;
+    total_ += count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += static_cast<double>(value) * static_cast<double>(count);
+  }
+
+  /**
+   * @brief Adds every sample of another histogram of the same precision
+   * @throw std::invalid_argument if the precisions differ
+   */
+  void merge(const LatencyHistogram &other) {
+    if (other.precisionBits() != precisionBits()) {
+      throw std::invalid_argument("Histogram precisions differ");
+    }
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+  }
+
+  /**
+   * @brief Forgets every sample
+   */
+  void reset() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+    sum_ = 0;
+  }
+
+  unsigned precisionBits() const { return buckets_.precisionBits(); }
+  uint64_t count() const { return total_; }
+  uint64_t min() const { return total_ == 0 ? 0 : min_; }
+  uint64_t max() const { return max_; }
+  double mean() const {
+    return total_ == 0 ? 0 : sum_ / static_cast<double>(total_);
+  }
+
+  /**
+   * @brief Smallest value at least percentile percent of the samples reach
+   *
+   * Reports the highest value of the bucket that holds it, capped by the
+   * largest sample, so percentiles never understate a latency.
+   * @param percentile 0 to 100
+   */
+  uint64_t percentile(double percentile) const {
+    if (total_ == 0) {
+      return 0;
+    }
+    double clamped = std::clamp(percentile, 0.0, 100.0);
+    uint64_t rank = static_cast<uint64_t>(
+        std::ceil(clamped / 100.0 * static_cast<double>(total_)));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(buckets_.highestOf(i), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  HistogramBuckets buckets_;
+  std::vector<uint64_t> counts_;
+  uint64_t total_ = 0;
+  uint64_t min_ = std::numeric_limits<uint64_t>::max();
+  uint64_t max_ = 0;
+  double sum_ = 0;
+};
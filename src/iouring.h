@@ -0,0 +1,363 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief Minimal io_uring instance driven through the raw system calls
+ *
+ * Wraps the submission and completion rings and one provided buffer ring,
+ * which is all the worker's io_uring engine needs, without depending on
+ * liburing. The ring is owned by a single thread.
+ *
+ * SQEs obtained with getSqe() are published to the kernel by submit() or
+ * submitAndWait(); with SQPOLL the kernel thread picks them up on its own
+ * and the system call is only made to wake it up or to wait.
+ */
+class IoUring {
+public:
+  struct Options {
+    unsigned entries = 4096;        // Submission queue size
+    bool sqPoll = false;            // Let a kernel thread poll the SQ
+    unsigned sqPollIdleMs = 1000;   // SQPOLL thread idle time before sleeping
+    unsigned bufferCount = 256;     // Provided receive buffers, power of two
+    unsigned bufferSize = 16 * 1024; // Size of each receive buffer
+  };
+
+  static constexpr uint16_t BUFFER_GROUP = 0;
+
+  /**
+   * @brief Sets up the rings and registers the provided buffer ring
+   * @throws runtime_error if the kernel lacks a required feature
+   */
+  explicit IoUring(const Options &options) : options_(options) {
+    if (options_.bufferCount == 0 ||
+        (options_.bufferCount & (options_.bufferCount - 1)) != 0 ||
+        options_.bufferCount > 32768) {
+      throw std::invalid_argument("Buffer count must be a power of two");
+    }
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = options_.entries * 4; // Room for multishot bursts
+    if (options_.sqPoll) {
+      params.flags |= IORING_SETUP_SQPOLL;
+      params.sq_thread_idle = options_.sqPollIdleMs;
+    } else {
+      params.flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    }
+    ringFd_ = static_cast<int>(
+        syscall(__NR_io_uring_setup, options_.entries, &params));
+    if (ringFd_ < 0 && errno == EINVAL && !options_.sqPoll) {
+      // Kernels before 6.0 do not know the task-running hints
+      params.flags = IORING_SETUP_CQSIZE;
+      ringFd_ = static_cast<int>(
+          syscall(__NR_io_uring_setup, options_.entries, &params));
+    }
+    if (ringFd_ < 0) {
+      fail("io_uring_setup");
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(params.features & IORING_FEAT_NODROP)) {
+      errno = ENOSYS;
+      fail("io_uring features");
+    }
+
+    try {
+      mapRings(params);
+      setupBufferRing();
+    } catch (...) {
+      release();
+      throw;
+    }
+  }
+
+  ~IoUring() { release(); }
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  /**
+   * @brief Returns a zeroed SQE, submitting pending ones if the SQ is full
+   * @return nullptr if the SQ stays full, see reserve()
+   */
+  io_uring_sqe *getSqe() {
+    if (!reserve(1)) {
+      return nullptr;
+    }
+    io_uring_sqe *sqe = &sqes_[sqTail_ & sqMask_];
+    std::memset(sqe, 0, sizeof *sqe);
+    sqArray_[sqTail_ & sqMask_] = sqTail_ & sqMask_;
+    ++sqTail_;
+    return sqe;
+  }
+
+  /**
+   * @brief Makes room for count SQEs, submitting pending ones if needed
+   *
+   * Submits once; with SQPOLL it waits for the kernel thread to consume
+   * entries instead. The SQ stays full when the kernel refuses new work
+   * with EBUSY until completions are reaped, which the caller has to do
+   * from its event loop before trying again.
+   * @return false if fewer than count SQEs are free
+   */
+  bool reserve(unsigned count) {
+    if (sqFree() >= count) {
+      return true;
+    }
+    submit();
+    if (options_.sqPoll && sqFree() < count) {
+      syscall(__NR_io_uring_enter, ringFd_, 0, 0, IORING_ENTER_SQ_WAIT,
+              nullptr, 0);
+    }
+    return sqFree() >= count;
+  }
+
+  /**
+   * @brief Hands queued SQEs to the kernel without waiting
+   */
+  void submit() { enter(0); }
+
+  /**
+   * @brief Hands queued SQEs to the kernel and waits for completions
+   * @param waitNr Number of CQEs to wait for
+   */
+  void submitAndWait(unsigned waitNr) { enter(waitNr); }
+
+  /**
+   * @brief Hands queued SQEs to the kernel and checks for completions
+   *
+   * Never blocks. Without SQPOLL this enters the kernel so that deferred
+   * completion work runs; with SQPOLL the kernel thread posts completions
+   * itself and no system call is needed unless it has gone to sleep.
+   * @return true if completions are ready for forEachCqe()
+   */
+  bool poll() {
+    enter(0, !options_.sqPoll);
+    return *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+  }
+
+  /**
+   * @brief Calls f(const io_uring_cqe &) for every available completion
+   *
+   * f may queue new SQEs. Each CQE is released after f returns.
+   * @return Number of completions processed
+   */
+  template <typename F> unsigned forEachCqe(F &&f) {
+    unsigned count = 0;
+    unsigned head = *cqHead_;
+    while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+      io_uring_cqe cqe = cqes_[head & cqMask_];
+      __atomic_store_n(cqHead_, ++head, __ATOMIC_RELEASE);
+      f(cqe);
+      ++count;
+    }
+    return count;
+  }
+
+  /**
+   * @brief Returns the memory of a provided buffer selected by the kernel
+   */
+  char *buffer(uint16_t bid) const {
+    return buffers_ + static_cast<size_t>(bid) * options_.bufferSize;
+  }
+
+  /**
+   * @brief Gives a provided buffer back to the kernel
+   */
+  void recycleBuffer(uint16_t bid) {
+    // Index the ring as a plain array: in C++ the header's flexible-array
+    // wrapper gains an empty member and moves bufs[] off offset 0
+    io_uring_buf *entries = reinterpret_cast<io_uring_buf *>(bufRing_);
+    io_uring_buf &entry = entries[bufTail_ & (options_.bufferCount - 1)];
+    entry.addr = reinterpret_cast<uint64_t>(buffer(bid));
+    entry.len = options_.bufferSize;
+    entry.bid = bid;
+    ++bufTail_;
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+  }
+
+  /**
+   * @brief Extracts the provided buffer id from a completion
+   * @return false if the completion carries no buffer
+   */
+  static bool bufferId(const io_uring_cqe &cqe, uint16_t &bid) {
+    if (!(cqe.flags & IORING_CQE_F_BUFFER)) {
+      return false;
+    }
+    bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    return true;
+  }
+
+  const Options &options() const { return options_; }
+
+private:
+  Options options_;
+  int ringFd_ = -1;
+
+  void *ringMem_ = MAP_FAILED;
+  size_t ringSize_ = 0;
+  io_uring_sqe *sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+  size_t sqesSize_ = 0;
+
+  unsigned *sqHead_ = nullptr;
+  unsigned *sqTailPtr_ = nullptr;
+  unsigned *sqFlags_ = nullptr;
+  unsigned *sqArray_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned sqEntries_ = 0;
+  unsigned sqTail_ = 0;      // Local tail, published by enter()
+  unsigned *cqHead_ = nullptr;
+  unsigned *cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe *cqes_ = nullptr;
+
+  io_uring_buf_ring *bufRing_ = static_cast<io_uring_buf_ring *>(MAP_FAILED);
+  size_t bufRingSize_ = 0;
+  char *buffers_ = static_cast<char *>(MAP_FAILED);
+  size_t buffersSize_ = 0;
+  uint16_t bufTail_ = 0;
+  bool bufRingRegistered_ = false;
+
+  [[noreturn]] static void fail(const char *what) {
+    throw std::runtime_error(std::string(what) + " failed: " +
+                             strerror(errno));
+  }
+
+  void mapRings(const io_uring_params &params) {
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ringSize_ = sqSize > cqSize ? sqSize : cqSize;
+    ringMem_ = mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (ringMem_ == MAP_FAILED) {
+      fail("mmap io_uring rings");
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(
+        mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+      fail("mmap io_uring sqes");
+    }
+
+    char *base = static_cast<char *>(ringMem_);
+    sqHead_ = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+    sqTailPtr_ = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+    sqFlags_ = reinterpret_cast<unsigned *>(base + params.sq_off.flags);
+    sqArray_ = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+    sqMask_ = *reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqTail_ = *sqTailPtr_;
+    cqHead_ = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+  }
+
+  void setupBufferRing() {
+    bufRingSize_ = options_.bufferCount * sizeof(io_uring_buf);
+    bufRing_ = static_cast<io_uring_buf_ring *>(
+        mmap(nullptr, bufRingSize_, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (bufRing_ == MAP_FAILED) {
+      fail("mmap buffer ring");
+    }
+    buffersSize_ = static_cast<size_t>(options_.bufferCount) *
+                   options_.bufferSize;
+    buffers_ = static_cast<char *>(mmap(nullptr, buffersSize_,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (buffers_ == MAP_FAILED) {
+      fail("mmap receive buffers");
+    }
+
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof reg);
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing_);
+    reg.ring_entries = options_.bufferCount;
+    reg.bgid = BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING,
+                &reg, 1) < 0) {
+      fail("io_uring_register(PBUF_RING)");
+    }
+    bufRingRegistered_ = true;
+    for (unsigned bid = 0; bid < options_.bufferCount; ++bid) {
+      recycleBuffer(static_cast<uint16_t>(bid));
+    }
+  }
+
+  unsigned sqFree() const {
+    return sqEntries_ - (sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE));
+  }
+
+  void enter(unsigned waitNr, bool getEvents = false) {
+    unsigned pending = sqTail_ - *sqTailPtr_;
+    __atomic_store_n(sqTailPtr_, sqTail_, __ATOMIC_RELEASE);
+
+    unsigned flags = waitNr > 0 || getEvents ? IORING_ENTER_GETEVENTS : 0;
+    unsigned toSubmit = pending;
+    if (options_.sqPoll) {
+      // The kernel thread consumes the SQ itself; only wake it when asleep
+      toSubmit = 0;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (__atomic_load_n(sqFlags_, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+        flags |= IORING_ENTER_SQ_WAKEUP;
+      }
+      if (flags == 0) {
+        return;
+      }
+    } else if (toSubmit == 0 && flags == 0) {
+      return;
+    }
+    while (syscall(__NR_io_uring_enter, ringFd_, toSubmit, waitNr, flags,
+                   nullptr, 0) < 0) {
+      if (errno != EINTR) {
+        // EBUSY/EAGAIN: completions must be reaped before submitting more
+        break;
+      }
+    }
+  }
+
+  void release() {
+    if (bufRingRegistered_) {
+      io_uring_buf_reg reg;
+      std::memset(&reg, 0, sizeof reg);
+      reg.bgid = BUFFER_GROUP;
+      syscall(__NR_io_uring_register, ringFd_, IORING_UNREGISTER_PBUF_RING,
+              &reg, 1);
+      bufRingRegistered_ = false;
+    }
+    if (ringFd_ >= 0) {
+      close(ringFd_);
+      ringFd_ = -1;
+    }
+    if (buffers_ != MAP_FAILED) {
+      munmap(buffers_, buffersSize_);
+      buffers_ = static_cast<char *>(MAP_FAILED);
+    }
+    if (bufRing_ != MAP_FAILED) {
+      munmap(bufRing_, bufRingSize_);
+      bufRing_ = static_cast<io_uring_buf_ring *>(MAP_FAILED);
+    }
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqesSize_);
+      sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+    }
+    if (ringMem_ != MAP_FAILED) {
+      munmap(ringMem_, ringSize_);
+      ringMem_ = MAP_FAILED;
+    }
+  }
+};
@@ -0,0 +1,877 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fixscan.h"
+#include "mappedfile.h"
+#include "message.h"
+
+/**
+ * @brief When journaled frames are forced out to disk
+ */
+enum class JournalSync : uint8_t {
+  None,  // Kernel writeback only; survives a crash of the process
+  Async, // Start writeback of new frames (sync_file_range), do not wait
+  Sync,  // msync(MS_SYNC) new frames; survives a crash of the machine
+};
+
+/**
+ * @brief Settings shared by the journals of all sessions
+ */
+struct JournalOptions {
+  std::string directory;                  // Empty = journaling off
+  size_t segmentBytes = 64 * 1024 * 1024; // Pre-allocated size of each file
+  // Size of a segment created on the owning thread, when opening a new or
+  // reset journal; the full sized one follows in the background
+  size_t firstSegmentBytes = 256 * 1024;
+  JournalSync sync = JournalSync::None;
+  // Smallest time between two syncs of one journal, 0 = after every batch
+  std::chrono::milliseconds syncInterval{0};
+  size_t retainSegments = 8; // Older segments are deleted on rollover
+};
+
+/**
+ * @brief Append-only, memory-mapped log of the outbound frames of a session
+ *
+ * Frames are stored back to back, exactly as sent, in pre-allocated segment
+ * files "<directory>/<name>.<number>.journal" mapped into memory, so an
+ * append is a memcpy into the page cache and never a system call. Frames
+ * are self-delimiting, so no index is stored on disk: opening a journal
+ * scans its segments, verifying each frame's BodyLength and CheckSum, and
+ * rebuilds the MsgSeqNum to offset index in memory. A frame torn by a crash
+ * ends the scan.
+ *
+ * Syncing is batched: sync() covers everything appended since the previous
+ * one and is meant to be called once per event batch. The next segment is
+ * created and faulted in on a background thread once the current one is
+ * half full, so rollover only swaps pointers. Segments created on the
+ * owning thread, by the constructor and reset(), are only firstSegmentBytes
+ * large, and the full sized next one is started right away: allocating a
+ * whole segment would stall the caller for as long. A spare that is no
+ * longer wanted, after reset() or when the journal is closed, is left to a
+ * background thread that waits for it and deletes it. Opening still takes
+ * a few system calls, and a session filling its first segment before the
+ * next is ready waits for the rest of that allocation.
+ *
+ * Stored frames are returned as views into the mapping, valid until the
+ * segment holding them is deleted by rollover or reset(). A journal is
+ * owned by a single thread; an exclusive lock on "<name>.lock" keeps other
+ * processes and threads from opening the same session.
+ */
+class SessionJournal {
+public:
+  /**
+   * @brief Opens or creates the journal of one session
+   * @param options Directory, segment size and sync policy
+   * @param name Session name, characters unsafe in file names are replaced
+   * @param reset Start over at MsgSeqNum 1, as reset() does, without
+   * reading the existing segments
+   * @throws runtime_error if the files cannot be created or are in use
+   */
+  SessionJournal(const JournalOptions &options, std::string_view name,
+                 bool reset = false)
+      : options_(options) {
+    if (options_.segmentBytes == 0 || options_.segmentBytes > UINT32_MAX) {
+      throw std::invalid_argument("Journal segment size out of range");
+    }
+    if (options_.retainSegments == 0) {
+      options_.retainSegments = 1;
+    }
+    baseName_.reserve(name.size());
+    for (char c : name) {
+      bool safe = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+                  (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+      baseName_.push_back(safe ? c : '_');
+    }
+    prefix_ = options_.directory + "/" + baseName_;
+
+    if (mkdir(options_.directory.c_str(), 0755) == -1 && errno != EEXIST) {
+      fail("mkdir " + options_.directory);
+    }
+    std::string lockPath = prefix_ + ".lock";
+    lockFd_ = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lockFd_ == -1) {
+      fail("open " + lockPath);
+    }
+    if (flock(lockFd_, LOCK_EX | LOCK_NB) == -1) {
+      int error = errno;
+      ::close(lockFd_);
+      errno = error;
+      fail("lock " + lockPath);
+    }
+
+    try {
+      std::vector<uint64_t> existing = existingSegments();
+      if (reset) {
+        // Numbered past the old files, which go once the new one exists
+        uint64_t number = existing.empty() ? 0 : existing.back() + 1;
+        segments_.push_back(Segment::create(path(number), number,
+                                            inlineSegmentBytes(0), false));
+        for (uint64_t old : existing) {
+          unlink(path(old).c_str());
+        }
+      } else {
+        for (uint64_t number : existing) {
+          segments_.push_back(Segment::open(path(number), number));
+          recover(*segments_.back());
+        }
+      }
+      if (segments_.empty()) {
+        segments_.push_back(Segment::create(path(0), 0, inlineSegmentBytes(0),
+                                            false));
+      }
+      growSoon();
+    } catch (...) {
+      segments_.clear();
+      ::close(lockFd_);
+      throw;
+    }
+  }
+
+  ~SessionJournal() {
+    discardSpare();
+    sync(std::chrono::steady_clock::now(), true);
+    segments_.clear();
+    ::close(lockFd_);
+  }
+
+  SessionJournal(const SessionJournal &) = delete;
+  SessionJournal &operator=(const SessionJournal &) = delete;
+
+  /**
+   * @brief MsgSeqNum following the last journaled frame, 1 if empty
+   */
+  uint64_t nextSeqNum() const { return nextSeq_; }
+
+  /**
+   * @brief Appends a complete outbound frame
+   * @param seqNum Its MsgSeqNum, above every frame journaled so far
+   * @return false if seqNum goes backwards, the frame is larger than a
+   * segment, or no new segment could be created
+   */
+  bool append(uint64_t seqNum, std::string_view frame) {
+    return append(seqNum, std::span<const std::string_view>(&frame, 1));
+  }
+
+  /**
+   * @brief Appends a frame given as consecutive parts, such as the header
+   * and the shared body of a fanned out frame
+   */
+  bool append(uint64_t seqNum, std::span<const std::string_view> parts) {
+    size_t length = 0;
+    for (std::string_view part : parts) {
+      length += part.size();
+    }
+    if (seqNum < nextSeq_ || length == 0) {
+      return false;
+    }
+    Segment *segment = segments_.back().get();
+    if (segment->capacity - segment->size < length) {
+      if (!rollover(length)) {
+        return false;
+      }
+      segment = segments_.back().get();
+    }
+    size_t at = segment->size;
+    for (std::string_view part : parts) {
+      std::memcpy(segment->data + at, part.data(), part.size());
+      at += part.size();
+    }
+    index(seqNum, segment->number, segment->size, length);
+    segment->size += length;
+    if (!spare_.valid() && segment->size > segment->capacity / 2) {
+      prepareSpare(segment->number + 1);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Looks up the journaled frame with the given MsgSeqNum
+   * @return false if it was never journaled or has been deleted
+   */
+  bool frame(uint64_t seqNum, std::string_view &out) const {
+    if (seqNum < firstSeq_ || seqNum - firstSeq_ >= index_.size()) {
+      return false;
+    }
+    const Entry &entry = index_[seqNum - firstSeq_];
+    if (entry.length == 0) {
+      return false;
+    }
+    for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+      if ((*it)->number == entry.segment) {
+        out = std::string_view((*it)->data + entry.offset, entry.length);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Whether frames appended since the last sync await syncing
+   */
+  bool dirty() const {
+    return options_.sync != JournalSync::None &&
+           segments_.back()->synced != segments_.back()->size;
+  }
+
+  /**
+   * @brief Syncs the frames appended since the previous sync
+   *
+   * Does nothing before syncInterval has passed since the previous sync,
+   * unless forced.
+   * @return false if the kernel reported an error
+   */
+  bool sync(std::chrono::steady_clock::time_point now, bool force = false) {
+    if (!dirty() ||
+        (!force && now - lastSync_ < options_.syncInterval)) {
+      return true;
+    }
+    lastSync_ = now;
+    return syncSegment(*segments_.back());
+  }
+
+  /**
+   * @brief Deletes every journaled frame, for a session reset to MsgSeqNum 1
+   * @throws runtime_error if the new segment cannot be created, leaving the
+   * journal as it was
+   */
+  void reset() {
+    uint64_t number = segments_.back()->number + 1;
+    std::unique_ptr<Segment> fresh =
+        Segment::create(path(number), number, inlineSegmentBytes(0), false);
+    discardSpare();
+    for (const std::unique_ptr<Segment> &segment : segments_) {
+      unlink(path(segment->number).c_str());
+    }
+    segments_.clear();
+    segments_.push_back(std::move(fresh));
+    index_.clear();
+    firstSeq_ = 1;
+    nextSeq_ = 1;
+    growSoon();
+  }
+
+  size_t segmentCount() const { return segments_.size(); }
+
+  /**
+   * @brief Waits until the spares of reset or closed journals are deleted
+   *
+   * For tests, and for callers about to remove the journal directory.
+   */
+  static void awaitDiscarded() { Reaper::instance().wait(); }
+
+  /**
+   * @brief Copies a journaled frame for resending, marked PossDupFlag=Y
+   *
+   * Inserts 43=Y, and OrigSendingTime (122) copied from SendingTime (52)
+   * when the frame has one, right after MsgSeqNum, and recomputes
+   * BodyLength and CheckSum. Frames already carrying PossDupFlag are
+   * copied as they are.
+   * @return Length of the copy, 0 if it does not fit or the frame is
+   * malformed
+   */
+  static size_t copyAsPossDup(std::string_view frame, char *out,
+                              size_t capacity) {
+    size_t beginEnd = frame.find(Message::SOH);
+    if (beginEnd == std::string_view::npos ||
+        frame.substr(beginEnd + 1, 2) != Message::BodyLength ||
+        frame.size() < TRAILER_LENGTH) {
+      return 0;
+    }
+    size_t lengthStart = beginEnd + 3;
+    size_t bodyStart = frame.find(Message::SOH, lengthStart) + 1;
+    size_t trailer = frame.size() - TRAILER_LENGTH;
+    std::string_view body = frame.substr(0, trailer);
+    if (bodyStart == 0 || bodyStart > trailer) {
+      return 0;
+    }
+    if (body.find("\x01" "43=", bodyStart - 1) != std::string_view::npos) {
+      if (frame.size() > capacity) {
+        return 0;
+      }
+      std::memcpy(out, frame.data(), frame.size());
+      return frame.size();
+    }
+    size_t seqNum = body.find("\x01" "34=", bodyStart - 1);
+    size_t insertAt = seqNum == std::string_view::npos
+                          ? std::string_view::npos
+                          : body.find(Message::SOH, seqNum + 1);
+    if (insertAt == std::string_view::npos) {
+      return 0;
+    }
+    ++insertAt;
+    std::string_view sendingTime = fieldValue(body, "\x01" "52=");
+
+    constexpr std::string_view POSS_DUP = "43=Y\x01";
+    constexpr std::string_view ORIG_SENDING_TIME = "122=";
+    size_t inserted = POSS_DUP.size();
+    if (!sendingTime.empty()) {
+      inserted += ORIG_SENDING_TIME.size() + sendingTime.size() + 1;
+    }
+    char digits[20];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits),
+                                   trailer - bodyStart + inserted);
+    size_t digitCount = static_cast<size_t>(end - digits);
+    size_t length = lengthStart + digitCount + 1 + (trailer - bodyStart) +
+                    inserted + TRAILER_LENGTH;
+    if (length > capacity) {
+      return 0;
+    }
+
+    char *p = out;
+    auto put = [&p](std::string_view bytes) {
+      std::memcpy(p, bytes.data(), bytes.size());
+      p += bytes.size();
+    };
+    put(frame.substr(0, lengthStart));
+    put(std::string_view(digits, digitCount));
+    *p++ = Message::SOH;
+    put(body.substr(bodyStart, insertAt - bodyStart));
+    put(POSS_DUP);
+    if (!sendingTime.empty()) {
+      put(ORIG_SENDING_TIME);
+      put(sendingTime);
+      *p++ = Message::SOH;
+    }
+    put(body.substr(insertAt));
+    unsigned checksum =
+        FixScanner::kernel().checksum(out, static_cast<size_t>(p - out)) %
+        256;
+    p[0] = '1';
+    p[1] = '0';
+    p[2] = '=';
+    p[3] = static_cast<char>('0' + checksum / 100);
+    p[4] = static_cast<char>('0' + checksum / 10 % 10);
+    p[5] = static_cast<char>('0' + checksum % 10);
+    p[6] = Message::SOH;
+    return length;
+  }
+
+  /**
+   * @brief MsgType (35) of a raw frame, empty if it has none
+   */
+  static std::string_view msgTypeOf(std::string_view frame) {
+    return fieldValue(frame, "\x01" "35=");
+  }
+
+  /**
+   * @brief Whether a MsgType belongs to the session layer
+   *
+   * Those are not resent but replaced by a SequenceReset-GapFill.
+   */
+  static bool isAdminMsgType(std::string_view msgType) {
+    return msgType.size() == 1 &&
+           (msgType[0] == 'A' || (msgType[0] >= '0' && msgType[0] <= '5'));
+  }
+
+private:
+  static constexpr size_t TRAILER_LENGTH = 7; // "10=NNN" + SOH
+  static constexpr uint64_t MAX_SEQ_GAP = 1 << 20; // Larger jumps restart
+
+  /**
+   * @brief One mapped, pre-allocated segment file
+   */
+  struct Segment {
+    uint64_t number = 0;
+    int fd = -1;
+    char *data = nullptr;
+    size_t capacity = 0; // Size of the file and the mapping
+    size_t size = 0;     // Bytes of complete frames
+    size_t synced = 0;   // Bytes already synced
+
+    Segment() = default;
+    Segment(const Segment &) = delete;
+    Segment &operator=(const Segment &) = delete;
+    ~Segment() {
+      if (data != nullptr) {
+        munmap(data, capacity);
+      }
+      if (fd != -1) {
+        ::close(fd);
+      }
+    }
+
+    /**
+     * @brief Creates a new zero-filled segment of capacity bytes
+     * @param populate Fault every page in now rather than on first append
+     */
+    static std::unique_ptr<Segment> create(const std::string &path,
+                                           uint64_t number, size_t capacity,
+                                           bool populate) {
+      auto segment = std::make_unique<Segment>();
+      segment->number = number;
+      segment->fd =
+          ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (segment->fd == -1) {
+        fail("open " + path);
+      }
+      if (!allocateFile(segment->fd, capacity)) {
+        int error = errno;
+        unlink(path.c_str());
+        errno = error;
+        fail("allocate " + path);
+      }
+      segment->map(capacity, 0, path);
+      if (populate) {
+        // Page by page: MAP_POPULATE would hold the process's mmap lock
+        // throughout, blocking every mmap and munmap of other threads
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const volatile char *bytes = segment->data;
+        for (size_t at = 0; at < capacity; at += page) {
+          bytes[at];
+        }
+      }
+      return segment;
+    }
+
+    /**
+     * @brief Maps an existing segment; its frames are found by recover()
+     */
+    static std::unique_ptr<Segment> open(const std::string &path,
+                                         uint64_t number) {
+      auto segment = std::make_unique<Segment>();
+      segment->number = number;
+      segment->fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+      struct stat info;
+      if (segment->fd == -1 || fstat(segment->fd, &info) == -1) {
+        fail("open " + path);
+      }
+      if (info.st_size <= 0 || static_cast<uint64_t>(info.st_size) >
+                                   UINT32_MAX) {
+        errno = EINVAL;
+        fail("size of " + path);
+      }
+      segment->map(static_cast<size_t>(info.st_size), 0, path);
+      return segment;
+    }
+
+  private:
+    void map(size_t bytes, int extraFlags, const std::string &path) {
+      void *address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | extraFlags, fd, 0);
+      if (address == MAP_FAILED) {
+        fail("mmap " + path);
+      }
+      data = static_cast<char *>(address);
+      capacity = bytes;
+    }
+  };
+
+  /**
+   * @brief Background thread deleting spares that are no longer wanted
+   *
+   * Waiting for a spare still being allocated would stall the owning
+   * thread, so it is handed over here with the file it is created in. One
+   * thread serves every journal of the process.
+   */
+  class Reaper {
+  public:
+    static Reaper &instance() {
+      static Reaper reaper;
+      return reaper;
+    }
+
+    ~Reaper() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      changed_.notify_all();
+      thread_.join();
+    }
+
+    void discard(std::future<std::unique_ptr<Segment>> spare,
+                 std::string path) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(Discarded{std::move(spare), std::move(path)});
+        ++pending_;
+      }
+      changed_.notify_all();
+    }
+
+    void wait() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+  private:
+    struct Discarded {
+      std::future<std::unique_ptr<Segment>> spare;
+      std::string path;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Discarded> queue_;
+    size_t pending_ = 0; // Queued or being deleted
+    bool stopping_ = false;
+    std::thread thread_{[this] { run(); }};
+
+    Reaper() = default;
+
+    void run() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (true) {
+        changed_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) {
+          return; // Stopping with nothing left
+        }
+        Discarded discarded = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        try {
+          discarded.spare.get(); // Unmapped and closed right away
+        } catch (const std::exception &) {
+        }
+        unlink(discarded.path.c_str());
+        lock.lock();
+        --pending_;
+        changed_.notify_all();
+      }
+    }
+  };
+
+  /**
+   * @brief Location of one journaled frame, length 0 if missing
+   */
+  struct Entry {
+    uint64_t segment = 0;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+  };
+
+  JournalOptions options_;
+  std::string baseName_;
+  std::string prefix_; // Directory and session name
+  int lockFd_ = -1;
+  std::deque<std::unique_ptr<Segment>> segments_; // Oldest first
+  std::deque<Entry> index_; // By MsgSeqNum, starting at firstSeq_
+  uint64_t firstSeq_ = 1;
+  uint64_t nextSeq_ = 1;
+  std::future<std::unique_ptr<Segment>> spare_; // Next segment, if started
+  std::string sparePath_; // File the spare is created in
+  std::chrono::steady_clock::time_point lastSync_;
+
+  [[noreturn]] static void fail(const std::string &what) {
+    throw std::runtime_error("Journal " + what + ": " + strerror(errno));
+  }
+
+  std::string path(uint64_t number) const {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%06llu.journal",
+             static_cast<unsigned long long>(number));
+    return prefix_ + suffix;
+  }
+
+  /**
+   * @brief File a spare is created in, renamed to path(number) once used
+   *
+   * Unique within the process and not named like a segment, so a journal
+   * of the same session opened meanwhile neither reads it nor clashes
+   * with a spare that is still being deleted.
+   */
+  std::string sparePath(uint64_t number) const {
+    static std::atomic<uint64_t> spares{0};
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%06llu.%ld-%llu.spare",
+             static_cast<unsigned long long>(number),
+             static_cast<long>(getpid()),
+             static_cast<unsigned long long>(
+                 spares.fetch_add(1, std::memory_order_relaxed)));
+    return prefix_ + suffix;
+  }
+
+  /**
+   * @brief Numbers of the segment files of this session, oldest first
+   * Spare files left behind by a crash are deleted on the way.
+   */
+  std::vector<uint64_t> existingSegments() const {
+    std::vector<uint64_t> numbers;
+    DIR *dir = opendir(options_.directory.c_str());
+    if (dir == nullptr) {
+      fail("opendir " + options_.directory);
+    }
+    constexpr std::string_view SUFFIX = ".journal";
+    while (dirent *entry = readdir(dir)) {
+      std::string_view name = entry->d_name;
+      if (isSpareFile(name)) {
+        unlink((options_.directory + "/" + std::string(name)).c_str());
+        continue;
+      }
+      if (name.size() <= baseName_.size() + 1 + SUFFIX.size() ||
+          name.substr(0, baseName_.size()) != baseName_ ||
+          name[baseName_.size()] != '.' || !name.ends_with(SUFFIX)) {
+        continue;
+      }
+      std::string_view digits = name.substr(
+          baseName_.size() + 1,
+          name.size() - baseName_.size() - 1 - SUFFIX.size());
+      uint64_t number;
+      auto [end, ec] =
+          std::from_chars(digits.data(), digits.data() + digits.size(), number);
+      if (ec == std::errc() && end == digits.data() + digits.size()) {
+        numbers.push_back(number);
+      }
+    }
+    closedir(dir);
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+  }
+
+  /**
+   * @brief Whether name is "<name>.<number>.<pid>-<count>.spare" of this
+   * session, see sparePath()
+   */
+  bool isSpareFile(std::string_view name) const {
+    constexpr std::string_view SUFFIX = ".spare";
+    if (name.size() <= baseName_.size() + 1 + SUFFIX.size() ||
+        name.substr(0, baseName_.size()) != baseName_ ||
+        name[baseName_.size()] != '.' || !name.ends_with(SUFFIX)) {
+      return false;
+    }
+    std::string_view rest = name.substr(
+        baseName_.size() + 1, name.size() - baseName_.size() - 1 -
+                                  SUFFIX.size());
+    size_t dot = rest.find('.');
+    size_t dash = rest.find('-');
+    auto digits = [](std::string_view text) {
+      return !text.empty() &&
+             std::all_of(text.begin(), text.end(),
+                         [](char c) { return c >= '0' && c <= '9'; });
+    };
+    return dot != std::string_view::npos && dash != std::string_view::npos &&
+           dot < dash && digits(rest.substr(0, dot)) &&
+           digits(rest.substr(dot + 1, dash - dot - 1)) &&
+           digits(rest.substr(dash + 1));
+  }
+
+  /**
+   * @brief Indexes the complete frames at the start of an existing segment
+   */
+  void recover(Segment &segment) {
+    size_t offset = 0;
+    uint64_t seqNum = 0;
+    while (size_t length = scanFrame(std::string_view(
+               segment.data + offset, segment.capacity - offset), seqNum)) {
+      index(seqNum, segment.number, offset, length);
+      offset += length;
+    }
+    segment.size = offset;
+    segment.synced = offset;
+  }
+
+  /**
+   * @brief Checks for a complete frame at the start of bytes
+   * @return Its length and MsgSeqNum, 0 if there is no valid frame
+   */
+  static size_t scanFrame(std::string_view bytes, uint64_t &seqNum) {
+    constexpr size_t MAX_BODY_LENGTH_DIGITS = 7;
+    if (!bytes.starts_with(Message::BeginString)) {
+      return 0;
+    }
+    size_t beginEnd = bytes.find(Message::SOH);
+    if (beginEnd == std::string_view::npos || beginEnd > 32 ||
+        bytes.substr(beginEnd + 1, 2) != Message::BodyLength) {
+      return 0;
+    }
+    size_t lengthStart = beginEnd + 3;
+    size_t lengthEnd = bytes.find(Message::SOH, lengthStart);
+    size_t bodyLength = 0;
+    if (lengthEnd == std::string_view::npos || lengthEnd == lengthStart ||
+        lengthEnd - lengthStart > MAX_BODY_LENGTH_DIGITS ||
+        std::from_chars(bytes.data() + lengthStart, bytes.data() + lengthEnd,
+                        bodyLength)
+                .ptr != bytes.data() + lengthEnd) {
+      return 0;
+    }
+    size_t trailer = lengthEnd + 1 + bodyLength;
+    size_t length = trailer + TRAILER_LENGTH;
+    if (length > bytes.size() || bytes.substr(trailer, 3) != "10=" ||
+        bytes[length - 1] != Message::SOH) {
+      return 0;
+    }
+    unsigned checksum = 0;
+    if (std::from_chars(bytes.data() + trailer + 3,
+                        bytes.data() + length - 1, checksum)
+                .ptr != bytes.data() + length - 1 ||
+        FixScanner::kernel().checksum(bytes.data(), trailer) % 256 !=
+            checksum) {
+      return 0;
+    }
+    std::string_view value =
+        fieldValue(bytes.substr(0, trailer), "\x01" "34=");
+    if (value.empty() ||
+        std::from_chars(value.data(), value.data() + value.size(), seqNum)
+                .ptr != value.data() + value.size()) {
+      return 0;
+    }
+    return length;
+  }
+
+  /**
+   * @brief Value of the first field starting with tag, e.g. "\x01" "34="
+   */
+  static std::string_view fieldValue(std::string_view frame,
+                                     std::string_view tag) {
+    size_t start = frame.find(tag);
+    if (start == std::string_view::npos) {
+      return {};
+    }
+    start += tag.size();
+    size_t end = frame.find(Message::SOH, start);
+    return end == std::string_view::npos ? std::string_view()
+                                         : frame.substr(start, end - start);
+  }
+
+  /**
+   * @brief Records where the frame with seqNum is stored
+   * Skipped MsgSeqNums are indexed as missing.
+   */
+  void index(uint64_t seqNum, uint64_t segment, size_t offset,
+             size_t length) {
+    if (index_.empty() || seqNum < nextSeq_ ||
+        seqNum - nextSeq_ > MAX_SEQ_GAP) {
+      index_.clear();
+      firstSeq_ = seqNum;
+    }
+    while (firstSeq_ + index_.size() < seqNum) {
+      index_.push_back(Entry{});
+    }
+    index_.push_back(Entry{segment, static_cast<uint32_t>(offset),
+                           static_cast<uint32_t>(length)});
+    nextSeq_ = seqNum + 1;
+  }
+
+  /**
+   * @brief Size of a segment created on the owning thread, with room for
+   * at least bytes
+   */
+  size_t inlineSegmentBytes(size_t bytes) const {
+    size_t first = options_.firstSegmentBytes == 0 ? options_.segmentBytes
+                                                   : options_.firstSegmentBytes;
+    return std::min(options_.segmentBytes, std::max(first, bytes));
+  }
+
+  /**
+   * @brief Starts the full sized next segment if the current one is small
+   */
+  void growSoon() {
+    const Segment &current = *segments_.back();
+    if (!spare_.valid() && current.capacity < options_.segmentBytes) {
+      prepareSpare(current.number + 1);
+    }
+  }
+
+  /**
+   * @brief Starts creating the next segment on a background thread
+   */
+  void prepareSpare(uint64_t number) {
+    sparePath_ = sparePath(number);
+    spare_ = std::async(std::launch::async,
+                        [path = sparePath_, number,
+                         capacity = options_.segmentBytes]() {
+                          return Segment::create(path, number, capacity, true);
+                        });
+  }
+
+  /**
+   * @brief Hands a pending spare to the Reaper rather than waiting for it
+   */
+  void discardSpare() {
+    if (spare_.valid()) {
+      Reaper::instance().discard(std::move(spare_), std::move(sparePath_));
+    }
+  }
+
+  /**
+   * @brief Continues in a new segment with room for bytes
+   */
+  bool rollover(size_t bytes) {
+    if (bytes > options_.segmentBytes) {
+      return false;
+    }
+    Segment &current = *segments_.back();
+    if (options_.sync != JournalSync::None) {
+      syncSegment(current);
+    }
+    uint64_t number = current.number + 1;
+    std::unique_ptr<Segment> next;
+    if (spare_.valid()) {
+      try {
+        next = spare_.get();
+      } catch (const std::exception &) {
+      }
+      if (next && rename(sparePath_.c_str(), path(number).c_str()) == -1) {
+        unlink(sparePath_.c_str());
+        next.reset();
+      }
+    }
+    if (!next) {
+      try {
+        next = Segment::create(path(number), number, inlineSegmentBytes(bytes),
+                               false);
+      } catch (const std::exception &) {
+        return false;
+      }
+    }
+    segments_.push_back(std::move(next));
+    growSoon();
+
+    while (segments_.size() > options_.retainSegments) {
+      uint64_t oldest = segments_.front()->number;
+      unlink(path(oldest).c_str());
+      segments_.pop_front();
+      while (!index_.empty() && (index_.front().length == 0 ||
+                                 index_.front().segment <= oldest)) {
+        index_.pop_front();
+        ++firstSeq_;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Writes the unsynced bytes of one segment per the sync policy
+   */
+  bool syncSegment(Segment &segment) {
+    if (segment.synced == segment.size) {
+      return true;
+    }
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t from = segment.synced & ~(page - 1);
+    size_t length = segment.size - from;
+    int rc = options_.sync == JournalSync::Sync
+                 ? msync(segment.data + from, length, MS_SYNC)
+                 : sync_file_range(segment.fd, static_cast<off_t>(from),
+                                   static_cast<off_t>(length),
+                                   SYNC_FILE_RANGE_WRITE);
+    segment.synced = segment.size;
+    return rc == 0;
+  }
+};
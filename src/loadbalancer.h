@@ -0,0 +1,188 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "metrics.h"
+#include "router.h"
+
+/**
+ * @brief How connections are spread over the workers
+ *
+ * The load of a worker combines its message rate, its connection count and
+ * the bytes waiting in its inbound channels, each relative to the mean over
+ * all workers and weighted. New connections go to the least loaded worker.
+ * When the busiest worker carries imbalance times the mean load, one of
+ * its connections is moved to the least loaded one, at most once per
+ * cooldown, so the next samples show the effect before the next move.
+ */
+struct BalancePolicy {
+  double rateWeight = 1.0;       // Messages per second
+  double connectionWeight = 0.5; // Connections owned
+  double queueWeight = 0.5;      // Routed bytes waiting to be drained
+  double imbalance = 1.5;        // Busiest over mean load that moves a
+                                 // connection, 0 = never move
+  double minRate = 1000;         // Messages/s below which the busiest
+                                 // worker is left alone
+  std::chrono::milliseconds interval{1000}; // Between load samples
+  std::chrono::milliseconds cooldown{5000}; // After a move
+};
+
+/**
+ * @brief Load of one worker over the last sample interval
+ */
+struct WorkerLoad {
+  double messageRate = 0; // Frames parsed per second
+  uint64_t connections = 0;
+  uint64_t queued = 0; // Bytes in the worker's inbound channels
+};
+
+/**
+ * @brief Places new connections and decides on moves between workers
+ *
+ * Fed with samples of the worker metrics by the thread that accepts
+ * connections; not thread-safe. Connections placed since the last sample
+ * count towards their worker, so a burst of logons is spread out rather
+ * than sent to the worker that was idlest before it.
+ */
+class LoadBalancer {
+public:
+  struct Move {
+    size_t from;
+    size_t to;
+  };
+
+  explicit LoadBalancer(size_t workers, const BalancePolicy &policy = {})
+      : policy_(policy), loads_(workers), placed_(workers, 0),
+        lastMessages_(workers, 0) {}
+
+  const BalancePolicy &policy() const { return policy_; }
+
+  /** @brief Loads of the last sample, in worker order */
+  const std::vector<WorkerLoad> &loads() const { return loads_; }
+
+  /**
+   * @brief Takes a sample of the workers' metrics and channel backlogs
+   * Message rates are taken over the time since the previous sample.
+   * @param metrics Metrics of every worker, in worker order
+   */
+  void sample(std::span<const WorkerMetrics *const> metrics,
+              const Router &router, std::chrono::steady_clock::time_point now) {
+    double seconds =
+        std::chrono::duration<double>(now - lastSample_).count();
+    bool first = lastSample_ == std::chrono::steady_clock::time_point();
+    std::vector<WorkerLoad> loads(metrics.size());
+    for (size_t i = 0; i < metrics.size(); ++i) {
+      uint64_t messages = metrics[i]->messagesIn.load();
+      if (!first && seconds > 0) {
+        loads[i].messageRate =
+            static_cast<double>(messages - lastMessages_[i]) / seconds;
+      }
+      lastMessages_[i] = messages;
+      loads[i].connections = metrics[i]->connections();
+      loads[i].queued = router.queuedBytes(static_cast<uint32_t>(i));
+    }
+    lastSample_ = now;
+    update(loads);
+  }
+
+  /**
+   * @brief Replaces the loads of all workers
+   */
+  void update(std::span<const WorkerLoad> loads) {
+    loads_.assign(loads.begin(), loads.end());
+    std::fill(placed_.begin(), placed_.end(), 0);
+  }
+
+  /**
+   * @brief Picks the worker for a new connection and counts it there
+   * Ties go round-robin, so without samples placement is plain round-robin.
+   */
+  size_t place() {
+    std::vector<double> scores = this->scores();
+    size_t best = next_ % scores.size();
+    for (size_t k = 1; k < scores.size(); ++k) {
+      size_t i = (next_ + k) % scores.size();
+      if (scores[i] < scores[best]) {
+        best = i;
+      }
+    }
+    ++placed_[best];
+    next_ = best + 1;
+    return best;
+  }
+
+  /**
+   * @brief Decides whether a connection should move, and between which
+   * workers
+   * @return The move, which also starts the cooldown, or nothing
+   */
+  std::optional<Move> rebalance(std::chrono::steady_clock::time_point now) {
+    if (policy_.imbalance <= 0 || loads_.size() < 2 ||
+        (lastMove_ != std::chrono::steady_clock::time_point() &&
+         now - lastMove_ < policy_.cooldown)) {
+      return std::nullopt;
+    }
+    std::vector<double> scores = this->scores();
+    auto [lowest, highest] = std::minmax_element(scores.begin(), scores.end());
+    size_t from = static_cast<size_t>(highest - scores.begin());
+    size_t to = static_cast<size_t>(lowest - scores.begin());
+    double mean = 0;
+    for (double score : scores) {
+      mean += score / static_cast<double>(scores.size());
+    }
+    const WorkerLoad &busiest = loads_[from];
+    if (from == to || *highest < mean * policy_.imbalance ||
+        busiest.messageRate < policy_.minRate || busiest.connections < 2) {
+      return std::nullopt;
+    }
+    lastMove_ = now;
+    return Move{from, to};
+  }
+
+  /**
+   * @brief Weighted load of every worker, relative to the mean
+   * Each part is the worker's share of the total times the worker count,
+   * so at perfect balance every worker scores the same.
+   */
+  std::vector<double> scores() const {
+    size_t count = loads_.size();
+    double rate = 0, connections = 0, queued = 0;
+    for (size_t i = 0; i < count; ++i) {
+      rate += loads_[i].messageRate;
+      connections += static_cast<double>(loads_[i].connections + placed_[i]);
+      queued += static_cast<double>(loads_[i].queued);
+    }
+    // Shares of each total; a total of 0 adds nothing to any worker
+    auto share = [count](double value, double total) {
+      return total > 0 ? value * static_cast<double>(count) / total : 0;
+    };
+    double weights =
+        policy_.rateWeight + policy_.connectionWeight + policy_.queueWeight;
+    std::vector<double> scores(count);
+    for (size_t i = 0; i < count; ++i) {
+      double score =
+          policy_.rateWeight * share(loads_[i].messageRate, rate) +
+          policy_.connectionWeight *
+              share(static_cast<double>(loads_[i].connections + placed_[i]),
+                    connections) +
+          policy_.queueWeight *
+              share(static_cast<double>(loads_[i].queued), queued);
+      scores[i] = weights > 0 ? score / weights : 0;
+    }
+    return scores;
+  }
+
+private:
+  BalancePolicy policy_;
+  std::vector<WorkerLoad> loads_;
+  std::vector<uint64_t> placed_; // Connections placed since the sample
+  std::vector<uint64_t> lastMessages_;
+  std::chrono::steady_clock::time_point lastSample_{};
+  std::chrono::steady_clock::time_point lastMove_{};
+  size_t next_ = 0; // Where the round-robin of ties continues
+};
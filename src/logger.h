@@ -0,0 +1,462 @@
+#pragma once
+
+// Standard library includes
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// System includes
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Compile-time log levels. Every LOG_* macro below GR_LOG_LEVEL expands to a
+ * discarded `if constexpr` branch, so its arguments are type-checked but no
+ * code is generated. The CMake option GENERALROUTER_LOG_LEVEL sets the value.
+ */
+#define GR_LOG_LEVEL_TRACE 0
+#define GR_LOG_LEVEL_DEBUG 1
+#define GR_LOG_LEVEL_INFO 2
+#define GR_LOG_LEVEL_WARN 3
+#define GR_LOG_LEVEL_ERROR 4
+#define GR_LOG_LEVEL_OFF 5
+
+#ifndef GR_LOG_LEVEL
+#define GR_LOG_LEVEL GR_LOG_LEVEL_INFO
+#endif
+
+#define GR_LOG_AT(threshold, level, ...)                                       \
+  do {                                                                         \
+    if constexpr ((threshold) >= GR_LOG_LEVEL) {                               \
+      Logger::instance().log(level, __VA_ARGS__);                              \
+    }                                                                          \
+  } while (0)
+
+#define LOG_TRACE(...)                                                         \
+  GR_LOG_AT(GR_LOG_LEVEL_TRACE, LogLevel::Trace, __VA_ARGS__)
+#define LOG_DEBUG(...)                                                         \
+  GR_LOG_AT(GR_LOG_LEVEL_DEBUG, LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) GR_LOG_AT(GR_LOG_LEVEL_INFO, LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) GR_LOG_AT(GR_LOG_LEVEL_WARN, LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...)                                                         \
+  GR_LOG_AT(GR_LOG_LEVEL_ERROR, LogLevel::Error, __VA_ARGS__)
+
+/**
+ * @brief Severity of a log record
+ */
+enum class LogLevel : uint8_t { Trace, Debug, Info, Warn, Error };
+
+/**
+ * @brief A fixed-size, unformatted log record
+ *
+ * The producer only copies the raw arguments into payload. Turning them into
+ * text is deferred to the background thread through the formatter, which is
+ * instantiated for the exact argument types of the call site.
+ */
+struct LogRecord {
+  static constexpr size_t SIZE = 256;
+  using Formatter = void (*)(std::string &out, const char *format,
+                             const char *payload);
+
+  int64_t timestamp;   // Nanoseconds since the epoch
+  const char *format;  // Format string with {} placeholders, must be static
+  Formatter formatter; // Decodes payload and expands format
+  LogLevel level;
+  char payload[SIZE - sizeof(int64_t) - sizeof(const char *) -
+               sizeof(Formatter) - sizeof(LogLevel)];
+};
+
+/**
+ * @brief Single-producer single-consumer ring of log records
+ *
+ * Each logging thread owns one ring. The owning thread is the only producer
+ * and the logger's background thread is the only consumer.
+ */
+class LogRing {
+public:
+  static constexpr size_t CAPACITY = 1024; // Must be a power of two
+
+  /**
+   * @brief Returns the next free record or nullptr if the ring is full
+   */
+  LogRecord *tryAcquire() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cachedHead_ == CAPACITY) {
+      cachedHead_ = head_.load(std::memory_order_acquire);
+      if (tail - cachedHead_ == CAPACITY) {
+        return nullptr;
+      }
+    }
+    return &records_[tail & (CAPACITY - 1)];
+  }
+
+  /** @brief Makes the record returned by tryAcquire visible */
+  void publish() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  /** @brief Returns the oldest record or nullptr if the ring is empty */
+  const LogRecord *front() const {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &records_[head & (CAPACITY - 1)];
+  }
+
+  /** @brief Releases the record returned by front */
+  void pop() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  /** @brief Marks the ring as abandoned by its producer thread */
+  void retire() { retired_.store(true, std::memory_order_release); }
+
+  bool retired() const { return retired_.load(std::memory_order_acquire); }
+
+private:
+  alignas(64) std::atomic<size_t> head_{0}; // Consumer position
+  alignas(64) std::atomic<size_t> tail_{0}; // Producer position
+  size_t cachedHead_ = 0;                   // Producer's copy of head_
+  alignas(64) std::atomic<bool> retired_{false};
+  LogRecord records_[CAPACITY];
+};
+
+/**
+ * @brief Asynchronous logger with per-thread lock-free rings
+ *
+ * The calling thread copies arguments into its own ring and returns. A
+ * background thread drains every ring, formats the records and writes them
+ * in batches to the output file (stderr by default).
+ */
+class Logger {
+public:
+  static Logger &instance() {
+    static Logger logger;
+    return logger;
+  }
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  ~Logger() {
+    running_.store(false, std::memory_order_release);
+    if (drainer_.joinable()) {
+      drainer_.join();
+    }
+    drainAll();
+    if (ownsFd_) {
+      close(outputFd_);
+    }
+  }
+
+  /**
+   * @brief Redirects output to a file, appending to it
+   * @param path Path of the log file
+   * @return true if the file was opened
+   */
+  bool setOutputFile(const std::string &path) {
+    int fd =
+        open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    int old = outputFd_;
+    outputFd_ = fd;
+    if (ownsFd_) {
+      close(old);
+    }
+    ownsFd_ = true;
+    return true;
+  }
+
+  /**
+   * @brief Records a message without formatting it
+   * @param level Severity of the record
+   * @param format Format string using {} as placeholders
+   * @param args Values copied into the record; strings are copied by value
+   * and truncated if the record runs out of space
+   */
+  template <typename... Args>
+  void log(LogLevel level, const char *format, const Args &...args) {
+    LogRing &ring = threadRing();
+    LogRecord *record = ring.tryAcquire();
+    if (!record) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    record->timestamp =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    record->format = format;
+    record->formatter = &formatRecord<WireType<Args>...>;
+    record->level = level;
+    [[maybe_unused]] size_t offset = 0;
+    (encode<WireType<Args>>(record->payload, offset, args), ...);
+    ring.publish();
+  }
+
+  /**
+   * @brief Blocks until every record published so far has been written
+   */
+  void flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    drainRings();
+  }
+
+  /** @brief Number of records dropped because a ring was full */
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  /** @brief Number of rings, including those of exited threads not drained */
+  size_t ringCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rings_.size();
+  }
+
+private:
+  static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+  std::mutex mutex_; // Guards rings_ and the output descriptor
+  std::vector<std::shared_ptr<LogRing>> rings_;
+  std::atomic<bool> running_{true};
+  std::atomic<uint64_t> dropped_{0};
+  int outputFd_ = STDERR_FILENO;
+  bool ownsFd_ = false;
+  std::string pending_;
+  std::thread drainer_;
+
+  Logger() = default;
+
+  /**
+   * @brief Canonical representation of an argument inside a record
+   */
+  template <typename T>
+  using WireType = typename std::conditional_t<
+      std::is_convertible_v<const T &, std::string_view>,
+      std::type_identity<std::string_view>,
+      std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>,
+                         std::type_identity<T>>>::type;
+
+  /**
+   * @brief Owns the calling thread's ring and retires it on thread exit
+   */
+  struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+    ~ThreadRing() {
+      if (ring) {
+        ring->retire();
+      }
+    }
+  };
+
+  LogRing &threadRing() {
+    static thread_local ThreadRing local;
+    if (!local.ring) {
+      local.ring = std::make_shared<LogRing>();
+      std::lock_guard<std::mutex> lock(mutex_);
+      rings_.push_back(local.ring);
+      if (!drainer_.joinable()) {
+        drainer_ = std::thread([this]() { run(); });
+      }
+    }
+    return *local.ring;
+  }
+
+  template <typename W, typename T>
+  static void encode(char *payload, size_t &offset, const T &value) {
+    constexpr size_t capacity = sizeof(LogRecord::payload);
+    if constexpr (std::is_same_v<W, std::string_view>) {
+      std::string_view view(value);
+      uint16_t length;
+      if (offset + sizeof(length) > capacity) {
+        offset = capacity + 1; // Mark the remaining arguments as truncated
+        return;
+      }
+      length = static_cast<uint16_t>(
+          std::min(view.size(), capacity - offset - sizeof(length)));
+      std::memcpy(payload + offset, &length, sizeof(length));
+      std::memcpy(payload + offset + sizeof(length), view.data(), length);
+      offset += sizeof(length) + length;
+    } else {
+      static_assert(std::is_trivially_copyable_v<W>,
+                    "log arguments must be strings or trivially copyable");
+      if (offset + sizeof(W) > capacity) {
+        offset = capacity + 1; // Mark the remaining arguments as truncated
+        return;
+      }
+      W wire = static_cast<W>(value);
+      std::memcpy(payload + offset, &wire, sizeof(W));
+      offset += sizeof(W);
+    }
+  }
+
+  template <typename W>
+  static void decodeAndAppend(std::string &out, const char *payload,
+                              size_t &offset) {
+    constexpr size_t capacity = sizeof(LogRecord::payload);
+    if constexpr (std::is_same_v<W, std::string_view>) {
+      uint16_t length = 0;
+      if (offset + sizeof(length) > capacity) {
+        out += "<truncated>";
+        return;
+      }
+      std::memcpy(&length, payload + offset, sizeof(length));
+      out.append(payload + offset + sizeof(length), length);
+      offset += sizeof(length) + length;
+    } else {
+      if (offset + sizeof(W) > capacity) {
+        out += "<truncated>";
+        return;
+      }
+      W value;
+      std::memcpy(&value, payload + offset, sizeof(W));
+      offset += sizeof(W);
+      if constexpr (std::is_same_v<W, bool>) {
+        out += value ? "true" : "false";
+      } else if constexpr (std::is_same_v<W, char>) {
+        out += value;
+      } else if constexpr (std::is_floating_point_v<W>) {
+        char text[32];
+        int n = std::snprintf(text, sizeof(text), "%g",
+                              static_cast<double>(value));
+        out.append(text, n > 0 ? static_cast<size_t>(n) : 0);
+      } else if constexpr (std::is_pointer_v<W>) {
+        char text[32];
+        int n = std::snprintf(text, sizeof(text), "%p",
+                              reinterpret_cast<const void *>(value));
+        out.append(text, n > 0 ? static_cast<size_t>(n) : 0);
+      } else {
+        char text[24];
+        auto result = std::to_chars(text, text + sizeof(text), value);
+        out.append(text, result.ptr);
+      }
+    }
+  }
+
+  /**
+   * @brief Expands one {} placeholder per argument, in order
+   */
+  template <typename... Ws>
+  static void formatRecord(std::string &out, const char *format,
+                           [[maybe_unused]] const char *payload) {
+    [[maybe_unused]] size_t offset = 0;
+    [[maybe_unused]] auto appendNext = [&](auto decode) {
+      while (*format) {
+        if (format[0] == '{' && format[1] == '}') {
+          format += 2;
+          decode();
+          return;
+        }
+        out += *format++;
+      }
+    };
+    (appendNext([&]() { decodeAndAppend<Ws>(out, payload, offset); }), ...);
+    out += format;
+  }
+
+  static const char *levelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace:
+      return "TRACE";
+    case LogLevel::Debug:
+      return "DEBUG";
+    case LogLevel::Info:
+      return "INFO ";
+    case LogLevel::Warn:
+      return "WARN ";
+    case LogLevel::Error:
+      return "ERROR";
+    }
+    return "?????";
+  }
+
+  void appendRecord(const LogRecord &record) {
+    time_t seconds = static_cast<time_t>(record.timestamp / 1000000000);
+    tm parts;
+    gmtime_r(&seconds, &parts);
+    char prefix[48];
+    int n = std::snprintf(
+        prefix, sizeof(prefix), "%04d-%02d-%02d %02d:%02d:%02d.%09lld %s ",
+        parts.tm_year + 1900, parts.tm_mon + 1, parts.tm_mday, parts.tm_hour,
+        parts.tm_min, parts.tm_sec,
+        static_cast<long long>(record.timestamp % 1000000000),
+        levelName(record.level));
+    pending_.append(prefix, n > 0 ? static_cast<size_t>(n) : 0);
+    record.formatter(pending_, record.format, record.payload);
+    pending_ += '\n';
+  }
+
+  void writePending() {
+    size_t written = 0;
+    while (written < pending_.size()) {
+      ssize_t n = ::write(outputFd_, pending_.data() + written,
+                          pending_.size() - written);
+      if (n <= 0) {
+        break;
+      }
+      written += static_cast<size_t>(n);
+    }
+    pending_.clear();
+  }
+
+  /**
+   * @brief Drains every ring once; the caller holds mutex_
+   * @return true if any record was written
+   */
+  bool drainRings() {
+    bool any = false;
+    for (size_t i = 0; i < rings_.size();) {
+      LogRing &ring = *rings_[i];
+      bool retired = ring.retired();
+      while (const LogRecord *record = ring.front()) {
+        appendRecord(*record);
+        ring.pop();
+        any = true;
+        if (pending_.size() >= FLUSH_THRESHOLD) {
+          writePending();
+        }
+      }
+      if (retired) {
+        rings_[i] = std::move(rings_.back());
+        rings_.pop_back();
+      } else {
+        ++i;
+      }
+    }
+    writePending();
+    return any;
+  }
+
+  void drainAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    drainRings();
+  }
+
+  void run() {
+    while (running_.load(std::memory_order_acquire)) {
+      bool any;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        any = drainRings();
+      }
+      if (!any) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @brief Allocates every block of a file that is written through a shared
+ * mapping
+ *
+ * A store into a hole of a MAP_SHARED mapping raises SIGBUS when the disk
+ * is full, killing the process, so the blocks are reserved before the file
+ * is mapped and a full disk fails here instead. Filesystems without
+ * fallocate get the file written with zeros rather than left sparse.
+ * @return false with errno set if the blocks cannot be allocated
+ */
+inline bool allocateFile(int fd, size_t bytes) {
+  int rc = posix_fallocate(fd, 0, static_cast<off_t>(bytes));
+  if (rc == 0) {
+    return true;
+  }
+  if (rc != EOPNOTSUPP && rc != EINVAL) {
+    errno = rc;
+    return false;
+  }
+  static const char zeros[64 * 1024] = {};
+  for (size_t done = 0; done < bytes;) {
+    ssize_t written = pwrite(fd, zeros, std::min(sizeof(zeros), bytes - done),
+                             static_cast<off_t>(done));
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      if (written == 0) {
+        errno = ENOSPC;
+      }
+      return false;
+    }
+    done += static_cast<size_t>(written);
+  }
+  return true;
+}
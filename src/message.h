@@ -1,10 +1,22 @@
 #pragma once
+#include <algorithm>
+#include <array>
 #include <charconv> // Required for std::from_chars
-#include <iostream>
+#include <cstring>
+#include <optional>
 #include <string_view>
-#include <vector>
+#include <type_traits>
 
 #include "circularbuffer.h"
+#include "fieldtable.h"
+#include "fixscan.h"
+#include "fixtypes.h"
+#include "logger.h"
+
+// Number of fields a Message stores without heap allocation
+#ifndef GR_MESSAGE_INLINE_FIELDS
+#define GR_MESSAGE_INLINE_FIELDS 64
+#endif
 
 /**
  * @brief Enum representing possible outcomes of message parsing
@@ -32,10 +44,12 @@ public:
   std::string_view targetCompID; // Message recipient's ID (tag 56)
   std::string_view clOrdID;      // Unique client order ID (tag 11)
   std::string_view seqNumber;    // Message sequence number (tag 34)
-  std::vector<std::pair<std::string_view, std::string_view>>
-      otherFields;       // Additional FIX fields
-  bool finished = false; // Flag indicating complete message parse
-  size_t _checksum;      // Cumulative checksum calculation
+  FieldTable<GR_MESSAGE_INLINE_FIELDS> fields; // Every field, by tag
+  std::string_view frame; // Raw bytes of the whole message, 8= to 10=
+  size_t frameLength = 0;  // Bytes to consume once the message is handled
+  bool finished = false;   // Flag indicating complete message parse
+  bool badChecksum = false; // ERROR was a CheckSum mismatch
+  size_t _checksum;        // Checksum computed over the frame, mod 256
 
   Message() : _checksum(0) {};
   Message(const Message &) = delete;
@@ -56,6 +70,9 @@ public:
   static constexpr std::string_view ClOrdID = "11=";
   static constexpr std::string_view SeqNumber = "34=";
 
+  // Largest BodyLength accepted before a frame is rejected as oversized
+  static constexpr size_t MAX_BODY_LENGTH = 64 * 1024;
+
   /**
    * @brief Sets a field in the message based on tag-value pair
    *
@@ -69,13 +86,16 @@ public:
                               size_t taglength, const char *value,
                               size_t valuelength) {
 
-    int _tag;
-    auto result = std::from_chars(tag, tag + taglength, _tag);
-    if (result.ec == std::errc::invalid_argument ||
-        result.ec == std::errc::result_out_of_range) {
-      std::cerr << "Error: Invalid tag format." << std::endl;
+    // Digits were validated by the scanner, only the width needs checking
+    if (taglength == 0 || taglength > MAX_TAG_DIGITS) {
+      LOG_WARN("Invalid tag format: {}", std::string_view(tag, taglength));
       return; // Or throw an exception, depending on your error handling policy
     }
+    int _tag = 0;
+    for (size_t i = 0; i < taglength; ++i) {
+      _tag = _tag * 10 + (tag[i] - '0');
+    }
+    message.fields.insert(_tag, std::string_view(value, valuelength));
 
     switch (_tag) {
     case 8:
@@ -86,11 +106,7 @@ public:
       break;
     case 10:
       message.checkSum = std::string_view(value, valuelength);
-      message._checksum -= '1' + '0' + '=' + SOH;
-      for (size_t i = 0; i < valuelength; i++) {
-        message._checksum -= value[i];
-      }
-      std::cout << "Final Checksum: " << message._checksum % 256 << std::endl;
+      LOG_TRACE("Final Checksum: {}", message._checksum);
       message.finished = true;
       break;
     case 35:
@@ -109,21 +125,123 @@ public:
       message.seqNumber = std::string_view(value, valuelength);
       break;
     default:
-      message.otherFields.emplace_back(std::string_view(tag, taglength),
-                                       std::string_view(value, valuelength));
       break;
     }
   }
 
+  /**
+   * @brief Locates and verifies one complete frame at the start of data
+   *
+   * Reads only the BeginString and BodyLength fields, then jumps straight to
+   * the CheckSum trailer that BodyLength points at. The checksum is verified
+   * over the contiguous frame with one vector pass. Nothing is dispatched and
+   * nothing is consumed.
+   *
+   * @param data Start of the buffered bytes, expected to begin with "8="
+   * @param length Number of buffered bytes
+   * @param frameLength Output frame size including the trailer. Set on
+   * FINISHED, and on ERROR when the frame boundary is known but its content
+   * is invalid (bad checksum) so the caller can skip it. Zero for garbled
+   * headers, after which the stream cannot be resynchronised.
+   * @param checksum Output checksum computed over the frame, mod 256
+   * @return FINISHED if a valid frame is present, CONTINUE if more bytes are
+   * needed, ERROR otherwise
+   */
+  static ParseResult frameFixMessage(const char *data, size_t length,
+                                     size_t &frameLength, size_t &checksum) {
+    frameLength = 0;
+    const FixScanner::Kernel &scan = FixScanner::kernel();
+
+    // 8=<BeginString><SOH>
+    if (!matchesPrefix(data, length, BeginString)) {
+      LOG_WARN("Frame does not start with BeginString");
+      return ParseResult::ERROR;
+    }
+    if (length <= BeginString.size()) {
+      return ParseResult::CONTINUE;
+    }
+    size_t searchLength =
+        std::min(length - BeginString.size(), MAX_BEGIN_STRING + 1);
+    size_t versionEnd =
+        scan.find(data + BeginString.size(), searchLength, SOH);
+    if (versionEnd == FixScanner::npos) {
+      if (searchLength > MAX_BEGIN_STRING) {
+        LOG_WARN("BeginString too long");
+        return ParseResult::ERROR;
+      }
+      return ParseResult::CONTINUE;
+    }
+    size_t pos = BeginString.size() + versionEnd + 1;
+
+    // 9=<BodyLength><SOH>
+    if (!matchesPrefix(data + pos, length - pos, BodyLength)) {
+      LOG_WARN("BodyLength must be the second field");
+      return ParseResult::ERROR;
+    }
+    if (length - pos <= BodyLength.size()) {
+      return ParseResult::CONTINUE;
+    }
+    pos += BodyLength.size();
+    size_t bodyLength = 0;
+    size_t digits = 0;
+    while (pos < length && data[pos] != SOH) {
+      if (data[pos] < '0' || data[pos] > '9' ||
+          ++digits > MAX_BODY_LENGTH_DIGITS) {
+        LOG_WARN("Invalid BodyLength");
+        return ParseResult::ERROR;
+      }
+      bodyLength = bodyLength * 10 + static_cast<size_t>(data[pos++] - '0');
+    }
+    if (pos == length) {
+      return ParseResult::CONTINUE;
+    }
+    if (digits == 0 || bodyLength > MAX_BODY_LENGTH) {
+      LOG_WARN("BodyLength out of range: {}", bodyLength);
+      return ParseResult::ERROR;
+    }
+
+    // 10=NNN<SOH> right after the body
+    size_t trailer = pos + 1 + bodyLength;
+    if (length < trailer + TRAILER_LENGTH) {
+      return ParseResult::CONTINUE;
+    }
+    const char *t = data + trailer;
+    if (!matchesPrefix(t, TRAILER_LENGTH, CheckSum) ||
+        !scan.allDigits(t + CheckSum.size(), 3) ||
+        t[TRAILER_LENGTH - 1] != SOH) {
+      LOG_WARN("CheckSum not found where BodyLength points");
+      return ParseResult::ERROR;
+    }
+
+    frameLength = trailer + TRAILER_LENGTH;
+    checksum = scan.checksum(data, trailer) % 256;
+    size_t received = static_cast<size_t>((t[3] - '0') * 100 +
+                                          (t[4] - '0') * 10 + (t[5] - '0'));
+    if (checksum != received) {
+      LOG_WARN("Checksum error: Calculated {}, received {}", checksum,
+               received);
+      return ParseResult::ERROR;
+    }
+    return ParseResult::FINISHED;
+  }
+
   /**
    * @brief Parses a FIX message from a circular buffer
    *
-   * Performs zero-copy parsing of FIX messages, maintaining a running checksum
-   * and validating the message format.
+   * Frames the message first with frameFixMessage, and only dispatches the
+   * fields once the whole frame is known to be present and intact. With a
+   * mirrored buffer the read view covers every buffered byte, so a message
+   * straddling the wrap point is scanned in a single linear pass.
+   *
+   * The buffer is not consumed: the string_views stored in message stay valid
+   * until the caller calls buffer.consume(message.frameLength), typically
+   * after the handler has returned.
    *
    * @param buffer Circular buffer containing message data
    * @param message Message object to populate
-   * @return ParseResult indicating parsing outcome
+   * @return ParseResult indicating parsing outcome. On ERROR a non-zero
+   * message.frameLength is the number of bytes to discard, and
+   * message.badChecksum tells a CheckSum mismatch from malformed fields.
    */
   static ParseResult parseFixMessage(CircularBuffer &buffer, Message &message) {
     size_t start;
@@ -132,64 +250,112 @@ public:
     if (!buffer.getReadView(start, data, length)) {
       return ParseResult::CONTINUE;
     }
+    return parseFixMessage(data, length, message);
+  }
 
-    size_t pos = 0;
-    while (pos < length) {
-      // get field tag
-      size_t tagstart = pos;
-      while ('=' != data[pos] && pos < length) {
-        if (data[pos] < '0' || data[pos] > '9') {
-          std::cout << "Invalid tag character: " << data[pos] << std::endl;
-          // buffer.consume(pos); // Consume invalid data
-          return ParseResult::ERROR;
-        }
-        message._checksum += data[pos++];
-      }
-      if (pos == length) {
-        std::cout << "Incomplete tag." << std::endl;
-        return ParseResult::CONTINUE; // Need more data
+  /**
+   * @brief Parses the FIX message at the start of contiguous bytes
+   *
+   * Same as the buffer overload, for callers walking several frames of one
+   * read view: the next frame starts message.frameLength bytes further.
+   * The string_views stored in message point into data.
+   */
+  static ParseResult parseFixMessage(const char *data, size_t length,
+                                     Message &message) {
+    size_t frameLength;
+    size_t checksum;
+    ParseResult framed = frameFixMessage(data, length, frameLength, checksum);
+    message.frameLength = frameLength;
+    // Only a checksum mismatch fails after the frame length is known
+    message.badChecksum = framed == ParseResult::ERROR && frameLength != 0;
+    if (framed != ParseResult::FINISHED) {
+      if (framed == ParseResult::CONTINUE) {
+        LOG_TRACE("Message not finished.");
       }
-      size_t taglen = pos - tagstart;
-
-      message._checksum += data[pos++]; // Consume '='
+      return framed;
+    }
 
-      size_t valuestart = pos;
-      while (SOH != data[pos] && pos < length) {
-        message._checksum += data[pos++];
-      }
-      if (pos == length) {
-        std::cout << "Incomplete value." << std::endl;
-        return ParseResult::CONTINUE; // Need more data
-      }
+    message._checksum = checksum;
+    if (!dispatchFields(message, data, frameLength)) {
+      return ParseResult::ERROR;
+    }
+    message.frame = std::string_view(data, frameLength);
+    return ParseResult::FINISHED;
+  }
 
-      message._checksum += data[pos++]; // Consume SOH
-      setMessageField(message, data + tagstart, taglen, data + valuestart,
-                      pos - valuestart - 1);
-      buffer.consume(pos - tagstart);
-      if (message.finished) {
-        auto calculated_checksum =
-            static_cast<long int>(message._checksum % 256);
-        int received_checksum;
-        auto result =
-            std::from_chars(message.checkSum.data(),
-                            message.checkSum.data() + message.checkSum.length(),
-                            received_checksum);
-        if (result.ec == std::errc::invalid_argument ||
-            result.ec == std::errc::result_out_of_range) {
-          std::cerr << "Error: Invalid tag format." << std::endl;
-          return ParseResult::ERROR;
-        }
+  /**
+   * @brief Looks up any field of the message by tag in constant time
+   * @param tag Numeric FIX tag
+   * @return The value of the first occurrence, or an empty view if absent
+   */
+  std::string_view get(int tag) const {
+    const FixField *field = fields.find(tag);
+    return field ? field->value : std::string_view();
+  }
 
-        if (calculated_checksum != received_checksum) {
-          std::cout << "Checksum error: Calculated " << calculated_checksum
-                    << ", received " << received_checksum << std::endl;
-          return ParseResult::ERROR;
+  /**
+   * @brief Reads a field as the type its tag is declared with
+   *
+   * The text is converted on the first call for the tag and the result is
+   * cached until reset(), so handlers can ask again without re-parsing.
+   * @tparam Tag A FixTag, such as fix::MsgSeqNum or fix::Price
+   * @return The value, or nullopt if the field is absent or malformed
+   */
+  template <typename Tag> std::optional<typename Tag::type> get() const {
+    using T = typename Tag::type;
+    static_assert(std::is_trivially_copyable_v<T> &&
+                      sizeof(T) <= sizeof(TypedValue::bytes),
+                  "Typed fields must fit the value cache");
+    const void *kind = &TypedKind<T>::id;
+    for (size_t i = 0; i < typedCount_; ++i) {
+      const TypedValue &cached = typed_[i];
+      if (cached.tag == Tag::tag && cached.kind == kind) {
+        if (!cached.valid) {
+          return std::nullopt;
         }
-        return ParseResult::FINISHED;
+        T value;
+        std::memcpy(&value, cached.bytes, sizeof(T));
+        return value;
       }
     }
-    std::cout << "Message not finished." << std::endl;
-    return ParseResult::CONTINUE;
+    const FixField *field = fields.find(Tag::tag);
+    T value{};
+    bool valid = field != nullptr && FixValue<T>::parse(field->value, value);
+    if (typedCount_ < TYPED_CACHE) {
+      TypedValue &cached = typed_[typedCount_++];
+      cached.tag = Tag::tag;
+      cached.kind = kind;
+      cached.valid = valid;
+      std::memcpy(cached.bytes, &value, sizeof(T));
+    }
+    if (!valid) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  /**
+   * @brief Checks whether the message carries the given tag
+   */
+  bool has(int tag) const { return fields.find(tag) != nullptr; }
+
+  /**
+   * @brief Checks whether a tag is also exposed as a named member
+   */
+  static constexpr bool isNamedTag(int tag) {
+    switch (tag) {
+    case 8:
+    case 9:
+    case 10:
+    case 11:
+    case 34:
+    case 35:
+    case 49:
+    case 56:
+      return true;
+    default:
+      return false;
+    }
   }
 
   // Add required field validation flags
@@ -208,8 +374,73 @@ public:
     targetCompID = {};
     clOrdID = {};
     seqNumber = {};
-    otherFields.clear();
+    fields.clear();
+    frame = {};
+    frameLength = 0;
     finished = false;
+    badChecksum = false;
     _checksum = 0;
+    typedCount_ = 0;
+  }
+
+private:
+  static constexpr size_t MAX_BEGIN_STRING = 16;
+  static constexpr size_t MAX_TAG_DIGITS = 9;
+  static constexpr size_t MAX_BODY_LENGTH_DIGITS = 7;
+  static constexpr size_t TRAILER_LENGTH = 7; // "10=NNN" + SOH
+  static constexpr size_t TYPED_CACHE = 8;     // Typed fields kept per message
+
+  // Address of id identifies a value type in the typed cache
+  template <typename T> struct TypedKind {
+    static constexpr char id = 0;
+  };
+
+  // One converted field, for get<Tag>()
+  struct TypedValue {
+    int tag = 0;
+    bool valid = false;
+    const void *kind = nullptr;
+    alignas(8) unsigned char bytes[16];
+  };
+
+  mutable std::array<TypedValue, TYPED_CACHE> typed_{};
+  mutable size_t typedCount_ = 0;
+
+  /**
+   * @brief Checks that the available bytes agree with the start of prefix
+   */
+  static bool matchesPrefix(const char *data, size_t length,
+                            std::string_view prefix) {
+    size_t n = std::min(length, prefix.size());
+    return std::string_view(data, n) == prefix.substr(0, n);
+  }
+
+  /**
+   * @brief Splits a verified frame into fields and stores them in message
+   * @return false if a field is malformed
+   */
+  static bool dispatchFields(Message &message, const char *data,
+                             size_t length) {
+    const FixScanner::Kernel &scan = FixScanner::kernel();
+    size_t pos = 0;
+    while (pos < length) {
+      size_t equals = scan.find(data + pos, length - pos, '=');
+      if (equals == FixScanner::npos || equals == 0 ||
+          !scan.allDigits(data + pos, equals)) {
+        LOG_WARN("Invalid tag in: {}",
+                 std::string_view(data + pos, std::min<size_t>(
+                                                  length - pos, 16)));
+        return false;
+      }
+      size_t valuestart = pos + equals + 1; // Skip '='
+      size_t soh = scan.find(data + valuestart, length - valuestart, SOH);
+      if (soh == FixScanner::npos) {
+        LOG_WARN("Unterminated field value");
+        return false;
+      }
+      setMessageField(message, data + pos, equals, data + valuestart, soh);
+      pos = valuestart + soh + 1; // Consume SOH
+    }
+    return message.finished;
   }
 };
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "channel.h"
+#include "histogram.h"
+
+/**
+ * @brief Cheap monotonic time stamps for latency metrics
+ *
+ * Reads the time stamp counter where there is one, which costs a few ns
+ * instead of the 20 or so of clock_gettime, and steady_clock nanoseconds
+ * elsewhere. Ticks are only converted to nanoseconds when metrics are read.
+ */
+class MetricsClock {
+public:
+  static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#endif
+  }
+
+  /**
+   * @brief Nanoseconds per tick
+   * Measured against steady_clock on the first call, which takes 20 ms.
+   */
+  static double nsPerTick() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double ratio = [] {
+      auto start = std::chrono::steady_clock::now();
+      uint64_t first = now();
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      uint64_t ticks = now() - first;
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start);
+      return ticks == 0 ? 1.0
+                        : static_cast<double>(elapsed.count()) /
+                              static_cast<double>(ticks);
+    }();
+    return ratio;
+#else
+    return 1.0;
+#endif
+  }
+};
+
+/**
+ * @brief Monotonic counter with a single writer and any number of readers
+ *
+ * The writer adds with a relaxed load and store rather than a locked
+ * read-modify-write, so counting costs the same as on a plain integer.
+ * Readers see every value eventually, never a torn one.
+ */
+class MetricCounter {
+public:
+  void add(uint64_t n = 1) {
+    value_.store(value_.load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+  }
+
+  uint64_t load() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * @brief Log-linear histogram with a single writer and lock-free readers
+ *
+ * Buckets follow HistogramBuckets. Recording is a bucket lookup and three
+ * relaxed counter updates; readers copy the buckets into a
+ * LatencyHistogram. A snapshot taken while samples are recorded may be a
+ * few samples behind in some buckets, never inconsistent within one.
+ */
+class MetricHistogram {
+public:
+  /**
+   * @param precisionBits Resolution, 7 reports values within 1.6%
+   */
+  explicit MetricHistogram(unsigned precisionBits = 7)
+      : buckets_(precisionBits),
+        counts_(std::make_unique<MetricCounter[]>(buckets_.count())) {}
+
+  void record(uint64_t value, uint64_t count = 1) {
+    counts_[buckets_.indexOf(value)].add(count);
+    total_.add(count);
+    sum_.add(value * count);
+  }
+
+  uint64_t count() const { return total_.load(); }
+  uint64_t sum() const { return sum_.load(); }
+
+  /**
+   * @brief Adds every recorded sample to into, multiplied by scale
+   * Each sample counts as the highest value of its bucket.
+   * @param into Histogram to add to, typically shared by several workers
+   * @param scale Unit conversion, e.g. MetricsClock::nsPerTick()
+   */
+  void snapshot(LatencyHistogram &into, double scale = 1.0) const {
+    for (size_t i = 0; i < buckets_.count(); ++i) {
+      uint64_t count = counts_[i].load();
+      if (count != 0) {
+        into.record(static_cast<uint64_t>(
+                        static_cast<double>(buckets_.highestOf(i)) * scale),
+                    count);
+      }
+    }
+  }
+
+private:
+  HistogramBuckets buckets_;
+  std::unique_ptr<MetricCounter[]> counts_;
+  MetricCounter total_;
+  MetricCounter sum_;
+};
+
+/**
+ * @brief Runtime metrics of one worker
+ *
+ * Only the owning worker writes, anything may read at any time. The
+ * structure starts on its own cache line and groups what is written for
+ * every message apart from the error counters, so readers and other
+ * workers never share a line the worker writes on its fast path.
+ */
+struct alignas(CACHE_LINE) WorkerMetrics {
+  // Updated for every read, write and message
+  MetricCounter bytesIn;     // Read from client sockets
+  MetricCounter bytesOut;    // Written to client sockets
+  MetricCounter messagesIn;  // Complete, valid frames parsed
+  MetricCounter messagesOut; // Frames written to write buffers
+  MetricCounter routedIn;    // Frames received from other workers
+
+  // Updated per connection or on errors
+  alignas(CACHE_LINE) MetricCounter connectionsOpened;
+  MetricCounter connectionsClosed;
+  MetricCounter garbledStreams;      // Connections closed on unframeable input
+  MetricCounter checksumErrors;      // Frames discarded for their CheckSum
+  MetricCounter invalidMessages;     // Other frames discarded
+  MetricCounter readBufferOverflows; // Frames too large for any buffer
+  MetricCounter writeBufferDrops;    // Responses or routed frames not written
+  MetricCounter routeDrops;          // Unroutable frames, full channels
+  MetricCounter journalErrors;       // Failed journal appends and syncs
+  MetricCounter readPauses;          // Reading paused for pending output
+  MetricCounter slowConsumers;       // Disconnected for pending output
+  MetricCounter heartbeatsSent;      // Heartbeats and TestRequests sent
+  MetricCounter heartbeatTimeouts;   // Closed for an unanswered TestRequest
+  MetricCounter idleTimeouts;        // Closed after the idle timeout
+  MetricCounter migrationsIn;        // Connections taken from other workers
+  MetricCounter migrationsOut;       // Connections moved to other workers
+
+  // Ticks from the read that completed a frame until it was parsed
+  MetricHistogram readToParse;
+  // Ticks from parsing a frame (or draining it from another worker) until
+  // its response or routed copy left the write buffer
+  MetricHistogram parseToFlush;
+  // Routed frames found per drain of the inbound channels
+  MetricHistogram inboundDepth;
+
+  /**
+   * @brief Connections the worker currently owns
+   * Read while the worker runs, the counters may be a few updates apart.
+   */
+  uint64_t connections() const {
+    uint64_t in = connectionsOpened.load() + migrationsIn.load();
+    uint64_t out = connectionsClosed.load() + migrationsOut.load();
+    return in > out ? in - out : 0;
+  }
+};
@@ -0,0 +1,315 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "channel.h"
+#include "histogram.h"
+#include "logger.h"
+#include "metrics.h"
+
+/**
+ * @class MetricsServer
+ * @brief Serves the metrics of every worker in Prometheus text format
+ *
+ * A thread of its own answers GET /metrics on the admin port, one request
+ * per connection. Every scrape reads the workers' counters and histograms
+ * as they are, without locks and without stopping the workers; the cost
+ * of a scrape is paid by this thread alone.
+ */
+class MetricsServer {
+public:
+  static constexpr double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+  static constexpr int IO_TIMEOUT_MS = 1000; // Per request read and write
+
+  /**
+   * @brief Opens the admin port and starts answering scrapes
+   * @param port Port to listen on
+   * @param workers Metrics of each worker, in worker order; must outlive
+   * the server
+   * @throws Exits program on socket creation/binding failure
+   */
+  MetricsServer(uint16_t port, std::vector<const WorkerMetrics *> workers)
+      : workers_(std::move(workers)) {
+    listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd_ == -1) {
+      LOG_ERROR("Failed to create metrics socket: {}", strerror(errno));
+      exit(1);
+    }
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(listenFd_, reinterpret_cast<sockaddr *>(&addr), sizeof addr) ==
+            -1 ||
+        listen(listenFd_, 16) == -1) {
+      LOG_ERROR("Failed to listen on metrics port {}: {}", port,
+                strerror(errno));
+      close(listenFd_);
+      exit(1);
+    }
+    thread_ = std::jthread([this]() { serve(); });
+  }
+
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+  ~MetricsServer() {
+    stop_ = true;
+    stopSignal_.notify();
+    thread_.join();
+    close(listenFd_);
+  }
+
+  /**
+   * @brief Port the server listens on, useful after binding port 0
+   */
+  uint16_t port() const {
+    sockaddr_in addr{};
+    socklen_t length = sizeof addr;
+    getsockname(listenFd_, reinterpret_cast<sockaddr *>(&addr), &length);
+    return ntohs(addr.sin_port);
+  }
+
+  /**
+   * @brief Renders the metrics of the given workers
+   *
+   * Counters are labelled with the worker index. Latencies are summaries in
+   * seconds, per worker and, without the worker label, over all of them.
+   * Quantiles cover everything recorded since the worker started.
+   */
+  static std::string render(std::span<const WorkerMetrics *const> workers) {
+    std::string out;
+    counter(out, workers, "bytes_received_total",
+            "Bytes read from client sockets", &WorkerMetrics::bytesIn);
+    counter(out, workers, "bytes_sent_total", "Bytes written to client sockets",
+            &WorkerMetrics::bytesOut);
+    counter(out, workers, "messages_received_total",
+            "Valid FIX frames parsed", &WorkerMetrics::messagesIn);
+    counter(out, workers, "messages_sent_total",
+            "FIX frames written to write buffers",
+            &WorkerMetrics::messagesOut);
+    counter(out, workers, "routed_frames_received_total",
+            "Frames received from other workers", &WorkerMetrics::routedIn);
+    counter(out, workers, "connections_opened_total", "Connections taken over",
+            &WorkerMetrics::connectionsOpened);
+    counter(out, workers, "connections_closed_total", "Connections closed",
+            &WorkerMetrics::connectionsClosed);
+    counter(out, workers, "garbled_streams_total",
+            "Connections closed on input that cannot be framed",
+            &WorkerMetrics::garbledStreams);
+    counter(out, workers, "checksum_errors_total",
+            "Frames discarded for a CheckSum mismatch",
+            &WorkerMetrics::checksumErrors);
+    counter(out, workers, "invalid_messages_total",
+            "Frames discarded for malformed fields",
+            &WorkerMetrics::invalidMessages);
+    counter(out, workers, "read_buffer_overflows_total",
+            "Connections closed on a frame larger than the read buffer",
+            &WorkerMetrics::readBufferOverflows);
+    counter(out, workers, "write_buffer_drops_total",
+            "Responses and routed frames dropped for write buffer space",
+            &WorkerMetrics::writeBufferDrops);
+    counter(out, workers, "route_drops_total",
+            "Frames dropped without a route or channel space",
+            &WorkerMetrics::routeDrops);
+    counter(out, workers, "journal_errors_total",
+            "Failed journal appends and syncs", &WorkerMetrics::journalErrors);
+    counter(out, workers, "read_pauses_total",
+            "Times reading stopped until pending output drained",
+            &WorkerMetrics::readPauses);
+    counter(out, workers, "slow_consumer_disconnects_total",
+            "Connections closed for pending output above the high watermark",
+            &WorkerMetrics::slowConsumers);
+    counter(out, workers, "heartbeats_sent_total",
+            "Heartbeats and TestRequests sent on idle sessions",
+            &WorkerMetrics::heartbeatsSent);
+    counter(out, workers, "heartbeat_timeouts_total",
+            "Sessions closed for a TestRequest left unanswered",
+            &WorkerMetrics::heartbeatTimeouts);
+    counter(out, workers, "idle_timeouts_total",
+            "Connections closed for receiving nothing within the idle timeout",
+            &WorkerMetrics::idleTimeouts);
+    counter(out, workers, "migrations_in_total",
+            "Connections taken over from other workers",
+            &WorkerMetrics::migrationsIn);
+    counter(out, workers, "migrations_out_total",
+            "Connections moved to other workers",
+            &WorkerMetrics::migrationsOut);
+
+    double nsPerTick = MetricsClock::nsPerTick();
+    summary(out, workers, "read_to_parse_seconds",
+            "From the read completing a frame until it was parsed",
+            &WorkerMetrics::readToParse, nsPerTick, 1e-9);
+    summary(out, workers, "parse_to_flush_seconds",
+            "From parsing a frame until its output left the write buffer",
+            &WorkerMetrics::parseToFlush, nsPerTick, 1e-9);
+    summary(out, workers, "inbound_channel_depth",
+            "Routed frames found per drain of the inbound channels",
+            &WorkerMetrics::inboundDepth, 1, 1);
+    return out;
+  }
+
+private:
+  static constexpr std::string_view PREFIX = "generalrouter_";
+
+  static void header(std::string &out, std::string_view name,
+                     std::string_view help, std::string_view type) {
+    out.append("# HELP ").append(PREFIX).append(name).append(" ");
+    out.append(help).append("\n# TYPE ").append(PREFIX).append(name);
+    out.append(" ").append(type).append("\n");
+  }
+
+  static void sample(std::string &out, std::string_view name,
+                     std::string_view labels, std::string_view value) {
+    out.append(PREFIX).append(name);
+    if (!labels.empty()) {
+      out.append("{").append(labels).append("}");
+    }
+    out.append(" ").append(value).append("\n");
+  }
+
+  // Counts stay exact past 2^53
+  static void sample(std::string &out, std::string_view name,
+                     std::string_view labels, uint64_t value) {
+    sample(out, name, labels, std::string_view(std::to_string(value)));
+  }
+
+  static void sample(std::string &out, std::string_view name,
+                     std::string_view labels, double value) {
+    char number[32];
+    std::snprintf(number, sizeof number, "%.9g", value);
+    sample(out, name, labels, std::string_view(number));
+  }
+
+  static std::string workerLabel(size_t index) {
+    return "worker=\"" + std::to_string(index) + "\"";
+  }
+
+  static void counter(std::string &out,
+                      std::span<const WorkerMetrics *const> workers,
+                      std::string_view name, std::string_view help,
+                      MetricCounter WorkerMetrics::*member) {
+    header(out, name, help, "counter");
+    for (size_t i = 0; i < workers.size(); ++i) {
+      sample(out, name, workerLabel(i), (workers[i]->*member).load());
+    }
+  }
+
+  static void quantiles(std::string &out, std::string_view name,
+                        const std::string &labels,
+                        const LatencyHistogram &histogram, double sum,
+                        double unit) {
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    for (double q : QUANTILES) {
+      char label[48];
+      std::snprintf(label, sizeof label, "quantile=\"%g\"", q);
+      sample(out, name, prefix + label,
+             static_cast<double>(histogram.percentile(q * 100)) * unit);
+    }
+    std::string plain(name);
+    sample(out, plain + "_sum", labels, sum);
+    sample(out, plain + "_count", labels, histogram.count());
+  }
+
+  // Samples are scaled to integer nanoseconds (or left as counts) by scale,
+  // which keeps the snapshots precise, and reported multiplied by unit
+  static void summary(std::string &out,
+                      std::span<const WorkerMetrics *const> workers,
+                      std::string_view name, std::string_view help,
+                      MetricHistogram WorkerMetrics::*member, double scale,
+                      double unit) {
+    header(out, name, help, "summary");
+    LatencyHistogram all;
+    double allSum = 0;
+    for (size_t i = 0; i < workers.size(); ++i) {
+      const MetricHistogram &histogram = workers[i]->*member;
+      LatencyHistogram snapshot;
+      histogram.snapshot(snapshot, scale);
+      double sum = static_cast<double>(histogram.sum()) * scale * unit;
+      quantiles(out, name, workerLabel(i), snapshot, sum, unit);
+      all.merge(snapshot);
+      allSum += sum;
+    }
+    quantiles(out, name, "", all, allSum, unit);
+  }
+
+  void serve() {
+    while (!stop_) {
+      pollfd fds[2] = {{listenFd_, POLLIN, 0}, {stopSignal_.fd(), POLLIN, 0}};
+      if (::poll(fds, 2, -1) == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        LOG_ERROR("Metrics poll failed: {}", strerror(errno));
+        return;
+      }
+      if (fds[0].revents & POLLIN) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd != -1) {
+          answer(fd);
+          close(fd);
+        }
+      }
+    }
+  }
+
+  // Reads the request line and answers it; slow clients time out
+  void answer(int fd) {
+    timeval timeout{IO_TIMEOUT_MS / 1000, (IO_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+
+    std::string request;
+    char chunk[1024];
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.size() < 8192) {
+      ssize_t n = read(fd, chunk, sizeof chunk);
+      if (n <= 0) {
+        return;
+      }
+      request.append(chunk, static_cast<size_t>(n));
+    }
+
+    std::string_view line(request);
+    line = line.substr(0, line.find("\r\n"));
+    bool scrape = line.starts_with("GET /metrics ") || line == "GET /metrics";
+    std::string body = scrape ? render(workers_) : "Not found\n";
+    std::string response =
+        std::string(scrape ? "HTTP/1.0 200 OK\r\n"
+                           : "HTTP/1.0 404 Not Found\r\n") +
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " +
+        std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    for (size_t sent = 0; sent < response.size();) {
+      ssize_t n = send(fd, response.data() + sent, response.size() - sent,
+                       MSG_NOSIGNAL);
+      if (n <= 0) {
+        LOG_WARN("Metrics response not sent: {}", strerror(errno));
+        return;
+      }
+      sent += static_cast<size_t>(n);
+    }
+  }
+
+  std::vector<const WorkerMetrics *> workers_;
+  int listenFd_ = -1;
+  std::atomic<bool> stop_{false};
+  EventSignal stopSignal_;
+  std::jthread thread_;
+};
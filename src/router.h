@@ -0,0 +1,705 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "channel.h"
+#include "fixscan.h"
+#include "logger.h"
+#include "message.h"
+
+/**
+ * @brief Where a logged-on session lives
+ *
+ * sessionId is unique for the lifetime of the process, so a stale address
+ * never matches a connection that later reuses the same fd.
+ */
+struct SessionAddress {
+  uint32_t worker = 0;    // Index of the owning worker
+  int fd = -1;            // Connection fd on that worker
+  uint64_t sessionId = 0; // 0 = no session
+};
+
+/**
+ * @brief Sends messages of one MsgType to a fixed destination session
+ *
+ * An empty senderCompID matches every sender; a rule naming the sender wins
+ * over it. Messages without a matching rule go to their TargetCompID.
+ * Drop-copy sessions listed in copies get the message as well.
+ */
+struct RouteRule {
+  std::string msgType;
+  std::string senderCompID;
+  std::string destination;           // CompID of the receiving session
+  std::vector<std::string> copies{}; // CompIDs that receive a copy too
+};
+
+/**
+ * @brief Header spans of a received frame that forwarding rewrites
+ *
+ * Offsets are relative to the start of the frame, so a layout stays valid
+ * for a copy of the frame in another buffer.
+ */
+struct FrameLayout {
+  uint32_t bodyLengthAt = 0; // BodyLength (9) value
+  uint32_t bodyLengthSize = 0;
+  uint32_t targetAt = 0; // TargetCompID (56) value
+  uint32_t targetSize = 0;
+  uint32_t seqNumAt = 0; // MsgSeqNum (34) value
+  uint32_t seqNumSize = 0;
+  uint32_t trailerAt = 0; // "10=" of the CheckSum trailer
+  uint8_t checksum = 0;   // Byte sum mod 256 of everything before trailerAt
+
+  /**
+   * @brief Records the rewritable spans of a parsed message
+   * @return false if the frame lacks TargetCompID or MsgSeqNum
+   */
+  static bool of(const Message &message, FrameLayout &layout) {
+    const char *base = message.frame.data();
+    if (base == nullptr || message.targetCompID.data() == nullptr ||
+        message.seqNumber.data() == nullptr) {
+      return false;
+    }
+    layout.bodyLengthAt = static_cast<uint32_t>(message.bodyLength.data() - base);
+    layout.bodyLengthSize = static_cast<uint32_t>(message.bodyLength.size());
+    layout.targetAt = static_cast<uint32_t>(message.targetCompID.data() - base);
+    layout.targetSize = static_cast<uint32_t>(message.targetCompID.size());
+    layout.seqNumAt = static_cast<uint32_t>(message.seqNumber.data() - base);
+    layout.seqNumSize = static_cast<uint32_t>(message.seqNumber.size());
+    layout.trailerAt = static_cast<uint32_t>(message.checkSum.data() - base -
+                                             Message::CheckSum.size());
+    layout.checksum = static_cast<uint8_t>(message._checksum);
+    return true;
+  }
+
+  /**
+   * @brief Copies the frame with a new TargetCompID and MsgSeqNum
+   *
+   * Everything but the three header values and the trailer is copied
+   * verbatim. BodyLength and CheckSum are adjusted by the size and byte sum
+   * differences of the replaced values, so the body is never re-scanned.
+   *
+   * @param frame The frame this layout was taken from
+   * @param target New TargetCompID
+   * @param seqNum New MsgSeqNum
+   * @return Length of the written frame, 0 if it does not fit
+   */
+  size_t forward(std::string_view frame, std::string_view target,
+                 uint64_t seqNum, char *out, size_t capacity) const {
+    unsigned frameChecksum;
+    size_t header = forwardHeader(frame, target, seqNum, out, capacity,
+                                  frameChecksum);
+    size_t shared = trailerAt - sharedAt();
+    if (header == 0 || capacity - header < shared + TRAILER_LENGTH) {
+      return 0;
+    }
+    std::memcpy(out + header, frame.data() + sharedAt(), shared);
+    writeTrailer(frameChecksum, out + header + shared);
+    return header + shared + TRAILER_LENGTH;
+  }
+
+  /**
+   * @brief Start of the bytes a forwarded frame keeps unchanged
+   * They run from the end of the last rewritten header value up to
+   * trailerAt, and can be sent from one copy to any number of sessions.
+   */
+  uint32_t sharedAt() const {
+    return std::max({bodyLengthAt + bodyLengthSize, targetAt + targetSize,
+                     seqNumAt + seqNumSize});
+  }
+
+  /**
+   * @brief Writes the rewritten header of a forwarded frame, up to sharedAt()
+   *
+   * The frame then continues with its bytes from sharedAt() to trailerAt,
+   * unchanged, and ends with writeTrailer(frameChecksum).
+   * @param frameChecksum Output CheckSum of the whole forwarded frame
+   * @return Length of the header, 0 if it does not fit
+   */
+  size_t forwardHeader(std::string_view frame, std::string_view target,
+                       uint64_t seqNum, char *out, size_t capacity,
+                       unsigned &frameChecksum) const {
+    char seqDigits[20];
+    auto seqEnd = std::to_chars(seqDigits, seqDigits + sizeof(seqDigits), seqNum);
+    std::string_view seq(seqDigits, static_cast<size_t>(seqEnd.ptr - seqDigits));
+
+    size_t bodyStart = bodyLengthAt + bodyLengthSize + 1;
+    size_t bodyLength = trailerAt - bodyStart + target.size() - targetSize +
+                        seq.size() - seqNumSize;
+    char lengthDigits[20];
+    auto lengthEnd = std::to_chars(lengthDigits,
+                                   lengthDigits + sizeof(lengthDigits), bodyLength);
+    std::string_view length(lengthDigits,
+                            static_cast<size_t>(lengthEnd.ptr - lengthDigits));
+
+    struct Patch {
+      size_t at;
+      size_t size;
+      std::string_view value;
+    };
+    Patch patches[3] = {{bodyLengthAt, bodyLengthSize, length},
+                        {targetAt, targetSize, target},
+                        {seqNumAt, seqNumSize, seq}};
+    if (patches[2].at < patches[1].at) {
+      std::swap(patches[1], patches[2]);
+    }
+
+    size_t total = sharedAt();
+    for (const Patch &patch : patches) {
+      total = total - patch.size + patch.value.size();
+    }
+    if (total > capacity) {
+      return 0;
+    }
+
+    const FixScanner::Kernel &scan = FixScanner::kernel();
+    uint32_t sum = checksum;
+    size_t from = 0;
+    char *p = out;
+    for (const Patch &patch : patches) {
+      std::memcpy(p, frame.data() + from, patch.at - from);
+      p += patch.at - from;
+      std::memcpy(p, patch.value.data(), patch.value.size());
+      p += patch.value.size();
+      // Unsigned wrap-around keeps the sum right modulo 256
+      sum += scan.checksum(patch.value.data(), patch.value.size()) -
+             scan.checksum(frame.data() + patch.at, patch.size);
+      from = patch.at + patch.size;
+    }
+    frameChecksum = sum % 256;
+    return total;
+  }
+
+  /**
+   * @brief Writes the "10=NNN" trailer, TRAILER_LENGTH bytes
+   */
+  static void writeTrailer(unsigned frameChecksum, char *out) {
+    out[0] = '1';
+    out[1] = '0';
+    out[2] = '=';
+    out[3] = static_cast<char>('0' + frameChecksum / 100);
+    out[4] = static_cast<char>('0' + frameChecksum / 10 % 10);
+    out[5] = static_cast<char>('0' + frameChecksum % 10);
+    out[6] = Message::SOH;
+  }
+
+  static constexpr size_t TRAILER_LENGTH = 7; // "10=NNN" + SOH
+};
+
+/**
+ * @brief Header of a frame record in an inter-worker channel
+ * The addresses of further destinations on the same worker follow it, then
+ * the raw frame bytes, so a frame fanned out to many sessions of a worker
+ * crosses the channel once.
+ */
+struct RoutedFrame {
+  SessionAddress destination;
+  FrameLayout layout;
+  uint32_t copies = 0; // SessionAddress entries following the header
+  bool move = false;   // A SessionMove follows instead of a frame
+};
+static_assert(std::is_trivially_copyable_v<RoutedFrame>);
+static_assert(sizeof(RoutedFrame) % alignof(SessionAddress) == 0);
+
+/**
+ * @brief One step of moving a connection from one worker to another
+ *
+ * Steps travel through the same channels as the routed frames, so each is
+ * ordered with the frames its sender posted before and after it.
+ */
+struct SessionMove {
+  enum class Step : uint32_t {
+    Handover, // Source to target: take over the connection in state
+    Adopted,  // Target to source: the session was re-registered at epoch
+    Released, // Source to target: no more frames are forwarded
+  };
+  Step step = Step::Handover;
+  SessionAddress session; // Where the session lives from now on
+  uint64_t epoch = 0;     // Adopted: router epoch of the re-registration
+  void *state = nullptr;  // Handover: the connection, owned by the target
+};
+static_assert(std::is_trivially_copyable_v<SessionMove>);
+
+/**
+ * @brief Message routing state shared by all workers
+ *
+ * Holds the session registry (CompID to SessionAddress), the per-MsgType
+ * route rules and an SpscRing for every (producer, consumer) pair of
+ * workers, which carries frames whose destination lives on another worker.
+ *
+ * Registry and rules are immutable snapshots behind atomic pointers. Lookups
+ * are a single acquire load and never take a lock, so workers keep routing
+ * while a table is replaced. Updates copy the whole table, publish the copy
+ * and retire the old one, which is freed once every worker has passed a
+ * quiescent state (quiescent-state-based reclamation). Workers report
+ * quiescent states between event batches and go offline while they block.
+ */
+class Router {
+public:
+  static constexpr size_t DEFAULT_CHANNEL_BYTES = 1 << 20;
+
+  /**
+   * @param workers Number of workers sharing the router
+   * @param channelBytes Size of each inter-worker channel
+   */
+  explicit Router(size_t workers, size_t channelBytes = DEFAULT_CHANNEL_BYTES)
+      : readers_(workers), wakeups_(workers, nullptr),
+        sessions_(new SessionTable()), rules_(new RuleTable()) {
+    // Indexed [consumer * workers + producer]; a worker never posts to itself
+    for (size_t i = 0; i < workers * workers; ++i) {
+      bool self = i / workers == i % workers;
+      channels_.push_back(self ? nullptr
+                               : std::make_unique<SpscRing>(channelBytes));
+    }
+  }
+
+  Router(const Router &) = delete;
+  Router &operator=(const Router &) = delete;
+
+  ~Router() {
+    delete sessions_.load();
+    delete rules_.load();
+  }
+
+  size_t workers() const { return readers_.size(); }
+
+  /**
+   * @brief Sets the signal that wakes a worker for routed frames
+   */
+  void attachWorker(uint32_t worker, EventSignal &wakeup) {
+    wakeups_[worker] = &wakeup;
+  }
+
+  /**
+   * @brief Returns a process-wide unique session id
+   */
+  uint64_t nextSessionId() {
+    return nextSessionId_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Marks a point where the worker holds no table references
+   * Also brings an offline worker back online; call it before the first
+   * lookup of every event batch.
+   */
+  void quiescent(uint32_t worker) {
+    readers_[worker].seen.store(epoch_.load(std::memory_order_seq_cst),
+                                std::memory_order_seq_cst);
+  }
+
+  /**
+   * @brief Excludes a worker from grace periods while it blocks
+   */
+  void offline(uint32_t worker) {
+    readers_[worker].seen.store(OFFLINE, std::memory_order_release);
+  }
+
+  /**
+   * @brief Finds the session a message should be delivered to
+   * @return false if no session is registered for the destination
+   */
+  bool resolve(const Message &message, SessionAddress &address) const {
+    std::string_view destination = message.targetCompID;
+    const RuleTable *rules = rules_.load(std::memory_order_acquire);
+    if (const RouteRule *best = match(*rules, message)) {
+      destination = best->destination;
+    }
+    return lookup(destination, address);
+  }
+
+  /**
+   * @brief Finds every session a message goes to: the one resolve() picks,
+   * then the drop-copy sessions of its rule
+   *
+   * Sessions that are not registered are skipped, and none is listed twice.
+   * @param addresses Cleared, then filled
+   * @return Number of sessions found
+   */
+  size_t resolveAll(const Message &message,
+                    std::vector<SessionAddress> &addresses) const {
+    addresses.clear();
+    std::string_view destination = message.targetCompID;
+    const RuleTable *rules = rules_.load(std::memory_order_acquire);
+    const RouteRule *best = match(*rules, message);
+    if (best != nullptr) {
+      destination = best->destination;
+    }
+    SessionAddress address;
+    if (lookup(destination, address)) {
+      addresses.push_back(address);
+    }
+    if (best != nullptr) {
+      for (const std::string &copy : best->copies) {
+        if (lookup(copy, address) &&
+            std::none_of(addresses.begin(), addresses.end(),
+                         [&](const SessionAddress &listed) {
+                           return listed.sessionId == address.sessionId;
+                         })) {
+          addresses.push_back(address);
+        }
+      }
+    }
+    return addresses.size();
+  }
+
+  /**
+   * @brief Returns the session registered for a CompID
+   */
+  bool lookup(std::string_view compID, SessionAddress &address) const {
+    const SessionTable *sessions = sessions_.load(std::memory_order_acquire);
+    auto found = sessions->find(compID);
+    if (found == sessions->end()) {
+      return false;
+    }
+    address = found->second;
+    return true;
+  }
+
+  /**
+   * @brief Registers or replaces the session of a CompID
+   */
+  void registerSession(std::string_view compID, const SessionAddress &address) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    auto *table = new SessionTable(*sessions_.load(std::memory_order_relaxed));
+    auto [entry, inserted] = table->try_emplace(std::string(compID), address);
+    if (!inserted) {
+      LOG_WARN("Session {} logged on again, routing to the new connection",
+               compID);
+      entry->second = address;
+    }
+    publish(sessions_, table);
+  }
+
+  /**
+   * @brief Points a CompID at the new address of a session that moved to
+   * another worker, if it still belongs to that session
+   * @return Epoch of the update; see passed()
+   */
+  uint64_t relocateSession(std::string_view compID,
+                           const SessionAddress &address) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    const SessionTable *current = sessions_.load(std::memory_order_relaxed);
+    auto found = current->find(compID);
+    if (found != current->end() &&
+        found->second.sessionId == address.sessionId) {
+      auto *table = new SessionTable(*current);
+      table->find(compID)->second = address;
+      publish(sessions_, table);
+    }
+    return epoch_.load(std::memory_order_seq_cst);
+  }
+
+  /**
+   * @brief Whether every worker has passed a quiescent state, or gone
+   * offline, since the table update of epoch
+   * No worker resolves through a table older than epoch afterwards, and
+   * everything a worker posted through one is already in the channels.
+   */
+  bool passed(uint64_t epoch) const {
+    return std::all_of(readers_.begin(), readers_.end(),
+                       [&](const Reader &reader) {
+                         return reader.seen.load(std::memory_order_seq_cst) >=
+                                epoch;
+                       });
+  }
+
+  /**
+   * @brief Removes a CompID if it still belongs to the given session
+   */
+  void unregisterSession(std::string_view compID, uint64_t sessionId) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    const SessionTable *current = sessions_.load(std::memory_order_relaxed);
+    auto found = current->find(compID);
+    if (found == current->end() || found->second.sessionId != sessionId) {
+      return;
+    }
+    auto *table = new SessionTable(*current);
+    table->erase(table->find(compID));
+    publish(sessions_, table);
+  }
+
+  /**
+   * @brief Replaces all route rules at once
+   */
+  void setRules(const std::vector<RouteRule> &rules) {
+    auto *table = new RuleTable();
+    for (const RouteRule &rule : rules) {
+      (*table)[rule.msgType].push_back(rule);
+    }
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    publish(rules_, table);
+  }
+
+  /**
+   * @brief Adds a rule, replacing one for the same MsgType and sender
+   */
+  void addRule(const RouteRule &rule) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    auto *table = new RuleTable(*rules_.load(std::memory_order_relaxed));
+    std::vector<RouteRule> &list = (*table)[rule.msgType];
+    auto same = std::find_if(list.begin(), list.end(), [&](const RouteRule &r) {
+      return r.senderCompID == rule.senderCompID;
+    });
+    if (same != list.end()) {
+      *same = rule;
+    } else {
+      list.push_back(rule);
+    }
+    publish(rules_, table);
+  }
+
+  /**
+   * @brief Removes the rule for a MsgType and sender
+   * @return false if there was no such rule
+   */
+  bool removeRule(std::string_view msgType, std::string_view senderCompID) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    const RuleTable *current = rules_.load(std::memory_order_relaxed);
+    auto match = current->find(msgType);
+    if (match == current->end()) {
+      return false;
+    }
+    auto *table = new RuleTable(*current);
+    std::vector<RouteRule> &list = table->find(msgType)->second;
+    auto same = std::find_if(list.begin(), list.end(), [&](const RouteRule &r) {
+      return r.senderCompID == senderCompID;
+    });
+    if (same == list.end()) {
+      delete table;
+      return false;
+    }
+    list.erase(same);
+    if (list.empty()) {
+      table->erase(table->find(msgType));
+    }
+    publish(rules_, table);
+    return true;
+  }
+
+  /**
+   * @brief Copies a frame into the channel towards another worker
+   * Must be called from worker from. The destination worker is woken unless
+   * a wakeup is already pending.
+   * @return false if the channel is full
+   */
+  bool post(uint32_t from, const SessionAddress &destination,
+            const FrameLayout &layout, std::string_view frame) {
+    return post(from, std::span<const SessionAddress>(&destination, 1),
+                layout, frame);
+  }
+
+  /**
+   * @brief Copies a frame once into the channel towards another worker, for
+   * several destination sessions on that worker
+   * @param destinations At least one, all on the same worker
+   * @return false if the channel is full
+   */
+  bool post(uint32_t from, std::span<const SessionAddress> destinations,
+            const FrameLayout &layout, std::string_view frame) {
+    uint32_t worker = destinations.front().worker;
+    SpscRing &channel = *channels_[worker * workers() + from];
+    size_t copies = destinations.size() - 1;
+    size_t addresses = copies * sizeof(SessionAddress);
+    char *record =
+        channel.reserve(sizeof(RoutedFrame) + addresses + frame.size());
+    if (record == nullptr) {
+      return false;
+    }
+    RoutedFrame header{destinations.front(), layout,
+                       static_cast<uint32_t>(copies)};
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(header), destinations.data() + 1, addresses);
+    std::memcpy(record + sizeof(header) + addresses, frame.data(),
+                frame.size());
+    channel.commit();
+    if (EventSignal *wakeup = wakeups_[worker]) {
+      wakeup->notify();
+    }
+    return true;
+  }
+
+  /**
+   * @brief Posts a step of a connection move to worker to
+   * Must be called from worker from.
+   * @return false if the channel is full
+   */
+  bool postMove(uint32_t from, uint32_t to, const SessionMove &move) {
+    SpscRing &channel = *channels_[to * workers() + from];
+    char *record = channel.reserve(sizeof(RoutedFrame) + sizeof(move));
+    if (record == nullptr) {
+      return false;
+    }
+    RoutedFrame header;
+    header.move = true;
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(header), &move, sizeof(move));
+    channel.commit();
+    if (EventSignal *wakeup = wakeups_[to]) {
+      wakeup->notify();
+    }
+    return true;
+  }
+
+  /**
+   * @brief Hands every frame posted to a worker to f, in order per producer
+   * Must be called from worker. Each frame is released as soon as f returns.
+   * @param f Called as f(const RoutedFrame &, std::span<const SessionAddress>
+   * copies, std::string_view frame), where copies are the destinations
+   * after routed.destination
+   */
+  template <typename F> void drain(uint32_t worker, F &&f) {
+    for (uint32_t from = 0; from < workers(); ++from) {
+      drainFrom(worker, from, f, [](const SessionMove &) {});
+    }
+  }
+
+  /**
+   * @brief Hands everything worker from posted to worker to f or onMove,
+   * in order
+   * Must be called from worker.
+   * @param onMove Called as onMove(const SessionMove &)
+   * @return Number of frames passed to f
+   */
+  template <typename F, typename M>
+  size_t drainFrom(uint32_t worker, uint32_t from, F &&f, M &&onMove) {
+    SpscRing *channel = channels_[worker * workers() + from].get();
+    size_t frames = 0;
+    std::string_view record;
+    while (channel != nullptr && channel->front(record)) {
+      RoutedFrame header;
+      std::memcpy(&header, record.data(), sizeof(header));
+      if (header.move) {
+        SessionMove move;
+        std::memcpy(&move, record.data() + sizeof(header), sizeof(move));
+        onMove(static_cast<const SessionMove &>(move));
+        channel->pop();
+        continue;
+      }
+      // Records are 8-byte aligned and so is the header size
+      const auto *copies = reinterpret_cast<const SessionAddress *>(
+          record.data() + sizeof(header));
+      size_t addresses = header.copies * sizeof(SessionAddress);
+      f(static_cast<const RoutedFrame &>(header),
+        std::span<const SessionAddress>(copies, header.copies),
+        record.substr(sizeof(header) + addresses));
+      channel->pop();
+      ++frames;
+    }
+    return frames;
+  }
+
+  /**
+   * @brief Bytes posted to a worker and not drained yet, callable from any
+   * thread
+   * An approximation while the workers run.
+   */
+  size_t queuedBytes(uint32_t worker) const {
+    size_t bytes = 0;
+    for (uint32_t from = 0; from < workers(); ++from) {
+      if (const SpscRing *channel = channels_[worker * workers() + from].get()) {
+        bytes += channel->queuedBytes();
+      }
+    }
+    return bytes;
+  }
+
+  /**
+   * @brief Number of retired tables not yet freed
+   */
+  size_t retiredCount() {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    reclaim();
+    return retired_.size();
+  }
+
+private:
+  // Transparent hashing, so lookups take string_views without a copy
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view text) const {
+      return std::hash<std::string_view>()(text);
+    }
+  };
+  using SessionTable = std::unordered_map<std::string, SessionAddress,
+                                          StringHash, std::equal_to<>>;
+  using RuleTable = std::unordered_map<std::string, std::vector<RouteRule>,
+                                       StringHash, std::equal_to<>>;
+
+  static constexpr uint64_t OFFLINE = UINT64_MAX;
+
+  // The rule for a message's MsgType naming its sender, else the one for
+  // every sender
+  static const RouteRule *match(const RuleTable &rules,
+                                const Message &message) {
+    auto found = rules.find(message.msgType);
+    if (found == rules.end()) {
+      return nullptr;
+    }
+    const RouteRule *best = nullptr;
+    for (const RouteRule &rule : found->second) {
+      if (rule.senderCompID == message.senderCompID) {
+        return &rule;
+      }
+      if (rule.senderCompID.empty()) {
+        best = &rule;
+      }
+    }
+    return best;
+  }
+
+  struct alignas(64) Reader {
+    std::atomic<uint64_t> seen{OFFLINE}; // Epoch at the last quiescent state
+  };
+
+  struct Retired {
+    uint64_t epoch; // Freed once every online reader has seen this epoch
+    std::shared_ptr<const void> table;
+  };
+
+  std::vector<Reader> readers_;
+  std::vector<std::unique_ptr<SpscRing>> channels_;
+  std::vector<EventSignal *> wakeups_;
+  std::atomic<const SessionTable *> sessions_;
+  std::atomic<const RuleTable *> rules_;
+  std::atomic<uint64_t> epoch_{1};
+  std::atomic<uint64_t> nextSessionId_{1};
+  std::mutex writeMutex_; // Serializes table updates
+  std::vector<Retired> retired_;
+
+  /**
+   * @brief Swaps in a new table and retires the old one
+   * Called with writeMutex_ held.
+   */
+  template <typename Table>
+  void publish(std::atomic<const Table *> &slot, const Table *table) {
+    const Table *old = slot.exchange(table, std::memory_order_seq_cst);
+    uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    retired_.push_back(Retired{epoch, std::shared_ptr<const void>(old)});
+    reclaim();
+  }
+
+  /**
+   * @brief Frees retired tables no reader can still see
+   */
+  void reclaim() {
+    uint64_t oldest = OFFLINE;
+    for (const Reader &reader : readers_) {
+      oldest = std::min(oldest, reader.seen.load(std::memory_order_seq_cst));
+    }
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                  [&](const Retired &entry) {
+                                    return entry.epoch <= oldest;
+                                  }),
+                   retired_.end());
+  }
+};
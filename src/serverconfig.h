@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "loadbalancer.h"
+#include "topology.h"
+#include "worker.h"
+
+/**
+ * @brief How accepted connections reach the workers
+ */
+enum class AcceptMode {
+  Acceptor,  // One accepting thread hands fds to the least loaded worker
+  ReusePort, // Each worker accepts on its own SO_REUSEPORT listener
+  // ReusePort plus a CBPF program steering each flow to the listener of the
+  // worker pinned to the CPU that received it
+  ReusePortCpu,
+};
+
+/**
+ * @brief Everything TcpServer needs to know before it starts its workers
+ */
+struct ServerConfig {
+  uint16_t port = 8080;
+  AcceptMode acceptMode = AcceptMode::Acceptor;
+  IoEngineType engine = IoEngineType::Epoll;
+  size_t zeroCopyMinBytes = 0; // Smallest zero-copy send, 0 = off
+  int backlog = SOMAXCONN;     // listen() backlog of each listener
+
+  // Number of workers, 0 = one per CPU in workerCpus or else per online CPU
+  int workers = 0;
+  // CPU worker i is pinned to is workerCpus[i % size]; empty = unpinned,
+  // except in ReusePortCpu mode, where worker i runs on CPU i
+  std::vector<int> workerCpus;
+  // CPU of the thread calling TcpServer::run(), -1 = unpinned. Keeping it
+  // off the worker CPUs stops accept bursts from delaying message handling
+  int acceptorCpu = -1;
+  // Place each pinned worker's buffers and connection table on the NUMA
+  // node of its CPU
+  bool numaLocal = true;
+  // How every worker waits for events; spinning suits dedicated cores
+  PollPolicy poll;
+  // Output watermarks per connection and what a client that stops reading
+  // gets: reads paused, or a disconnect
+  FlowControl flowControl;
+  // Timer wheel resolution and idle timeout; heartbeats follow each Logon
+  SessionTimers timers;
+  // Per-session journal of outbound frames; off without a directory
+  JournalOptions journal;
+  // Ring file per worker of the raw bytes read, for replays; off without a
+  // directory
+  CaptureOptions capture;
+  // Placement of accepted connections by worker load, and moves of
+  // connections off workers busier than the rest
+  BalancePolicy balance;
+  // Time workers get on shutdown to flush their output before connections
+  // are closed with it unsent, 0 = close at once
+  std::chrono::milliseconds shutdownTimeout{5000};
+  // Admin port serving the workers' metrics at /metrics, 0 = off
+  uint16_t metricsPort = 0;
+
+  /**
+   * @brief Number of workers the server will start
+   */
+  int workerCount() const {
+    if (workers > 0) {
+      return workers;
+    }
+    return workerCpus.empty() ? CpuTopology::cpuCount()
+                              : static_cast<int>(workerCpus.size());
+  }
+
+  /**
+   * @brief CPU worker i is pinned to, -1 if it stays unpinned
+   */
+  int workerCpu(int worker) const {
+    if (!workerCpus.empty()) {
+      return workerCpus[static_cast<size_t>(worker) % workerCpus.size()];
+    }
+    return acceptMode == AcceptMode::ReusePortCpu ? worker : -1;
+  }
+};
@@ -0,0 +1,212 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#include <sys/uio.h>
+
+#include "circularbuffer.h"
+
+/**
+ * @brief Immutable copy of a frame shared by several output queues
+ *
+ * The bytes are stored right behind the header in one allocation. The
+ * reference count is not atomic: a frame is created, queued and released
+ * by one worker, and only ever reached through FrameRef handles.
+ */
+class SharedFrame {
+public:
+  SharedFrame(const SharedFrame &) = delete;
+  SharedFrame &operator=(const SharedFrame &) = delete;
+
+  std::string_view bytes() const {
+    return std::string_view(reinterpret_cast<const char *>(this + 1), size_);
+  }
+  uint32_t refs() const { return refs_; }
+
+private:
+  friend class FrameRef;
+
+  explicit SharedFrame(uint32_t size) : size_(size) {}
+
+  uint32_t refs_ = 1;
+  uint32_t size_;
+};
+
+/**
+ * @brief Counted reference to a SharedFrame
+ * The frame is freed when its last reference goes.
+ */
+class FrameRef {
+public:
+  FrameRef() = default;
+  FrameRef(const FrameRef &other) : frame_(other.frame_) {
+    if (frame_ != nullptr) {
+      ++frame_->refs_;
+    }
+  }
+  FrameRef(FrameRef &&other) noexcept
+      : frame_(std::exchange(other.frame_, nullptr)) {}
+  FrameRef &operator=(FrameRef other) noexcept {
+    std::swap(frame_, other.frame_);
+    return *this;
+  }
+  ~FrameRef() { reset(); }
+
+  /**
+   * @brief Copies bytes into a new shared frame, the only copy it makes
+   */
+  static FrameRef copy(std::string_view bytes) {
+    void *memory = ::operator new(sizeof(SharedFrame) + bytes.size());
+    auto *frame = new (memory) SharedFrame(static_cast<uint32_t>(bytes.size()));
+    std::memcpy(static_cast<char *>(memory) + sizeof(SharedFrame),
+                bytes.data(), bytes.size());
+    FrameRef ref;
+    ref.frame_ = frame;
+    return ref;
+  }
+
+  void reset() {
+    if (frame_ != nullptr && --frame_->refs_ == 0) {
+      frame_->~SharedFrame();
+      ::operator delete(frame_);
+    }
+    frame_ = nullptr;
+  }
+
+  const SharedFrame *get() const { return frame_; }
+  const SharedFrame *operator->() const { return frame_; }
+  explicit operator bool() const { return frame_ != nullptr; }
+
+private:
+  SharedFrame *frame_ = nullptr;
+};
+
+/**
+ * @brief Shared frame bytes spliced into a connection's output stream
+ *
+ * A connection's output is its write buffer with, at given positions,
+ * ranges of shared frames in between. Fanning a frame out to many sessions
+ * then costs each of them its own rewritten header and trailer in the write
+ * buffer, and a reference to the unchanged middle, which every session
+ * sends straight from the one shared copy.
+ *
+ * Positions are kept as the write buffer bytes between a splice and the
+ * previous one, so they survive the write buffer being moved to larger
+ * storage. The write buffer is never empty while a splice is pending as
+ * long as every splice is followed by buffered bytes, such as a trailer.
+ */
+class SpliceQueue {
+public:
+  bool empty() const { return splices_.empty(); }
+  size_t size() const { return splices_.size(); }
+
+  /** @brief Unsent bytes of the spliced frames */
+  size_t bytes() const { return bytes_; }
+
+  /**
+   * @brief Appends a range of frame to the output, after everything now in
+   * buffer
+   */
+  void splice(const CircularBuffer &buffer, FrameRef frame, uint32_t offset,
+              uint32_t size) {
+    if (size == 0) {
+      return;
+    }
+    size_t gap = buffer.dataSize() - gaps_;
+    splices_.push_back(Splice{gap, std::move(frame), offset, size});
+    gaps_ += gap;
+    bytes_ += size;
+  }
+
+  /**
+   * @brief Describes the output in send order, buffered and spliced bytes
+   * @param iov Receives up to max segments
+   * @return Number of segments filled; fewer than the output if max is hit
+   */
+  int gather(const CircularBuffer &buffer, iovec *iov, int max) const {
+    iovec buffered[2];
+    int segments = buffer.getReadSegments(buffered);
+    int segment = 0;
+    size_t within = 0; // Bytes of buffered[segment] already described
+    int count = 0;
+    auto take = [&](size_t bytes) {
+      while (bytes > 0 && segment < segments && count < max) {
+        size_t chunk = std::min(bytes, buffered[segment].iov_len - within);
+        iov[count].iov_base = static_cast<char *>(buffered[segment].iov_base) +
+                              within;
+        iov[count].iov_len = chunk;
+        ++count;
+        bytes -= chunk;
+        within += chunk;
+        if (within == buffered[segment].iov_len) {
+          ++segment;
+          within = 0;
+        }
+      }
+      return bytes == 0;
+    };
+    for (const Splice &splice : splices_) {
+      if (!take(splice.gap) || count == max) {
+        return count;
+      }
+      iov[count].iov_base = const_cast<char *>(
+          splice.frame->bytes().data() + splice.offset);
+      iov[count].iov_len = splice.size;
+      ++count;
+    }
+    take(buffer.dataSize() - gaps_);
+    return count;
+  }
+
+  /**
+   * @brief Retires sent bytes in send order, releasing finished frames
+   */
+  void consume(CircularBuffer &buffer, size_t bytes) {
+    while (bytes > 0 && !splices_.empty()) {
+      Splice &front = splices_.front();
+      size_t buffered = std::min(bytes, front.gap);
+      buffer.consume(buffered);
+      front.gap -= buffered;
+      gaps_ -= buffered;
+      bytes -= buffered;
+      if (front.gap > 0) {
+        return;
+      }
+      size_t spliced = std::min<size_t>(bytes, front.size);
+      front.offset += static_cast<uint32_t>(spliced);
+      front.size -= static_cast<uint32_t>(spliced);
+      bytes_ -= spliced;
+      bytes -= spliced;
+      if (front.size > 0) {
+        return;
+      }
+      splices_.pop_front();
+    }
+    buffer.consume(bytes);
+  }
+
+  /** @brief Drops every splice, for a closed connection */
+  void clear() {
+    splices_.clear();
+    gaps_ = 0;
+    bytes_ = 0;
+  }
+
+private:
+  struct Splice {
+    size_t gap; // Write buffer bytes between the previous splice and this one
+    FrameRef frame;
+    uint32_t offset; // Unsent range of the frame
+    uint32_t size;
+  };
+
+  std::deque<Splice> splices_;
+  size_t gaps_ = 0;  // Write buffer bytes before the last splice
+  size_t bytes_ = 0; // Unsent spliced bytes
+};
@@ -1,9 +1,13 @@
 #include "tcpclient.h"
-#include <errno.h>  // For errno
-#include <string.h> // For strerror
+#include <errno.h>    // For errno
+#include <string.h>   // For strerror
+#include <sys/uio.h>  // For iovec
 
-// Constructor: Initializes the epoll instance.
-TCPClient::TCPClient() { initEpoll(); }
+// Constructor: Initializes the epoll instance and the outbound ring.
+TCPClient::TCPClient(size_t send_buffer_bytes)
+    : send_ring_(send_buffer_bytes) {
+  initEpoll();
+}
 
 // Destructor: Closes the connection and the epoll file descriptor.
 TCPClient::~TCPClient() {
@@ -14,13 +18,20 @@ TCPClient::~TCPClient() {
   }
 }
 
-// Initializes the epoll instance.
+// Initializes the epoll instance and registers the send wakeup.
 void TCPClient::initEpoll() {
   epoll_fd_ = epoll_create1(0); // Create an epoll instance
   if (epoll_fd_ == -1) {
     throw std::runtime_error(
         "Failed to create epoll fd"); // Throw an error if epoll creation fails
   }
+  struct epoll_event event;
+  event.events = EPOLLIN | EPOLLET;
+  event.data.fd = send_signal_.fd();
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, send_signal_.fd(), &event) == -1) {
+    close(epoll_fd_);
+    throw std::runtime_error("Failed to register send wakeup");
+  }
 }
 
 // Sets the given file descriptor to non-blocking mode.
@@ -42,6 +53,8 @@ void TCPClient::connect(const std::string &host, uint16_t port,
   }
 
   setNonBlocking(sock_fd_); // Set the socket to non-blocking mode
+  send_offset_ = 0; // A message cut short by the last connection goes again
+  frame_buffer_.reset(); // So is a frame the last connection left unfinished
 
   struct sockaddr_in addr;     // Create an address structure
   addr.sin_family = AF_INET;   // Set the address family to IPv4
@@ -52,9 +65,9 @@ void TCPClient::connect(const std::string &host, uint16_t port,
     return;
   }
 
-  current_event_.events =
-      EPOLLIN | EPOLLOUT |
-      EPOLLET; // Set the event types to monitor (read, write, edge-triggered)
+  // Read, write and edge-triggered: EPOLLOUT stays registered and only
+  // fires when the socket becomes writable again after EAGAIN
+  current_event_.events = EPOLLIN | EPOLLOUT | EPOLLET;
   current_event_.data.fd = sock_fd_; // Set the file descriptor for the event
   if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock_fd_, &current_event_) == -1) {
     close(sock_fd_);         // Close the socket
@@ -76,6 +89,12 @@ void TCPClient::connect(const std::string &host, uint16_t port,
 
 // Closes the TCP connection.
 void TCPClient::disconnect() {
+  stopThreads();
+  closeSocket();
+}
+
+// Closes the socket; also used by the I/O thread when the peer goes away.
+void TCPClient::closeSocket() {
   if (sock_fd_ >= 0) {
     // Remove socket from epoll monitoring and clean up resources
     epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, sock_fd_, nullptr);
@@ -87,10 +106,17 @@ void TCPClient::disconnect() {
 
 // Process pending socket events using epoll
 void TCPClient::poll() {
+  // Once connected the I/O thread owns every event
+  if (io_thread_.joinable()) {
+    return;
+  }
   // Only handle connection events
   int nfds = epoll_wait(epoll_fd_, events_.data(), events_.size(), 0);
 
   for (int i = 0; i < nfds; ++i) {
+    if (events_[i].data.fd != sock_fd_) {
+      continue; // Send wakeup; queued messages go out once connected
+    }
     if (events_[i].events & EPOLLERR || events_[i].events & EPOLLHUP) {
       disconnect();
       if (connect_handler_) {
@@ -100,14 +126,18 @@ void TCPClient::poll() {
       connected_ = true;
       if (connect_handler_) {
         connect_handler_(true);
-        startThreads(); // Start threads after successful connection
       }
+      startThreads(); // Start the I/O thread after successful connection
     }
   }
 }
 
 // Reads data from the socket.
 void TCPClient::doRead() {
+  if (frame_handler_ || batch_handler_) {
+    doReadFrames();
+    return;
+  }
   while (true) {
     ssize_t bytes = read(sock_fd_, read_buffer_.data(),
                          max_buffer_size); // Read data from the socket
@@ -119,58 +149,163 @@ void TCPClient::doRead() {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
         break; // No more data to read
       }
-      disconnect(); // Disconnect on error
+      closeSocket(); // Disconnect on error
       break;
     } else if (bytes == 0) {
-      disconnect(); // Disconnect if the connection was closed by the peer
+      closeSocket(); // Disconnect if the connection was closed by the peer
       break;
     }
   }
 }
 
-// Asynchronously sends a message to the connected server.
-// The message is added to a queue and sent when the socket is available for
-// writing.
-void TCPClient::asyncSend(const std::string &message) {
-  std::lock_guard<std::mutex> lock(
-      write_mutex_);                 // Protect the write queue with a mutex
-  write_queue_.push_back(message);   // Add the message to the write queue
-  current_event_.events |= EPOLLOUT; // Add EPOLLOUT to the event mask
-  epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, sock_fd_,
-            &current_event_); // Modify the epoll event for the socket
-}
-
-// Writes data to the socket.
-void TCPClient::doWrite() {
-  std::lock_guard<std::mutex> lock(
-      write_mutex_);              // Protect the write queue with a mutex
-  while (!write_queue_.empty()) { // While there are messages in the queue
-    const std::string &message =
-        write_queue_.front(); // Get the first message from the queue
-    ssize_t bytes = write(sock_fd_, message.data(),
-                          message.size()); // Write the message to the socket
+// Reads like doRead(), but frames the stream in place. The views handed to
+// the handlers point into frame_buffer_, which is not written again before
+// they return, so frames are consumed as soon as they are parsed.
+void TCPClient::doReadFrames() {
+  while (sock_fd_ >= 0) {
+    ssize_t bytes = frame_buffer_.writeFromSocketV(sock_fd_);
     if (bytes > 0) {
-      write_queue_.pop_front(); // Remove the message from the queue
+      if (!deliverFrames()) {
+        closeSocket(); // The stream cannot be resynchronised
+        break;
+      }
+    } else if (bytes == -1 && frame_buffer_.full()) {
+      closeSocket(); // A frame larger than the buffer can never complete
+      break;
     } else if (bytes == -1) {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        break; // No more data can be written
+        break; // No more data to read
+      }
+      if (errno != EINTR) {
+        closeSocket(); // Disconnect on error
+        break;
       }
-      disconnect(); // Disconnect on error
+    } else {
+      closeSocket(); // Disconnect if the connection was closed by the peer
       break;
     }
   }
+}
+
+bool TCPClient::deliverFrames() {
+  size_t count = 0;
+  while (true) {
+    if (count == frames_.size()) {
+      frames_.emplace_back();
+    }
+    Message &message = frames_[count];
+    ParseResult result = Message::parseFixMessage(frame_buffer_, message);
+    if (result == ParseResult::CONTINUE) {
+      message.reset();
+      break;
+    }
+    size_t length = message.frameLength;
+    if (result == ParseResult::ERROR) {
+      message.reset();
+      if (length == 0) {
+        return false;
+      }
+      frame_buffer_.consume(length); // Skip the invalid frame
+      continue;
+    }
+    frame_buffer_.consume(length);
+    if (frame_handler_) {
+      frame_handler_(message);
+      message.reset();
+    } else {
+      ++count;
+    }
+  }
+
+  if (count > 0) {
+    batch_handler_(std::span<const Message>(frames_.data(), count));
+    for (size_t i = 0; i < count; ++i) {
+      frames_[i].reset();
+    }
+  }
+  return true;
+}
+
+// Asynchronously sends a message to the connected server.
+// The message is copied into the outbound ring and the I/O thread is woken
+// to send it; only the first push after a drain writes to the eventfd.
+bool TCPClient::asyncSend(std::string_view message) {
+  if (!send_ring_.push(message)) {
+    return false;
+  }
+  send_signal_.notify();
+  return true;
+}
+
+// Writes queued messages to the socket, many per writev.
+// A partial write keeps the unsent rest of its message for the next call.
+void TCPClient::doWrite() {
+  std::array<std::string_view, max_write_batch> messages;
+  std::array<struct iovec, max_write_batch> iov;
+  while (sock_fd_ >= 0 && connected_) {
+    size_t count = send_ring_.peek(messages.data(), messages.size());
+    if (count == 0) {
+      return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      iov[i].iov_base = const_cast<char *>(messages[i].data());
+      iov[i].iov_len = messages[i].size();
+    }
+    iov[0].iov_base = static_cast<char *>(iov[0].iov_base) + send_offset_;
+    iov[0].iov_len -= send_offset_;
+
+    struct msghdr msg {};
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = count;
+    ssize_t bytes = sendmsg(sock_fd_, &msg, MSG_NOSIGNAL);
+    if (bytes == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        closeSocket(); // Disconnect on error
+      }
+      return; // EPOLLOUT resumes once the socket drains
+    }
+
+    // Release the fully written messages
+    size_t written = send_offset_ + static_cast<size_t>(bytes);
+    size_t done = 0;
+    while (done < count && written >= messages[done].size()) {
+      written -= messages[done].size();
+      ++done;
+    }
+    send_ring_.pop(done);
+    send_offset_ = written;
+  }
+}
 
-  // If the write queue is empty, remove EPOLLOUT from the event mask
-  if (write_queue_.empty()) {
-    current_event_.events &= ~EPOLLOUT; // Remove EPOLLOUT from the event mask
-    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, sock_fd_,
-              &current_event_); // Modify the epoll event for the socket
+// Sets the per-frame handler; frames are parsed from then on.
+void TCPClient::setFrameHandler(FrameHandler handler) {
+  ensureFrameBuffer();
+  batch_handler_ = nullptr;
+  frame_handler_ = std::move(handler);
+}
+
+// Sets the per-read batch handler; frames are parsed from then on.
+void TCPClient::setBatchHandler(BatchHandler handler) {
+  ensureFrameBuffer();
+  frame_handler_ = nullptr;
+  batch_handler_ = std::move(handler);
+}
+
+void TCPClient::ensureFrameBuffer() {
+  // Mirrored, so a frame straddling the wrap point parses in one pass
+  if (frame_buffer_.capacity() == 0) {
+    frame_buffer_ = CircularBuffer(FRAME_BUFFER_SIZE, BufferMode::Mirrored);
   }
 }
 
 // Sets the message handler function.
 void TCPClient::setMessageHandler(MessageHandler handler) {
   message_handler_ = handler; // Store the message handler
+  frame_handler_ = nullptr;   // Raw chunks again instead of frames
+  batch_handler_ = nullptr;
 }
 
 // Returns true if the client is currently connected to the server, false
@@ -178,60 +313,49 @@ void TCPClient::setMessageHandler(MessageHandler handler) {
 bool TCPClient::isConnected() const { return connected_; }
 
 void TCPClient::startThreads() {
-  std::lock_guard<std::mutex> lock(stop_mutex_);
+  if (io_thread_.joinable()) {
+    return;
+  }
   should_stop_ = false;
-  receive_thread_ = std::thread(&TCPClient::receiveLoop, this);
-  send_thread_ = std::thread(&TCPClient::sendLoop, this);
+  io_thread_ = std::thread(&TCPClient::ioLoop, this);
 }
 
 void TCPClient::stopThreads() {
-  {
-    std::lock_guard<std::mutex> lock(stop_mutex_);
-    should_stop_ = true;
-  }
-
-  if (receive_thread_.joinable()) {
-    receive_thread_.join();
-  }
-  if (send_thread_.joinable()) {
-    send_thread_.join();
+  if (!io_thread_.joinable() ||
+      io_thread_.get_id() == std::this_thread::get_id()) {
+    return;
   }
+  should_stop_ = true;
+  send_signal_.notify(); // Ends a blocking epoll_wait
+  io_thread_.join();
 }
 
-void TCPClient::receiveLoop() {
-  while (true) {
-    {
-      std::lock_guard<std::mutex> lock(stop_mutex_);
-      if (should_stop_)
-        break;
-    }
-
-    // Check for read events
-    struct epoll_event events[1];
-    int nfds = epoll_wait(epoll_fd_, events, 1, 100); // 100ms timeout
-
-    if (nfds > 0 && (events[0].events & EPOLLIN)) {
-      doRead();
-    }
-  }
-}
+void TCPClient::ioLoop() {
+  // Messages queued before the connection was up; their wakeup is taken
+  // here so the next push rings again
+  send_signal_.clear();
+  doWrite();
 
-void TCPClient::sendLoop() {
-  while (true) {
-    {
-      std::lock_guard<std::mutex> lock(stop_mutex_);
-      if (should_stop_)
-        break;
+  std::array<struct epoll_event, 2> events;
+  while (!should_stop_) {
+    int nfds = epoll_wait(epoll_fd_, events.data(), events.size(), -1);
+    if (nfds == -1 && errno != EINTR) {
+      break;
     }
 
-    // Check for write events if there's data to send
-    {
-      std::lock_guard<std::mutex> lock(write_mutex_);
-      if (!write_queue_.empty()) {
+    for (int i = 0; i < nfds; ++i) {
+      if (events[i].data.fd == send_signal_.fd()) {
+        // Cleared first, so a push during the drain rings again
+        send_signal_.clear();
+        doWrite();
+        continue;
+      }
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        doRead();
+      }
+      if (events[i].events & EPOLLOUT) {
         doWrite();
       }
     }
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
   }
 }
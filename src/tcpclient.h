@@ -9,28 +9,65 @@
 #include <unistd.h>     // For close() function
 
 // Standard library includes
-#include <array>      // For fixed-size array
-#include <deque>      // For double-ended queue
-#include <functional> // For std::function
-#include <memory>     // For smart pointers
-#include <mutex>      // For thread safety
-#include <string>     // For string manipulation
-#include <thread>     // For thread support
+#include <array>       // For fixed-size array
+#include <atomic>      // For state shared with the I/O thread
+#include <functional>  // For std::function
+#include <memory>      // For smart pointers
+#include <span>        // For frames handed to the batch handler
+#include <string>      // For string manipulation
+#include <string_view> // For messages passed to asyncSend
+#include <thread>      // For thread support
+#include <vector>      // For the reused batch of frames
+
+#include "channel.h"
+#include "circularbuffer.h"
+#include "message.h"
 
 /**
  * @brief TCP client implementation with non-blocking I/O and event-driven
  * architecture
+ *
+ * Once connected, one I/O thread owns the socket. asyncSend() may be called
+ * from any thread: it copies the message into a lock-free MPSC ring and
+ * rings an eventfd, and the I/O thread sends everything queued with as few
+ * writev calls as the socket allows.
+ *
+ * Received bytes go to a MessageHandler as they arrive, or, once a
+ * FrameHandler or BatchHandler is set, are framed with the same
+ * Message::parseFixMessage path the server uses, without any allocation.
  */
 class TCPClient {
 public:
   /** Type alias for message handler callback function */
   using MessageHandler = std::function<void(const std::string &)>;
 
+  /**
+   * Type alias for the per-frame callback; the Message and every view into
+   * it are only valid until the callback returns
+   */
+  using FrameHandler = std::function<void(const Message &)>;
+
+  /**
+   * Type alias for the callback taking every complete frame of one read;
+   * the Messages are only valid until the callback returns
+   */
+  using BatchHandler = std::function<void(std::span<const Message>)>;
+
   /** Type alias for connection status callback function */
   using ConnectHandler = std::function<void(bool)>;
 
-  /** @brief Constructs a new TCP client instance */
-  TCPClient();
+  /** Default size of the outbound ring */
+  static constexpr size_t DEFAULT_SEND_BUFFER = 1024 * 1024;
+
+  /** Size of the receive buffer used once frames are delivered */
+  static constexpr size_t FRAME_BUFFER_SIZE = 4 * Message::MAX_BODY_LENGTH;
+
+  /**
+   * @brief Constructs a new TCP client instance
+   * @param send_buffer_bytes Size of the outbound ring; no single message
+   * may exceed half of it
+   */
+  explicit TCPClient(size_t send_buffer_bytes = DEFAULT_SEND_BUFFER);
 
   /**
    * @brief Destroys the TCP client instance and releases resources
@@ -55,9 +92,13 @@ public:
 
   /**
    * @brief Queues a message for asynchronous transmission
-   * @param message Data to be sent
+   *
+   * Callable from any thread without locking. Messages queued before the
+   * connection is established are sent once it is.
+   * @param message Data to be sent, copied before the call returns
+   * @return false if the outbound ring is full or the message too large
    */
-  void asyncSend(const std::string &message);
+  bool asyncSend(std::string_view message);
 
   /**
    * @brief Sets callback for handling incoming messages
@@ -65,16 +106,34 @@ public:
    */
   void setMessageHandler(MessageHandler handler);
 
+  /**
+   * @brief Delivers each complete FIX frame as a parsed Message
+   *
+   * Replaces the MessageHandler and any BatchHandler. Set it before
+   * connecting.
+   * @param handler Called once per frame on the I/O thread
+   */
+  void setFrameHandler(FrameHandler handler);
+
+  /**
+   * @brief Delivers all complete FIX frames of one read in a single call
+   *
+   * Replaces the MessageHandler and any FrameHandler. Set it before
+   * connecting.
+   * @param handler Called once per read that completed at least one frame
+   */
+  void setBatchHandler(BatchHandler handler);
+
   /** @brief Returns current connection status */
   bool isConnected() const;
 
   /** @brief Processes pending socket events */
   void poll();
 
-  /** @brief Starts the message processing threads */
+  /** @brief Starts the I/O thread */
   void startThreads();
 
-  /** @brief Stops the message processing threads */
+  /** @brief Stops the I/O thread */
   void stopThreads();
 
 private:
@@ -87,35 +146,53 @@ private:
    */
   void setNonBlocking(int fd);
 
-  /** @brief Processes events from epoll */
-  void handleEvents();
+  /** @brief Closes the socket, keeping the I/O thread alive */
+  void closeSocket();
 
   /** @brief Handles incoming data from socket */
   void doRead();
 
-  /** @brief Processes outgoing data queue */
+  /** @brief Reads into the receive buffer and delivers complete frames */
+  void doReadFrames();
+
+  /**
+   * @brief Parses every complete frame in the receive buffer
+   * @return false if the stream cannot be framed any more
+   */
+  bool deliverFrames();
+
+  /** @brief Allocates the receive buffer on first use */
+  void ensureFrameBuffer();
+
+  /** @brief Sends queued messages until the ring is empty or EAGAIN */
   void doWrite();
 
-  /** @brief Thread function for receiving messages */
-  void receiveLoop();
+  /** @brief Thread function handling socket and send wakeup events */
+  void ioLoop();
 
-  /** @brief Thread function for sending messages */
-  void sendLoop();
+  /** Messages gathered into one writev */
+  static constexpr size_t max_write_batch = 64;
 
   // File descriptors and state flags
-  int epoll_fd_{-1};      ///< Epoll instance descriptor
-  int sock_fd_{-1};       ///< Socket descriptor
-  bool connected_{false}; ///< Connection state
-  bool writing_{false};   ///< Write operation state
+  int epoll_fd_{-1};                   ///< Epoll instance descriptor
+  int sock_fd_{-1};                    ///< Socket descriptor
+  std::atomic<bool> connected_{false}; ///< Connection state
 
-  // Message queue management
-  std::deque<std::string> write_queue_; ///< Pending messages
-  std::mutex write_mutex_;              ///< Queue synchronization
+  // Outbound queue, written by any thread and drained by the I/O thread
+  MpscByteRing send_ring_;  ///< Pending messages
+  EventSignal send_signal_; ///< Wakes the I/O thread after a push
+  size_t send_offset_{0};   ///< Bytes of the oldest message already sent
 
   // Buffer management
   static constexpr size_t max_buffer_size = 8192;
   std::array<char, max_buffer_size> read_buffer_; ///< Receive buffer
 
+  // Frame delivery, used once a frame or batch handler is set
+  CircularBuffer frame_buffer_;   ///< Received bytes, parsed in place
+  std::vector<Message> frames_;   ///< Reused parse targets, one per frame
+  FrameHandler frame_handler_;    ///< Per-frame callback
+  BatchHandler batch_handler_;    ///< Per-read callback
+
   // Event handling
   MessageHandler message_handler_;           ///< Message processing callback
   ConnectHandler connect_handler_;           ///< Connection status callback
@@ -123,8 +200,6 @@ private:
   std::array<struct epoll_event, 1> events_; ///< Event buffer
 
   // Thread management
-  std::thread receive_thread_; ///< Thread for receiving messages
-  std::thread send_thread_;    ///< Thread for sending messages
-  bool should_stop_{false};    ///< Thread control flag
-  std::mutex stop_mutex_;      ///< Mutex for thread control
+  std::thread io_thread_;                ///< Thread owning the socket
+  std::atomic<bool> should_stop_{false}; ///< Thread control flag
 };
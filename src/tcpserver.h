@@ -1,14 +1,18 @@
 #pragma once
 
 // Standard library includes
+#include <algorithm>
 #include <atomic>
-#include <iostream>
+#include <chrono>
+#include <latch>
 #include <map>
+#include <memory>
 #include <thread>
 #include <vector>
 
 // System includes
 #include <fcntl.h>
+#include <linux/filter.h>
 #include <netinet/in.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
@@ -16,43 +20,63 @@
 #include <unistd.h>
 
 // Local includes
+#include "loadbalancer.h"
+#include "logger.h"
+#include "metricsserver.h"
+#include "serverconfig.h"
+#include "topology.h"
 #include "worker.h"
 
 /**
  * @class TcpServer
  * @brief A multi-threaded TCP server using epoll for event handling
  *
- * This server uses a thread pool of workers to handle incoming connections
- * and implements a round-robin distribution of connections across workers.
+ * This server uses a thread pool of workers to handle incoming connections.
+ * In AcceptMode::Acceptor the server thread accepts and hands each
+ * connection to the least loaded worker; in the ReusePort modes the kernel
+ * balances them across per-worker listeners. In every mode the server
+ * thread samples the workers' load and moves connections off a worker that
+ * is far busier than the rest. Messages between logged-on sessions are
+ * routed by the shared Router.
  */
 class TcpServer {
 private:
-  int listenFd;
+  int listenFd = -1;
+  std::vector<int> workerListenFds; // SO_REUSEPORT listeners, one per worker
   int epollFd;
-  std::atomic<bool> shutdownFlag;
-  std::vector<WorkerThread> workers;
+  std::atomic<bool> shutdownFlag; // Stops the workers at once
+  std::atomic<bool> stopRequested{false}; // Ends run(), see stop()
+  std::unique_ptr<Router> router; // Sessions and routes, outlives workers
+  std::vector<std::unique_ptr<WorkerThread>> workers; // Stable addresses
   std::vector<std::jthread> workerThreads;
-  std::vector<int> workerPipesWrite;
-  std::atomic<int> roundRobinIndex;
+  ServerConfig config;
+  std::unique_ptr<LoadBalancer> balancer; // Used by the run() thread only
+  std::chrono::steady_clock::time_point lastBalance{}; // Last load sample
+  std::vector<std::vector<int>> handOffs; // Accepted fds, per worker
+  std::unique_ptr<MetricsServer> metricsServer; // Admin port, if configured
 
   /**
-   * @brief Initializes the listening socket
+   * @brief Opens a non-blocking listening socket
    * @param __hostshort Port number to listen on
+   * @param reusePort Join the port's SO_REUSEPORT group
+   * @param backlog Length of the accept queue
+   * @return The listening socket
    * @throws Exits program on socket creation/binding failure
    */
-  void initListenSocket(uint16_t __hostshort) {
-    // Create TCP/IP socket
-    listenFd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listenFd == -1) {
-      std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
+  static int openListenSocket(uint16_t __hostshort, bool reusePort,
+                              int backlog) {
+    // Create TCP/IP socket, non-blocking for async operation
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1) {
+      LOG_ERROR("Failed to create socket: {}", strerror(errno));
       exit(1);
     }
 
-    // Set socket to non-blocking mode for async operation
-    if (fcntl(listenFd, F_SETFL, O_NONBLOCK) == -1) {
-      std::cerr << "Failed to set non-blocking mode: " << strerror(errno)
-                << std::endl;
-      close(listenFd);
+    int one = 1;
+    if (reusePort &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof one) == -1) {
+      LOG_ERROR("Failed to set SO_REUSEPORT: {}", strerror(errno));
+      close(fd);
       exit(1);
     }
 
@@ -61,90 +85,322 @@ private:
     addr.sin_port = htons(__hostshort);
     addr.sin_addr.s_addr = INADDR_ANY;
 
-    if (bind(listenFd, (struct sockaddr *)&addr, sizeof addr) == -1) {
-      std::cerr << "Failed to bind socket: " << strerror(errno) << std::endl;
-      close(listenFd);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) == -1) {
+      LOG_ERROR("Failed to bind socket: {}", strerror(errno));
+      close(fd);
       exit(1);
     }
 
-    if (listen(listenFd, SOMAXCONN) == -1) {
-      std::cerr << "Failed to listen on socket: " << strerror(errno)
-                << std::endl;
-      close(listenFd);
+    if (listen(fd, backlog) == -1) {
+      LOG_ERROR("Failed to listen on socket: {}", strerror(errno));
+      close(fd);
       exit(1);
     }
+    return fd;
+  }
+
+  /**
+   * @brief Steers each new flow to the listener of the receiving CPU
+   *
+   * The classic BPF program maps the current CPU number to the index of the
+   * worker pinned to it, which the kernel uses as the index into the
+   * SO_REUSEPORT group (listeners are indexed in the order they were
+   * opened). CPUs without a worker yield an index past the group size and
+   * fall back to the default hash.
+   * @param fd Any listener of the group
+   * @param cpus CPU of each worker, in listener order
+   * @return false if the kernel rejected the program
+   */
+  static bool attachCpuSteering(int fd, const std::vector<int> &cpus) {
+    std::vector<sock_filter> code;
+    code.push_back({BPF_LD | BPF_W | BPF_ABS, 0, 0,
+                    static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)});
+    bool identity = true;
+    for (size_t i = 0; i < cpus.size(); ++i) {
+      identity = identity && cpus[i] == static_cast<int>(i);
+    }
+    if (identity) {
+      code.push_back({BPF_RET | BPF_A, 0, 0, 0});
+    } else {
+      // if (cpu == cpus[i]) return i; for every worker
+      for (size_t i = 0; i < cpus.size(); ++i) {
+        code.push_back({BPF_JMP | BPF_JEQ | BPF_K, 0, 1,
+                        static_cast<uint32_t>(cpus[i])});
+        code.push_back({BPF_RET | BPF_K, 0, 0, static_cast<uint32_t>(i)});
+      }
+      code.push_back({BPF_RET | BPF_K, 0, 0,
+                      static_cast<uint32_t>(cpus.size())});
+    }
+    sock_fprog program;
+    program.len = static_cast<unsigned short>(code.size());
+    program.filter = code.data();
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                      sizeof program) == 0;
+  }
+
+  static ServerConfig makeConfig(uint16_t port, AcceptMode mode,
+                                 IoEngineType engine, size_t zeroCopyMinBytes) {
+    ServerConfig config;
+    config.port = port;
+    config.acceptMode = mode;
+    config.engine = engine;
+    config.zeroCopyMinBytes = zeroCopyMinBytes;
+    return config;
   }
 
   void initEpoll() {
     epollFd = epoll_create1(0);
     if (epollFd == -1) {
-      std::cerr << "epoll_create1 failed" << std::endl;
+      LOG_ERROR("epoll_create1 failed: {}", strerror(errno));
       exit(1);
     }
 
+    if (listenFd == -1) {
+      return; // Workers accept on their own listeners
+    }
+
     epoll_event event;
     event.data.fd = listenFd;
     event.events = EPOLLIN | EPOLLET;
     if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == -1) {
-      std::cerr << "epoll_ctl failed for listenFd" << std::endl;
+      LOG_ERROR("epoll_ctl failed for listenFd: {}", strerror(errno));
       close(epollFd);
       exit(1);
     }
   }
 
+  /**
+   * @brief Pins the calling worker thread and binds its memory to the node
+   * of its CPU, before the worker allocates anything
+   */
+  void placeWorkerThread(int index) {
+    int cpu = config.workerCpu(index);
+    if (cpu < 0 || !CpuTopology::pinThread(cpu) || !config.numaLocal) {
+      return;
+    }
+    int node = CpuTopology::nodeOfCpu(cpu);
+    if (node >= 0) {
+      CpuTopology::preferNode(node);
+    }
+  }
+
+  /**
+   * @brief Passes the fds accepted for a worker in one batch
+   * Those its full control queue does not take are closed.
+   */
+  void handOff(size_t workerIndex) {
+    std::vector<int> &batch = handOffs[workerIndex];
+    if (batch.empty()) {
+      return;
+    }
+    size_t queued = workers[workerIndex]->handOff(batch);
+    if (queued < batch.size()) {
+      LOG_ERROR("Control queue of worker {} full, dropping {} connections",
+                workerIndex, batch.size() - queued);
+      for (size_t i = queued; i < batch.size(); ++i) {
+        close(batch[i]);
+      }
+    }
+    batch.clear();
+  }
+
 public:
-  TcpServer(uint16_t __hostshort) : shutdownFlag(false), roundRobinIndex(0) {
-    initListenSocket(__hostshort);
+  /**
+   * @brief Opens the listeners and starts the workers
+   *
+   * Each worker is constructed on its own thread after it has been pinned,
+   * so its control queue, connection table and buffer pool are first
+   * touched, and with numaLocal allocated, on the node it runs on.
+   */
+  explicit TcpServer(const ServerConfig &serverConfig)
+      : shutdownFlag(false), config(serverConfig) {
+    bool reusePort = config.acceptMode != AcceptMode::Acceptor;
+    if (!reusePort) {
+      listenFd = openListenSocket(config.port, false, config.backlog);
+    }
     initEpoll();
 
-    int numWorkers = std::thread::hardware_concurrency();
-    if (numWorkers == 0)
-      numWorkers = 1;
+    int numWorkers = config.workerCount();
+    for (int i = 0; config.acceptorCpu >= 0 && i < numWorkers; ++i) {
+      if (config.workerCpu(i) == config.acceptorCpu) {
+        LOG_WARN("Acceptor CPU {} is shared with worker {}", config.acceptorCpu,
+                 i);
+      }
+    }
 
-    // workers.resize(numWorkers);
+    // Open every listener before any worker accepts, so that listener i of
+    // the group is the one opened for worker i
+    for (int i = 0; reusePort && i < numWorkers; ++i) {
+      workerListenFds.push_back(
+          openListenSocket(config.port, true, config.backlog));
+    }
+    router = std::make_unique<Router>(numWorkers);
+    if (config.acceptMode == AcceptMode::ReusePortCpu) {
+      std::vector<int> cpus;
+      for (int i = 0; i < numWorkers; ++i) {
+        cpus.push_back(config.workerCpu(i));
+      }
+      if (!attachCpuSteering(workerListenFds.front(), cpus)) {
+        LOG_WARN("Failed to attach CPU steering program: {}",
+                 strerror(errno));
+      }
+    }
+
+    workers.resize(numWorkers);
+    std::latch ready(numWorkers);
     for (int i = 0; i < numWorkers; ++i) {
-      workers.emplace_back(shutdownFlag);
-      workerPipesWrite.push_back(workers.back().getPipeWriteFd());
-      workerThreads.emplace_back([this, i]() { workers[i].run(); });
+      workerThreads.emplace_back([this, i, reusePort, &ready]() {
+        placeWorkerThread(i);
+        auto worker = std::make_unique<WorkerThread>(
+            shutdownFlag, config.engine, config.zeroCopyMinBytes);
+        worker->attachRouter(*router, static_cast<uint32_t>(i));
+        worker->setPollPolicy(config.poll);
+        worker->setFlowControl(config.flowControl);
+        worker->setSessionTimers(config.timers);
+        worker->setJournal(config.journal);
+        worker->setCapture(config.capture, static_cast<uint32_t>(i));
+        if (reusePort) {
+          worker->addListener(workerListenFds[i]);
+        }
+        workers[i] = std::move(worker);
+        WorkerThread *self = workers[i].get();
+        ready.count_down();
+        self->run();
+      });
+    }
+    // handOff() may be called as soon as the constructor returns
+    ready.wait();
+    balancer = std::make_unique<LoadBalancer>(workers.size(), config.balance);
+    handOffs.resize(workers.size());
+
+    if (config.metricsPort != 0) {
+      metricsServer =
+          std::make_unique<MetricsServer>(config.metricsPort, workerMetrics());
+    }
+  }
+
+  TcpServer(uint16_t __hostshort, AcceptMode mode = AcceptMode::Acceptor,
+            IoEngineType engine = IoEngineType::Epoll,
+            size_t zeroCopyMinBytes = 0)
+      : TcpServer(makeConfig(__hostshort, mode, engine, zeroCopyMinBytes)) {}
+
+  /**
+   * @brief Routing state of all workers, for adding route rules at runtime
+   */
+  Router &getRouter() { return *router; }
+
+  /**
+   * @brief Metrics of every worker, in worker order, readable at any time
+   */
+  std::vector<const WorkerMetrics *> workerMetrics() const {
+    std::vector<const WorkerMetrics *> metrics;
+    for (const auto &worker : workers) {
+      metrics.push_back(&worker->getMetrics());
+    }
+    return metrics;
+  }
+
+  /**
+   * @brief Samples the workers' load once per interval and starts a move
+   * when one of them is busier than the policy allows
+   */
+  void balance() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastBalance < config.balance.interval) {
+      return;
+    }
+    lastBalance = now;
+    balancer->sample(workerMetrics(), *router, now);
+    if (auto move = balancer->rebalance(now)) {
+      LOG_INFO("Moving a connection from worker {} to worker {}", move->from,
+               move->to);
+      workers[move->from]->migrate(static_cast<uint32_t>(move->to));
     }
   }
 
   void run() {
-    while (!shutdownFlag) {
+    if (config.acceptorCpu >= 0) {
+      CpuTopology::pinThread(config.acceptorCpu);
+    }
+    int timeout = static_cast<int>(std::clamp<int64_t>(
+        config.balance.interval.count(), 1, 1000));
+    while (!shutdownFlag && !stopRequested) {
       epoll_event events[1];
-      int numEvents = epoll_wait(epollFd, events, 1, 1000);
+      int numEvents = epoll_wait(epollFd, events, 1, timeout);
+      if (numEvents == -1 && errno == EINTR) {
+        continue;
+      }
       if (numEvents == -1) {
-        std::cerr << "epoll_wait failed" << std::endl;
+        LOG_ERROR("epoll_wait failed: {}", strerror(errno));
         break;
       }
+      balance();
       if (numEvents == 0)
         continue;
 
       if (events[0].data.fd == listenFd && events[0].events & EPOLLIN) {
-        int newFd = accept(listenFd, nullptr, nullptr);
-        if (newFd == -1) {
-          std::cerr << "accept failed" << std::endl;
-          continue;
-        }
+        // Edge-triggered: drain the whole backlog before waiting again
+        while (true) {
+          int newFd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK);
+          if (newFd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+              continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+              LOG_WARN("accept failed: {}", strerror(errno));
+            }
+            break;
+          }
 
-        fcntl(newFd, F_SETFL, O_NONBLOCK);
-        int workerIndex = roundRobinIndex++ % workers.size();
-        ssize_t bytesWritten =
-            write(workerPipesWrite[workerIndex], &newFd, sizeof(newFd));
-        if (bytesWritten != sizeof(newFd)) {
-          std::cerr << "write to pipe failed" << std::endl;
-          close(newFd);
+          size_t workerIndex = balancer->place();
+          std::vector<int> &batch = handOffs[workerIndex];
+          batch.push_back(newFd);
+          if (batch.size() == ControlMessage::MAX_FDS) {
+            handOff(workerIndex);
+          }
+        }
+        for (size_t i = 0; i < handOffs.size(); ++i) {
+          handOff(i);
         }
       }
     }
   }
 
+  /**
+   * @brief Makes run() return, callable from any thread and from signal
+   * handlers
+   * The workers are stopped when the server is destroyed.
+   */
+  void stop() { stopRequested.store(true, std::memory_order_relaxed); }
+
+  /**
+   * @brief Stops the workers and closes the listeners
+   * Each worker first flushes and closes its connections, for up to
+   * shutdownTimeout; without a timeout, or if one cannot be told, all of
+   * them stop at once.
+   */
   ~TcpServer() {
-    shutdownFlag = true;
+    metricsServer.reset(); // Reads the workers until it stops
+    auto deadline = std::chrono::steady_clock::now() + config.shutdownTimeout;
+    bool graceful = config.shutdownTimeout.count() > 0;
+    for (auto &worker : workers) {
+      graceful = graceful && worker->stop(deadline);
+    }
+    if (!graceful) {
+      shutdownFlag = true;
+      for (auto &worker : workers) {
+        worker->wake();
+      }
+    }
     for (auto &thread : workerThreads) {
       thread.join();
     }
     close(epollFd);
-    close(listenFd);
+    if (listenFd != -1) {
+      close(listenFd);
+    }
+    for (int fd : workerListenFds) {
+      close(fd);
+    }
   }
 };
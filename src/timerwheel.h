@@ -0,0 +1,222 @@
+#pragma once
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/**
+ * @brief Timer embedded in the object it belongs to
+ *
+ * A node is linked into at most one wheel slot. Scheduling, cancelling and
+ * firing only rewrite the node's own pointers and the slot head, so a
+ * timer costs no allocation and no lookup.
+ */
+struct TimerNode {
+  TimerNode *next = nullptr;
+  TimerNode **prev = nullptr; // Slot head or previous node's next
+  uint64_t expiry = 0;        // Tick the timer fires at
+  void *owner = nullptr;      // Object the timer belongs to
+
+  bool scheduled() const { return prev != nullptr; }
+};
+
+/**
+ * @brief Hierarchical timing wheel counting time in ticks
+ *
+ * Four levels of 256 slots cover 2^32 ticks, 497 days at 10 ms. Level 0
+ * holds the timers due within 256 ticks, one slot per tick; each level
+ * above spans 256 times the range of the one below. Whenever level 0
+ * wraps, the matching slot of level 1 is cascaded down, and so on up.
+ * Scheduling and cancelling are O(1), and advancing by one tick costs one
+ * slot plus, every 256 ticks, one cascade.
+ *
+ * Timers due at the same tick fire in no particular order. A wheel is
+ * owned by a single thread and is not thread-safe.
+ */
+class TimerWheel {
+public:
+  static constexpr unsigned LEVEL_BITS = 8;
+  static constexpr unsigned LEVELS = 4;
+  static constexpr uint64_t SLOTS = uint64_t(1) << LEVEL_BITS;
+  static constexpr uint64_t MAX_DELAY =
+      (uint64_t(1) << (LEVEL_BITS * LEVELS)) - 1;
+
+  /**
+   * @param now Tick the wheel starts at
+   */
+  explicit TimerWheel(uint64_t now = 0) : now_(now) {}
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  /**
+   * @brief Next tick to be processed
+   * Timers scheduled for it or earlier fire on the next advance().
+   */
+  uint64_t now() const { return now_; }
+
+  /** @brief Number of scheduled timers */
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  /**
+   * @brief Schedules node to fire at tick expiry, moving it if scheduled
+   * Ticks already past fire on the next advance(); delays beyond MAX_DELAY
+   * are cut to it.
+   */
+  void schedule(TimerNode &node, uint64_t expiry) {
+    cancel(node);
+    node.expiry = expiry;
+    link(node);
+    ++size_;
+  }
+
+  /** @brief Unschedules node, if it is scheduled */
+  void cancel(TimerNode &node) {
+    if (!node.scheduled()) {
+      return;
+    }
+    *node.prev = node.next;
+    if (node.next != nullptr) {
+      node.next->prev = node.prev;
+    }
+    node.next = nullptr;
+    node.prev = nullptr;
+    --size_;
+  }
+
+  /**
+   * @brief Processes every tick up to and including until
+   *
+   * Calls fire(TimerNode &) for each timer due, after unscheduling it. fire
+   * may schedule and cancel any timer, including the one it is given; one
+   * scheduled for a tick already processed fires at the next tick.
+   * @return Number of timers fired
+   */
+  template <typename F> size_t advance(uint64_t until, F &&fire) {
+    size_t fired = 0;
+    while (now_ <= until) {
+      uint64_t index = now_ & (SLOTS - 1);
+      for (unsigned level = 1; index == 0 && level < LEVELS; ++level) {
+        index = (now_ >> (level * LEVEL_BITS)) & (SLOTS - 1);
+        cascade(slots_[level][index]);
+      }
+      TimerNode *due = slots_[0][now_ & (SLOTS - 1)];
+      slots_[0][now_ & (SLOTS - 1)] = nullptr;
+      if (due != nullptr) {
+        due->prev = &due;
+      }
+      ++now_;
+      // Detached first, so timers fire() schedules land in other slots
+      while (due != nullptr) {
+        TimerNode &node = *due;
+        cancel(node);
+        fire(node);
+        ++fired;
+      }
+    }
+    return fired;
+  }
+
+private:
+  // Links node into the slot of its expiry relative to now_
+  void link(TimerNode &node) {
+    uint64_t delay = node.expiry > now_ ? node.expiry - now_ : 0;
+    if (delay > MAX_DELAY) {
+      delay = MAX_DELAY;
+      node.expiry = now_ + delay;
+    }
+    uint64_t expiry = node.expiry > now_ ? node.expiry : now_;
+    unsigned level = 0;
+    while (level + 1 < LEVELS &&
+           delay >= (uint64_t(1) << ((level + 1) * LEVEL_BITS))) {
+      ++level;
+    }
+    TimerNode *&head =
+        slots_[level][(expiry >> (level * LEVEL_BITS)) & (SLOTS - 1)];
+    node.next = head;
+    node.prev = &head;
+    if (head != nullptr) {
+      head->prev = &node.next;
+    }
+    head = &node;
+  }
+
+  // Moves every timer of a higher level slot down to where it belongs now
+  void cascade(TimerNode *&head) {
+    TimerNode *node = head;
+    head = nullptr;
+    while (node != nullptr) {
+      TimerNode *next = node->next;
+      link(*node);
+      node = next;
+    }
+  }
+
+  std::array<std::array<TimerNode *, SLOTS>, LEVELS> slots_{};
+  uint64_t now_;
+  size_t size_ = 0;
+};
+
+/**
+ * @brief Periodic timerfd that drives a TimerWheel from an event loop
+ *
+ * The fd becomes readable once per interval while started; read() reports
+ * how many intervals passed, so a loop that was busy catches up in one go.
+ */
+class TickTimer {
+public:
+  TickTimer()
+      : fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+    if (fd_ == -1) {
+      throw std::runtime_error(std::string("timerfd_create failed: ") +
+                               strerror(errno));
+    }
+  }
+
+  TickTimer(const TickTimer &) = delete;
+  TickTimer &operator=(const TickTimer &) = delete;
+
+  ~TickTimer() { close(fd_); }
+
+  int fd() const { return fd_; }
+  bool running() const { return running_; }
+
+  /**
+   * @brief Starts firing every interval, or stops for a zero interval
+   */
+  void start(std::chrono::nanoseconds interval) {
+    itimerspec spec{};
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(interval);
+    spec.it_interval.tv_sec = static_cast<time_t>(seconds.count());
+    spec.it_interval.tv_nsec =
+        static_cast<long>((interval - seconds).count());
+    spec.it_value = spec.it_interval;
+    timerfd_settime(fd_, 0, &spec, nullptr);
+    running_ = interval.count() > 0;
+  }
+
+  void stop() { start(std::chrono::nanoseconds(0)); }
+
+  /**
+   * @brief Intervals passed since the last call, 0 if none
+   */
+  uint64_t read() {
+    uint64_t expirations = 0;
+    if (::read(fd_, &expirations, sizeof(expirations)) !=
+        static_cast<ssize_t>(sizeof(expirations))) {
+      return 0;
+    }
+    return expirations;
+  }
+
+private:
+  int fd_;
+  bool running_ = false;
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+/**
+ * @brief CPU affinity and NUMA memory placement for server threads
+ *
+ * Uses sysfs and the raw set_mempolicy system call, so no libnuma is
+ * needed. On machines with a single node every NUMA call is a no-op.
+ */
+class CpuTopology {
+public:
+  /**
+   * @brief Number of CPUs the process may run on
+   */
+  static int cpuCount() {
+    int count = static_cast<int>(std::thread::hardware_concurrency());
+    return count > 0 ? count : 1;
+  }
+
+  /**
+   * @brief Pins the calling thread to one CPU
+   * @return false if the CPU is not available to the process
+   */
+  static bool pinThread(int cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof cpus, &cpus);
+    if (rc != 0) {
+      LOG_WARN("Failed to pin thread to CPU {}: {}", cpu, strerror(rc));
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief NUMA node a CPU belongs to
+   * @return Node number, -1 if unknown (no NUMA support in the kernel)
+   */
+  static int nodeOfCpu(int cpu) {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr) {
+      return -1;
+    }
+    int node = -1;
+    while (dirent *entry = readdir(dir)) {
+      std::string_view name = entry->d_name;
+      if (name.size() > 4 && name.substr(0, 4) == "node") {
+        node = std::stoi(std::string(name.substr(4)));
+        break;
+      }
+    }
+    closedir(dir);
+    return node;
+  }
+
+  /**
+   * @brief Makes later allocations of the calling thread prefer one node
+   *
+   * Affects every page the thread faults in from now on, including its
+   * mmap'ed and memfd-backed buffers; memory comes from other nodes only
+   * when the preferred one is exhausted.
+   * @return false if the kernel rejected the policy
+   */
+  static bool preferNode(int node) {
+    if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8)) {
+      return false;
+    }
+    unsigned long mask = 1ul << node;
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask,
+                sizeof(mask) * 8) == -1) {
+      LOG_WARN("Failed to prefer NUMA node {}: {}", node, strerror(errno));
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Parses a CPU list such as "0-3,8,10-11"
+   * @return false on malformed input
+   */
+  static bool parseCpuList(std::string_view text, std::vector<int> &cpus) {
+    cpus.clear();
+    while (!text.empty()) {
+      size_t comma = text.find(',');
+      std::string_view item = text.substr(0, comma);
+      text = comma == std::string_view::npos ? std::string_view()
+                                             : text.substr(comma + 1);
+      size_t dash = item.find('-');
+      int first, last;
+      if (!parseInt(item.substr(0, dash), first)) {
+        return false;
+      }
+      last = first;
+      if (dash != std::string_view::npos &&
+          !parseInt(item.substr(dash + 1), last)) {
+        return false;
+      }
+      if (last < first) {
+        return false;
+      }
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    }
+    return !cpus.empty();
+  }
+
+private:
+  static bool parseInt(std::string_view text, int &value) {
+    if (text.empty()) {
+      return false;
+    }
+    value = 0;
+    for (char c : text) {
+      if (c < '0' || c > '9' || value > 100000) {
+        return false;
+      }
+      value = value * 10 + (c - '0');
+    }
+    return true;
+  }
+};
@@ -1,302 +1,2878 @@
 #pragma once
 
 // Standard library includes
+#include <algorithm>
 #include <atomic>
-#include <iostream>
-#include <map>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <span>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 // System includes
 #include <fcntl.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "bufferpool.h"
+#include "capture.h"
+#include "channel.h"
 #include "connection.h"
+#include "connectiontable.h"
+#include "iouring.h"
+#include "journal.h"
+#include "logger.h"
+#include "metrics.h"
+#include "router.h"
+#include "timerwheel.h"
 
 constexpr int MAX_EVENTS = 1024;
-constexpr size_t BUFSIZE = 1024 * 1024;
+constexpr size_t BUFSIZE = 1024 * 1024; // Largest per-connection buffer class
+constexpr int IDLE_SWEEP_MS = 1000;     // Interval between idle buffer sweeps
+constexpr std::chrono::seconds IDLE_TRIM_AFTER(10); // Idle time before trim
+constexpr size_t RESPONSE_SLACK = 64; // Write space beyond the request frame
+constexpr size_t ROUTE_SLACK = 24;    // Room for a longer MsgSeqNum/BodyLength
+constexpr size_t CONTROL_QUEUE_SIZE = 4096; // Pending commands per worker
+constexpr size_t RESEND_SLACK = 64; // PossDupFlag and OrigSendingTime
+constexpr size_t ADMIN_SLACK = 64;  // Header and trailer of a Heartbeat
+constexpr size_t PARSE_BATCH = 16;  // Frames parsed before they are handled
+constexpr size_t MAX_HELD_RECVS = 64; // Provided buffers a paused io_uring
+                                      // connection may keep
+constexpr int OUTPUT_SEGMENTS = 16; // iovecs gathered per send of spliced output
+constexpr size_t MAX_PARKED = 4096; // Frames held for sessions moving in
+constexpr std::chrono::seconds MIGRATE_TIMEOUT(1); // Wait for a connection
+                                                   // to go quiescent
+
+/**
+ * @brief Event loop implementation used by a WorkerThread
+ */
+enum class IoEngineType {
+  Epoll,         // epoll_wait plus read/write system calls per connection
+  IoUring,       // io_uring with multishot accept/recv and provided buffers
+  IoUringSqPoll, // IoUring with a kernel submission polling thread
+};
+
+/**
+ * @brief How a worker waits for events
+ *
+ * With a spin time the worker keeps polling without blocking for that long
+ * after its last event, so back-to-back messages never pay for a scheduler
+ * wakeup, and blocks again once traffic pauses. Spinning keeps the core
+ * busy, so it is meant for workers on dedicated cores.
+ */
+struct PollPolicy {
+  std::chrono::microseconds spin{0}; // Non-blocking polling after an event
+  int socketBusyPollUs = 0; // SO_BUSY_POLL on client sockets, 0 = off
+};
+
+/**
+ * @brief What a worker does about connections that read their output slower
+ * than they produce it
+ *
+ * Write buffers grow from the pool as output piles up. Once the unsent
+ * output of a connection reaches the high watermark, the worker either
+ * stops reading from it until the output is down to the low watermark,
+ * leaving further requests to TCP flow control, or disconnects it. Frames
+ * that still do not fit are dropped whole and counted, never truncated.
+ */
+struct FlowControl {
+  enum class Overflow : uint8_t {
+    Pause,      // Stop reading until the output drains
+    Disconnect, // Close the connection as a slow consumer
+  };
+  size_t highWatermark = 512 * 1024; // Unsent bytes that trigger the policy
+  size_t lowWatermark = 128 * 1024;  // Unsent bytes that resume reading
+  Overflow overflow = Overflow::Pause;
+};
+
+/**
+ * @brief Session timers of a worker
+ *
+ * Time is kept by a TimerWheel advancing once per resolution, so every
+ * timeout is accurate to one tick. A session sends a Heartbeat (35=0) after
+ * HeartBtInt (108, from its Logon) seconds without output, a TestRequest
+ * (35=1) after HeartBtInt plus 20% without input, and is closed if that
+ * goes unanswered for as long again.
+ */
+struct SessionTimers {
+  std::chrono::milliseconds resolution{100}; // One timer wheel tick
+  // Connections that send nothing for this long are closed, 0 = never
+  std::chrono::milliseconds idleTimeout{0};
+};
+
+/**
+ * @brief Command sent to a worker through its control queue
+ * Sized so that a command and its sequence fill one cache line of the queue.
+ */
+struct ControlMessage {
+  static constexpr size_t MAX_FDS = 8; // Sockets per AddConnections command
+
+  enum class Type : uint8_t {
+    AddConnections, // Take over the client sockets in fds
+    Migrate,        // Move connection fd, or a busy one for -1, to worker
+    Drain,          // Flush and close every connection, refuse new ones
+    Shutdown,       // Drain, then return from run()
+  };
+  Type type = Type::AddConnections;
+  uint8_t count = 0;   // AddConnections: sockets in fds
+  uint32_t worker = 0; // Migrate: destination worker
+  int fd = -1;         // Migrate: connection to move
+  // Drain, Shutdown: connections still unflushed then are closed anyway
+  std::chrono::steady_clock::time_point deadline{};
+  int fds[MAX_FDS] = {};
+};
+static_assert(sizeof(ControlMessage) + sizeof(size_t) <= CACHE_LINE);
 
 class WorkerThread {
 private:
   int epollFd;                           // Epoll file descriptor
-  int pipeReadFd;                        // Read end of control pipe
-  int pipeWriteFd;                       // Write end of control pipe
-  std::map<int, Connection> connections; // Active connections
+  EventSignal wakeup;                    // Rung for control and routed frames
+  MpscQueue<ControlMessage> control{CONTROL_QUEUE_SIZE}; // From any thread
+  int listenFd = -1;                     // Own SO_REUSEPORT listener, if any
+  ConnectionTable connections;           // Active connections by fd
   std::atomic<bool> &shutdownFlag;       // Shutdown signal
+  BufferPool pool;                       // Connection buffer cache
+  std::chrono::steady_clock::time_point lastSweep; // Last idle sweep
+  IoEngineType engine;                   // Requested event loop
+  std::unique_ptr<IoUring> ring;         // Set while the io_uring loop runs
+  uint32_t unarmed = 0;                  // UringOp bits left to rearm()
+  __kernel_timespec sweepInterval{IDLE_SWEEP_MS / 1000, 0}; // Timer SQE
+  size_t zeroCopyThreshold;              // Smallest zero-copy send, 0 = off
+  Router *router = nullptr;              // Shared routing state, if attached
+  uint32_t workerIndex = 0;              // This worker's index in the router
+  std::vector<Connection *> pendingFlush; // Destinations of routed frames
+  std::vector<SessionAddress> routeTargets; // Sessions of the frame routed
+  PollPolicy pollPolicy;                 // Spin before blocking, if set
+  FlowControl flowControl;               // Slow consumer handling
+  SessionTimers sessionTimers;           // Heartbeat and idle timeouts
+  uint64_t idleTicks = 0;                // idleTimeout in ticks, 0 = off
+  TimerWheel timers;                     // Session timers of all connections
+  TickTimer tickTimer;                   // Advances timers while any is set
+  std::chrono::steady_clock::time_point lastEvent; // End of the spin window
+  JournalOptions journalOptions;         // Journaling off without directory
+  std::vector<int> unsyncedJournals;     // Connections with frames to sync
+  std::vector<int> resending;            // Connections with resends left
+  std::unique_ptr<CaptureLog> capture;   // Raw input of every read, if set
+  std::unordered_map<int, int> replayFds; // Captured fd to replayed one
+  // Connection moves between workers, see migrate()
+  struct Migration {
+    int fd;
+    std::chrono::steady_clock::time_point deadline; // Given up after it
+  };
+  struct Forwarding {
+    SessionAddress session; // New address of a session that moved away
+    uint64_t epoch = 0;     // Of its re-registration, 0 until adopted
+    bool passed = false;    // Grace period over before the current drain
+  };
+  struct ParkedFrame {
+    SessionAddress destination;
+    FrameLayout layout;
+    FrameRef frame;
+  };
+  std::vector<Migration> migrating;      // Waiting to go quiescent
+  std::vector<Forwarding> forwarding;    // Frames still forwarded to them
+  std::vector<ParkedFrame> parked;       // For sessions still moving in
+  std::vector<std::pair<uint32_t, SessionMove>> unsentMoves; // Channel full
+  int32_t drainingFrom = -1;             // Worker whose frames are drained
+  // Graceful drain and shutdown, see drain() and stop()
+  bool draining = false;                 // Closing connections once flushed
+  bool stopping = false;                 // run() returns once drained
+  std::chrono::steady_clock::time_point drainDeadline{};
+  __kernel_timespec drainTimeout{};      // Wakes io_uring at the deadline
+  WorkerMetrics metrics;                 // Written by this worker only
+  uint64_t messageTick = 0; // Parse (or drain) of the frame being handled
+  std::vector<Message> batch;            // Frames of one read view
+
+  // io_uring user_data: operation in the low bits, Connection pointer (which
+  // is 64-byte aligned) in the rest, zero for the worker's own operations
+  enum UringOp : uint64_t {
+    OP_RECV = 1,
+    OP_SEND = 2,
+    OP_ACCEPT = 3,
+    OP_CONTROL = 4,
+    OP_TIMER = 5,
+    OP_CANCEL = 6,
+    OP_TICK = 7,
+    OP_DRAIN = 8,
+  };
+  static constexpr uint64_t OP_MASK = 63;
+
+  // Prevent copying
+  WorkerThread(const WorkerThread &) = delete;
+  WorkerThread &operator=(const WorkerThread &) = delete;
+
+  /**
+   * Registers a new client socket with this worker
+   * Buffers are taken from the pool on first read.
+   * @param fd Non-blocking client socket, owned by the worker from now on
+   */
+  void addConnection(int fd) {
+    if (draining) {
+      LOG_DEBUG("Draining, refusing connection (fd={})", fd);
+      close(fd);
+      return;
+    }
+    Connection *conn = openConnection(fd);
+    if (conn == nullptr) {
+      return;
+    }
+    if (pollPolicy.socketBusyPollUs > 0) {
+      enableBusyPoll(fd);
+    }
+    if (ring) {
+      armRecv(*conn);
+      return;
+    }
+    epoll_event event;
+    event.data.ptr = conn;
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+      LOG_ERROR("epoll_ctl failed for new connection: {}", strerror(errno));
+      closeConnection(*conn);
+    }
+  }
+
+  /**
+   * Sets up the connection state of a new fd, before it is polled
+   * @return nullptr if fd is in use, which is then closed
+   */
+  Connection *openConnection(int fd) {
+    Connection *conn = connections.open(fd);
+    if (conn == nullptr) {
+      LOG_ERROR("fd {} is already registered", fd);
+      close(fd);
+      return nullptr;
+    }
+    metrics.connectionsOpened.add();
+    conn->lastInTick = timers.now();
+    scheduleSessionTimer(*conn);
+    return conn;
+  }
+
+  /**
+   * Opens the connection replaying a captured one on a /dev/null fd
+   * Mappings left by connections the worker closed itself are dropped, as
+   * their fd may now be reused.
+   */
+  Connection *openReplayed(int capturedFd) {
+    int fd = ::open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+      LOG_WARN("Cannot open /dev/null for replay: {}", strerror(errno));
+      return nullptr;
+    }
+    std::erase_if(replayFds, [&](const auto &entry) {
+      return entry.second == fd || connections.get(entry.second) == nullptr;
+    });
+    Connection *conn = openConnection(fd);
+    if (conn != nullptr) {
+      conn->replayed = true;
+      replayFds[capturedFd] = fd;
+    }
+    return conn;
+  }
+
+  /**
+   * Makes blocking receives on fd poll the device queue first
+   * Raising SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN, so
+   * failure is only logged; the connection works without it.
+   */
+  void enableBusyPoll(int fd) {
+    int usecs = pollPolicy.socketBusyPollUs;
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) ==
+        -1) {
+      LOG_WARN("SO_BUSY_POLL failed on fd {}: {}", fd, strerror(errno));
+      return;
+    }
+#ifdef SO_PREFER_BUSY_POLL
+    int prefer = 1;
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+#endif
+  }
+
+  /**
+   * Queues a command and wakes the worker for it
+   * @return false if the control queue is full
+   */
+  bool command(const ControlMessage &message) {
+    if (!control.tryPush(message)) {
+      return false;
+    }
+    wakeup.notify();
+    return true;
+  }
+
+  /**
+   * Handles everything other threads queued for this worker
+   * The signal is cleared first, so anything queued meanwhile rings again.
+   */
+  void drainInbox() {
+    wakeup.clear();
+    ControlMessage message;
+    while (control.tryPop(message)) {
+      switch (message.type) {
+      case ControlMessage::Type::AddConnections:
+        for (uint8_t i = 0; i < message.count; ++i) {
+          addConnection(message.fds[i]);
+        }
+        break;
+      case ControlMessage::Type::Migrate:
+        startMigration(message.fd, message.worker);
+        break;
+      case ControlMessage::Type::Drain:
+      case ControlMessage::Type::Shutdown:
+        startDrain(message.deadline,
+                   message.type == ControlMessage::Type::Shutdown);
+        break;
+      }
+    }
+    if (router != nullptr) {
+      drainRouted();
+    }
+  }
+
+  /**
+   * Delivers the frames and connection moves other workers posted
+   * Sessions that moved away are released once their grace period had
+   * passed before the drain: by then every frame posted to their old
+   * address has been drained and forwarded.
+   */
+  void drainRouted() {
+    for (Forwarding &entry : forwarding) {
+      entry.passed = entry.epoch != 0 && router->passed(entry.epoch);
+    }
+    messageTick = MetricsClock::now();
+    auto onFrame = [this](const RoutedFrame &routed,
+                          std::span<const SessionAddress> copies,
+                          std::string_view frame) {
+      if (copies.empty()) {
+        deliver(routed.destination, routed.layout, frame);
+        return;
+      }
+      // The channel record is released on return, so this is the one
+      // copy all of them share
+      FrameRef shared = FrameRef::copy(frame);
+      deliverShared(routed.destination, routed.layout, shared);
+      for (const SessionAddress &copy : copies) {
+        deliverShared(copy, routed.layout, shared);
+      }
+    };
+    uint64_t drained = 0;
+    for (uint32_t from = 0; from < router->workers(); ++from) {
+      drainingFrom = static_cast<int32_t>(from);
+      drained += router->drainFrom(
+          workerIndex, from, onFrame,
+          [this, from](const SessionMove &move) { onMove(move, from); });
+    }
+    drainingFrom = -1;
+    metrics.routedIn.add(drained);
+    metrics.inboundDepth.record(drained);
+    if (!forwarding.empty()) {
+      std::erase_if(forwarding, [this](const Forwarding &entry) {
+        return entry.passed &&
+               router->postMove(workerIndex, entry.session.worker,
+                                SessionMove{SessionMove::Step::Released,
+                                            entry.session});
+      });
+    }
+  }
+
+  /**
+   * Handles a step of a connection move posted by worker from
+   */
+  void onMove(const SessionMove &move, uint32_t from) {
+    switch (move.step) {
+    case SessionMove::Step::Handover:
+      adoptConnection(
+          std::unique_ptr<Connection>(static_cast<Connection *>(move.state)),
+          from);
+      break;
+    case SessionMove::Step::Adopted:
+      for (Forwarding &entry : forwarding) {
+        if (entry.session.sessionId == move.session.sessionId) {
+          entry.epoch = move.epoch;
+        }
+      }
+      break;
+    case SessionMove::Step::Released:
+      releaseParked(move.session);
+      break;
+    }
+  }
+
+  /**
+   * Whether a connection may be moved to another worker
+   * One still being moved in is left alone until its old worker released
+   * it, as is one whose reads are paused or that has resends left.
+   */
+  static bool movable(const Connection &conn) {
+    return conn.isOpen() && !conn.closing && !conn.replayed &&
+           conn.migrateTo < 0 && conn.adoptedFrom < 0 && !conn.readPaused &&
+           conn.resendNext == 0;
+  }
+
+  /**
+   * Picks the connection whose move evens out the load best
+   * That is the one whose recent traffic is closest to half of the
+   * worker's, never one carrying all of it, which would only move the hot
+   * spot. Counting starts over with every choice.
+   */
+  Connection *chooseMigrant() {
+    uint64_t total = 0;
+    connections.forEach([&](Connection &conn) {
+      if (movable(conn)) {
+        total += conn.recentMessages;
+      }
+    });
+    Connection *best = nullptr;
+    uint64_t bestDistance = UINT64_MAX;
+    connections.forEach([&](Connection &conn) {
+      uint64_t share = conn.recentMessages;
+      conn.recentMessages = 0;
+      if (!movable(conn) || (total != 0 && (share == 0 || share == total))) {
+        return;
+      }
+      uint64_t distance = total > 2 * share ? total - 2 * share
+                                            : 2 * share - total;
+      if (distance < bestDistance) {
+        best = &conn;
+        bestDistance = distance;
+      }
+    });
+    return best;
+  }
+
+  /**
+   * Stops reading from a connection that is to move to worker to
+   * It is handed over at the end of a batch once quiescent; io_uring
+   * connections first have their multishot recv cancelled.
+   */
+  void startMigration(int fd, uint32_t to) {
+    if (router == nullptr || to == workerIndex || to >= router->workers() ||
+        draining) {
+      return;
+    }
+    Connection *conn = fd >= 0 ? connections.get(fd) : chooseMigrant();
+    if (conn == nullptr || !movable(*conn)) {
+      LOG_DEBUG("No connection to move to worker {}", to);
+      return;
+    }
+    conn->migrateTo = static_cast<int32_t>(to);
+    migrating.push_back(
+        Migration{conn->fd, std::chrono::steady_clock::now() + MIGRATE_TIMEOUT});
+    if (ring && conn->recvArmed) {
+      cancelRecv(*conn);
+    }
+  }
+
+  /**
+   * Whether nothing of a migrating connection is in flight on this worker
+   */
+  static bool quiescent(const Connection &conn) {
+    return conn.outputSize() == 0 && !writeBusy(conn) &&
+           conn.zeroCopySends.empty() && !conn.recvArmed &&
+           conn.heldRecvs.empty() && !conn.readPaused &&
+           conn.resendNext == 0 && !conn.flushPending;
+  }
+
+  /**
+   * Hands over the migrating connections that went quiescent
+   * Runs after the batch's output was flushed, so no pointer to them is
+   * left. Those that do not settle within MIGRATE_TIMEOUT stay.
+   */
+  void continueMigrations() {
+    auto now = std::chrono::steady_clock::now();
+    size_t kept = 0;
+    for (const Migration &migration : migrating) {
+      Connection *conn = connections.get(migration.fd);
+      if (conn == nullptr || conn->closing || conn->migrateTo < 0) {
+        continue;
+      }
+      if (quiescent(*conn)) {
+        handOver(*conn);
+      } else if (now >= migration.deadline) {
+        LOG_DEBUG("Connection does not settle, keeping it (fd={})", conn->fd);
+        conn->migrateTo = -1;
+        if (ring && !conn->recvArmed && !conn->readPaused) {
+          armRecv(*conn);
+        }
+      } else {
+        migrating[kept++] = migration;
+      }
+    }
+    migrating.resize(kept);
+  }
+
+  /**
+   * Moves a quiescent connection to the worker it migrates to
+   *
+   * The Connection object itself goes through the channel, so buffers,
+   * journal and session state move without a copy; its poll registration
+   * and timer are undone first. Timer stamps travel as ages, as the wheels
+   * of two workers do not share a clock. Frames still posted to the old
+   * address are forwarded until the new owner has re-registered the
+   * session and every worker has seen that.
+   */
+  void handOver(Connection &conn) {
+    auto to = static_cast<uint32_t>(conn.migrateTo);
+    SessionAddress session{to, conn.fd, conn.sessionId};
+    timers.cancel(conn.timer);
+    stampsToAges(conn);
+    if (!ring) {
+      epoll_ctl(epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    }
+    std::unique_ptr<Connection> moving = connections.detach(conn);
+    if (!router->postMove(workerIndex, to,
+                          SessionMove{SessionMove::Step::Handover, session, 0,
+                                      moving.get()})) {
+      LOG_WARN("Channel to worker {} full, keeping connection (fd={})", to,
+               session.fd);
+      moving->migrateTo = -1;
+      adoptConnection(std::move(moving), workerIndex);
+      return;
+    }
+    moving.release(); // Owned by the target from here on
+    metrics.migrationsOut.add();
+    if (session.sessionId != 0) {
+      forwarding.push_back(Forwarding{session});
+    }
+  }
+
+  /**
+   * Takes over a connection handed over by worker from (or given back
+   * to this worker when the handover failed)
+   * The session is re-registered at its new address, and frames for it
+   * that do not come through from's channel are parked until from has
+   * forwarded everything sent to the old one.
+   */
+  void adoptConnection(std::unique_ptr<Connection> moved, uint32_t from) {
+    Connection *conn = moved.get();
+    if (!connections.attach(moved)) {
+      LOG_ERROR("fd {} is already registered, closing moved connection",
+                conn->fd);
+      close(conn->fd);
+      pool.release(conn->readBuffer);
+      conn->splices.clear();
+      pool.release(conn->writeBuffer);
+      return;
+    }
+    conn->migrateTo = -1;
+    stampsFromAges(*conn);
+    scheduleSessionTimer(*conn);
+    if (from != workerIndex) {
+      metrics.migrationsIn.add();
+      if (conn->syncQueued) {
+        unsyncedJournals.push_back(conn->fd);
+      }
+      if (conn->sessionId != 0) {
+        conn->adoptedFrom = static_cast<int32_t>(from);
+        SessionAddress address{workerIndex, conn->fd, conn->sessionId};
+        SessionMove adopted{SessionMove::Step::Adopted, address,
+                            router->relocateSession(conn->compID, address)};
+        if (!router->postMove(workerIndex, from, adopted)) {
+          unsentMoves.emplace_back(from, adopted);
+        }
+      }
+    }
+    if (ring) {
+      armRecv(*conn);
+    } else {
+      // Bytes that arrived meanwhile are reported right away
+      epoll_event event;
+      event.data.ptr = conn;
+      event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+      if (epoll_ctl(epollFd, EPOLL_CTL_ADD, conn->fd, &event) == -1) {
+        LOG_ERROR("epoll_ctl failed for moved connection: {}",
+                  strerror(errno));
+        closeConnection(*conn);
+        return;
+      }
+    }
+    if (!conn->readBuffer.empty() && !processInput(*conn)) {
+      closeConnection(*conn);
+    }
+  }
+
+  // Ticks since each timer stamp, plus one for a set TestRequest stamp
+  void stampsToAges(Connection &conn) const {
+    uint64_t now = timers.now();
+    conn.lastInTick = now - conn.lastInTick;
+    conn.lastOutTick = now - conn.lastOutTick;
+    if (conn.testRequestTick != 0) {
+      conn.testRequestTick = now - conn.testRequestTick + 1;
+    }
+  }
+
+  void stampsFromAges(Connection &conn) const {
+    uint64_t now = timers.now();
+    auto since = [now](uint64_t age) { return now > age ? now - age : 0; };
+    conn.lastInTick = since(conn.lastInTick);
+    conn.lastOutTick = since(conn.lastOutTick);
+    if (conn.testRequestTick != 0) {
+      conn.testRequestTick = std::max<uint64_t>(
+          since(conn.testRequestTick - 1), 1);
+    }
+  }
+
+  /**
+   * Passes a frame for a session that moved away on to its new worker
+   * @return false if destination is no such session
+   */
+  bool forward(const SessionAddress &destination, const FrameLayout &layout,
+               std::string_view frame) {
+    for (const Forwarding &entry : forwarding) {
+      if (entry.session.sessionId != destination.sessionId) {
+        continue;
+      }
+      if (!router->post(workerIndex, entry.session, layout, frame)) {
+        LOG_WARN("Channel to worker {} full, dropping forwarded frame",
+                 entry.session.worker);
+        metrics.routeDrops.add();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * Whether a frame for target has to wait for its old worker's release
+   * Only frames forwarded through that worker's channel are older than the
+   * ones it parks.
+   */
+  bool mustPark(const Connection &target) const {
+    return target.adoptedFrom >= 0 && target.adoptedFrom != drainingFrom;
+  }
+
+  void park(const SessionAddress &destination, const FrameLayout &layout,
+            FrameRef frame) {
+    if (parked.size() >= MAX_PARKED) {
+      LOG_WARN("Too many frames for moving sessions, dropping routed frame");
+      metrics.routeDrops.add();
+      return;
+    }
+    parked.push_back(ParkedFrame{destination, layout, std::move(frame)});
+  }
+
+  /**
+   * Delivers the frames parked for a moved-in session, in arrival order,
+   * once its old worker has forwarded everything else
+   */
+  void releaseParked(const SessionAddress &session) {
+    Connection *conn = connections.get(session.fd);
+    if (conn != nullptr && conn->sessionId == session.sessionId) {
+      conn->adoptedFrom = -1;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < parked.size(); ++i) {
+      if (parked[i].destination.sessionId == session.sessionId) {
+        deliverShared(parked[i].destination, parked[i].layout,
+                      parked[i].frame);
+      } else if (kept++ != i) {
+        parked[kept - 1] = std::move(parked[i]);
+      }
+    }
+    parked.resize(kept);
+  }
+
+  /**
+   * Posts the moves that found their channel full, and checks on the
+   * sessions still forwarded to so they are released without more traffic
+   */
+  void continueForwarding() {
+    std::erase_if(unsentMoves, [this](const auto &entry) {
+      return router->postMove(workerIndex, entry.first, entry.second);
+    });
+    if (std::any_of(forwarding.begin(), forwarding.end(),
+                    [](const Forwarding &entry) { return entry.epoch != 0; })) {
+      drainRouted();
+    }
+  }
+
+  /**
+   * Accepts every pending connection on the worker's own listener
+   * With edge-triggered epoll a single accept per wakeup would leave the
+   * rest of a logon burst in the backlog until the next connection arrives.
+   */
+  void drainListener() {
+    while (true) {
+      int newFd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK);
+      if (newFd >= 0) {
+        addConnection(newFd);
+        continue;
+      }
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG_WARN("accept failed: {}", strerror(errno));
+      }
+      return;
+    }
+  }
+
+  /**
+   * Closes and cleans up a connection
+   * The object stays valid until the end of the current event batch.
+   * @param conn Connection to close
+   */
+  void closeConnection(Connection &conn) {
+    if (!conn.isOpen()) {
+      return;
+    }
+    if (!conn.closing) {
+      metrics.connectionsClosed.add();
+      if (capture) {
+        capture->closed(MetricsClock::now(), conn.fd);
+      }
+    }
+    timers.cancel(conn.timer);
+    if (conn.sessionId != 0) {
+      router->unregisterSession(conn.compID, conn.sessionId);
+      conn.sessionId = 0;
+    }
+    conn.journal.reset(); // Syncs what the policy asks for
+    if (ring) {
+      // Outstanding operations still reference the connection; shutting the
+      // socket down completes them, and finishClose() runs after the last
+      if (!conn.closing) {
+        conn.closing = true;
+        shutdown(conn.fd, SHUT_RDWR);
+        finishClose(conn);
+      }
+      return;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    close(conn.fd);
+    pool.release(conn.readBuffer);
+    conn.splices.clear();
+    pool.release(conn.writeBuffer);
+    connections.close(conn);
+  }
+
+  /**
+   * Returns the buffers of connections idle for IDLE_TRIM_AFTER to the pool
+   * Buffers still holding data are kept; they regrow lazily on next use.
+   */
+  void trimIdleConnections() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastSweep < std::chrono::milliseconds(IDLE_SWEEP_MS)) {
+      return;
+    }
+    lastSweep = now;
+    connections.forEach([&](Connection &conn) {
+      if (now - conn.lastActive >= IDLE_TRIM_AFTER) {
+        pool.trim(conn.readBuffer);
+        pool.trim(conn.writeBuffer);
+      }
+    });
+  }
+
+  /**
+   * Updates epoll events for a connection
+   * @param conn Connection to modify
+   * @param events New event mask
+   */
+  void setEpollEvents(Connection &conn, int events) {
+    if (conn.replayed) {
+      return;
+    }
+    epoll_event event;
+    event.data.ptr = &conn;
+    event.events = events | EPOLLRDHUP | EPOLLET;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event) == -1) {
+      LOG_ERROR("epoll_ctl failed to modify event: {}", strerror(errno));
+    }
+  }
+
+  /**
+   * Processes a logon message and prepares response
+   * @param conn Connection to write response to
+   */
+  void processLogon(Connection &conn, const Message &message) {
+    // Reply as the other side of the session
+    conn.sessionHeader = FixSessionHeader(
+        message.beginString, message.targetCompID, message.senderCompID);
+    std::optional<int64_t> seconds = message.get<fix::HeartBtInt>();
+    if (seconds && *seconds > 0) {
+      conn.heartbeatTicks = static_cast<uint32_t>(std::min<uint64_t>(
+          toTicks(std::chrono::seconds(*seconds)), TimerWheel::MAX_DELAY / 2));
+      conn.testRequestTick = 0;
+    }
+    if (!journalOptions.directory.empty() && !conn.journal) {
+      openJournal(conn, message);
+    }
+
+    // The response echoes the request, so it needs about one frame of space
+    char *out;
+    size_t space;
+    if (!pool.ensureSpace(conn.writeBuffer,
+                          message.frameLength + RESPONSE_SLACK) ||
+        !conn.writeBuffer.getWriteView(out, space)) {
+      LOG_WARN("Write buffer cannot hold logon response ({} bytes)",
+               message.frameLength);
+      metrics.writeBufferDrops.add();
+      return;
+    }
+
+    FixEncoder encoder(out, space);
+    encoder.begin(conn.sessionHeader, message.msgType, conn.nextOutSeqNum);
+    for (const FixField &field : message.fields) {
+      if (!Message::isNamedTag(field.tag)) {
+        encoder.field(field.tag, field.value);
+      }
+    }
+    size_t length = encoder.finish();
+    if (length == 0) {
+      LOG_WARN("Logon response does not fit the write buffer (fd={})",
+               conn.fd);
+      metrics.writeBufferDrops.add();
+      return;
+    }
+    conn.writeBuffer.commit(length);
+    journalFrame(conn, std::string_view(out, length));
+    ++conn.nextOutSeqNum;
+    countOutput(conn);
+    scheduleSessionTimer(conn);
+
+    // Messages for this CompID are routed to this connection from now on
+    if (router != nullptr && conn.sessionId == 0) {
+      conn.sessionId = router->nextSessionId();
+      conn.compID = message.senderCompID;
+      router->registerSession(conn.compID,
+                              SessionAddress{workerIndex, conn.fd, conn.sessionId});
+    }
+  }
+
+  /**
+   * Opens the journal of the session that just logged on
+   * Outbound MsgSeqNums continue from the journal, unless the Logon asks
+   * for a reset (ResetSeqNumFlag, 141=Y). Without a journal the session
+   * still works, it just cannot serve resends.
+   * Runs on the event loop, as the Logon response needs the MsgSeqNum: the
+   * lock, a scan of existing segments or a small first segment stall the
+   * worker briefly, while full sized segments are allocated off-thread. A
+   * reset is passed to the journal as it opens, so the old segments are
+   * never read and no spare is started only to be thrown away.
+   */
+  void openJournal(Connection &conn, const Message &message) {
+    std::string name = std::string(message.targetCompID) + "-" +
+                       std::string(message.senderCompID);
+    bool reset = message.get<fix::ResetSeqNumFlag>().value_or(false);
+    try {
+      conn.journal =
+          std::make_unique<SessionJournal>(journalOptions, name, reset);
+      if (reset) {
+        conn.nextOutSeqNum = 1;
+      } else {
+        conn.nextOutSeqNum =
+            std::max(conn.nextOutSeqNum, conn.journal->nextSeqNum());
+      }
+    } catch (const std::exception &e) {
+      LOG_WARN("Session {} runs without journal: {}", name, e.what());
+      conn.journal.reset();
+    }
+  }
+
+  /**
+   * Journals an outbound frame under the connection's next MsgSeqNum
+   * @param frame The frame just committed to the write buffer
+   */
+  void journalFrame(Connection &conn, std::string_view frame) {
+    journalFrame(conn, std::span<const std::string_view>(&frame, 1));
+  }
+
+  /**
+   * Journals an outbound frame written in consecutive parts
+   */
+  void journalFrame(Connection &conn, std::span<const std::string_view> parts) {
+    if (!conn.journal) {
+      return;
+    }
+    if (!conn.journal->append(conn.nextOutSeqNum, parts)) {
+      LOG_WARN("Failed to journal MsgSeqNum={} (fd={})", conn.nextOutSeqNum,
+               conn.fd);
+      metrics.journalErrors.add();
+      return;
+    }
+    if (!conn.syncQueued && conn.journal->dirty()) {
+      conn.syncQueued = true;
+      unsyncedJournals.push_back(conn.fd);
+    }
+  }
+
+  /**
+   * Syncs the journals written since the last batch, per their policy
+   * Journals still inside their sync interval stay listed for a later batch.
+   */
+  void syncJournals() {
+    auto now = std::chrono::steady_clock::now();
+    size_t kept = 0;
+    for (int fd : unsyncedJournals) {
+      Connection *conn = connections.get(fd);
+      if (conn == nullptr || !conn->syncQueued || !conn->journal) {
+        continue;
+      }
+      if (!conn->journal->sync(now)) {
+        LOG_WARN("Journal sync failed (fd={}): {}", fd, strerror(errno));
+        metrics.journalErrors.add();
+      }
+      if (conn->journal->dirty()) {
+        unsyncedJournals[kept++] = fd;
+      } else {
+        conn->syncQueued = false;
+      }
+    }
+    unsyncedJournals.resize(kept);
+  }
+
+  /**
+   * Queues the range asked for by a ResendRequest (35=2)
+   * BeginSeqNo (7) to EndSeqNo (16), 0 meaning the last message sent.
+   */
+  void processResendRequest(Connection &conn, const Message &message) {
+    if (conn.sessionHeader.empty()) {
+      LOG_WARN("Dropping ResendRequest received before logon (fd={})",
+               conn.fd);
+      return;
+    }
+    std::optional<int64_t> beginSeqNo = message.get<fix::BeginSeqNo>();
+    std::optional<int64_t> endSeqNo = message.get<fix::EndSeqNo>();
+    if (!beginSeqNo || !endSeqNo || *beginSeqNo <= 0 || *endSeqNo < 0) {
+      LOG_WARN("Malformed ResendRequest (fd={})", conn.fd);
+      return;
+    }
+    uint64_t begin = static_cast<uint64_t>(*beginSeqNo);
+    uint64_t end = static_cast<uint64_t>(*endSeqNo);
+    uint64_t last = conn.nextOutSeqNum - 1;
+    if (end == 0 || end > last) {
+      end = last;
+    }
+    if (begin > end) {
+      LOG_WARN("ResendRequest from {} beyond last MsgSeqNum {} (fd={})",
+               begin, last, conn.fd);
+      return;
+    }
+    if (conn.resendNext == 0) {
+      resending.push_back(conn.fd);
+    }
+    conn.resendNext = begin;
+    conn.resendEnd = end;
+  }
+
+  /**
+   * Writes as much of a queued resend as the write buffer takes
+   *
+   * Application messages are copied from the journal mapping with
+   * PossDupFlag=Y; session-level and unjournaled messages are covered by
+   * SequenceReset-GapFill messages, one per run.
+   * @return true once the whole range has been written
+   */
+  bool resend(Connection &conn) {
+    CircularBuffer &out = conn.writeBuffer;
+    bool wrote = false;
+    while (conn.isOpen() && conn.resendNext <= conn.resendEnd) {
+      uint64_t seqNum = conn.resendNext;
+      uint64_t gapEnd = seqNum;
+      std::string_view frame;
+      if (!conn.journal) {
+        gapEnd = conn.resendEnd + 1;
+      }
+      while (gapEnd <= conn.resendEnd &&
+             (!conn.journal->frame(gapEnd, frame) ||
+              SessionJournal::isAdminMsgType(
+                  SessionJournal::msgTypeOf(frame)))) {
+        ++gapEnd;
+      }
+
+      bool gapFill = gapEnd > seqNum;
+      size_t needed =
+          (gapFill ? conn.sessionHeader.prefix().size() +
+                         conn.sessionHeader.compIDs().size()
+                   : frame.size()) +
+          RESEND_SLACK;
+      char *data;
+      size_t space;
+      if ((writeBusy(conn) ? out.availableSpace() < needed
+                           : !pool.ensureSpace(out, needed)) ||
+          !out.getWriteView(data, space)) {
+        // The epoll engine can make room right away
+        if (!ring && !out.empty()) {
+          flushOutput(conn);
+          if (conn.isOpen() && out.empty()) {
+            continue;
+          }
+        }
+        break;
+      }
+
+      size_t length = 0;
+      if (!gapFill) {
+        length = SessionJournal::copyAsPossDup(frame, data, space);
+        if (length == 0) {
+          LOG_WARN("Cannot resend MsgSeqNum={}, filling the gap (fd={})",
+                   seqNum, conn.fd);
+          gapEnd = seqNum + 1;
+        }
+      }
+      if (length == 0) {
+        FixEncoder encoder(data, space);
+        encoder.begin(conn.sessionHeader, "4", seqNum)
+            .field(43, "Y")
+            .field(123, "Y")
+            .field(36, gapEnd);
+        length = encoder.finish();
+        if (length == 0) {
+          break;
+        }
+      }
+      out.commit(length);
+      metrics.messagesOut.add();
+      conn.lastOutTick = timers.now();
+      wrote = true;
+      conn.resendNext = std::max(gapEnd, seqNum + 1);
+    }
+
+    if (wrote && !conn.flushPending) {
+      conn.flushPending = true;
+      pendingFlush.push_back(&conn);
+    }
+    if (conn.resendNext <= conn.resendEnd) {
+      return false;
+    }
+    conn.resendNext = 0;
+    conn.resendEnd = 0;
+    return true;
+  }
+
+  /**
+   * Continues the resends that are still waiting for write buffer space
+   */
+  void continueResends() {
+    size_t kept = 0;
+    for (int fd : resending) {
+      Connection *conn = connections.get(fd);
+      if (conn == nullptr || conn->closing || conn->resendNext == 0) {
+        continue;
+      }
+      if (!resend(*conn)) {
+        resending[kept++] = fd;
+      }
+    }
+    resending.resize(kept);
+  }
+
+  /**
+   * Converts a duration to timer wheel ticks, at least one
+   */
+  uint64_t toTicks(std::chrono::milliseconds duration) const {
+    return std::max<uint64_t>(
+        1, static_cast<uint64_t>(duration / sessionTimers.resolution));
+  }
+
+  /**
+   * Schedules conn's timer for the earliest of its session deadlines
+   * Traffic only moves conn.lastInTick and conn.lastOutTick, so no message
+   * touches the wheel; a timer that fires early just moves itself on.
+   */
+  void scheduleSessionTimer(Connection &conn) {
+    uint64_t expiry = UINT64_MAX;
+    if (idleTicks != 0) {
+      expiry = conn.lastInTick + idleTicks;
+    }
+    if (conn.heartbeatTicks != 0) {
+      uint64_t grace = conn.heartbeatTicks + conn.heartbeatTicks / 5;
+      uint64_t silentSince =
+          conn.testRequestTick != 0 ? conn.testRequestTick : conn.lastInTick;
+      expiry = std::min({expiry, conn.lastOutTick + conn.heartbeatTicks,
+                         silentSince + grace});
+    }
+    if (expiry == UINT64_MAX) {
+      timers.cancel(conn.timer);
+      return;
+    }
+    timers.schedule(conn.timer, expiry);
+    if (!tickTimer.running()) {
+      tickTimer.start(sessionTimers.resolution);
+    }
+  }
+
+  /**
+   * Handles whichever deadlines of conn are due and schedules the next one
+   */
+  void onSessionTimer(Connection &conn) {
+    uint64_t now = timers.now();
+    if (idleTicks != 0 && now - conn.lastInTick >= idleTicks) {
+      LOG_INFO("Closing idle connection (fd={})", conn.fd);
+      metrics.idleTimeouts.add();
+      closeConnection(conn);
+      return;
+    }
+    if (conn.heartbeatTicks != 0) {
+      uint64_t grace = conn.heartbeatTicks + conn.heartbeatTicks / 5;
+      if (conn.testRequestTick != 0 &&
+          conn.lastInTick >= conn.testRequestTick) {
+        conn.testRequestTick = 0; // Anything received answers it
+      }
+      if (conn.testRequestTick != 0) {
+        if (now - conn.testRequestTick >= grace) {
+          LOG_WARN("TestRequest unanswered, closing session {} (fd={})",
+                   conn.compID, conn.fd);
+          metrics.heartbeatTimeouts.add();
+          closeConnection(conn);
+          return;
+        }
+      } else if (now - conn.lastInTick >= grace) {
+        char id[24];
+        char *end = std::to_chars(id, id + sizeof id, now).ptr;
+        if (writeSessionMessage(conn, "1",
+                                std::string_view(id, static_cast<size_t>(
+                                                         end - id)))) {
+          conn.testRequestTick = now;
+        }
+      }
+      if (now - conn.lastOutTick >= conn.heartbeatTicks) {
+        writeSessionMessage(conn, "0", {});
+      }
+    }
+    scheduleSessionTimer(conn);
+  }
+
+  /**
+   * Advances the session timers by the ticks passed since the last call
+   * The tick timer is stopped while no timer is scheduled.
+   */
+  void onTick() {
+    uint64_t ticks = tickTimer.read();
+    if (ticks != 0) {
+      timers.advance(timers.now() + ticks - 1, [this](TimerNode &node) {
+        onSessionTimer(*static_cast<Connection *>(node.owner));
+      });
+    }
+    if (timers.empty() && tickTimer.running()) {
+      tickTimer.stop();
+    }
+  }
+
+  /**
+   * Writes a Heartbeat or TestRequest carrying testReqID (112), if any
+   * It goes out with the routed output at the end of the batch.
+   * @return false if the write buffer had no room for it
+   */
+  bool writeSessionMessage(Connection &conn, std::string_view msgType,
+                           std::string_view testReqID) {
+    CircularBuffer &out = conn.writeBuffer;
+    size_t needed = conn.sessionHeader.prefix().size() +
+                    conn.sessionHeader.compIDs().size() + testReqID.size() +
+                    ADMIN_SLACK;
+    char *data;
+    size_t space;
+    if ((writeBusy(conn) ? out.availableSpace() < needed
+                         : !pool.ensureSpace(out, needed)) ||
+        !out.getWriteView(data, space)) {
+      LOG_WARN("Write buffer full, dropping MsgType={} (fd={})", msgType,
+               conn.fd);
+      metrics.writeBufferDrops.add();
+      return false;
+    }
+    FixEncoder encoder(data, space);
+    encoder.begin(conn.sessionHeader, msgType, conn.nextOutSeqNum);
+    if (!testReqID.empty()) {
+      encoder.field(112, testReqID);
+    }
+    size_t length = encoder.finish();
+    if (length == 0) {
+      metrics.writeBufferDrops.add();
+      return false;
+    }
+    out.commit(length);
+    journalFrame(conn, std::string_view(data, length));
+    ++conn.nextOutSeqNum;
+    countOutput(conn);
+    metrics.heartbeatsSent.add();
+    if (!conn.flushPending) {
+      conn.flushPending = true;
+      pendingFlush.push_back(&conn);
+    }
+    return true;
+  }
+
+  /**
+   * Answers a TestRequest (35=1) with a Heartbeat echoing its TestReqID
+   */
+  void processTestRequest(Connection &conn, const Message &message) {
+    if (conn.sessionHeader.empty()) {
+      LOG_WARN("Dropping TestRequest received before logon (fd={})",
+               conn.fd);
+      return;
+    }
+    writeSessionMessage(conn, "0",
+                        message.get<fix::TestReqID>().value_or(""));
+  }
+
+  /**
+   * Forwards an application message to the session it is addressed to,
+   * and to the drop-copy sessions of its route
+   * Sessions on this worker are written to directly, those of each other
+   * worker get one copy of the raw frame through that worker's mailbox.
+   */
+  void routeMessage(Connection &conn, const Message &message) {
+    if (conn.sessionId == 0) {
+      LOG_WARN("Dropping MsgType={} received before logon (fd={})",
+               message.msgType, conn.fd);
+      metrics.routeDrops.add();
+      return;
+    }
+    if (router->resolveAll(message, routeTargets) == 0) {
+      LOG_WARN("No route for MsgType={} from {} to {}", message.msgType,
+               message.senderCompID, message.targetCompID);
+      metrics.routeDrops.add();
+      return;
+    }
+    FrameLayout layout;
+    if (!FrameLayout::of(message, layout)) {
+      LOG_WARN("Cannot route frame without TargetCompID and MsgSeqNum "
+               "(fd={})",
+               conn.fd);
+      metrics.routeDrops.add(routeTargets.size());
+      return;
+    }
+    // Grouped by worker, each group is delivered or posted as one
+    std::stable_sort(routeTargets.begin(), routeTargets.end(),
+                     [](const SessionAddress &a, const SessionAddress &b) {
+                       return a.worker < b.worker;
+                     });
+    for (size_t first = 0; first < routeTargets.size();) {
+      size_t last = first + 1;
+      while (last < routeTargets.size() &&
+             routeTargets[last].worker == routeTargets[first].worker) {
+        ++last;
+      }
+      std::span<const SessionAddress> group(routeTargets.data() + first,
+                                            last - first);
+      if (group.front().worker == workerIndex) {
+        deliverAll(group, layout, message.frame);
+      } else if (!router->post(workerIndex, group, layout, message.frame)) {
+        LOG_WARN("Channel to worker {} full, dropping routed frame",
+                 group.front().worker);
+        metrics.routeDrops.add(group.size());
+      }
+      first = last;
+    }
+  }
+
+  /**
+   * Writes a routed frame to one or more sessions on this worker
+   * A frame for several sessions is copied once and shared between them.
+   */
+  void deliverAll(std::span<const SessionAddress> destinations,
+                  const FrameLayout &layout, std::string_view frame) {
+    if (destinations.size() == 1) {
+      deliver(destinations.front(), layout, frame);
+      return;
+    }
+    FrameRef shared = FrameRef::copy(frame);
+    for (const SessionAddress &destination : destinations) {
+      deliverShared(destination, layout, shared);
+    }
+  }
+
+  /**
+   * Returns the connection of a routed frame's destination session
+   * @return nullptr, with the drop counted, if the session has closed
+   */
+  Connection *destinationOf(const SessionAddress &destination) {
+    Connection *target = connections.get(destination.fd);
+    if (target == nullptr || target->sessionId != destination.sessionId ||
+        target->closing) {
+      LOG_WARN("Destination session closed, dropping routed frame");
+      metrics.routeDrops.add();
+      return nullptr;
+    }
+    return target;
+  }
+
+  /**
+   * Reserves write space for a routed frame
+   * While the kernel reads from the buffer it cannot be swapped for a
+   * larger one.
+   * @return false, with the drop counted, if there is not enough space
+   */
+  bool routeSpace(Connection &target, size_t needed, char *&data,
+                  size_t &space) {
+    CircularBuffer &out = target.writeBuffer;
+    if ((writeBusy(target) ? out.availableSpace() < needed
+                           : !pool.ensureSpace(out, needed)) ||
+        !out.getWriteView(data, space)) {
+      LOG_WARN("Write buffer full, dropping routed frame (fd={})", target.fd);
+      metrics.writeBufferDrops.add();
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Counts a routed frame just written to target and queues its flush
+   */
+  void routedOutput(Connection &target) {
+    ++target.nextOutSeqNum;
+    countOutput(target);
+    if (!target.flushPending) {
+      target.flushPending = true;
+      pendingFlush.push_back(&target);
+    }
+  }
+
+  /**
+   * Writes a routed frame to its destination session on this worker
+   * Only TargetCompID and MsgSeqNum are rewritten; the rest is copied as is.
+   */
+  void deliver(const SessionAddress &destination, const FrameLayout &layout,
+               std::string_view frame) {
+    if (!forwarding.empty() && forward(destination, layout, frame)) {
+      return;
+    }
+    Connection *target = destinationOf(destination);
+    if (target == nullptr) {
+      return;
+    }
+    if (mustPark(*target)) {
+      park(destination, layout, FrameRef::copy(frame));
+      return;
+    }
+    CircularBuffer &out = target->writeBuffer;
+    size_t needed = frame.size() + target->compID.size() + ROUTE_SLACK;
+    char *data;
+    size_t space;
+    if (!routeSpace(*target, needed, data, space)) {
+      return;
+    }
+    size_t length = layout.forward(frame, target->compID,
+                                   target->nextOutSeqNum, data, space);
+    if (length == 0) {
+      LOG_WARN("Routed frame does not fit the write buffer (fd={})",
+               target->fd);
+      metrics.writeBufferDrops.add();
+      return;
+    }
+    out.commit(length);
+    journalFrame(*target, std::string_view(data, length));
+    routedOutput(*target);
+  }
+
+  /**
+   * Writes a frame shared with other sessions to a destination on this
+   * worker
+   * Only the rewritten header and the trailer go to its write buffer; the
+   * unchanged middle is spliced in from the shared copy and sent from there.
+   */
+  void deliverShared(const SessionAddress &destination,
+                     const FrameLayout &layout, const FrameRef &shared) {
+    if (!forwarding.empty() && forward(destination, layout, shared->bytes())) {
+      return;
+    }
+    Connection *target = destinationOf(destination);
+    if (target == nullptr) {
+      return;
+    }
+    if (mustPark(*target)) {
+      park(destination, layout, shared);
+      return;
+    }
+    CircularBuffer &out = target->writeBuffer;
+    std::string_view frame = shared->bytes();
+    size_t needed = layout.sharedAt() + target->compID.size() + ROUTE_SLACK +
+                    FrameLayout::TRAILER_LENGTH;
+    char *data;
+    size_t space;
+    if (!routeSpace(*target, needed, data, space)) {
+      return;
+    }
+    unsigned checksum;
+    size_t header = layout.forwardHeader(
+        frame, target->compID, target->nextOutSeqNum, data, space, checksum);
+    if (header == 0) {
+      LOG_WARN("Routed frame does not fit the write buffer (fd={})",
+               target->fd);
+      metrics.writeBufferDrops.add();
+      return;
+    }
+    char trailer[FrameLayout::TRAILER_LENGTH];
+    FrameLayout::writeTrailer(checksum, trailer);
+    std::string_view body =
+        frame.substr(layout.sharedAt(), layout.trailerAt - layout.sharedAt());
+    if (target->journal) {
+      std::string_view parts[3] = {std::string_view(data, header), body,
+                                   std::string_view(trailer, sizeof trailer)};
+      journalFrame(*target, parts);
+    }
+    out.commit(header);
+    target->splices.splice(out, shared, layout.sharedAt(),
+                           static_cast<uint32_t>(body.size()));
+    out.writeFromBytes(trailer, sizeof trailer);
+    routedOutput(*target);
+  }
+
+  /**
+   * Stops reading from every connection and refuses new ones, so that each
+   * is closed once its output has gone out
+   * Moves not yet handed over are called off: the destination may be
+   * stopping too. A later drain can only bring the deadline forward.
+   * @param stop Return from run() once no connection is left
+   */
+  void startDrain(std::chrono::steady_clock::time_point deadline, bool stop) {
+    drainDeadline = draining ? std::min(drainDeadline, deadline) : deadline;
+    draining = true;
+    stopping = stopping || stop;
+    for (const Migration &migration : migrating) {
+      if (Connection *conn = connections.get(migration.fd)) {
+        conn->migrateTo = -1;
+      }
+    }
+    migrating.clear();
+    LOG_INFO("Draining {} connections{}", connections.size(),
+             stopping ? " before shutdown" : "");
+    connections.forEach([this](Connection &conn) {
+      if (conn.closing) {
+        return;
+      }
+      if (!ring) {
+        setEpollEvents(conn, epollInterest(conn));
+      } else if (conn.recvArmed) {
+        cancelRecv(conn);
+      }
+    });
+    if (ring) {
+      armDrainTimeout();
+    }
+  }
+
+  /**
+   * Closes the draining connections whose output has gone out, and the
+   * rest once the deadline has passed
+   * Input that arrived meanwhile is discarded first, as closing a socket
+   * with unread input resets it and the peer would lose the output still
+   * in flight. A drain without shutdown ends once no connection is left.
+   */
+  void continueDrain() {
+    bool late = std::chrono::steady_clock::now() >= drainDeadline;
+    connections.forEach([&](Connection &conn) {
+      if (conn.closing || !conn.isOpen()) {
+        return;
+      }
+      bool flushed = conn.outputSize() == 0 && !writeBusy(conn) &&
+                     conn.zeroCopySends.empty();
+      if (flushed) {
+        discardInput(conn);
+      } else if (late) {
+        LOG_WARN("Drain deadline passed, closing connection with {} bytes "
+                 "unsent (fd={})",
+                 conn.outputSize(), conn.fd);
+      } else {
+        return;
+      }
+      closeConnection(conn);
+    });
+    if (!stopping && (late || connections.size() == 0)) {
+      LOG_INFO("Drain complete");
+      draining = false;
+    }
+  }
+
+  /**
+   * Reads and drops what a draining connection's peer still sent, up to a
+   * bound, so a client that keeps sending cannot hold up the drain
+   */
+  static void discardInput(const Connection &conn) {
+    char scratch[4096];
+    for (int i = 0; i < 64; ++i) {
+      if (recv(conn.fd, scratch, sizeof(scratch), MSG_DONTWAIT) <= 0) {
+        return;
+      }
+    }
+  }
+
+  /**
+   * Whether a Shutdown command has completed: no connection is left, or
+   * its deadline has passed and the rest are closed on the way out
+   */
+  bool stopped() const {
+    return stopping && (connections.size() == 0 ||
+                        std::chrono::steady_clock::now() >= drainDeadline);
+  }
+
+  /**
+   * Work deferred to the end of each event batch
+   * Output goes out before journals are synced, so syncing never delays it.
+   */
+  void endBatch() {
+    if (!resending.empty()) {
+      continueResends();
+    }
+    if (!forwarding.empty() || !unsentMoves.empty()) {
+      continueForwarding();
+    }
+    flushRouted();
+    if (!migrating.empty()) {
+      continueMigrations();
+    }
+    if (draining) {
+      continueDrain();
+    }
+    if (!unsyncedJournals.empty()) {
+      syncJournals();
+    }
+  }
+
+  /**
+   * Sends the output routed to other connections during this batch
+   */
+  void flushRouted() {
+    for (Connection *conn : pendingFlush) {
+      conn->flushPending = false;
+      if (ring) {
+        flushUring(*conn);
+        // Routed output piles up behind sends still in flight
+        if (conn->isOpen() && !conn->closing && !checkBacklog(*conn)) {
+          closeConnection(*conn);
+        }
+      } else {
+        flushOutput(*conn);
+      }
+    }
+    pendingFlush.clear();
+  }
+
+  /**
+   * Processes different message types
+   * @param conn Connection context
+   * @param message Parsed FIX message
+   */
+  void processData(Connection &conn, const Message &message) {
+    switch (FixMsgType::code(message.msgType)) {
+    case FixMsgType::code("A"):
+      processLogon(conn, message);
+      break;
+    case FixMsgType::code("0"):
+      // Heartbeats only show the session is alive, which the read recorded
+      break;
+    case FixMsgType::code("1"):
+      processTestRequest(conn, message);
+      break;
+    case FixMsgType::code("2"):
+      processResendRequest(conn, message);
+      break;
+    default:
+      if (router != nullptr) {
+        routeMessage(conn, message);
+      }
+      break;
+    }
+  }
+
+  /**
+   * Handles the frames parsed from one read view, in arrival order
+   * @param conn Connection the frames arrived on
+   * @param messages Parsed frames, pointing into conn.readBuffer
+   */
+  void processBatch(Connection &conn, std::span<const Message> messages) {
+    for (const Message &message : messages) {
+      // Debug logging for parsed message
+      LOG_DEBUG("Parsed FIX message: BeginString={} BodyLength={} "
+                "CheckSum={} MsgType={} SenderCompID={} TargetCompID={} "
+                "ClOrdID={} SeqNumber={} Fields={}",
+                message.beginString, message.bodyLength, message.checkSum,
+                message.msgType, message.senderCompID, message.targetCompID,
+                message.clOrdID, message.seqNumber, message.fields.size());
+      for (const FixField &field : message.fields) {
+        LOG_TRACE("Field {}={}", field.tag, field.value);
+      }
+      processData(conn, message);
+    }
+  }
+
+  /**
+   * Checks whether the kernel still reads from the connection's write buffer
+   */
+  static bool writeBusy(const Connection &conn) {
+    return conn.sendsInFlight > 0 || conn.writeBuffer.pinnedSize() > 0;
+  }
+
+  /**
+   * Counts a frame just committed to conn's write buffer
+   * The flush latency runs from the oldest frame written since the buffer
+   * was last empty.
+   */
+  void countOutput(Connection &conn) {
+    metrics.messagesOut.add();
+    conn.lastOutTick = timers.now();
+    if (conn.unflushed++ == 0) {
+      conn.outputTick = messageTick;
+    }
+  }
+
+  /**
+   * Records the flush latency once conn's write buffer has been emptied
+   * Every frame of the flush counts with the age of the oldest one, which
+   * overstates rather than understates the latency of the others.
+   */
+  void countFlushed(Connection &conn) {
+    if (conn.unflushed != 0 && conn.writeBuffer.empty()) {
+      metrics.parseToFlush.record(MetricsClock::now() - conn.outputTick,
+                                  conn.unflushed);
+      conn.unflushed = 0;
+    }
+  }
+
+  /**
+   * Decides whether the pending output goes out with MSG_ZEROCOPY
+   * Zero-copy only pays off for large sends; SO_ZEROCOPY is enabled on the
+   * socket the first time one is due.
+   */
+  bool useZeroCopy(Connection &conn) {
+    // Spliced frames may be freed as soon as they count as sent
+    if (zeroCopyThreshold == 0 || !conn.splices.empty() ||
+        conn.zeroCopyState == Connection::ZeroCopy::Disabled ||
+        conn.writeBuffer.dataSize() < zeroCopyThreshold) {
+      return false;
+    }
+    if (conn.zeroCopyState == Connection::ZeroCopy::Untried) {
+      int one = 1;
+      bool ok = ring != nullptr || setsockopt(conn.fd, SOL_SOCKET, SO_ZEROCOPY,
+                                              &one, sizeof one) == 0;
+      conn.zeroCopyState =
+          ok ? Connection::ZeroCopy::Enabled : Connection::ZeroCopy::Disabled;
+      if (!ok) {
+        LOG_DEBUG("SO_ZEROCOPY unavailable (fd={}): {}", conn.fd,
+                  strerror(errno));
+        return false;
+      }
+    }
+    return ring != nullptr || !conn.zeroCopySends.full();
+  }
+
+  /**
+   * Sends the pending output with MSG_ZEROCOPY
+   * The sent bytes stay pinned in writeBuffer until the kernel reports the
+   * send complete on the socket error queue.
+   * @return Bytes sent or -1 with errno set
+   */
+  ssize_t sendZeroCopy(Connection &conn) {
+    iovec segments[2];
+    msghdr msg{};
+    msg.msg_iov = segments;
+    msg.msg_iovlen = conn.writeBuffer.getReadSegments(segments);
+    ssize_t sent = sendmsg(conn.fd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+    if (sent > 0) {
+      conn.writeBuffer.consumePinned(static_cast<size_t>(sent));
+      conn.zeroCopySends.push(static_cast<size_t>(sent));
+    }
+    return sent;
+  }
+
+  /**
+   * Sends the pending output including spliced shared frames in one writev
+   * @return Bytes sent or -1 with errno set
+   */
+  ssize_t sendSpliced(Connection &conn) {
+    iovec segments[OUTPUT_SEGMENTS];
+    int count = conn.splices.gather(conn.writeBuffer, segments,
+                                    OUTPUT_SEGMENTS);
+    ssize_t sent = writev(conn.fd, segments, count);
+    if (sent > 0) {
+      conn.splices.consume(conn.writeBuffer, static_cast<size_t>(sent));
+    }
+    return sent;
+  }
+
+  /**
+   * Drains zero-copy completion notifications from the socket error queue
+   */
+  void drainErrorQueue(Connection &conn) {
+    size_t released = 0;
+    while (true) {
+      char control[128];
+      msghdr msg{};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof control;
+      if (recvmsg(conn.fd, &msg, MSG_ERRQUEUE) == -1) {
+        break; // EAGAIN once the queue is empty
+      }
+      for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+           cm = CMSG_NXTHDR(&msg, cm)) {
+        if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+              (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+          continue;
+        }
+        auto *err = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cm));
+        if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+          continue;
+        }
+        // ee_info..ee_data is the range of completed send numbers
+        released += conn.zeroCopySends.complete(err->ee_data);
+        if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+          // The kernel had to copy anyway (e.g. loopback); stop paying for
+          // the notifications on this socket
+          conn.zeroCopyState = Connection::ZeroCopy::Disabled;
+        }
+      }
+    }
+    if (released > 0) {
+      conn.writeBuffer.releasePinned(released);
+      // Frames held back while the write buffer was pinned can go out now
+      if (!conn.readBuffer.empty() && !processInput(conn)) {
+        closeConnection(conn);
+        return;
+      }
+      flushOutput(conn);
+    }
+  }
+
+  /**
+   * Switches EPOLLOUT interest on or off, skipping redundant epoll_ctl calls
+   */
+  void armOutput(Connection &conn, bool armed) {
+    if (conn.outputArmed != armed) {
+      conn.outputArmed = armed;
+      setEpollEvents(conn, epollInterest(conn));
+    }
+  }
+
+  int epollInterest(const Connection &conn) const {
+    int events = 0;
+    if (!conn.readPaused && !draining) {
+      events |= EPOLLIN;
+    }
+    if (conn.outputArmed) {
+      events |= EPOLLOUT;
+    }
+    return events;
+  }
+
+  /**
+   * Applies the flow control policy once conn's unsent output has reached
+   * the high watermark
+   * @return false if the connection has to be closed as a slow consumer
+   */
+  bool checkBacklog(Connection &conn) {
+    if (conn.readPaused || conn.outputSize() < flowControl.highWatermark) {
+      return true;
+    }
+    if (flowControl.overflow == FlowControl::Overflow::Disconnect) {
+      LOG_WARN("Slow consumer, closing connection with {} bytes unsent "
+               "(fd={})",
+               conn.outputSize(), conn.fd);
+      metrics.slowConsumers.add();
+      return false;
+    }
+    LOG_DEBUG("Pausing reads with {} bytes unsent (fd={})", conn.outputSize(),
+              conn.fd);
+    metrics.readPauses.add();
+    conn.readPaused = true;
+    if (!ring) {
+      setEpollEvents(conn, epollInterest(conn));
+    } else if (conn.recvArmed) {
+      // The multishot recv is armed again on resume
+      cancelRecv(conn);
+    }
+    return true;
+  }
+
+  /**
+   * Cancels the multishot recv of an io_uring connection
+   * It ends with -ECANCELED; completions already queued still arrive.
+   */
+  void cancelRecv(Connection &conn) {
+    io_uring_sqe *sqe = ring->getSqe();
+    if (sqe == nullptr) {
+      // Held recvs keep a paused connection paused; moving or draining it
+      // gives up at its deadline
+      LOG_WARN("io_uring SQ full, recv not cancelled (fd={})", conn.fd);
+      return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = uringData(&conn, OP_RECV);
+    sqe->user_data = uringData(nullptr, OP_CANCEL);
+  }
+
+  /**
+   * Resumes reading from a paused epoll connection once its output is down
+   * to the low watermark
+   * Bytes and a shutdown that arrived while paused raise no new edge, so
+   * the socket is read until EAGAIN right away. Repeats while the output
+   * keeps draining completely.
+   */
+  void resumeEpoll(Connection &conn) {
+    while (conn.isOpen() && conn.readPaused && !draining &&
+           conn.outputSize() <= flowControl.lowWatermark) {
+      conn.readPaused = false;
+      setEpollEvents(conn, epollInterest(conn));
+      if (!processInput(conn)) {
+        closeConnection(conn);
+        return;
+      }
+      processFixStream(conn, true);
+      flushOutput(conn);
+    }
+  }
+
+  /**
+   * Sends all pending output of an epoll connection right away
+   *
+   * Everything queued since the last flush goes out in one writev (or
+   * zero-copy sendmsg), repeated until the buffer is empty. EPOLLOUT is
+   * only armed when the socket stops accepting data.
+   */
+  void flushOutput(Connection &conn) {
+    CircularBuffer &out = conn.writeBuffer;
+    while (conn.isOpen() && !out.empty()) {
+      bool zeroCopy = useZeroCopy(conn);
+      ssize_t sent = zeroCopy                 ? sendZeroCopy(conn)
+                     : conn.splices.empty() ? out.readToSocketV(conn.fd)
+                                            : sendSpliced(conn);
+      if (sent > 0) {
+        metrics.bytesOut.add(static_cast<uint64_t>(sent));
+        continue;
+      }
+      if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        armOutput(conn, true);
+        if (!checkBacklog(conn)) {
+          closeConnection(conn);
+        }
+        return;
+      }
+      if (sent == -1 && zeroCopy && errno == ENOBUFS) {
+        // Out of optmem for notifications, fall back to copying sends
+        conn.zeroCopyState = Connection::ZeroCopy::Disabled;
+        continue;
+      }
+      LOG_WARN("write failed (fd={}): {}", conn.fd, strerror(errno));
+      closeConnection(conn);
+      return;
+    }
+    if (conn.isOpen()) {
+      countFlushed(conn);
+      armOutput(conn, false);
+    }
+  }
+
+  /**
+   * Parses and handles every complete frame in the connection's read buffer
+   *
+   * Frames are parsed back to back from the read view into a batch of up to
+   * PARSE_BATCH, which is handled as a whole and released with a single
+   * consume, before the next batch is parsed. Shared by both I/O engines;
+   * the engine only moves bytes in and out.
+   * @param conn Connection whose readBuffer received new data
+   * @return false if the connection must be closed
+   */
+  bool processInput(Connection &conn) {
+    CircularBuffer &readBuffer = conn.readBuffer;
+    ParseResult result = ParseResult::FINISHED;
+    while (result == ParseResult::FINISHED) {
+      // Requests stay buffered while the client does not read its output
+      if (!checkBacklog(conn)) {
+        return false;
+      }
+      if (conn.readPaused) {
+        return true;
+      }
+      size_t start;
+      char *data;
+      size_t length;
+      if (!readBuffer.getReadView(start, data, length)) {
+        break;
+      }
+      size_t parsed = 0; // Bytes of the batch, discarded frames included
+      size_t count = 0;
+      size_t needed = 0; // Write space the responses may take
+      while (count < PARSE_BATCH) {
+        LOG_TRACE("Parsing FIX message...");
+        Message &message = batch[count];
+        result = Message::parseFixMessage(data + parsed, length - parsed,
+                                          message);
+        if (result == ParseResult::FINISHED) {
+          // The responses may need a larger write buffer, which cannot be
+          // swapped in while the kernel still sends from the current one.
+          // Leave the frame buffered until those sends complete.
+          needed += message.frameLength + RESPONSE_SLACK;
+          if (writeBusy(conn) && conn.writeBuffer.availableSpace() < needed) {
+            message.reset();
+            result = ParseResult::CONTINUE;
+            break;
+          }
+          parsed += message.frameLength;
+          ++count;
+          continue;
+        }
+        if (result == ParseResult::ERROR && message.frameLength != 0) {
+          LOG_WARN("Discarding invalid FIX message (fd={}, bytes={})",
+                   conn.fd, message.frameLength);
+          (message.badChecksum ? metrics.checksumErrors
+                               : metrics.invalidMessages)
+              .add();
+          parsed += message.frameLength;
+          message.reset();
+          result = ParseResult::FINISHED;
+          continue;
+        }
+        message.reset();
+        break;
+      }
 
-  // Prevent copying
-  WorkerThread(const WorkerThread &) = delete;
-  WorkerThread &operator=(const WorkerThread &) = delete;
+      if (count > 0) {
+        messageTick = MetricsClock::now();
+        metrics.messagesIn.add(count);
+        conn.recentMessages += count;
+        metrics.readToParse.record(messageTick - conn.readTick, count);
+        processBatch(conn, std::span<const Message>(batch.data(), count));
+        for (size_t i = 0; i < count; ++i) {
+          batch[i].reset();
+        }
+      }
+      // Releases the whole batch at once
+      readBuffer.consume(parsed);
+    }
+
+    if (result == ParseResult::ERROR) {
+      LOG_WARN("Garbled FIX stream, closing connection (fd={})", conn.fd);
+      metrics.garbledStreams.add();
+      return false;
+    }
+    // Only connections that actually fill their buffer move up a class
+    if (readBuffer.full() && !pool.grow(readBuffer)) {
+      LOG_WARN("Read buffer full without a complete frame (fd={})", conn.fd);
+      metrics.readBufferOverflows.add();
+      return false;
+    }
+    return true;
+  }
 
   /**
-   * Closes and cleans up a connection
-   * @param fd Socket file descriptor to close
+   * Captures the bytes the last read appended to the read buffer
+   * They are its newest bytes, in up to two segments when it wrapped.
    */
-  void closeConnection(int fd) {
-    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
-    close(fd);
-    connections.erase(fd);
+  void captureRead(Connection &conn, size_t bytes) {
+    iovec iov[2];
+    int count = conn.readBuffer.getReadSegments(iov);
+    std::string_view parts[2];
+    size_t found = 0;
+    for (int i = count - 1; i >= 0 && bytes > 0; --i) {
+      size_t take = std::min(bytes, iov[i].iov_len);
+      parts[1 - found++] = std::string_view(
+          static_cast<const char *>(iov[i].iov_base) + iov[i].iov_len - take,
+          take);
+      bytes -= take;
+    }
+    capture->append(conn.readTick, conn.fd,
+                    std::span<const std::string_view>(parts + 2 - found, found));
   }
 
   /**
-   * Updates epoll events for a file descriptor
-   * @param fd File descriptor to modify
-   * @param events New event mask
+   * Reads everything available on an epoll connection and processes it
+   *
+   * Every read is parsed and handled in full before the next one. A read
+   * that leaves buffer space unused has drained the socket, so the read
+   * that would only return EAGAIN is skipped: edge-triggered epoll reports
+   * the next arrival anyway. Once the peer has shut down, reading goes on
+   * until end of file, which arrives without a further event.
+   * @param conn Connection to read from
+   * @param peerClosed EPOLLRDHUP was reported with the event
    */
-  void setEpollEvents(int fd, int events) {
-    epoll_event event;
-    event.data.fd = fd;
-    event.events = events | EPOLLET;
-    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == -1) {
-      std::cerr << "epoll_ctl failed to modify event" << std::endl;
+  void processFixStream(Connection &conn, bool peerClosed) {
+    CircularBuffer &readBuffer = conn.readBuffer;
+    pool.ensureAllocated(readBuffer);
+
+    while (conn.isOpen() && !conn.readPaused) {
+      // Read socket data with improved error handling
+      size_t space = readBuffer.availableSpace();
+      ssize_t bytesRead = readBuffer.writeFromSocketV(conn.fd);
+      if (bytesRead < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return; // No more data available
+        }
+        LOG_ERROR("Fatal socket error: {}", strerror(errno));
+        closeConnection(conn);
+        return;
+      }
+      if (bytesRead == 0) {
+        LOG_INFO("Connection closed by peer (fd={}).", conn.fd);
+        closeConnection(conn);
+        return;
+      }
+      conn.lastActive = std::chrono::steady_clock::now();
+      conn.lastInTick = timers.now();
+      conn.readTick = MetricsClock::now();
+      metrics.bytesIn.add(static_cast<uint64_t>(bytesRead));
+      if (capture) {
+        captureRead(conn, static_cast<size_t>(bytesRead));
+      }
+
+      if (!processInput(conn)) {
+        closeConnection(conn);
+        return;
+      }
+      if (static_cast<size_t>(bytesRead) < space && !peerClosed) {
+        return;
+      }
     }
   }
 
   /**
-   * Processes a logon message and prepares response
-   * @param message Incoming FIX message
-   * @param conn Connection to write response to
+   * Resumes reading from a paused io_uring connection
+   * Bytes held in provided buffers are moved to the read buffer first,
+   * parsing in between when it has no room, and the recv is armed again
+   * once none are left. Stops early if the output fills up again.
+   */
+  void resumeUring(Connection &conn) {
+    conn.readPaused = false;
+    size_t released = 0;
+    while (released < conn.heldRecvs.size() && !conn.readPaused) {
+      auto [bid, length] = conn.heldRecvs[released];
+      if (!pool.ensureSpace(conn.readBuffer, length)) {
+        size_t before = conn.readBuffer.dataSize();
+        if (!processInput(conn)) {
+          break;
+        }
+        if (conn.readBuffer.dataSize() == before && !conn.readPaused) {
+          LOG_WARN("Read buffer full without a complete frame (fd={})",
+                   conn.fd);
+          metrics.readBufferOverflows.add();
+          break;
+        }
+        continue;
+      }
+      conn.readBuffer.writeFromBytes(ring->buffer(bid), length);
+      ring->recycleBuffer(bid);
+      ++released;
+    }
+    conn.heldRecvs.erase(conn.heldRecvs.begin(),
+                         conn.heldRecvs.begin() +
+                             static_cast<std::ptrdiff_t>(released));
+    if (!conn.readPaused && !conn.heldRecvs.empty()) {
+      closeConnection(conn);
+    } else if (!conn.readPaused && !conn.recvArmed && conn.migrateTo < 0) {
+      armRecv(conn);
+    }
+  }
+
+  /**
+   * Recycles a closing io_uring connection once no operation references it
+   */
+  void finishClose(Connection &conn) {
+    if (!conn.closing || conn.recvArmed || conn.sendsInFlight > 0) {
+      return;
+    }
+    conn.closing = false;
+    for (auto [bid, length] : conn.heldRecvs) {
+      ring->recycleBuffer(bid);
+    }
+    close(conn.fd);
+    pool.release(conn.readBuffer);
+    conn.splices.clear();
+    pool.release(conn.writeBuffer);
+    connections.close(conn);
+  }
+
+  static uint64_t uringData(Connection *conn, UringOp op) {
+    return reinterpret_cast<uint64_t>(conn) | op;
+  }
+
+  /**
+   * Arms a multishot recv that picks buffers from the provided buffer ring
+   */
+  void armRecv(Connection &conn) {
+    if (draining) {
+      return; // Draining connections are only written to
+    }
+    io_uring_sqe *sqe = ring->getSqe();
+    if (sqe == nullptr) {
+      LOG_WARN("io_uring SQ full, closing connection (fd={})", conn.fd);
+      closeConnection(conn);
+      return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn.fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = IoUring::BUFFER_GROUP;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = uringData(&conn, OP_RECV);
+    conn.recvArmed = true;
+  }
+
+  /**
+   * Returns an SQE for a worker-wide operation
+   * If the SQ is full, op is recorded and armed again by rearm() once the
+   * batch's completions were reaped.
    */
-  void processLogon(Connection &conn) {
-    Message &message = conn.message;
+  io_uring_sqe *workerSqe(UringOp op) {
+    io_uring_sqe *sqe = ring->getSqe();
+    if (sqe == nullptr) {
+      LOG_WARN("io_uring SQ full, arming operation {} later",
+               static_cast<unsigned>(op));
+      unarmed |= 1u << op;
+    }
+    return sqe;
+  }
+
+  void rearm() {
+    uint32_t ops = std::exchange(unarmed, 0);
+    if (ops & (1u << OP_ACCEPT)) {
+      armAccept();
+    }
+    if (ops & (1u << OP_CONTROL)) {
+      armControl();
+    }
+    if (ops & (1u << OP_TICK)) {
+      armTick();
+    }
+    if (ops & (1u << OP_TIMER)) {
+      armTimer();
+    }
+    if ((ops & (1u << OP_DRAIN)) && draining) {
+      armDrainTimeout();
+    }
+  }
+
+  void armAccept() {
+    io_uring_sqe *sqe = workerSqe(OP_ACCEPT);
+    if (sqe == nullptr) {
+      return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK;
+    sqe->user_data = uringData(nullptr, OP_ACCEPT);
+  }
+
+  // Commands and routed frames from other threads still ring the eventfd
+  void armControl() {
+    io_uring_sqe *sqe = workerSqe(OP_CONTROL);
+    if (sqe == nullptr) {
+      return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wakeup.fd();
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = uringData(nullptr, OP_CONTROL);
+  }
 
-    // Prepare response
-    conn.writeBuffer.writeFromString(Message::BeginString);
-    conn.writeBuffer.writeFromString(message.beginString);
-    conn.writeBuffer.writeFromByte(Message::SOH);
+  // Ticks of the session timers, read and counted by onTick()
+  void armTick() {
+    io_uring_sqe *sqe = workerSqe(OP_TICK);
+    if (sqe == nullptr) {
+      return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = tickTimer.fd();
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = uringData(nullptr, OP_TICK);
+  }
+
+  void armTimer() {
+    io_uring_sqe *sqe = workerSqe(OP_TIMER);
+    if (sqe == nullptr) {
+      return;
+    }
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&sweepInterval);
+    sqe->len = 1;
+    sqe->user_data = uringData(nullptr, OP_TIMER);
+  }
 
-    // BodyLength
-    conn.writeBuffer.writeFromString(Message::BodyLength);
-    conn.writeBuffer.writeFromString(message.bodyLength);
-    conn.writeBuffer.writeFromByte(Message::SOH);
+  // Ends the wait for completions at the drain deadline
+  void armDrainTimeout() {
+    auto left = std::max(std::chrono::nanoseconds(0),
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             drainDeadline - std::chrono::steady_clock::now()));
+    drainTimeout.tv_sec = left.count() / 1000000000;
+    drainTimeout.tv_nsec = left.count() % 1000000000;
+    io_uring_sqe *sqe = workerSqe(OP_DRAIN);
+    if (sqe == nullptr) {
+      return;
+    }
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&drainTimeout);
+    sqe->len = 1;
+    sqe->user_data = uringData(nullptr, OP_DRAIN);
+  }
 
-    // send Msgtype
-    conn.writeBuffer.writeFromString(Message::MsgType);
-    conn.writeBuffer.writeFromString(message.msgType);
-    conn.writeBuffer.writeFromByte(Message::SOH);
+  /**
+   * Queues the pending output of a connection as linked send SQEs
+   *
+   * Each contiguous segment of writeBuffer, and each shared frame spliced
+   * between them, becomes one send; the link keeps
+   * them in order and MSG_WAITALL makes a short send fail the chain rather
+   * than let a later segment overtake it. Large payloads use SEND_ZC. The
+   * sent bytes are consumed once the whole chain, including any zero-copy
+   * notifications, has completed, so anything cancelled is simply sent again
+   * and no byte is overwritten while the kernel may still read it.
+   */
+  void flushUring(Connection &conn) {
+    if (!conn.isOpen() || conn.closing || conn.sendsInFlight > 0 ||
+        conn.writeBuffer.empty()) {
+      return;
+    }
+    iovec segments[OUTPUT_SEGMENTS];
+    int count = conn.splices.gather(conn.writeBuffer, segments,
+                                    OUTPUT_SEGMENTS);
+    if (!ring->reserve(static_cast<unsigned>(count))) {
+      // The chain is linked, so all of it has to go into the SQ at once
+      LOG_WARN("io_uring SQ full, closing connection (fd={})", conn.fd);
+      closeConnection(conn);
+      return;
+    }
+    bool zeroCopy = useZeroCopy(conn);
+    for (int k = 0; k < count; ++k) {
+      io_uring_sqe *sqe = ring->getSqe();
+      sqe->opcode = zeroCopy ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+      sqe->fd = conn.fd;
+      sqe->addr = reinterpret_cast<uint64_t>(segments[k].iov_base);
+      sqe->len = static_cast<uint32_t>(segments[k].iov_len);
+      sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+      if (k + 1 < count) {
+        sqe->flags = IOSQE_IO_LINK;
+      }
+      sqe->user_data = uringData(&conn, OP_SEND);
+    }
+    conn.sendsInFlight = static_cast<uint32_t>(count);
+  }
 
-    // send SeqNumber
-    conn.writeBuffer.writeFromString(Message::SeqNumber);
-    conn.writeBuffer.writeFromString(message.seqNumber);
-    conn.writeBuffer.writeFromByte(Message::SOH);
+  void onRecv(Connection &conn, const io_uring_cqe &cqe) {
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+      conn.recvArmed = false;
+    }
+    uint16_t bid;
+    if (IoUring::bufferId(cqe, bid)) {
+      bool keep = true;
+      bool recycle = true;
+      if (!conn.closing && cqe.res > 0) {
+        size_t length = static_cast<size_t>(cqe.res);
+        conn.lastActive = std::chrono::steady_clock::now();
+        conn.lastInTick = timers.now();
+        conn.readTick = MetricsClock::now();
+        metrics.bytesIn.add(length);
+        if (capture) {
+          capture->append(conn.readTick, conn.fd,
+                          std::string_view(ring->buffer(bid), length));
+        }
+        if (conn.readPaused || !conn.heldRecvs.empty()) {
+          // Completions queued before the cancel took effect; the bytes wait
+          // unparsed, in the read buffer or in the provided buffer itself
+          if (conn.heldRecvs.empty() &&
+              pool.ensureSpace(conn.readBuffer, length)) {
+            conn.readBuffer.writeFromBytes(ring->buffer(bid), length);
+          } else if (conn.heldRecvs.size() < MAX_HELD_RECVS) {
+            conn.heldRecvs.emplace_back(bid, static_cast<uint32_t>(length));
+            recycle = false;
+          } else {
+            LOG_WARN("Paused connection keeps receiving (fd={})", conn.fd);
+            metrics.readBufferOverflows.add();
+            keep = false;
+          }
+        } else if (pool.ensureSpace(conn.readBuffer, length)) {
+          conn.readBuffer.writeFromBytes(ring->buffer(bid), length);
+          keep = processInput(conn);
+        } else {
+          LOG_WARN("Read buffer full without a complete frame (fd={})",
+                   conn.fd);
+          metrics.readBufferOverflows.add();
+          keep = false;
+        }
+      }
+      if (recycle) {
+        ring->recycleBuffer(bid);
+      }
+      if (!keep) {
+        closeConnection(conn);
+      }
+      flushUring(conn);
+    } else if (cqe.res == 0) {
+      if (!conn.closing) {
+        LOG_INFO("Connection closed by peer (fd={}).", conn.fd);
+      }
+      closeConnection(conn);
+    } else if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+      if (!conn.closing) {
+        LOG_ERROR("Fatal socket error: {}", strerror(-cqe.res));
+      }
+      closeConnection(conn);
+    }
+    // The kernel ends a multishot recv when it runs out of provided buffers
+    if (!conn.recvArmed && !conn.closing && conn.isOpen() &&
+        !conn.readPaused && conn.migrateTo < 0) {
+      armRecv(conn);
+    }
+    finishClose(conn);
+  }
 
-    // send SenderCompID
-    conn.writeBuffer.writeFromString(Message::SenderCompID);
-    conn.writeBuffer.writeFromString(message.targetCompID);
-    conn.writeBuffer.writeFromByte(Message::SOH);
+  void onSend(Connection &conn, const io_uring_cqe &cqe) {
+    if (cqe.flags & IORING_CQE_F_NOTIF) {
+      --conn.sendsInFlight; // SEND_ZC released its pages
+    } else {
+      if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        --conn.sendsInFlight; // No notification follows
+      }
+      if (cqe.res > 0) {
+        conn.sentBytes += static_cast<size_t>(cqe.res);
+        metrics.bytesOut.add(static_cast<uint64_t>(cqe.res));
+      } else if (cqe.res == -EINVAL &&
+                 conn.zeroCopyState == Connection::ZeroCopy::Enabled) {
+        // Kernel without SEND_ZC; the bytes are sent again as regular sends
+        conn.zeroCopyState = Connection::ZeroCopy::Disabled;
+      } else if (cqe.res < 0 && cqe.res != -ECANCELED && !conn.closing) {
+        LOG_WARN("write failed (fd={}): {}", conn.fd, strerror(-cqe.res));
+        closeConnection(conn);
+      }
+    }
+    if (conn.sendsInFlight > 0) {
+      return;
+    }
+    conn.splices.consume(conn.writeBuffer, conn.sentBytes);
+    conn.sentBytes = 0;
+    if (!conn.closing && conn.isOpen()) {
+      countFlushed(conn);
+      if (conn.readPaused &&
+          conn.outputSize() <= flowControl.lowWatermark) {
+        resumeUring(conn);
+      }
+      // Frames held back while the write buffer was busy can go out now
+      if (conn.isOpen() && !conn.closing && !conn.readBuffer.empty() &&
+          !processInput(conn)) {
+        closeConnection(conn);
+      }
+      flushUring(conn);
+    }
+    finishClose(conn);
+  }
 
-    // send TargetCompID
-    conn.writeBuffer.writeFromString(Message::TargetCompID);
-    conn.writeBuffer.writeFromString(message.senderCompID);
-    conn.writeBuffer.writeFromByte(Message::SOH);
+  void onCompletion(const io_uring_cqe &cqe) {
+    Connection *conn = reinterpret_cast<Connection *>(cqe.user_data & ~OP_MASK);
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+    switch (cqe.user_data & OP_MASK) {
+    case OP_RECV:
+      onRecv(*conn, cqe);
+      break;
+    case OP_SEND:
+      onSend(*conn, cqe);
+      break;
+    case OP_ACCEPT:
+      if (cqe.res >= 0) {
+        addConnection(cqe.res);
+      } else if (cqe.res != -EAGAIN && cqe.res != -ECONNABORTED) {
+        LOG_WARN("accept failed: {}", strerror(-cqe.res));
+      }
+      if (!more) {
+        armAccept();
+      }
+      break;
+    case OP_CONTROL:
+      drainInbox();
+      if (!more) {
+        armControl();
+      }
+      break;
+    case OP_TIMER:
+      trimIdleConnections();
+      armTimer();
+      break;
+    case OP_TICK:
+      onTick();
+      if (!more) {
+        armTick();
+      }
+      break;
+    case OP_CANCEL:
+      break; // The cancelled recv reports on its own
+    case OP_DRAIN:
+      break; // endBatch() finds the deadline passed
+    }
+  }
 
-    // send OtherFields
-    for (const auto &field : message.otherFields) {
-      conn.writeBuffer.writeFromString(field.first);
-      conn.writeBuffer.writeFromByte('=');
-      conn.writeBuffer.writeFromString(field.second);
-      conn.writeBuffer.writeFromByte(Message::SOH);
+  /**
+   * Stops pinning routing tables while the worker blocks for events
+   */
+  void goOffline() {
+    if (router != nullptr) {
+      router->offline(workerIndex);
     }
+  }
 
-    // checkSum
-    conn.writeBuffer.writeFromString(Message::CheckSum);
-    conn.writeBuffer.writeFromString(message.checkSum);
-    conn.writeBuffer.writeFromByte(Message::SOH);
+  /**
+   * Marks the start of an event batch, in which routing tables are read
+   */
+  void goOnline() {
+    if (router != nullptr) {
+      router->quiescent(workerIndex);
+    }
   }
 
   /**
-   * Processes different message types
-   * @param message Parsed FIX message
-   * @param conn Connection context
+   * Whether the worker is still inside the spin window of its last event
+   */
+  bool spinning() const {
+    return pollPolicy.spin.count() > 0 && !shutdownFlag &&
+           std::chrono::steady_clock::now() - lastEvent < pollPolicy.spin;
+  }
+
+  /**
+   * Longest blocking wait for epoll events, cut short by a drain deadline
+   */
+  int blockingTimeout() const {
+    if (!draining) {
+      return IDLE_SWEEP_MS;
+    }
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        drainDeadline - std::chrono::steady_clock::now());
+    return static_cast<int>(
+        std::clamp<int64_t>(left.count() + 1, 0, IDLE_SWEEP_MS));
+  }
+
+  /**
+   * Waits for epoll events, spinning first if the poll policy asks for it
+   * @return Number of events, -1 on error
+   */
+  int waitEpoll(epoll_event *events) {
+    goOffline();
+    int numEvents = 0;
+    while (numEvents == 0 && spinning()) {
+      numEvents = epoll_wait(epollFd, events, MAX_EVENTS, 0);
+    }
+    if (numEvents == 0) {
+      numEvents = epoll_wait(epollFd, events, MAX_EVENTS, blockingTimeout());
+    }
+    goOnline();
+    if (numEvents > 0) {
+      lastEvent = std::chrono::steady_clock::now();
+    }
+    return numEvents;
+  }
+
+  /**
+   * Submits queued SQEs and waits for completions, spinning first if the
+   * poll policy asks for it
    */
-  void processData(Connection &conn) {
-    // Beging String
-    if ("A" == conn.message.msgType) {
-      processLogon(conn);
+  void waitUring() {
+    goOffline();
+    bool ready = false;
+    while (!ready && spinning()) {
+      ready = ring->poll();
     }
+    // Without its control poll or timers armed the worker must not block
+    if (!ready && unarmed == 0) {
+      ring->submitAndWait(1);
+    }
+    goOnline();
+    lastEvent = std::chrono::steady_clock::now();
   }
 
   /**
-   * Processes incoming FIX stream with zero-copy parsing
-   * @param socketFd Socket file descriptor to read from
-   * @return true if a complete message was processed, false otherwise
-   * @throws runtime_error on critical errors
+   * io_uring event loop
+   * Falls back to epoll if the kernel lacks io_uring or one of the features
+   * used here (provided buffer rings need 5.19, multishot recv 6.0).
    */
-  bool processFixStream(int socketFd) {
-    auto connectionIt = connections.find(socketFd);
-    if (connectionIt == connections.end()) {
-      auto [it, inserted] = connections.try_emplace(socketFd, BUFSIZE);
-      if (!inserted) {
-        throw std::runtime_error("Failed to create connection");
+  void runUring() {
+    IoUring::Options options;
+    options.sqPoll = engine == IoEngineType::IoUringSqPoll;
+    try {
+      ring = std::make_unique<IoUring>(options);
+    } catch (const std::runtime_error &e) {
+      LOG_WARN("io_uring unavailable, using epoll: {}", e.what());
+      runEpoll();
+      return;
+    }
+
+    unarmed = 0;
+    armControl();
+    armTick();
+    if (listenFd != -1) {
+      armAccept();
+    }
+    armTimer();
+    while (!shutdownFlag && !stopped()) {
+      waitUring();
+      ring->forEachCqe([this](const io_uring_cqe &cqe) { onCompletion(cqe); });
+      endBatch();
+      if (unarmed != 0) {
+        rearm();
       }
-      connectionIt = it;
+      // Closing connections are only recycled after their last completion
+      connections.reclaim();
     }
 
-    CircularBuffer &readBuffer = connectionIt->second.readBuffer;
-    Message &message = connectionIt->second.message;
+    // Connections handed over meanwhile are closed with the others
+    if (router != nullptr) {
+      drainRouted();
+    }
+    // Tearing the ring down cancels everything still in flight
+    ring.reset();
+    connections.forEach([this](Connection &conn) { closeConnection(conn); });
+    connections.reclaim();
+    goOffline();
+  }
 
-    while (true) {
-      // Read socket data with improved error handling
-      ssize_t bytesRead = readBuffer.writeFromSocket(socketFd);
-      if (bytesRead < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-          return false; // No more data available
-        }
-        std::cerr << "Fatal socket error: " << strerror(errno) << std::endl;
-        closeConnection(socketFd);
-        return false;
+  /**
+   * epoll event loop
+   */
+  void runEpoll() {
+    while (!shutdownFlag && !stopped()) {
+      epoll_event events[MAX_EVENTS];
+      int numEvents = waitEpoll(events);
+      if (numEvents == -1 && errno == EINTR) {
+        continue;
       }
-      if (bytesRead == 0) {
-        std::cout << "Connection closed by peer." << std::endl;
-        closeConnection(socketFd);
-        return false;
+      if (numEvents == -1) {
+        LOG_ERROR("epoll_wait failed: {}", strerror(errno));
+        break;
       }
 
-      // Parse FIX messages
-      while (true) {
-        std::cout << "Parsing FIX message..." << std::endl;
-        switch (Message::parseFixMessage(readBuffer, message)) {
-        case ParseResult::FINISHED: {
-          // Debug logging for parsed message
-          std::cout << "Parsed FIX message:" << std::endl
-                    << "BeginString:" << message.beginString << std::endl
-                    << "BodyLength:" << message.bodyLength << std::endl
-                    << "CheckSum:" << message.checkSum << std::endl
-                    << "MsgType:" << message.msgType << std::endl
-                    << "SenderCompID:" << message.senderCompID << std::endl
-                    << "TargetCompID:" << message.targetCompID << std::endl
-                    << "ClordID:" << message.clOrdID << std::endl
-                    << "SeqNumber:" << message.seqNumber << std::endl
-                    << "Other fields:" << message.otherFields.size()
-                    << std::endl;
-          for (const auto &field : message.otherFields) {
-            std::cout << field.first << ":" << field.second << std::endl;
+      for (int i = 0; i < numEvents; ++i) {
+        if (events[i].data.ptr == &wakeup) {
+          drainInbox();
+        } else if (events[i].data.ptr == &tickTimer) {
+          onTick();
+        } else if (events[i].data.ptr == &listenFd) {
+          drainListener();
+        } else {
+          Connection &conn = *static_cast<Connection *>(events[i].data.ptr);
+          if ((events[i].events & EPOLLERR) &&
+              conn.zeroCopyState == Connection::ZeroCopy::Enabled) {
+            drainErrorQueue(conn);
+          }
+          if (events[i].events & (EPOLLIN | EPOLLRDHUP) && !draining) {
+            processFixStream(conn, events[i].events & EPOLLRDHUP);
+          }
+          // Responses of the whole read batch leave in one send, right away
+          if (conn.isOpen() && (events[i].events & EPOLLIN ||
+                                events[i].events & EPOLLOUT)) {
+            flushOutput(conn);
+          }
+          if (conn.readPaused) {
+            resumeEpoll(conn);
           }
-
-          // Process complete message
-          processData(connectionIt->second);
-          message.reset();
-          return true;
-        }
-        default:
-          return false;
         }
       }
+      endBatch();
+      // No pointer from this batch is used past this point
+      connections.reclaim();
+      trimIdleConnections();
+    }
+    // 关闭所有连接
+    if (router != nullptr) {
+      drainRouted();
     }
+    connections.forEach([this](Connection &conn) { closeConnection(conn); });
+    connections.reclaim();
+    goOffline();
   }
 
 public:
   /**
-   * Constructor initializes epoll and control pipe
+   * Constructor initializes epoll and the control queue
    * @param sf Reference to shutdown flag
+   * @param engineType Event loop used by run()
+   * @param zeroCopyMinBytes Smallest pending output sent with MSG_ZEROCOPY
+   * (SEND_ZC on io_uring), 0 disables zero-copy sends
    */
-  WorkerThread(std::atomic<bool> &sf) : shutdownFlag(sf) {
+  WorkerThread(std::atomic<bool> &sf,
+               IoEngineType engineType = IoEngineType::Epoll,
+               size_t zeroCopyMinBytes = 0)
+      : shutdownFlag(sf), pool(BufferPool::Options{4 * 1024, BUFSIZE}),
+        lastSweep(std::chrono::steady_clock::now()), engine(engineType),
+        zeroCopyThreshold(zeroCopyMinBytes) {
+    batch.resize(PARSE_BATCH);
     epollFd = epoll_create1(0);
     if (epollFd == -1) {
-      std::cerr << "epoll_create1 failed" << std::endl;
+      LOG_ERROR("epoll_create1 failed: {}", strerror(errno));
       exit(1);
     }
 
-    int pipeFds[2];
-    if (pipe(pipeFds) == -1) {
-      std::cerr << "pipe failed" << std::endl;
+    // Registrations without a Connection point at the worker's own member
+    epoll_event event;
+    event.data.ptr = &wakeup;
+    event.events = EPOLLIN | EPOLLET;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeup.fd(), &event) == -1) {
+      LOG_ERROR("epoll_ctl failed for eventfd: {}", strerror(errno));
+      exit(1);
+    }
+    event.data.ptr = &tickTimer;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, tickTimer.fd(), &event) == -1) {
+      LOG_ERROR("epoll_ctl failed for timerfd: {}", strerror(errno));
       exit(1);
     }
-    pipeReadFd = pipeFds[0];
-    pipeWriteFd = pipeFds[1];
+  }
+
+  // epoll registrations point into the worker, so it must not move
+  WorkerThread(WorkerThread &&) = delete;
+  WorkerThread &operator=(WorkerThread &&) = delete;
+
+  /**
+   * Hands client sockets over to this worker, callable from any thread
+   * Up to ControlMessage::MAX_FDS sockets go in one command, and the worker
+   * is woken once for the whole batch. A draining worker closes them.
+   * @param fds Non-blocking client sockets, owned by the worker once queued
+   * @return How many of fds, from the front, were queued; the control
+   * queue is full for the rest
+   */
+  size_t handOff(std::span<const int> fds) {
+    size_t queued = 0;
+    while (queued < fds.size()) {
+      ControlMessage message;
+      message.count = static_cast<uint8_t>(
+          std::min(fds.size() - queued, ControlMessage::MAX_FDS));
+      std::copy_n(fds.begin() + static_cast<std::ptrdiff_t>(queued),
+                  message.count, message.fds);
+      if (!control.tryPush(message)) {
+        break;
+      }
+      queued += message.count;
+    }
+    if (queued > 0) {
+      wakeup.notify();
+    }
+    return queued;
+  }
+
+  /**
+   * Hands a client socket over to this worker, callable from any thread
+   * @param fd Non-blocking client socket, owned by the worker on success
+   * @return false if the control queue is full
+   */
+  bool handOff(int fd) { return handOff(std::span<const int>(&fd, 1)) == 1; }
+
+  /**
+   * Moves one of this worker's connections to another, callable from any
+   * thread
+   *
+   * The worker stops reading from the connection and hands it over once
+   * nothing of it is in flight: no unsent output, outstanding send or
+   * receive, or pending resend. The fd, both buffers with whatever they
+   * hold, the journal and the session state move through the inter-worker
+   * channel, and the session is re-registered with the router; frames
+   * routed to its old address meanwhile are forwarded, in order, none
+   * dropped. Bytes the client sends meanwhile wait in the socket.
+   * Connections that do not settle within MIGRATE_TIMEOUT stay.
+   * @param to Index of the destination worker in the router
+   * @param fd Connection to move, -1 for the one that evens out the load
+   * @return false if the control queue is full
+   */
+  bool migrate(uint32_t to, int fd = -1) {
+    ControlMessage message;
+    message.type = ControlMessage::Type::Migrate;
+    message.worker = to;
+    message.fd = fd;
+    return command(message);
+  }
 
-    fcntl(pipeReadFd, F_SETFL, O_NONBLOCK);
+  /**
+   * Closes every connection once its output has gone out, callable from
+   * any thread
+   *
+   * The worker stops reading from its connections and refuses new ones
+   * until all are closed, then takes connections again. Input that arrives
+   * meanwhile is dropped. Connections whose output has not gone out by the
+   * deadline are closed with it unsent.
+   * @return false if the control queue is full
+   */
+  bool drain(std::chrono::steady_clock::time_point deadline) {
+    ControlMessage message;
+    message.type = ControlMessage::Type::Drain;
+    message.deadline = deadline;
+    return command(message);
+  }
+
+  /**
+   * Shuts the worker down gracefully, callable from any thread
+   * Drains it as drain() does, and run() returns once no connection is left
+   * or at the deadline. The shutdown flag still stops the worker at once.
+   * @return false if the control queue is full
+   */
+  bool stop(std::chrono::steady_clock::time_point deadline) {
+    ControlMessage message;
+    message.type = ControlMessage::Type::Shutdown;
+    message.deadline = deadline;
+    return command(message);
+  }
 
+  /**
+   * Makes the worker accept directly on its own listening socket
+   * Must be called before run(). The socket stays owned by the caller.
+   * @param fd Non-blocking listening socket
+   */
+  void addListener(int fd) {
+    listenFd = fd;
     epoll_event event;
-    event.data.fd = pipeReadFd;
+    event.data.ptr = &listenFd;
     event.events = EPOLLIN | EPOLLET;
-    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, pipeReadFd, &event) == -1) {
-      std::cerr << "epoll_ctl failed for pipe" << std::endl;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == -1) {
+      LOG_ERROR("epoll_ctl failed for listener: {}", strerror(errno));
       exit(1);
     }
   }
 
-  // Support move operations
-  WorkerThread(WorkerThread &&) = default;            // 移动构造函数（可选）
-  WorkerThread &operator=(WorkerThread &&) = default; // 移动赋值运算符
+  /**
+   * Enables routing between the sessions of all workers sharing router
+   * Must be called before run(). The router must outlive the worker.
+   * @param sharedRouter Routing state shared by the workers
+   * @param index Index of this worker, below sharedRouter.workers()
+   */
+  void attachRouter(Router &sharedRouter, uint32_t index) {
+    router = &sharedRouter;
+    workerIndex = index;
+    router->attachWorker(index, wakeup);
+  }
 
-  int getPipeWriteFd() const { return pipeWriteFd; }
+  /**
+   * Selects how the worker waits for events
+   * Must be called before run().
+   */
+  void setPollPolicy(const PollPolicy &policy) { pollPolicy = policy; }
 
   /**
-   * Main worker loop
-   * Handles epoll events and processes messages
+   * Selects how slow consumers are handled
+   * Must be called before run().
    */
-  void run() {
-    while (!shutdownFlag) {
-      epoll_event events[MAX_EVENTS];
-      int numEvents = epoll_wait(epollFd, events, MAX_EVENTS, -1);
-      if (numEvents == -1) {
-        std::cerr << "epoll_wait failed" << std::endl;
-        break;
-      }
+  void setFlowControl(const FlowControl &policy) { flowControl = policy; }
 
-      for (int i = 0; i < numEvents; ++i) {
-        if (events[i].data.fd == pipeReadFd) {
-          int newFd;
-          ssize_t bytesRead = read(pipeReadFd, &newFd, sizeof(newFd));
-          if (bytesRead == sizeof(newFd)) {
-            auto connectionIt = connections.find(newFd);
-            if (connectionIt == connections.end()) {
-              auto [it, inserted] = connections.try_emplace(newFd, BUFSIZE);
-              connectionIt = it;
-            }
-            epoll_event event;
-            event.data.fd = newFd;
-            event.events = EPOLLIN | EPOLLET;
-            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, newFd, &event) == -1) {
-              std::cerr << "epoll_ctl failed for new connection" << std::endl;
-              close(newFd);
-              continue;
-            }
-          } else if (bytesRead == -1 && errno != EAGAIN) {
-            std::cerr << "read from pipe failed" << std::endl;
-          }
-        } else {
-          int fd = events[i].data.fd;
-          if (events[i].events & EPOLLIN) {
-            Connection &conn = connections.at(fd);
-            while (processFixStream(fd)) {
-            }
-            if (!conn.writeBuffer.empty()) {
-              setEpollEvents(fd, EPOLLIN | EPOLLOUT);
-            } else {
-              setEpollEvents(fd, EPOLLIN);
-            }
-          }
-          if (events[i].events & EPOLLOUT) {
-            Connection &conn = connections.at(fd);
-            while (!conn.writeBuffer.empty()) {
-              ssize_t bytesWritten = conn.writeBuffer.readToSocket(fd);
-              if (bytesWritten > 0) {
-                break;
-              } else if (bytesWritten == -1 &&
-                         (errno == EAGAIN || EWOULDBLOCK)) {
-                break;
-              } else {
-                std::cerr << "write failed" << std::endl;
-                closeConnection(fd);
-                break;
-              }
-            }
-            if (conn.writeBuffer.empty()) {
-              setEpollEvents(fd, EPOLLIN);
-            }
-          }
+  /**
+   * Sets the timer resolution and idle timeout
+   * Must be called before run(). The resolution is at least 1 ms.
+   */
+  void setSessionTimers(const SessionTimers &options) {
+    sessionTimers = options;
+    sessionTimers.resolution =
+        std::max(sessionTimers.resolution, std::chrono::milliseconds(1));
+    idleTicks = options.idleTimeout.count() > 0 ? toTicks(options.idleTimeout)
+                                                : 0;
+  }
+
+  /**
+   * Journals the outbound frames of every session for resends and restarts
+   * Must be called before run(). An empty directory leaves journaling off.
+   */
+  void setJournal(const JournalOptions &options) { journalOptions = options; }
+
+  /**
+   * Captures the raw input of every connection to a ring file for replays
+   * Must be called before run(). An empty directory leaves capture off, and
+   * a file that cannot be created only logs a warning.
+   * @param index Names the file, unique among the workers of a server
+   */
+  void setCapture(const CaptureOptions &options, uint32_t index) {
+    capture.reset();
+    if (options.directory.empty()) {
+      return;
+    }
+    try {
+      capture = std::make_unique<CaptureLog>(options, index,
+                                             MetricsClock::nsPerTick());
+    } catch (const std::exception &e) {
+      LOG_WARN("Worker {} runs without capture: {}", index, e.what());
+    }
+  }
+
+  /**
+   * Feeds one captured read through the parser and handlers, without sockets
+   *
+   * Called instead of run(), from one thread, record by record. A captured
+   * connection seen for the first time is opened on /dev/null, which takes
+   * and discards all of its output, so logons, routing between replayed
+   * sessions, journaling and the gathering writes run as they did live.
+   * Session timers do not advance.
+   * @param capturedFd Connection of the record
+   * @param bytes The bytes read, empty when the connection was closed
+   * @return false if no connection could be opened for the record
+   */
+  bool replay(int capturedFd, std::string_view bytes) {
+    Connection *conn = nullptr;
+    auto found = replayFds.find(capturedFd);
+    if (found != replayFds.end()) {
+      conn = connections.get(found->second);
+    }
+    if (bytes.empty()) {
+      if (conn != nullptr) {
+        closeConnection(*conn);
+      }
+      replayFds.erase(capturedFd);
+    } else {
+      if (conn == nullptr && (conn = openReplayed(capturedFd)) == nullptr) {
+        return false;
+      }
+      conn->lastActive = std::chrono::steady_clock::now();
+      conn->lastInTick = timers.now();
+      conn->readTick = MetricsClock::now();
+      metrics.bytesIn.add(bytes.size());
+      bool keep = pool.ensureSpace(conn->readBuffer, bytes.size());
+      if (keep) {
+        conn->readBuffer.writeFromBytes(bytes.data(), bytes.size());
+        keep = processInput(*conn);
+        // Output never backs up on /dev/null, so a pause ends at once
+        while (keep && conn->isOpen() && conn->readPaused) {
+          flushOutput(*conn);
+          conn->readPaused = false;
+          keep = processInput(*conn);
         }
+      } else {
+        metrics.readBufferOverflows.add();
+      }
+      if (!keep) {
+        closeConnection(*conn);
+      } else if (conn->isOpen()) {
+        flushOutput(*conn);
       }
     }
-    // 关闭所有连接
-    for (const auto &pair : connections) {
-      closeConnection(pair.first);
+    endBatch();
+    connections.reclaim();
+    return true;
+  }
+
+  /**
+   * Closes every connection opened by replay(), as at the end of a capture
+   */
+  void endReplay() {
+    for (auto [capturedFd, fd] : replayFds) {
+      if (Connection *conn = connections.get(fd)) {
+        closeConnection(*conn);
+      }
+    }
+    replayFds.clear();
+    endBatch();
+    connections.reclaim();
+  }
+
+  /**
+   * Wakes the worker from a blocking wait, callable from any thread
+   * Used after setting the shutdown flag, so workers exit right away.
+   */
+  void wake() { wakeup.notify(); }
+
+  /**
+   * Counters and latency histograms of this worker, readable from any thread
+   * Latencies are in MetricsClock ticks.
+   */
+  const WorkerMetrics &getMetrics() const { return metrics; }
+
+  /**
+   * Main worker loop
+   * Handles socket events with the selected engine and processes messages
+   */
+  void run() {
+    if (engine == IoEngineType::Epoll) {
+      runEpoll();
+    } else {
+      runUring();
     }
   }
-};
\ No newline at end of file
+};
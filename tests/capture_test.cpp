@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include "../src/capture.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class CaptureTest : public ::testing::Test {
+protected:
+    std::string directory;
+    CaptureOptions options;
+
+    CaptureTest() {
+        char path[] = "/tmp/capture_test.XXXXXX";
+        directory = mkdtemp(path);
+        options.directory = directory;
+        options.ringBytes = CaptureLog::MIN_RING_BYTES;
+    }
+    ~CaptureTest() override { std::filesystem::remove_all(directory); }
+
+    struct Read {
+        uint64_t ticks;
+        int fd;
+        std::string bytes;
+    };
+
+    std::vector<Read> readBack(const std::string &path, bool *intact = nullptr) {
+        CaptureFile file(path);
+        std::vector<Read> reads;
+        bool complete = file.forEach(
+            [&](const CaptureRecord &record, std::string_view bytes) {
+                reads.push_back(Read{record.ticks, record.fd, std::string(bytes)});
+            });
+        if (intact != nullptr) {
+            *intact = complete;
+        }
+        return reads;
+    }
+};
+
+TEST_F(CaptureTest, ReadsBackRecordsInOrder) {
+    CaptureLog log(options, 3, 0.5);
+    EXPECT_EQ(log.path(), directory + "/worker-3.capture");
+    log.append(100, 7, "8=FIX.4.2\x01");
+    std::string_view parts[] = {"9=5", "\x01" "35=0"};
+    log.append(101, 8, std::span<const std::string_view>(parts));
+    log.closed(102, 7);
+
+    CaptureFile file(log.path());
+    EXPECT_DOUBLE_EQ(file.nsPerTick(), 0.5);
+    bool intact = false;
+    std::vector<Read> reads = readBack(log.path(), &intact);
+    EXPECT_TRUE(intact);
+    ASSERT_EQ(reads.size(), 3u);
+    EXPECT_EQ(reads[0].ticks, 100u);
+    EXPECT_EQ(reads[0].fd, 7);
+    EXPECT_EQ(reads[0].bytes, "8=FIX.4.2\x01");
+    EXPECT_EQ(reads[1].bytes, "9=5\x01" "35=0");
+    EXPECT_EQ(reads[2].fd, 7);
+    EXPECT_TRUE(reads[2].bytes.empty()); // The close
+}
+
+TEST_F(CaptureTest, AllocatesTheRingUpFront) {
+    CaptureLog log(options, 0, 1.0);
+    // No holes, so appends through the mapping never need a new block
+    struct stat info;
+    ASSERT_EQ(stat(log.path().c_str(), &info), 0);
+    size_t bytes = CaptureFileHeader::SIZE + CaptureLog::MIN_RING_BYTES;
+    EXPECT_EQ(static_cast<size_t>(info.st_size), bytes);
+    EXPECT_GE(static_cast<size_t>(info.st_blocks) * 512, bytes);
+}
+
+TEST_F(CaptureTest, KeepsTheNewestReadsWhenTheRingWraps) {
+    CaptureLog log(options, 0, 1.0);
+    // Odd sizes, so records end anywhere and the ring wraps mid-page
+    constexpr size_t READS = 300;
+    for (size_t i = 0; i < READS; ++i) {
+        std::string bytes(50000 + i * 37, static_cast<char>('a' + i % 26));
+        ASSERT_TRUE(log.append(i, static_cast<int>(i % 5), bytes));
+    }
+
+    std::vector<Read> reads = readBack(log.path());
+    ASSERT_FALSE(reads.empty());
+    ASSERT_LT(reads.size(), READS);
+    EXPECT_EQ(reads.back().ticks, READS - 1);
+    size_t held = 0;
+    for (size_t i = 0; i < reads.size(); ++i) {
+        uint64_t index = reads.front().ticks + i;
+        EXPECT_EQ(reads[i].ticks, index); // No gaps
+        EXPECT_EQ(reads[i].bytes,
+                  std::string(50000 + index * 37,
+                              static_cast<char>('a' + index % 26)));
+        held += CaptureLog::recordSize(reads[i].bytes.size());
+    }
+    EXPECT_LE(held, CaptureLog::MIN_RING_BYTES);
+    // Only as much as the next read is dropped
+    EXPECT_GT(held + CaptureLog::recordSize(50000 + READS * 37) * 2,
+              CaptureLog::MIN_RING_BYTES);
+}
+
+TEST_F(CaptureTest, DropsReadsTooLargeForTheRing) {
+    CaptureLog log(options, 0, 1.0);
+    EXPECT_FALSE(log.append(1, 4, std::string(CaptureLog::MIN_RING_BYTES, 'x')));
+    EXPECT_EQ(log.dropped(), 1u);
+    EXPECT_TRUE(log.append(2, 4, "fits"));
+    std::vector<Read> reads = readBack(log.path());
+    ASSERT_EQ(reads.size(), 1u);
+    EXPECT_EQ(reads[0].bytes, "fits");
+}
+
+TEST_F(CaptureTest, RejectsOtherFiles) {
+    std::string path = directory + "/other";
+    FILE *file = std::fopen(path.c_str(), "w");
+    std::string junk(8192, 'x');
+    std::fwrite(junk.data(), 1, junk.size(), file);
+    std::fclose(file);
+    EXPECT_THROW(CaptureFile{path}, std::runtime_error);
+    EXPECT_THROW(CaptureFile{directory + "/missing"}, std::runtime_error);
+}
@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include "../src/channel.h"
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(ChannelTest, SpscRingKeepsRecordsContiguousAcrossWrap) {
+    SpscRing ring(256);
+    std::string_view record;
+    // Records of 8 + 40 bytes leave 16 bytes at the end after five rounds
+    for (int round = 0; round < 20; ++round) {
+        std::string payload(40, static_cast<char>('a' + round % 26));
+        ASSERT_TRUE(ring.push(payload)) << round;
+        ASSERT_TRUE(ring.front(record));
+        EXPECT_EQ(record, payload);
+        ring.pop();
+    }
+    EXPECT_FALSE(ring.front(record));
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(ChannelTest, SpscRingRejectsWhenFull) {
+    SpscRing ring(256);
+    EXPECT_EQ(ring.reserve(ring.maxRecord() + 1), nullptr);
+    size_t pushed = 0;
+    while (ring.push(std::string(56, 'x'))) {
+        ++pushed;
+    }
+    EXPECT_EQ(pushed, 4u); // 64 bytes per record
+
+    std::string_view record;
+    ASSERT_TRUE(ring.front(record));
+    ring.pop();
+    EXPECT_TRUE(ring.push(std::string(56, 'y')));
+}
+
+TEST(ChannelTest, SpscRingTransfersInOrderBetweenThreads) {
+    SpscRing ring(4096);
+    constexpr int COUNT = 200000;
+    std::jthread producer([&]() {
+        for (int i = 0; i < COUNT; ++i) {
+            std::string payload = std::to_string(i);
+            payload.resize(1 + i % 100, '.');
+            while (!ring.push(payload)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (int i = 0; i < COUNT;) {
+        std::string_view record;
+        if (!ring.front(record)) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::string expected = std::to_string(i);
+        expected.resize(1 + i % 100, '.');
+        ASSERT_EQ(record, expected);
+        ring.pop();
+        ++i;
+    }
+}
+
+TEST(ChannelTest, MpscQueueDeliversEveryValueOncePerProducerOrder) {
+    MpscQueue<uint64_t> queue(1024);
+    constexpr uint64_t PRODUCERS = 4;
+    constexpr uint64_t PER_PRODUCER = 100000;
+    std::vector<std::jthread> producers;
+    for (uint64_t p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (uint64_t i = 0; i < PER_PRODUCER; ++i) {
+                while (!queue.tryPush(p << 32 | i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    std::vector<uint64_t> next(PRODUCERS, 0);
+    for (uint64_t received = 0; received < PRODUCERS * PER_PRODUCER;) {
+        uint64_t value;
+        if (!queue.tryPop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t producer = value >> 32;
+        ASSERT_LT(producer, PRODUCERS);
+        ASSERT_EQ(value & 0xffffffff, next[producer]);
+        ++next[producer];
+        ++received;
+    }
+    uint64_t value;
+    EXPECT_FALSE(queue.tryPop(value));
+}
+
+TEST(ChannelTest, MpscQueueRejectsWhenFull) {
+    MpscQueue<int> queue(4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.tryPush(i));
+    }
+    EXPECT_FALSE(queue.tryPush(4));
+    int value;
+    ASSERT_TRUE(queue.tryPop(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(queue.tryPush(4));
+}
+
+TEST(ChannelTest, EventSignalWritesOnlyOnTransition) {
+    EventSignal signal;
+    pollfd pfd{signal.fd(), POLLIN, 0};
+    EXPECT_EQ(poll(&pfd, 1, 0), 0);
+
+    signal.notify();
+    signal.notify();
+    uint64_t count = 0;
+    ASSERT_EQ(read(signal.fd(), &count, sizeof(count)),
+              static_cast<ssize_t>(sizeof(count)));
+    EXPECT_EQ(count, 1u);
+
+    // Still pending until the consumer clears it
+    signal.notify();
+    EXPECT_EQ(poll(&pfd, 1, 0), 0);
+    signal.clear();
+    signal.notify();
+    EXPECT_EQ(poll(&pfd, 1, 0), 1);
+}
+
+TEST(ChannelTest, MpscByteRingPeeksBatchAcrossWrap) {
+    MpscByteRing ring(256);
+    EXPECT_FALSE(ring.push(std::string(ring.maxRecord() + 1, 'x')));
+    std::string_view records[4];
+    // Records of 8 + 48 bytes wrap in the second round
+    for (int round = 0; round < 10; ++round) {
+        std::string first(48, static_cast<char>('a' + round));
+        std::string second(48, static_cast<char>('A' + round));
+        ASSERT_TRUE(ring.push(first)) << round;
+        ASSERT_TRUE(ring.push(second)) << round;
+        ASSERT_EQ(ring.peek(records, 4), 2u);
+        EXPECT_EQ(records[0], first);
+        EXPECT_EQ(records[1], second);
+        ring.pop(2);
+    }
+    EXPECT_TRUE(ring.empty());
+    EXPECT_EQ(ring.peek(records, 4), 0u);
+}
+
+TEST(ChannelTest, MpscByteRingRejectsWhenFull) {
+    MpscByteRing ring(256);
+    size_t pushed = 0;
+    while (ring.push(std::string(56, 'x'))) {
+        ++pushed;
+    }
+    EXPECT_EQ(pushed, 4u); // 64 bytes per record
+
+    ring.pop();
+    EXPECT_TRUE(ring.push(std::string(56, 'y')));
+}
+
+TEST(ChannelTest, MpscByteRingKeepsRecordsIntactPerProducerOrder) {
+    MpscByteRing ring(4096);
+    constexpr int PRODUCERS = 4;
+    constexpr int PER_PRODUCER = 50000;
+    std::vector<std::jthread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&ring, p]() {
+            for (int i = 0; i < PER_PRODUCER; ++i) {
+                std::string payload = std::to_string(p) + ":" +
+                                      std::to_string(i) + ":";
+                payload.resize(payload.size() + i % 90,
+                               static_cast<char>('a' + p));
+                while (!ring.push(payload)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    std::vector<int> next(PRODUCERS, 0);
+    std::string_view records[16];
+    for (int received = 0; received < PRODUCERS * PER_PRODUCER;) {
+        size_t count = ring.peek(records, 16);
+        if (count == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t r = 0; r < count; ++r) {
+            int p = records[r][0] - '0';
+            ASSERT_GE(p, 0);
+            ASSERT_LT(p, PRODUCERS);
+            std::string expected = std::to_string(p) + ":" +
+                                   std::to_string(next[p]) + ":";
+            expected.resize(expected.size() + next[p] % 90,
+                            static_cast<char>('a' + p));
+            ASSERT_EQ(records[r], expected);
+            ++next[p];
+        }
+        ring.pop(count);
+        received += static_cast<int>(count);
+    }
+    EXPECT_TRUE(ring.empty());
+}
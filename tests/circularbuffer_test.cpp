@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include "../src/bufferpool.h"
 #include "../src/circularbuffer.h"
 #include <string>
 
@@ -13,4 +14,118 @@ TEST_F(CircularBufferTest, Constructor) {
     EXPECT_NO_THROW({
         CircularBuffer buffer(1024);
     });
-}
\ No newline at end of file
+}
+
+TEST_F(CircularBufferTest, MirroredCapacityRoundedToPage) {
+    CircularBuffer buffer(100, BufferMode::Mirrored);
+    EXPECT_TRUE(buffer.isMirrored());
+    EXPECT_EQ(buffer.capacity() % static_cast<size_t>(sysconf(_SC_PAGESIZE)), 0u);
+    EXPECT_GE(buffer.capacity(), 100u);
+}
+
+TEST_F(CircularBufferTest, MirroredViewSpansWrap) {
+    CircularBuffer buffer(4096, BufferMode::Mirrored);
+    const size_t capacity = buffer.capacity();
+
+    // Move head and tail close to the end of the ring
+    std::string filler(capacity - 10, 'x');
+    ASSERT_EQ(buffer.writeFromString(filler), static_cast<ssize_t>(filler.size()));
+    buffer.consume(filler.size());
+
+    std::string payload = "8=FIX.4.2\x01" "9=5\x01" "35=A\x01";
+    ASSERT_EQ(buffer.writeFromString(payload), static_cast<ssize_t>(payload.size()));
+
+    size_t start;
+    char *data;
+    size_t length;
+    ASSERT_TRUE(buffer.getReadView(start, data, length));
+    EXPECT_EQ(start, capacity - 10);
+    EXPECT_EQ(length, payload.size());
+    EXPECT_EQ(std::string(data, length), payload);
+}
+
+TEST_F(CircularBufferTest, HeapViewStopsAtWrap) {
+    CircularBuffer buffer(64);
+    std::string filler(60, 'x');
+    buffer.writeFromString(filler);
+    buffer.consume(filler.size());
+    buffer.writeFromString("abcd");
+    buffer.writeFromString("efgh");
+
+    size_t start;
+    char *data;
+    size_t length;
+    ASSERT_TRUE(buffer.getReadView(start, data, length));
+    EXPECT_EQ(length, 4u);
+    EXPECT_EQ(buffer.dataSize(), 8u);
+}
+
+TEST_F(CircularBufferTest, ScatterGatherAcrossWrap) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    CircularBuffer buffer(64);
+    std::string filler(60, 'x');
+    buffer.writeFromString(filler);
+    buffer.consume(filler.size());
+
+    // 12 bytes land as 4 at the end of the ring and 8 at the start
+    std::string payload = "0123456789ab";
+    ASSERT_EQ(write(fds[0], payload.data(), payload.size()),
+              static_cast<ssize_t>(payload.size()));
+    EXPECT_EQ(buffer.writeFromSocketV(fds[1]),
+              static_cast<ssize_t>(payload.size()));
+    EXPECT_EQ(buffer.dataSize(), payload.size());
+
+    iovec iov[2];
+    EXPECT_EQ(buffer.getReadSegments(iov), 2);
+
+    EXPECT_EQ(buffer.readToSocketV(fds[1]), static_cast<ssize_t>(payload.size()));
+    EXPECT_TRUE(buffer.empty());
+
+    char received[16] = {};
+    ASSERT_EQ(read(fds[0], received, sizeof(received)),
+              static_cast<ssize_t>(payload.size()));
+    EXPECT_EQ(std::string(received, payload.size()), payload);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_F(CircularBufferTest, PoolGrowKeepsDataAndRecyclesBuffers) {
+    BufferPool pool;
+    CircularBuffer buffer;
+    EXPECT_EQ(buffer.capacity(), 0u);
+
+    pool.ensureAllocated(buffer);
+    EXPECT_EQ(buffer.capacity(), pool.minSize());
+
+    // Wrap the data before growing so the transfer has to stitch both halves
+    std::string filler(buffer.capacity() - 10, 'x');
+    buffer.writeFromString(filler);
+    buffer.consume(filler.size());
+    std::string payload(100, 'p');
+    buffer.writeFromString(payload);
+
+    ASSERT_TRUE(pool.grow(buffer));
+    EXPECT_EQ(buffer.capacity(), pool.minSize() * 4);
+    size_t start;
+    char *data;
+    size_t length;
+    ASSERT_TRUE(buffer.getReadView(start, data, length));
+    EXPECT_EQ(std::string(data, length), payload);
+    EXPECT_EQ(pool.cachedBytes(), pool.minSize());
+
+    // The small buffer released by grow() is handed out again
+    CircularBuffer reused = pool.acquire(1);
+    EXPECT_EQ(reused.capacity(), pool.minSize());
+    EXPECT_TRUE(reused.empty());
+    EXPECT_EQ(pool.cachedBytes(), 0u);
+
+    EXPECT_FALSE(pool.trim(buffer));
+    buffer.consume(payload.size());
+    EXPECT_TRUE(pool.trim(buffer));
+    EXPECT_EQ(buffer.capacity(), 0u);
+    EXPECT_TRUE(pool.ensureSpace(buffer, pool.maxSize()));
+    EXPECT_FALSE(pool.grow(buffer));
+}
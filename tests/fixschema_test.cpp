@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include "../src/fixencoder.h"
+#include "../src/fixschema.h"
+#include <string>
+
+namespace {
+
+std::string frame(std::string_view msgType, auto &&fields) {
+    FixSessionHeader header("FIX.4.2", "CLIENT", "SERVER");
+    std::string out(1024, '\0');
+    FixEncoder encoder(out.data(), out.size());
+    encoder.begin(header, msgType, 7);
+    fields(encoder);
+    out.resize(encoder.finish());
+    return out;
+}
+
+std::string order() {
+    return frame("D", [](FixEncoder &e) {
+        e.field(52, "20240115-13:45:30.123")
+            .field(11, "ORD-1")
+            .field(55, "AAPL")
+            .field(54, "2")
+            .field(38, "100")
+            .field(44, "187.25")
+            .field(5001, "ignored")
+            .field(44, "999");
+    });
+}
+
+template <typename T> std::optional<T> parsed(std::string_view text) {
+    T value{};
+    if (!FixValue<T>::parse(text, value)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+template <typename... F> struct Overloaded : F... {
+    using F::operator()...;
+};
+template <typename... F> Overloaded(F...) -> Overloaded<F...>;
+
+using NewOrderSingle = FixSchema<"D", fix::ClOrdID, fix::Side, fix::OrderQty,
+                                 fix::Price, fix::TimeInForce>;
+using Heartbeat = FixSchema<"0", fix::TestReqID>;
+using Logon = FixSchema<"A", fix::HeartBtInt, fix::ResetSeqNumFlag>;
+using ExecutionReport = FixSchema<"8", fix::ClOrdID>;
+using PositionReport = FixSchema<"AP", fix::Symbol>;
+
+} // namespace
+
+TEST(FixValueTest, ParsesDecimalsExactly) {
+    EXPECT_EQ(parsed<FixDecimal>("187.25")->units, 18725000000);
+    EXPECT_EQ(parsed<FixDecimal>("-0.5")->units, -50000000);
+    EXPECT_EQ(parsed<FixDecimal>("7")->units, 7 * FixDecimal::ONE);
+    EXPECT_EQ(parsed<FixDecimal>(".00000001")->units, 1);
+    EXPECT_EQ(parsed<FixDecimal>("9999999999.99999999")->units,
+              999999999999999999);
+    EXPECT_EQ(*parsed<FixDecimal>("0.1"), *parsed<FixDecimal>("0.10000"));
+    for (const char *bad : {"", "-", ".", "1.000000001", "12345678901", "1e5",
+                            "1.2.3", "+1", " 1"}) {
+        EXPECT_FALSE(parsed<FixDecimal>(bad)) << bad;
+    }
+}
+
+TEST(FixValueTest, ParsesUtcTimestamps) {
+    EXPECT_EQ(parsed<FixTimestamp>("19700101-00:00:00")->nanos, 0);
+    EXPECT_EQ(parsed<FixTimestamp>("20240115-13:45:30")->nanos,
+              1705326330LL * 1000000000);
+    EXPECT_EQ(parsed<FixTimestamp>("20240115-13:45:30.123")->nanos,
+              1705326330LL * 1000000000 + 123000000);
+    EXPECT_EQ(parsed<FixTimestamp>("20240115-13:45:30.123456")->nanos,
+              1705326330LL * 1000000000 + 123456000);
+    EXPECT_EQ(parsed<FixTimestamp>("20000229-23:59:59.000000001")->nanos,
+              951868799LL * 1000000000 + 1);
+    for (const char *bad :
+         {"", "20240115", "20240115 13:45:30", "20241315-13:45:30",
+          "20240115-24:00:00", "20240115-13:45:30.1", "20240115-13:45:30.",
+          "2024011a-13:45:30", "20240115-13:45:30.1234"}) {
+        EXPECT_FALSE(parsed<FixTimestamp>(bad)) << bad;
+    }
+}
+
+TEST(FixValueTest, ParsesIntegersFlagsAndChars) {
+    EXPECT_EQ(parsed<int64_t>("42"), 42);
+    EXPECT_EQ(parsed<int64_t>("-3"), -3);
+    EXPECT_FALSE(parsed<int64_t>(""));
+    EXPECT_FALSE(parsed<int64_t>("12x"));
+    EXPECT_FALSE(parsed<int64_t>("99999999999999999999"));
+    EXPECT_EQ(parsed<bool>("Y"), true);
+    EXPECT_EQ(parsed<bool>("N"), false);
+    EXPECT_FALSE(parsed<bool>("y"));
+    EXPECT_EQ(parsed<char>("2"), '2');
+    EXPECT_FALSE(parsed<char>("22"));
+    EXPECT_EQ(parsed<FixSide>("1"), FixSide::Buy);
+    EXPECT_FALSE(parsed<FixSide>(""));
+}
+
+TEST(FixValueTest, MsgTypeCodesAreDistinct) {
+    static_assert(FixMsgType::code("A") != FixMsgType::code("AE"));
+    static_assert(FixMsgType::code("AE") != FixMsgType::code("EA"));
+    static_assert(FixMsgType::code("") == 0);
+    static_assert(FixMsgType::code("123456789") == 0);
+    EXPECT_EQ(FixMsgType::code("A"), static_cast<uint64_t>('A'));
+}
+
+TEST(MessageTypedGetTest, ConvertsAndCachesFields) {
+    std::string bytes = order();
+    Message message;
+    ASSERT_EQ(Message::parseFixMessage(bytes.data(), bytes.size(), message),
+              ParseResult::FINISHED);
+    EXPECT_EQ(message.get<fix::MsgSeqNum>(), 7);
+    EXPECT_EQ(message.get<fix::BodyLength>(),
+              std::stoll(std::string(message.bodyLength)));
+    EXPECT_EQ(message.get<fix::Price>()->units, 18725000000);
+    EXPECT_EQ(message.get<fix::OrderQty>()->units, 100 * FixDecimal::ONE);
+    EXPECT_EQ(message.get<fix::Side>(), FixSide::Sell);
+    EXPECT_EQ(message.get<fix::SendingTime>()->nanos,
+              1705326330LL * 1000000000 + 123000000);
+    EXPECT_EQ(message.get<fix::ClOrdID>(), "ORD-1");
+    EXPECT_FALSE(message.get<fix::HeartBtInt>());
+    // Cached answers, including the same tag read as another type
+    EXPECT_EQ(message.get<fix::Price>()->units, 18725000000);
+    EXPECT_EQ((message.get<FixTag<44, std::string_view>>()), "187.25");
+    EXPECT_FALSE((message.get<FixTag<55, int64_t>>()));
+
+    message.reset();
+    std::string logon = frame("A", [](FixEncoder &e) {
+        e.field(98, "0").field(108, "30").field(141, "Y");
+    });
+    ASSERT_EQ(Message::parseFixMessage(logon.data(), logon.size(), message),
+              ParseResult::FINISHED);
+    EXPECT_EQ(message.get<fix::HeartBtInt>(), 30);
+    EXPECT_EQ(message.get<fix::ResetSeqNumFlag>(), true);
+    EXPECT_FALSE(message.get<fix::Price>());
+}
+
+TEST(FixSchemaTest, CapturesOnlyDeclaredTags) {
+    std::string bytes = order();
+    NewOrderSingle::Values values;
+    ASSERT_TRUE(NewOrderSingle::parse(bytes, values));
+    EXPECT_EQ(values.get<fix::ClOrdID>(), "ORD-1");
+    EXPECT_EQ(values.get<fix::Side>(), FixSide::Sell);
+    EXPECT_EQ(values.get<fix::OrderQty>()->units, 100 * FixDecimal::ONE);
+    EXPECT_EQ(values.get<fix::Price>()->units, 18725000000); // First one
+    EXPECT_FALSE(values.has<fix::TimeInForce>());
+    static_assert(NewOrderSingle::indexOf<fix::Price>() == 3);
+}
+
+TEST(FixSchemaTest, RejectsDeclaredFieldsThatDoNotConvert) {
+    std::string bad = frame("D", [](FixEncoder &e) {
+        e.field(11, "ORD-2").field(44, "12.x").field(5001, "fine");
+    });
+    NewOrderSingle::Values values;
+    EXPECT_FALSE(NewOrderSingle::parse(bad, values));
+
+    // Undeclared fields are never converted
+    std::string odd = frame("D", [](FixEncoder &e) {
+        e.field(11, "ORD-3").field(108, "not a number");
+    });
+    ASSERT_TRUE(NewOrderSingle::parse(odd, values));
+    EXPECT_EQ(values.get<fix::ClOrdID>(), "ORD-3");
+    EXPECT_FALSE(values.has<fix::Price>());
+
+    EXPECT_FALSE(NewOrderSingle::parse("8=FIX.4.2\x01" "9x=5\x01", values));
+}
+
+TEST(FixDispatchTest, RoutesFramesBySchema) {
+    using Dispatch = FixDispatch<NewOrderSingle, Heartbeat, Logon,
+                                 ExecutionReport, PositionReport>;
+    static_assert(Dispatch::tableBits() <= 6);
+    static_assert(Dispatch::find(FixMsgType::code("AP")) == 4);
+    static_assert(Dispatch::find(FixMsgType::code("D")) == 0);
+    static_assert(Dispatch::find(FixMsgType::code("Z")) == Dispatch::COUNT);
+
+    std::string orders;
+    int logons = 0;
+    auto handler = Overloaded{
+        [&](const NewOrderSingle::Values &v) {
+            orders += std::string(*v.get<fix::ClOrdID>());
+        },
+        [&](const Logon::Values &v) { logons += v.get<fix::HeartBtInt>() ? 1 : 0; },
+        [](const auto &) { FAIL() << "unexpected schema"; }};
+
+    std::string bytes = order();
+    EXPECT_EQ(Dispatch::msgTypeOf(bytes), "D");
+    EXPECT_EQ(Dispatch::dispatch(bytes, handler), DispatchResult::Handled);
+    EXPECT_EQ(orders, "ORD-1");
+
+    std::string logon = frame("A", [](FixEncoder &e) { e.field(108, "30"); });
+    EXPECT_EQ(Dispatch::dispatch(logon, handler), DispatchResult::Handled);
+    EXPECT_EQ(logons, 1);
+
+    std::string cancel = frame("F", [](FixEncoder &e) { e.field(11, "X"); });
+    EXPECT_EQ(Dispatch::dispatch(cancel, handler), DispatchResult::NoSchema);
+    std::string broken = frame("A", [](FixEncoder &e) { e.field(141, "?"); });
+    EXPECT_EQ(Dispatch::dispatch(broken, handler), DispatchResult::Malformed);
+    EXPECT_EQ(Dispatch::dispatch("garbage", handler), DispatchResult::NoSchema);
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "../src/histogram.h"
+#include <cstdint>
+#include <limits>
+
+TEST(HistogramTest, SmallValuesAreExact) {
+    LatencyHistogram histogram(10);
+    for (uint64_t value = 1; value <= 100; ++value) {
+        histogram.record(value);
+    }
+    EXPECT_EQ(histogram.count(), 100u);
+    EXPECT_EQ(histogram.min(), 1u);
+    EXPECT_EQ(histogram.max(), 100u);
+    EXPECT_DOUBLE_EQ(histogram.mean(), 50.5);
+    EXPECT_EQ(histogram.percentile(50), 50u);
+    EXPECT_EQ(histogram.percentile(99), 99u);
+    EXPECT_EQ(histogram.percentile(100), 100u);
+}
+
+TEST(HistogramTest, LargeValuesStayWithinResolution) {
+    LatencyHistogram histogram(10);
+    // Relative error is bounded by one bucket, 1 / 512 at 10 bits
+    for (uint64_t value : {1000ull, 123456ull, 98765432ull, 1ull << 40}) {
+        histogram.reset();
+        histogram.record(value);
+        histogram.record(value + value / 100); // Keeps max above the bucket
+        uint64_t reported = histogram.percentile(50);
+        EXPECT_GE(reported, value) << value;
+        EXPECT_LE(reported, value + value / 512) << value;
+    }
+}
+
+TEST(HistogramTest, PercentilesOfSkewedDistribution) {
+    LatencyHistogram histogram;
+    histogram.record(1000, 9900);
+    histogram.record(50000, 90);
+    histogram.record(2000000, 10);
+    EXPECT_EQ(histogram.count(), 10000u);
+    EXPECT_NEAR(static_cast<double>(histogram.percentile(50)), 1000, 2);
+    EXPECT_NEAR(static_cast<double>(histogram.percentile(99.5)), 50000, 100);
+    EXPECT_EQ(histogram.percentile(99.95), 2000000u);
+    EXPECT_EQ(histogram.max(), 2000000u);
+}
+
+TEST(HistogramTest, MergeAddsSamples) {
+    LatencyHistogram first;
+    LatencyHistogram second;
+    first.record(10, 3);
+    second.record(10000, 1);
+    first.merge(second);
+    EXPECT_EQ(first.count(), 4u);
+    EXPECT_EQ(first.min(), 10u);
+    EXPECT_EQ(first.max(), 10000u);
+    EXPECT_EQ(first.percentile(75), 10u);
+
+    LatencyHistogram coarse(4);
+    EXPECT_THROW(first.merge(coarse), std::invalid_argument);
+}
+
+TEST(HistogramTest, HandlesExtremes) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.percentile(50), 0u);
+    EXPECT_EQ(histogram.min(), 0u);
+    histogram.record(0);
+    histogram.record(std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(histogram.percentile(50), 0u);
+    EXPECT_EQ(histogram.percentile(100), std::numeric_limits<uint64_t>::max());
+    EXPECT_THROW(LatencyHistogram(1), std::invalid_argument);
+}
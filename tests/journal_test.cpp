@@ -0,0 +1,268 @@
+#include <gtest/gtest.h>
+#include "../src/fixencoder.h"
+#include "../src/journal.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class JournalTest : public ::testing::Test {
+protected:
+    JournalOptions options;
+
+    void SetUp() override {
+        char path[] = "/tmp/journal_test.XXXXXX";
+        ASSERT_NE(mkdtemp(path), nullptr);
+        options.directory = path;
+        options.segmentBytes = 4096;
+    }
+
+    void TearDown() override {
+        SessionJournal::awaitDiscarded();
+        std::filesystem::remove_all(options.directory);
+    }
+
+    std::vector<std::string> files() const {
+        std::vector<std::string> names;
+        for (const auto &entry :
+             std::filesystem::directory_iterator(options.directory)) {
+            names.push_back(entry.path().filename().string());
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    static std::string encode(std::string_view msgType, uint64_t seqNum,
+                              std::string_view sendingTime = "") {
+        FixSessionHeader header("FIX.4.2", "EXECUTOR", "CLIENT1");
+        char out[512];
+        FixEncoder encoder(out, sizeof(out));
+        encoder.begin(header, msgType, seqNum);
+        if (!sendingTime.empty()) {
+            encoder.field(52, sendingTime);
+        }
+        encoder.field(11, "ORDER-" + std::to_string(seqNum)).field(38, 100);
+        return std::string(out, encoder.finish());
+    }
+};
+
+TEST_F(JournalTest, LooksUpFramesBySeqNum) {
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    EXPECT_EQ(journal.nextSeqNum(), 1u);
+    ASSERT_TRUE(journal.append(1, encode("A", 1)));
+    ASSERT_TRUE(journal.append(2, encode("D", 2)));
+    // Skipped numbers are remembered as missing
+    ASSERT_TRUE(journal.append(5, encode("D", 5)));
+    EXPECT_FALSE(journal.append(4, encode("D", 4)));
+    EXPECT_EQ(journal.nextSeqNum(), 6u);
+
+    std::string_view frame;
+    ASSERT_TRUE(journal.frame(2, frame));
+    EXPECT_EQ(frame, encode("D", 2));
+    EXPECT_EQ(SessionJournal::msgTypeOf(frame), "D");
+    EXPECT_FALSE(journal.frame(3, frame));
+    EXPECT_FALSE(journal.frame(6, frame));
+    ASSERT_TRUE(journal.frame(5, frame));
+    EXPECT_EQ(frame, encode("D", 5));
+}
+
+TEST_F(JournalTest, RecoversAfterReopenAndStopsAtTornFrame) {
+    {
+        SessionJournal journal(options, "EXECUTOR-CLIENT1");
+        for (uint64_t seq = 1; seq <= 3; ++seq) {
+            ASSERT_TRUE(journal.append(seq, encode("D", seq)));
+        }
+    }
+    // Simulate a crash halfway through copying the fourth frame
+    std::string path = options.directory + "/EXECUTOR-CLIENT1.000000.journal";
+    std::string torn = encode("D", 4).substr(0, 30);
+    size_t end = 3 * encode("D", 1).size();
+    {
+        FILE *file = fopen(path.c_str(), "r+");
+        ASSERT_NE(file, nullptr);
+        fseek(file, static_cast<long>(end), SEEK_SET);
+        fwrite(torn.data(), 1, torn.size(), file);
+        fclose(file);
+    }
+
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    EXPECT_EQ(journal.nextSeqNum(), 4u);
+    std::string_view frame;
+    ASSERT_TRUE(journal.frame(3, frame));
+    EXPECT_EQ(frame, encode("D", 3));
+    // The torn frame is overwritten by the next append
+    ASSERT_TRUE(journal.append(4, encode("D", 4)));
+    ASSERT_TRUE(journal.frame(4, frame));
+    EXPECT_EQ(frame, encode("D", 4));
+}
+
+TEST_F(JournalTest, IsLockedWhileOpen) {
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    EXPECT_THROW(SessionJournal(options, "EXECUTOR-CLIENT1"),
+                 std::runtime_error);
+    SessionJournal other(options, "EXECUTOR-CLIENT2");
+}
+
+TEST_F(JournalTest, AllocatesSegmentBlocksUpFront) {
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    // No holes, so appends through the mapping never need a new block
+    struct stat info;
+    std::string path = options.directory + "/EXECUTOR-CLIENT1.000000.journal";
+    ASSERT_EQ(stat(path.c_str(), &info), 0);
+    EXPECT_EQ(static_cast<size_t>(info.st_size), options.segmentBytes);
+    EXPECT_GE(static_cast<size_t>(info.st_blocks) * 512, options.segmentBytes);
+}
+
+TEST_F(JournalTest, StartsSmallAndGrowsIntoFullSegments) {
+    options.firstSegmentBytes = 1024;
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    std::string first = options.directory + "/EXECUTOR-CLIENT1.000000.journal";
+    struct stat info;
+    ASSERT_EQ(stat(first.c_str(), &info), 0);
+    EXPECT_EQ(static_cast<size_t>(info.st_size), 1024u);
+
+    // Past the small segment, appends go on in a full sized one
+    uint64_t seq = 1;
+    for (size_t bytes = 0; bytes < 2048; ++seq) {
+        std::string frame = encode("D", seq);
+        ASSERT_TRUE(journal.append(seq, frame)) << seq;
+        bytes += frame.size();
+    }
+    EXPECT_EQ(journal.segmentCount(), 2u);
+    std::string second = options.directory + "/EXECUTOR-CLIENT1.000001.journal";
+    ASSERT_EQ(stat(second.c_str(), &info), 0);
+    EXPECT_EQ(static_cast<size_t>(info.st_size), options.segmentBytes);
+    std::string_view frame;
+    EXPECT_TRUE(journal.frame(1, frame));
+    EXPECT_TRUE(journal.frame(seq - 1, frame));
+}
+
+TEST_F(JournalTest, RollsOverAndDeletesOldSegments) {
+    options.retainSegments = 2;
+    options.sync = JournalSync::Sync;
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    std::string sample = encode("D", 100);
+    uint64_t perSegment = options.segmentBytes / sample.size();
+    uint64_t last = perSegment * 4;
+    for (uint64_t seq = 100; seq < 100 + last; ++seq) {
+        ASSERT_TRUE(journal.append(seq, encode("D", seq))) << seq;
+        ASSERT_TRUE(journal.sync(std::chrono::steady_clock::now()));
+        EXPECT_FALSE(journal.dirty());
+    }
+    EXPECT_EQ(journal.segmentCount(), 2u);
+
+    std::string_view frame;
+    EXPECT_FALSE(journal.frame(100, frame));
+    ASSERT_TRUE(journal.frame(100 + last - 1, frame));
+    EXPECT_EQ(frame, encode("D", 100 + last - 1));
+    EXPECT_FALSE(journal.append(200 + last, std::string(8192, 'x')));
+}
+
+TEST_F(JournalTest, ResetStartsOverAtOne) {
+    {
+        SessionJournal journal(options, "EXECUTOR-CLIENT1");
+        ASSERT_TRUE(journal.append(1, encode("A", 1)));
+        ASSERT_TRUE(journal.append(2, encode("D", 2)));
+        journal.reset();
+        EXPECT_EQ(journal.nextSeqNum(), 1u);
+        std::string_view frame;
+        EXPECT_FALSE(journal.frame(2, frame));
+        ASSERT_TRUE(journal.append(1, encode("A", 1)));
+    }
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    EXPECT_EQ(journal.nextSeqNum(), 2u);
+}
+
+TEST_F(JournalTest, OpensForResetWithoutReadingOldSegments) {
+    {
+        SessionJournal journal(options, "EXECUTOR-CLIENT1");
+        for (uint64_t seq = 1; seq <= 100; ++seq) {
+            ASSERT_TRUE(journal.append(seq, encode("D", seq)));
+        }
+        EXPECT_GT(journal.segmentCount(), 1u);
+    }
+    SessionJournal journal(options, "EXECUTOR-CLIENT1", true);
+    EXPECT_EQ(journal.nextSeqNum(), 1u);
+    EXPECT_EQ(journal.segmentCount(), 1u);
+    std::string_view frame;
+    EXPECT_FALSE(journal.frame(1, frame));
+    ASSERT_TRUE(journal.append(1, encode("A", 1)));
+    std::vector<std::string> names = files();
+    ASSERT_EQ(names.size(), 2u);
+    EXPECT_EQ(names[1], "EXECUTOR-CLIENT1.lock");
+}
+
+TEST_F(JournalTest, ResetAndCloseDoNotWaitForTheSpare) {
+    options.segmentBytes = 64 * 1024 * 1024;
+    options.firstSegmentBytes = 4096;
+    auto elapsed = [](auto &&run) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        return std::chrono::steady_clock::now() - start;
+    };
+    // What the owning thread would wait for with every spare
+    auto allocation = elapsed([&] {
+        { SessionJournal journal(options, "EXECUTOR-FULL"); }
+        SessionJournal::awaitDiscarded();
+    });
+
+    // Each of these leaves a spare still being allocated behind
+    auto quick = elapsed([&] {
+        SessionJournal journal(options, "EXECUTOR-CLIENT1");
+        journal.reset();
+        ASSERT_TRUE(journal.append(1, encode("A", 1)));
+    });
+    EXPECT_LT(quick, allocation);
+
+    // Discarded spares go away, the reset segment stays
+    SessionJournal::awaitDiscarded();
+    std::vector<std::string> names = files();
+    size_t spares = std::count_if(names.begin(), names.end(),
+                                  [](const std::string &name) {
+                                      return name.ends_with(".spare");
+                                  });
+    EXPECT_EQ(spares, 0u);
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    EXPECT_EQ(journal.nextSeqNum(), 2u);
+    EXPECT_EQ(journal.segmentCount(), 1u);
+}
+
+TEST_F(JournalTest, DeletesSparesLeftByACrash) {
+    std::string stale =
+        options.directory + "/EXECUTOR-CLIENT1.000001.4242-7.spare";
+    std::string other =
+        options.directory + "/EXECUTOR-CLIENT2.000001.4242-7.spare";
+    for (const std::string &path : {stale, other}) {
+        int fd = open(path.c_str(), O_CREAT | O_WRONLY, 0644);
+        ASSERT_NE(fd, -1);
+        close(fd);
+    }
+    SessionJournal journal(options, "EXECUTOR-CLIENT1");
+    EXPECT_FALSE(std::filesystem::exists(stale));
+    EXPECT_TRUE(std::filesystem::exists(other));
+}
+
+TEST_F(JournalTest, CopiesFrameAsPossibleDuplicate) {
+    std::string frame = encode("D", 7, "20250314-15:24:42.191");
+    char out[512];
+    size_t length = SessionJournal::copyAsPossDup(frame, out, sizeof(out));
+
+    FixSessionHeader header("FIX.4.2", "EXECUTOR", "CLIENT1");
+    char expected[512];
+    FixEncoder encoder(expected, sizeof(expected));
+    encoder.begin(header, "D", 7)
+        .field(43, "Y")
+        .field(122, "20250314-15:24:42.191")
+        .field(52, "20250314-15:24:42.191")
+        .field(11, "ORDER-7")
+        .field(38, 100);
+    EXPECT_EQ(std::string(out, length),
+              std::string(expected, encoder.finish()));
+
+    // Already marked frames are copied as they are
+    std::string marked(out, length);
+    EXPECT_EQ(SessionJournal::copyAsPossDup(marked, out, sizeof(out)),
+              marked.size());
+    EXPECT_EQ(SessionJournal::copyAsPossDup(frame, out, 32), 0u);
+}
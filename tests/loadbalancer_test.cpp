@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "../src/loadbalancer.h"
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST(LoadBalancerTest, PlacesRoundRobinWithoutSamples) {
+    LoadBalancer balancer(3);
+    std::vector<size_t> placed;
+    for (int i = 0; i < 6; ++i) {
+        placed.push_back(balancer.place());
+    }
+    EXPECT_EQ(placed, (std::vector<size_t>{0, 1, 2, 0, 1, 2}));
+}
+
+TEST(LoadBalancerTest, PlacesOnLeastLoadedAndSpreadsBursts) {
+    LoadBalancer balancer(3);
+    std::vector<WorkerLoad> loads = {{5000, 10, 0}, {0, 2, 0}, {1000, 4, 0}};
+    balancer.update(loads);
+
+    std::vector<size_t> counts(3, 0);
+    for (int i = 0; i < 40; ++i) {
+        size_t worker = balancer.place();
+        if (i < 11) {
+            EXPECT_EQ(worker, 1u) << i;
+        }
+        ++counts[worker];
+    }
+    // The placements count as connections of their worker until the next
+    // sample, so the burst does not all land on the idlest one
+    EXPECT_EQ(counts[0], 0u);
+    EXPECT_GT(counts[2], 0u);
+    EXPECT_GT(counts[1], counts[2]);
+
+    balancer.update(loads);
+    EXPECT_EQ(balancer.place(), 1u);
+}
+
+TEST(LoadBalancerTest, MovesConnectionsOnlyPastTheThreshold) {
+    BalancePolicy policy;
+    policy.imbalance = 1.5;
+    policy.minRate = 1000;
+    policy.cooldown = 5s;
+    LoadBalancer balancer(2, policy);
+    auto now = std::chrono::steady_clock::now();
+
+    std::vector<WorkerLoad> balanced = {{5000, 4, 0}, {4000, 4, 0}};
+    balancer.update(balanced);
+    EXPECT_FALSE(balancer.rebalance(now));
+
+    std::vector<WorkerLoad> skewed = {{9000, 4, 0}, {1000, 4, 0}};
+    balancer.update(skewed);
+    auto move = balancer.rebalance(now);
+    ASSERT_TRUE(move);
+    EXPECT_EQ(move->from, 0u);
+    EXPECT_EQ(move->to, 1u);
+    // One move per cooldown, so samples show its effect first
+    EXPECT_FALSE(balancer.rebalance(now + 1s));
+    EXPECT_TRUE(balancer.rebalance(now + 6s));
+
+    // Too little traffic, or a single connection, is never moved
+    balancer.update(std::vector<WorkerLoad>{{900, 4, 0}, {0, 4, 0}});
+    EXPECT_FALSE(balancer.rebalance(now + 20s));
+    balancer.update(std::vector<WorkerLoad>{{9000, 1, 0}, {0, 4, 0}});
+    EXPECT_FALSE(balancer.rebalance(now + 20s));
+
+    policy.imbalance = 0;
+    LoadBalancer off(2, policy);
+    off.update(skewed);
+    EXPECT_FALSE(off.rebalance(now));
+}
+
+TEST(LoadBalancerTest, SamplesMetricsAndChannelBacklog) {
+    WorkerMetrics metrics[2];
+    std::vector<const WorkerMetrics *> workers = {&metrics[0], &metrics[1]};
+    Router router(2);
+    LoadBalancer balancer(2);
+    auto now = std::chrono::steady_clock::now();
+
+    metrics[0].messagesIn.add(100);
+    balancer.sample(workers, router, now);
+    EXPECT_EQ(balancer.loads()[0].messageRate, 0); // No interval yet
+
+    metrics[0].messagesIn.add(500);
+    metrics[0].connectionsOpened.add(3);
+    metrics[0].connectionsClosed.add();
+    metrics[0].migrationsOut.add();
+    metrics[1].migrationsIn.add();
+    ASSERT_TRUE(router.post(0, SessionAddress{1, 5, 1}, FrameLayout{},
+                            "8=FIX.4.2\x01"));
+    balancer.sample(workers, router, now + 500ms);
+
+    const std::vector<WorkerLoad> &loads = balancer.loads();
+    EXPECT_DOUBLE_EQ(loads[0].messageRate, 1000);
+    EXPECT_EQ(loads[0].connections, 1u);
+    EXPECT_EQ(loads[1].connections, 1u);
+    EXPECT_EQ(loads[0].queued, 0u);
+    EXPECT_GT(loads[1].queued, 0u);
+}
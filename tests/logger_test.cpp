@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include "../src/logger.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+class LoggerTest : public ::testing::Test {
+protected:
+    std::string directory;
+    std::string path;
+
+    LoggerTest() {
+        char name[] = "/tmp/logger_test.XXXXXX";
+        directory = mkdtemp(name);
+        path = directory + "/test.log";
+    }
+    ~LoggerTest() override { std::filesystem::remove_all(directory); }
+
+    void SetUp() override {
+        ASSERT_TRUE(Logger::instance().setOutputFile(path));
+    }
+
+    // Messages written so far, without the timestamp and padded level
+    std::vector<std::string> messages() {
+        Logger::instance().flush();
+        std::ifstream in(path);
+        std::vector<std::string> lines;
+        constexpr size_t PREFIX =
+            sizeof("2025-03-14 15:24:42.191000000 ERROR ") - 1;
+        for (std::string line; std::getline(in, line);) {
+            lines.push_back(line.size() >= PREFIX ? line.substr(PREFIX) : line);
+        }
+        return lines;
+    }
+};
+
+enum class Side : uint8_t { Buy = 1, Sell = 2 };
+
+TEST_F(LoggerTest, ExpandsEveryWireType) {
+    Logger &logger = Logger::instance();
+    std::string owned = "owned";
+    int value = 42;
+    const void *pointer = &value;
+    logger.log(LogLevel::Info, "{} {} {}", std::string_view("view"), owned,
+               "literal");
+    logger.log(LogLevel::Warn, "{} {} {}", -7, uint64_t(18446744073709551615u),
+               int64_t(-9000000000));
+    logger.log(LogLevel::Info, "{}/{} {} {}", true, false, 'Z', 1.5);
+    logger.log(LogLevel::Info, "at {} side {}", pointer, Side::Sell);
+
+    char text[32];
+    std::snprintf(text, sizeof(text), "%p", pointer);
+    std::vector<std::string> lines = messages();
+    ASSERT_EQ(lines.size(), 4u);
+    EXPECT_EQ(lines[0], "view owned literal");
+    EXPECT_EQ(lines[1], "-7 18446744073709551615 -9000000000");
+    EXPECT_EQ(lines[2], "true/false Z 1.5");
+    EXPECT_EQ(lines[3], std::string("at ") + text + " side 2");
+}
+
+TEST_F(LoggerTest, MismatchedPlaceholdersAreLeftOrDropped) {
+    Logger &logger = Logger::instance();
+    logger.log(LogLevel::Info, "no placeholders");
+    logger.log(LogLevel::Info, "{} and {}", 1);
+    logger.log(LogLevel::Info, "only {}", 1, 2, "three");
+    logger.log(LogLevel::Info, "{", 5);
+
+    std::vector<std::string> lines = messages();
+    ASSERT_EQ(lines.size(), 4u);
+    EXPECT_EQ(lines[0], "no placeholders");
+    EXPECT_EQ(lines[1], "1 and {}");
+    EXPECT_EQ(lines[2], "only 1");
+    EXPECT_EQ(lines[3], "{");
+}
+
+TEST_F(LoggerTest, MarksArgumentsPastThePayloadTruncated) {
+    constexpr size_t capacity = sizeof(LogRecord::payload);
+    std::string longText(2 * capacity, 'x');
+    Logger::instance().log(LogLevel::Error, "{} n={} s={}", longText, 7, "end");
+
+    std::vector<std::string> lines = messages();
+    ASSERT_EQ(lines.size(), 1u);
+    // The string takes what is left after its length, nothing follows it
+    std::string kept(capacity - sizeof(uint16_t), 'x');
+    EXPECT_EQ(lines[0], kept + " n=<truncated> s=<truncated>");
+}
+
+TEST_F(LoggerTest, CountsRecordsDroppedWhileTheRingIsFull) {
+    Logger &logger = Logger::instance();
+    uint64_t before = logger.dropped();
+    // The background thread cannot keep up with a tight loop for long
+    uint64_t attempts = 0;
+    while (logger.dropped() == before && attempts < 100000000) {
+        logger.log(LogLevel::Debug, "record {}", attempts++);
+    }
+    uint64_t dropped = logger.dropped() - before;
+    ASSERT_GT(dropped, 0u);
+    EXPECT_EQ(messages().size() + dropped, attempts);
+}
+
+TEST_F(LoggerTest, DrainsAnExitedThreadOnceAndRemovesItsRing) {
+    Logger &logger = Logger::instance();
+    logger.log(LogLevel::Info, "main");
+    size_t rings = logger.ringCount();
+    size_t whileRunning = 0;
+    std::thread([&] {
+        logger.log(LogLevel::Info, "worker {}", 1);
+        logger.log(LogLevel::Info, "worker {}", 2);
+        whileRunning = logger.ringCount();
+    }).join();
+    EXPECT_EQ(whileRunning, rings + 1);
+
+    std::vector<std::string> lines = messages();
+    EXPECT_EQ(logger.ringCount(), rings);
+    EXPECT_EQ(lines,
+              (std::vector<std::string>{"main", "worker 1", "worker 2"}));
+    logger.flush();
+    EXPECT_EQ(messages().size(), 3u);
+}
@@ -0,0 +1,267 @@
+#include <gtest/gtest.h>
+#include "../src/fixencoder.h"
+#include "../src/fixscan.h"
+#include "../src/message.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+class MessageTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+
+    // Wraps a body in a header with the right BodyLength and CheckSum
+    static std::string makeFrame(const std::string &body) {
+        std::string frame = "8=FIX.4.2\x01" "9=" + std::to_string(body.size()) +
+                            "\x01" + body;
+        unsigned sum = 0;
+        for (unsigned char c : frame) {
+            sum += c;
+        }
+        char trailer[8];
+        std::snprintf(trailer, sizeof(trailer), "10=%03u\x01", sum % 256);
+        return frame + trailer;
+    }
+
+    static std::vector<const FixScanner::Kernel *> kernels() {
+        std::vector<const FixScanner::Kernel *> result{&FixScanner::scalar()};
+#if defined(GR_FIXSCAN_X86)
+        result.push_back(&FixScanner::sse2());
+        if (__builtin_cpu_supports("avx2")) {
+            result.push_back(&FixScanner::avx2());
+        }
+#elif defined(GR_FIXSCAN_NEON)
+        result.push_back(&FixScanner::neon());
+#endif
+        return result;
+    }
+};
+
+// 向量化内核必须与标量参考实现一致
+TEST_F(MessageTest, KernelsMatchScalarReference) {
+    std::mt19937 rng(42);
+    std::vector<char> data(4096);
+    for (auto &c : data) {
+        c = static_cast<char>("0123456789=\x01" "abc\xff"[rng() % 16]);
+    }
+    const FixScanner::Kernel &reference = FixScanner::scalar();
+    for (const FixScanner::Kernel *kernel : kernels()) {
+        for (size_t offset = 0; offset < 70; ++offset) {
+            for (size_t length : {0, 1, 5, 15, 16, 17, 31, 32, 33, 100, 1000}) {
+                const char *p = data.data() + offset;
+                EXPECT_EQ(kernel->find(p, length, '='),
+                          reference.find(p, length, '='))
+                    << kernel->name;
+                EXPECT_EQ(kernel->find(p, length, Message::SOH),
+                          reference.find(p, length, Message::SOH))
+                    << kernel->name;
+                EXPECT_EQ(kernel->checksum(p, length),
+                          reference.checksum(p, length))
+                    << kernel->name;
+                EXPECT_EQ(kernel->allDigits(p, length),
+                          reference.allDigits(p, length))
+                    << kernel->name;
+            }
+        }
+    }
+
+    std::string digits(100, '7');
+    for (const FixScanner::Kernel *kernel : kernels()) {
+        EXPECT_TRUE(kernel->allDigits(digits.data(), digits.size()));
+        digits[63] = '/';
+        EXPECT_FALSE(kernel->allDigits(digits.data(), digits.size()));
+        digits[63] = '7';
+    }
+}
+
+TEST_F(MessageTest, ParsesLogon) {
+    std::string frame = makeFrame(
+        "35=A\x01" "34=1\x01" "49=CLIENT1\x01" "52=20250314-15:24:42.191\x01"
+        "56=EXECUTOR\x01" "98=0\x01" "108=30\x01");
+    CircularBuffer buffer(4096, BufferMode::Mirrored);
+    buffer.writeFromString(frame);
+
+    Message message;
+    ASSERT_EQ(Message::parseFixMessage(buffer, message), ParseResult::FINISHED);
+    EXPECT_EQ(message.beginString, "FIX.4.2");
+    EXPECT_EQ(message.msgType, "A");
+    EXPECT_EQ(message.senderCompID, "CLIENT1");
+    EXPECT_EQ(message.targetCompID, "EXECUTOR");
+    EXPECT_EQ(message.seqNumber, "1");
+    EXPECT_EQ(message.frameLength, frame.size());
+    EXPECT_EQ(message.frame, frame);
+
+    // Parsing leaves the frame in place until the caller consumes it
+    EXPECT_EQ(buffer.dataSize(), frame.size());
+}
+
+TEST_F(MessageTest, PartialFrameIsNotConsumed) {
+    std::string frame = makeFrame("35=0\x01" "34=2\x01");
+    CircularBuffer buffer(4096, BufferMode::Mirrored);
+    Message message;
+    for (size_t i = 0; i + 1 < frame.size(); ++i) {
+        buffer.writeFromByte(frame[i]);
+        ASSERT_EQ(Message::parseFixMessage(buffer, message),
+                  ParseResult::CONTINUE) << "at byte " << i;
+        EXPECT_EQ(buffer.dataSize(), i + 1);
+    }
+    buffer.writeFromByte(frame.back());
+    EXPECT_EQ(Message::parseFixMessage(buffer, message), ParseResult::FINISHED);
+}
+
+TEST_F(MessageTest, RejectsOversizedAndGarbledFrames) {
+    size_t frameLength;
+    size_t checksum;
+    std::string oversized = "8=FIX.4.2\x01" "9=9999999\x01";
+    EXPECT_EQ(Message::frameFixMessage(oversized.data(), oversized.size(),
+                                       frameLength, checksum),
+              ParseResult::ERROR);
+    EXPECT_EQ(frameLength, 0u);
+
+    std::string garbage = "GET / HTTP/1.1\r\n";
+    EXPECT_EQ(Message::frameFixMessage(garbage.data(), garbage.size(),
+                                       frameLength, checksum),
+              ParseResult::ERROR);
+
+    // BodyLength pointing into the middle of the body
+    std::string frame = makeFrame("35=0\x01");
+    frame.replace(frame.find("9=5"), 3, "9=3");
+    EXPECT_EQ(Message::frameFixMessage(frame.data(), frame.size(), frameLength,
+                                       checksum),
+              ParseResult::ERROR);
+}
+
+TEST_F(MessageTest, RejectsBadChecksum) {
+    std::string frame = "8=FIX.4.2\x01" "9=5\x01" "35=0\x01" "10=000\x01";
+    CircularBuffer buffer(4096, BufferMode::Mirrored);
+    buffer.writeFromString(frame);
+
+    Message message;
+    EXPECT_EQ(Message::parseFixMessage(buffer, message), ParseResult::ERROR);
+    // The frame boundary is known, so the caller can skip it
+    EXPECT_EQ(message.frameLength, frame.size());
+    EXPECT_TRUE(message.badChecksum);
+}
+
+TEST_F(MessageTest, RejectsNonDigitTag) {
+    CircularBuffer buffer(4096, BufferMode::Mirrored);
+    buffer.writeFromString(makeFrame("3x=A\x01"));
+
+    Message message;
+    EXPECT_EQ(Message::parseFixMessage(buffer, message), ParseResult::ERROR);
+    EXPECT_FALSE(message.badChecksum);
+}
+
+TEST_F(MessageTest, ParsesConsecutiveFramesOfOneView) {
+    std::string first = makeFrame("35=A\x01" "49=CLIENT1\x01");
+    std::string second = makeFrame("35=D\x01" "11=ORD1\x01");
+    std::string bytes = first + second + second.substr(0, 10);
+
+    Message messages[3];
+    size_t offset = 0;
+    ASSERT_EQ(Message::parseFixMessage(bytes.data(), bytes.size(), messages[0]),
+              ParseResult::FINISHED);
+    offset += messages[0].frameLength;
+    ASSERT_EQ(Message::parseFixMessage(bytes.data() + offset,
+                                       bytes.size() - offset, messages[1]),
+              ParseResult::FINISHED);
+    offset += messages[1].frameLength;
+    EXPECT_EQ(Message::parseFixMessage(bytes.data() + offset,
+                                       bytes.size() - offset, messages[2]),
+              ParseResult::CONTINUE);
+
+    // Both stay valid side by side, pointing into the same bytes
+    EXPECT_EQ(messages[0].senderCompID, "CLIENT1");
+    EXPECT_EQ(messages[1].clOrdID, "ORD1");
+    EXPECT_EQ(messages[1].frame, second);
+    EXPECT_EQ(offset, first.size() + second.size());
+}
+
+TEST_F(MessageTest, LooksUpAnyTag) {
+    std::string frame = makeFrame(
+        "35=8\x01" "34=7\x01" "49=EXEC\x01" "56=CLIENT\x01" "150=F\x01"
+        "5001=custom\x01" "20000=big\x01" "150=G\x01");
+    CircularBuffer buffer(4096, BufferMode::Mirrored);
+    buffer.writeFromString(frame);
+
+    Message message;
+    ASSERT_EQ(Message::parseFixMessage(buffer, message), ParseResult::FINISHED);
+    EXPECT_EQ(message.get(150), "F"); // First occurrence wins
+    EXPECT_EQ(message.get(5001), "custom");
+    EXPECT_EQ(message.get(20000), "big");
+    EXPECT_EQ(message.get(35), "8");
+    EXPECT_FALSE(message.has(151));
+    EXPECT_FALSE(message.has(20001));
+    EXPECT_EQ(message.fields.size(), 11u);
+
+    message.reset();
+    EXPECT_FALSE(message.has(150));
+    EXPECT_FALSE(message.has(5001));
+    EXPECT_TRUE(message.fields.empty());
+}
+
+TEST_F(MessageTest, FieldTableSpillsPastInlineCapacity) {
+    FieldTable<4> table;
+    for (int tag = 1; tag <= 40; ++tag) {
+        table.insert(tag * 1000, "v");
+    }
+    EXPECT_EQ(table.size(), 40u);
+    for (int tag = 1; tag <= 40; ++tag) {
+        ASSERT_NE(table.find(tag * 1000), nullptr) << tag;
+        EXPECT_EQ(table.find(tag * 1000)->tag, tag * 1000);
+    }
+    EXPECT_EQ(table.find(41000), nullptr);
+}
+
+TEST_F(MessageTest, EncoderWritesValidFrame) {
+    FixSessionHeader header("FIX.4.2", "EXECUTOR", "CLIENT1");
+    CircularBuffer buffer(4096, BufferMode::Mirrored);
+    char *out;
+    size_t space;
+    ASSERT_TRUE(buffer.getWriteView(out, space));
+
+    FixEncoder encoder(out, space);
+    encoder.begin(header, "8", 42)
+        .field(11, "ORDER-1")
+        .field(38, 1500)
+        .field(14, -7);
+    size_t length = encoder.finish();
+    ASSERT_GT(length, 0u);
+    buffer.commit(length);
+
+    std::string body = "35=8\x01" "49=EXECUTOR\x01" "56=CLIENT1\x01" "34=42\x01"
+                       "11=ORDER-1\x01" "38=1500\x01" "14=-7\x01";
+    EXPECT_EQ(std::string(out, length), makeFrame(body));
+
+    Message message;
+    ASSERT_EQ(Message::parseFixMessage(buffer, message), ParseResult::FINISHED);
+    EXPECT_EQ(message.msgType, "8");
+    EXPECT_EQ(message.seqNumber, "42");
+    EXPECT_EQ(message.get(38), "1500");
+}
+
+TEST_F(MessageTest, EncoderRejectsTooSmallSpan) {
+    FixSessionHeader header("FIX.4.2", "A", "B");
+    char out[48];
+    FixEncoder encoder(out, sizeof(out));
+    encoder.begin(header, "0", 1).field(58, std::string(64, 'x'));
+    EXPECT_TRUE(encoder.overflowed());
+    EXPECT_EQ(encoder.finish(), 0u);
+}
+
+TEST_F(MessageTest, EncoderRejectsBodyTheParserWould) {
+    FixSessionHeader header("FIX.4.2", "A", "B");
+    std::vector<char> out(2 * Message::MAX_BODY_LENGTH);
+    FixEncoder fits(out.data(), out.size());
+    fits.begin(header, "0", 1)
+        .field(58, std::string(Message::MAX_BODY_LENGTH - 64, 'x'));
+    EXPECT_GT(fits.finish(), Message::MAX_BODY_LENGTH - 64);
+
+    FixEncoder encoder(out.data(), out.size());
+    encoder.begin(header, "0", 1)
+        .field(58, std::string(Message::MAX_BODY_LENGTH, 'x'));
+    EXPECT_FALSE(encoder.overflowed());
+    EXPECT_EQ(encoder.finish(), 0u);
+}
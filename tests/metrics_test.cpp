@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "../src/metricsserver.h"
+#include <arpa/inet.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(MetricsTest, CounterSeesEveryAddOfItsWriter) {
+    MetricCounter counter;
+    std::thread writer([&counter]() {
+        for (int i = 0; i < 100000; ++i) {
+            counter.add();
+        }
+        counter.add(5);
+    });
+    uint64_t last = 0;
+    while (last < 100005) {
+        uint64_t now = counter.load();
+        ASSERT_GE(now, last); // Readers never see it go backwards
+        last = now;
+    }
+    writer.join();
+    EXPECT_EQ(counter.load(), 100005u);
+}
+
+TEST(MetricsTest, HistogramSnapshotKeepsCountsAndResolution) {
+    MetricHistogram histogram(7);
+    histogram.record(100, 98);
+    histogram.record(5000);
+    histogram.record(1000000);
+    EXPECT_EQ(histogram.count(), 100u);
+    EXPECT_EQ(histogram.sum(), 100u * 98 + 5000 + 1000000);
+
+    LatencyHistogram snapshot;
+    histogram.snapshot(snapshot);
+    EXPECT_EQ(snapshot.count(), 100u);
+    EXPECT_EQ(snapshot.percentile(50), 100u); // Exact below 2^7
+    // Above that within one bucket, 1 / 64 at 7 bits
+    EXPECT_GE(snapshot.percentile(99), 5000u);
+    EXPECT_LE(snapshot.percentile(99), 5000u + 5000 / 64);
+    EXPECT_GE(snapshot.max(), 1000000u);
+    EXPECT_LE(snapshot.max(), 1000000u + 1000000 / 64);
+
+    // Scaled snapshots of several writers can be merged
+    LatencyHistogram scaled;
+    histogram.snapshot(scaled, 2.0);
+    histogram.snapshot(scaled, 2.0);
+    EXPECT_EQ(scaled.count(), 200u);
+    EXPECT_EQ(scaled.percentile(50), 200u);
+}
+
+TEST(MetricsTest, WorkerMetricsKeepHotCountersOffErrorLine) {
+    WorkerMetrics metrics;
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&metrics) % CACHE_LINE, 0u);
+    auto offset = [&metrics](const void *member) {
+        return static_cast<size_t>(static_cast<const char *>(member) -
+                                   reinterpret_cast<const char *>(&metrics));
+    };
+    EXPECT_LT(offset(&metrics.routedIn), CACHE_LINE);
+    EXPECT_GE(offset(&metrics.connectionsOpened), CACHE_LINE);
+}
+
+TEST(MetricsTest, RendersPrometheusTextPerWorker) {
+    auto first = std::make_unique<WorkerMetrics>();
+    auto second = std::make_unique<WorkerMetrics>();
+    first->messagesIn.add(3);
+    second->messagesIn.add(uint64_t(1) << 60); // Exact, not 1.15e+18
+    second->checksumErrors.add();
+    first->inboundDepth.record(4);
+    second->inboundDepth.record(8);
+
+    std::vector<const WorkerMetrics *> workers{first.get(), second.get()};
+    std::string text = MetricsServer::render(workers);
+    EXPECT_NE(text.find("# TYPE generalrouter_messages_received_total counter\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("generalrouter_messages_received_total{worker=\"0\"} 3\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("generalrouter_messages_received_total{worker=\"1\"} "
+                        "1152921504606846976\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("generalrouter_checksum_errors_total{worker=\"1\"} 1\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("# TYPE generalrouter_parse_to_flush_seconds summary\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("generalrouter_inbound_channel_depth{worker=\"1\","
+                        "quantile=\"0.5\"} 8\n"),
+              std::string::npos);
+    // The series without a worker label merges all workers
+    EXPECT_NE(text.find("generalrouter_inbound_channel_depth{quantile=\"0.5\"} 4\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("generalrouter_inbound_channel_depth_sum 12\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("generalrouter_inbound_channel_depth_count 2\n"),
+              std::string::npos);
+}
+
+// Sends one HTTP request to the admin port and returns the whole response
+static std::string httpGet(uint16_t port, const std::string &path) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::string response;
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) == 0) {
+        std::string request = "GET " + path + " HTTP/1.1\r\nHost: x\r\n\r\n";
+        if (write(fd, request.data(), request.size()) ==
+            static_cast<ssize_t>(request.size())) {
+            char chunk[4096];
+            ssize_t n;
+            while ((n = read(fd, chunk, sizeof chunk)) > 0) {
+                response.append(chunk, static_cast<size_t>(n));
+            }
+        }
+    }
+    close(fd);
+    return response;
+}
+
+TEST(MetricsTest, ServerAnswersScrapes) {
+    auto metrics = std::make_unique<WorkerMetrics>();
+    metrics->bytesIn.add(42);
+    MetricsServer server(0, {metrics.get()});
+
+    std::string response = httpGet(server.port(), "/metrics");
+    EXPECT_EQ(response.rfind("HTTP/1.0 200 OK\r\n", 0), 0u) << response;
+    EXPECT_NE(response.find("Content-Type: text/plain; version=0.0.4\r\n"),
+              std::string::npos);
+    EXPECT_NE(response.find("generalrouter_bytes_received_total{worker=\"0\"} 42\n"),
+              std::string::npos);
+
+    // Counters are read live on every scrape
+    metrics->bytesIn.add(8);
+    EXPECT_NE(httpGet(server.port(), "/metrics")
+                  .find("generalrouter_bytes_received_total{worker=\"0\"} 50\n"),
+              std::string::npos);
+
+    EXPECT_EQ(httpGet(server.port(), "/").rfind("HTTP/1.0 404", 0), 0u);
+}
@@ -0,0 +1,245 @@
+#include <gtest/gtest.h>
+#include "../src/fixencoder.h"
+#include "../src/router.h"
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+class RouterTest : public ::testing::Test {
+protected:
+    CircularBuffer buffer{4096, BufferMode::Mirrored};
+    Message message;
+
+    // Encodes a NewOrderSingle the way a client would send it
+    static std::string encodeOrder(std::string_view sender,
+                                   std::string_view target, uint64_t seqNum) {
+        FixSessionHeader header("FIX.4.2", sender, target);
+        char out[512];
+        FixEncoder encoder(out, sizeof(out));
+        encoder.begin(header, "D", seqNum)
+            .field(11, "ORDER-1")
+            .field(55, "ABC")
+            .field(38, 100);
+        return std::string(out, encoder.finish());
+    }
+
+    // Parses frame into message, which then references buffer
+    void parse(const std::string &frame) {
+        buffer.reset();
+        message.reset();
+        buffer.writeFromString(frame);
+        ASSERT_EQ(Message::parseFixMessage(buffer, message),
+                  ParseResult::FINISHED);
+    }
+};
+
+TEST_F(RouterTest, ForwardRewritesTargetAndSeqNumOnly) {
+    parse(encodeOrder("CLIENT1", "CLIENT2", 7));
+    FrameLayout layout;
+    ASSERT_TRUE(FrameLayout::of(message, layout));
+
+    // Longer CompID and MsgSeqNum, so BodyLength and CheckSum both change
+    char out[512];
+    size_t length = layout.forward(message.frame, "CLIENT2-EU", 123456, out,
+                                   sizeof(out));
+    ASSERT_GT(length, 0u);
+    EXPECT_EQ(std::string(out, length),
+              encodeOrder("CLIENT1", "CLIENT2-EU", 123456));
+
+    // And shorter ones
+    length = layout.forward(message.frame, "C2", 3, out, sizeof(out));
+    EXPECT_EQ(std::string(out, length), encodeOrder("CLIENT1", "C2", 3));
+}
+
+TEST_F(RouterTest, ForwardHeaderSharedBodyAndTrailerMakeTheFrame) {
+    parse(encodeOrder("CLIENT1", "CLIENT2", 7));
+    FrameLayout layout;
+    ASSERT_TRUE(FrameLayout::of(message, layout));
+
+    char out[512];
+    unsigned checksum = 0;
+    size_t header = layout.forwardHeader(message.frame, "DROPCOPY", 42, out,
+                                         sizeof(out), checksum);
+    ASSERT_GT(header, 0u);
+    std::string forwarded(out, header);
+    forwarded += message.frame.substr(layout.sharedAt(),
+                                      layout.trailerAt - layout.sharedAt());
+    char trailer[FrameLayout::TRAILER_LENGTH];
+    FrameLayout::writeTrailer(checksum, trailer);
+    forwarded.append(trailer, sizeof(trailer));
+    EXPECT_EQ(forwarded, encodeOrder("CLIENT1", "DROPCOPY", 42));
+}
+
+TEST_F(RouterTest, ForwardRejectsTooSmallOutput) {
+    parse(encodeOrder("CLIENT1", "CLIENT2", 7));
+    FrameLayout layout;
+    ASSERT_TRUE(FrameLayout::of(message, layout));
+    char out[64];
+    EXPECT_EQ(layout.forward(message.frame, "CLIENT2", 8, out, sizeof(out)),
+              0u);
+}
+
+TEST_F(RouterTest, ResolvesByTargetCompIDAndRules) {
+    Router router(2);
+    router.registerSession("CLIENT2", SessionAddress{1, 10, 100});
+    router.registerSession("OMS", SessionAddress{0, 11, 101});
+    router.registerSession("RISK", SessionAddress{1, 12, 102});
+    parse(encodeOrder("CLIENT1", "CLIENT2", 1));
+
+    SessionAddress address;
+    ASSERT_TRUE(router.resolve(message, address));
+    EXPECT_EQ(address.sessionId, 100u);
+
+    // A MsgType rule redirects every sender, a sender rule wins over it
+    router.addRule(RouteRule{"D", "", "OMS"});
+    ASSERT_TRUE(router.resolve(message, address));
+    EXPECT_EQ(address.sessionId, 101u);
+    router.addRule(RouteRule{"D", "CLIENT1", "RISK"});
+    ASSERT_TRUE(router.resolve(message, address));
+    EXPECT_EQ(address.sessionId, 102u);
+
+    EXPECT_TRUE(router.removeRule("D", "CLIENT1"));
+    EXPECT_FALSE(router.removeRule("D", "CLIENT1"));
+    ASSERT_TRUE(router.resolve(message, address));
+    EXPECT_EQ(address.sessionId, 101u);
+
+    router.setRules({});
+    router.unregisterSession("CLIENT2", 100);
+    EXPECT_FALSE(router.resolve(message, address));
+}
+
+TEST_F(RouterTest, UnregisterKeepsNewerSession) {
+    Router router(1);
+    router.registerSession("CLIENT1", SessionAddress{0, 10, 1});
+    // The same CompID logged on again on another connection
+    router.registerSession("CLIENT1", SessionAddress{0, 11, 2});
+    router.unregisterSession("CLIENT1", 1);
+
+    SessionAddress address;
+    ASSERT_TRUE(router.lookup("CLIENT1", address));
+    EXPECT_EQ(address.fd, 11);
+}
+
+TEST_F(RouterTest, RetiredTablesWaitForOnlineReaders) {
+    Router router(2);
+    // Offline readers never hold up reclamation
+    router.registerSession("A", SessionAddress{0, 10, 1});
+    EXPECT_EQ(router.retiredCount(), 0u);
+
+    router.quiescent(0);
+    router.registerSession("B", SessionAddress{0, 11, 2});
+    router.addRule(RouteRule{"D", "", "A"});
+    EXPECT_EQ(router.retiredCount(), 2u); // Reader 0 may still see them
+
+    router.quiescent(0);
+    EXPECT_EQ(router.retiredCount(), 0u);
+
+    router.registerSession("C", SessionAddress{0, 12, 3});
+    router.offline(0);
+    EXPECT_EQ(router.retiredCount(), 0u);
+}
+
+TEST_F(RouterTest, PostedFramesReachTheirWorkerInOrder) {
+    EventSignal wakeup;
+    Router router(3);
+    router.attachWorker(1, wakeup);
+
+    SessionAddress destination{1, 10, 100};
+    std::vector<std::string> frames;
+    for (uint64_t seq = 1; seq <= 3; ++seq) {
+        frames.push_back(encodeOrder("CLIENT1", "CLIENT2", seq));
+        parse(frames.back());
+        FrameLayout layout;
+        ASSERT_TRUE(FrameLayout::of(message, layout));
+        ASSERT_TRUE(router.post(seq == 2 ? 2 : 0, destination, layout,
+                                message.frame));
+    }
+
+    // One wakeup for all three frames
+    uint64_t count = 0;
+    ASSERT_EQ(read(wakeup.fd(), &count, sizeof(count)),
+              static_cast<ssize_t>(sizeof(count)));
+    EXPECT_EQ(count, 1u);
+
+    wakeup.clear();
+    std::vector<std::string> received;
+    router.drain(1, [&](const RoutedFrame &routed,
+                        std::span<const SessionAddress> copies,
+                        std::string_view frame) {
+        EXPECT_EQ(routed.destination.sessionId, 100u);
+        EXPECT_TRUE(copies.empty());
+        received.emplace_back(frame);
+    });
+    // Ordered per producer: worker 0 sent 1 and 3, worker 2 sent 2
+    EXPECT_EQ(received,
+              (std::vector<std::string>{frames[0], frames[2], frames[1]}));
+
+    router.drain(1, [&](const RoutedFrame &, std::span<const SessionAddress>,
+                        std::string_view) {
+        ADD_FAILURE() << "Channel should be empty";
+    });
+}
+
+TEST_F(RouterTest, PostFailsWhenChannelIsFull) {
+    Router router(2, 4096);
+    parse(encodeOrder("CLIENT1", "CLIENT2", 1));
+    FrameLayout layout;
+    ASSERT_TRUE(FrameLayout::of(message, layout));
+    SessionAddress destination{1, 10, 100};
+    size_t posted = 0;
+    while (router.post(0, destination, layout, message.frame)) {
+        ++posted;
+    }
+    EXPECT_GT(posted, 0u);
+    EXPECT_LT(posted * message.frame.size(), 4096u);
+}
+
+TEST_F(RouterTest, ResolveAllAddsDropCopies) {
+    Router router(2);
+    router.registerSession("OMS", SessionAddress{0, 10, 100});
+    router.registerSession("AUDIT", SessionAddress{1, 11, 101});
+    router.registerSession("RISK", SessionAddress{0, 12, 102});
+    parse(encodeOrder("CLIENT1", "EXCHANGE", 1));
+
+    std::vector<SessionAddress> addresses;
+    EXPECT_EQ(router.resolveAll(message, addresses), 0u);
+
+    // Unknown and repeated copies are skipped, the destination comes first
+    router.addRule(RouteRule{"D", "", "OMS", {"AUDIT", "NOBODY", "OMS", "RISK"}});
+    ASSERT_EQ(router.resolveAll(message, addresses), 3u);
+    EXPECT_EQ(addresses[0].sessionId, 100u);
+    EXPECT_EQ(addresses[1].sessionId, 101u);
+    EXPECT_EQ(addresses[2].sessionId, 102u);
+
+    SessionAddress address;
+    ASSERT_TRUE(router.resolve(message, address));
+    EXPECT_EQ(address.sessionId, 100u);
+}
+
+TEST_F(RouterTest, PostCarriesEveryDestinationOfAWorker) {
+    EventSignal wakeup;
+    Router router(2);
+    router.attachWorker(1, wakeup);
+    std::string frame = encodeOrder("CLIENT1", "EXCHANGE", 1);
+    parse(frame);
+    FrameLayout layout;
+    ASSERT_TRUE(FrameLayout::of(message, layout));
+
+    std::vector<SessionAddress> destinations{SessionAddress{1, 10, 100},
+                                             SessionAddress{1, 11, 101},
+                                             SessionAddress{1, 12, 102}};
+    ASSERT_TRUE(router.post(0, destinations, layout, message.frame));
+
+    size_t records = 0;
+    router.drain(1, [&](const RoutedFrame &routed,
+                        std::span<const SessionAddress> copies,
+                        std::string_view received) {
+        ++records;
+        EXPECT_EQ(routed.destination.sessionId, 100u);
+        ASSERT_EQ(copies.size(), 2u);
+        EXPECT_EQ(copies[0].sessionId, 101u);
+        EXPECT_EQ(copies[1].fd, 12);
+        EXPECT_EQ(received, frame);
+    });
+    EXPECT_EQ(records, 1u);
+}
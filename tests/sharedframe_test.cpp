@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include "../src/sharedframe.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+// Concatenates what gather() describes, as a gathering send would
+std::string gathered(const SpliceQueue &splices, const CircularBuffer &buffer,
+                     int max = 16) {
+    std::vector<iovec> iov(static_cast<size_t>(max));
+    int count = splices.gather(buffer, iov.data(), max);
+    std::string out;
+    for (int i = 0; i < count; ++i) {
+        out.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+    }
+    return out;
+}
+
+} // namespace
+
+TEST(FrameRefTest, CountsReferencesToOneCopy) {
+    FrameRef frame = FrameRef::copy("shared bytes");
+    EXPECT_EQ(frame->bytes(), "shared bytes");
+    EXPECT_EQ(frame->refs(), 1u);
+
+    std::vector<FrameRef> queued(3, frame);
+    EXPECT_EQ(queued[2].get(), frame.get());
+    EXPECT_EQ(frame->refs(), 4u);
+    FrameRef moved = std::move(queued[0]);
+    EXPECT_FALSE(queued[0]);
+    EXPECT_EQ(frame->refs(), 4u);
+    queued.clear();
+    EXPECT_EQ(frame->refs(), 2u);
+}
+
+TEST(SpliceQueueTest, GathersBufferedAndSplicedBytesInOrder) {
+    CircularBuffer buffer(64);
+    SpliceQueue splices;
+    FrameRef body = FrameRef::copy("xxBODYxx");
+
+    buffer.writeFromString("H1|");
+    splices.splice(buffer, body, 2, 4);
+    buffer.writeFromString("|T1 H2|");
+    splices.splice(buffer, body, 2, 4);
+    buffer.writeFromString("|T2");
+    splices.splice(buffer, body, 0, 0); // Empty ranges are not queued
+
+    EXPECT_EQ(splices.size(), 2u);
+    EXPECT_EQ(splices.bytes(), 8u);
+    EXPECT_EQ(body->refs(), 3u);
+    EXPECT_EQ(gathered(splices, buffer), "H1|BODY|T1 H2|BODY|T2");
+    // A short iovec array describes a prefix
+    EXPECT_EQ(gathered(splices, buffer, 3), "H1|BODY|T1 H2|");
+}
+
+TEST(SpliceQueueTest, ConsumesPartialSendsAndReleasesFrames) {
+    CircularBuffer buffer(64);
+    SpliceQueue splices;
+    FrameRef first = FrameRef::copy("AAAA");
+    FrameRef second = FrameRef::copy("BBBB");
+
+    buffer.writeFromString("h1");
+    splices.splice(buffer, first, 0, 4);
+    buffer.writeFromString("t1h2");
+    splices.splice(buffer, second, 0, 4);
+    buffer.writeFromString("t2");
+    std::string output = gathered(splices, buffer);
+    ASSERT_EQ(output, "h1AAAAt1h2BBBBt2");
+
+    // Send it a few bytes at a time, splitting every segment
+    std::string sent;
+    for (size_t step : {1u, 3u, 4u, 2u, 5u, 1u}) {
+        sent += gathered(splices, buffer).substr(0, step);
+        splices.consume(buffer, step);
+        if (sent.size() == 4) {
+            EXPECT_EQ(first->refs(), 2u); // Still being sent
+        }
+    }
+    EXPECT_EQ(sent, output);
+    EXPECT_TRUE(splices.empty());
+    EXPECT_EQ(splices.bytes(), 0u);
+    EXPECT_EQ(buffer.dataSize(), 0u);
+    EXPECT_EQ(first->refs(), 1u);
+    EXPECT_EQ(second->refs(), 1u);
+}
+
+TEST(SpliceQueueTest, PositionsSurviveWrapAndTransfer) {
+    CircularBuffer buffer(4096);
+    SpliceQueue splices;
+    FrameRef body = FrameRef::copy("BODY");
+
+    // Leave the read position near the end so the output wraps
+    std::string filler(4094, '.');
+    buffer.writeFromString(filler);
+    buffer.consume(filler.size());
+    buffer.writeFromString("he");
+    buffer.writeFromString("ad");
+    splices.splice(buffer, body, 0, 4);
+    buffer.writeFromString("tail");
+    EXPECT_EQ(gathered(splices, buffer), "headBODYtail");
+
+    CircularBuffer larger(8192);
+    ASSERT_TRUE(buffer.transferTo(larger));
+    EXPECT_EQ(gathered(splices, larger), "headBODYtail");
+
+    splices.clear();
+    EXPECT_TRUE(splices.empty());
+    EXPECT_EQ(body->refs(), 1u);
+}
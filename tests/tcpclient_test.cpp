@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+#include "../src/tcpclient.h"
+#include "../src/fixencoder.h"
+#include <atomic>
+#include <chrono>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Connects a TCPClient to a loopback listener and reads what it sends from
+// the accepted socket
+class TCPClientTest : public ::testing::Test {
+protected:
+    int listener = -1;
+    int server = -1;
+    uint16_t port = 0;
+
+    void SetUp() override {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_NE(listener, -1);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        ASSERT_EQ(bind(listener, reinterpret_cast<sockaddr *>(&addr), len), 0);
+        ASSERT_EQ(listen(listener, 1), 0);
+        ASSERT_EQ(getsockname(listener, reinterpret_cast<sockaddr *>(&addr),
+                              &len),
+                  0);
+        port = ntohs(addr.sin_port);
+    }
+
+    void TearDown() override {
+        if (server != -1) {
+            close(server);
+        }
+        close(listener);
+    }
+
+    // Polls the client until its connection is up
+    void connect(TCPClient &client) {
+        client.connect("127.0.0.1", port, [](bool) {});
+        auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!client.isConnected() &&
+               std::chrono::steady_clock::now() < deadline) {
+            client.poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_TRUE(client.isConnected());
+        server = accept(listener, nullptr, nullptr);
+        ASSERT_NE(server, -1);
+    }
+
+    // Reads exactly bytes from the accepted socket, false on timeout
+    bool receive(std::string &data, size_t bytes, size_t chunk = 65536) {
+        std::string buffer(chunk, '\0');
+        while (data.size() < bytes) {
+            pollfd pfd{server, POLLIN, 0};
+            if (::poll(&pfd, 1, 5000) != 1) {
+                return false;
+            }
+            ssize_t n = read(server, buffer.data(),
+                             std::min(chunk, bytes - data.size()));
+            if (n <= 0) {
+                return false;
+            }
+            data.append(buffer.data(), static_cast<size_t>(n));
+        }
+        return true;
+    }
+
+    static std::string message(int producer, int i) {
+        std::string text = std::to_string(producer) + ":" + std::to_string(i);
+        text.resize(text.size() + i % 50, '.');
+        return text + "\n";
+    }
+};
+
+TEST_F(TCPClientTest, SendsMessagesQueuedBeforeConnect) {
+    TCPClient client;
+    ASSERT_TRUE(client.asyncSend("early\n"));
+    connect(client);
+    ASSERT_TRUE(client.asyncSend("late\n"));
+
+    std::string data;
+    ASSERT_TRUE(receive(data, 11));
+    EXPECT_EQ(data, "early\nlate\n");
+}
+
+TEST_F(TCPClientTest, ConcurrentSendersKeepPerThreadOrder) {
+    TCPClient client;
+    connect(client);
+
+    constexpr int PRODUCERS = 4;
+    constexpr int PER_PRODUCER = 20000;
+    size_t total = 0;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        for (int i = 0; i < PER_PRODUCER; ++i) {
+            total += message(p, i).size();
+        }
+    }
+
+    std::vector<std::jthread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&client, p]() {
+            for (int i = 0; i < PER_PRODUCER; ++i) {
+                while (!client.asyncSend(message(p, i))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::string data;
+    ASSERT_TRUE(receive(data, total));
+    std::vector<int> next(PRODUCERS, 0);
+    size_t start = 0;
+    while (start < data.size()) {
+        size_t end = data.find('\n', start);
+        ASSERT_NE(end, std::string::npos);
+        std::string line = data.substr(start, end + 1 - start);
+        int p = line[0] - '0';
+        ASSERT_GE(p, 0);
+        ASSERT_LT(p, PRODUCERS);
+        ASSERT_EQ(line, message(p, next[p]));
+        ++next[p];
+        start = end + 1;
+    }
+    for (int p = 0; p < PRODUCERS; ++p) {
+        EXPECT_EQ(next[p], PER_PRODUCER);
+    }
+}
+
+TEST_F(TCPClientTest, SlowReaderResumesPartialWrites) {
+    TCPClient client(1 << 23);
+    connect(client);
+    // Each message is far larger than the loopback socket buffers, so the
+    // client stops mid-message on EAGAIN and resumes on EPOLLOUT
+    std::vector<std::string> messages;
+    size_t total = 0;
+    for (int i = 0; i < 8; ++i) {
+        messages.emplace_back(512 * 1024 + i, static_cast<char>('a' + i));
+        total += messages.back().size();
+        ASSERT_TRUE(client.asyncSend(messages.back()));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::string data;
+    ASSERT_TRUE(receive(data, total, 4096));
+    size_t offset = 0;
+    for (const auto &expected : messages) {
+        ASSERT_EQ(data.compare(offset, expected.size(), expected), 0);
+        offset += expected.size();
+    }
+}
+
+// Receiving side: the accepted socket writes FIX frames to the client
+class TCPClientFrameTest : public TCPClientTest {
+protected:
+    static std::string frame(uint64_t seqNum, std::string_view clOrdID) {
+        FixSessionHeader header("FIX.4.2", "SERVER", "CLIENT");
+        char out[256];
+        FixEncoder encoder(out, sizeof(out));
+        encoder.begin(header, "D", seqNum).field(11, clOrdID);
+        return std::string(out, encoder.finish());
+    }
+
+    void send(std::string_view bytes) {
+        ASSERT_EQ(write(server, bytes.data(), bytes.size()),
+                  static_cast<ssize_t>(bytes.size()));
+    }
+
+    // Waits until the I/O thread has delivered count frames
+    static bool waitFor(std::atomic<int> &delivered, int count) {
+        auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (delivered.load() < count &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return delivered.load() == count;
+    }
+};
+
+TEST_F(TCPClientFrameTest, FrameHandlerGetsOneCallPerFrameAcrossReads) {
+    TCPClient client;
+    std::vector<std::string> clOrdIDs;
+    std::atomic<int> delivered{0};
+    client.setFrameHandler([&](const Message &message) {
+        EXPECT_EQ(message.msgType, "D");
+        EXPECT_EQ(message.frame.size(), message.frameLength);
+        clOrdIDs.emplace_back(message.clOrdID);
+        ++delivered;
+    });
+    connect(client);
+
+    // Two frames in one write, then one split in the middle of a field
+    std::string third = frame(3, "C");
+    send(frame(1, "A") + frame(2, "B") + third.substr(0, 20));
+    ASSERT_TRUE(waitFor(delivered, 2));
+    send(third.substr(20));
+    ASSERT_TRUE(waitFor(delivered, 3));
+    EXPECT_EQ(clOrdIDs, (std::vector<std::string>{"A", "B", "C"}));
+}
+
+TEST_F(TCPClientFrameTest, BatchHandlerGetsEveryFrameOfOneRead) {
+    TCPClient client;
+    std::vector<size_t> batches;
+    std::vector<std::string> clOrdIDs;
+    std::atomic<int> delivered{0};
+    client.setBatchHandler([&](std::span<const Message> frames) {
+        batches.push_back(frames.size());
+        for (const Message &message : frames) {
+            clOrdIDs.emplace_back(message.clOrdID);
+        }
+        delivered += static_cast<int>(frames.size());
+    });
+    connect(client);
+
+    // A corrupted frame in the middle is skipped, the rest is delivered
+    std::string bad = frame(2, "X");
+    bad[bad.size() - 2] = bad[bad.size() - 2] == '0' ? '1' : '0';
+    send(frame(1, "A") + bad + frame(3, "B") + frame(4, "C"));
+    ASSERT_TRUE(waitFor(delivered, 3));
+    EXPECT_EQ(batches, (std::vector<size_t>{3}));
+    EXPECT_EQ(clOrdIDs, (std::vector<std::string>{"A", "B", "C"}));
+}
+
+TEST_F(TCPClientFrameTest, GarbledStreamClosesConnection) {
+    TCPClient client;
+    std::atomic<int> delivered{0};
+    client.setFrameHandler([&](const Message &) { ++delivered; });
+    connect(client);
+
+    send("not a FIX message\x01");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (client.isConnected() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_FALSE(client.isConnected());
+    EXPECT_EQ(delivered.load(), 0);
+}
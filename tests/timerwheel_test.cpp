@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "../src/timerwheel.h"
+#include <poll.h>
+#include <random>
+#include <vector>
+
+// Fires every due timer, recording the tick it fired at in owner
+static size_t advanceTo(TimerWheel &wheel, uint64_t until,
+                        std::vector<uint64_t> &firedAt) {
+    return wheel.advance(until, [&](TimerNode &node) {
+        firedAt[reinterpret_cast<uintptr_t>(node.owner)] = wheel.now() - 1;
+    });
+}
+
+TEST(TimerWheelTest, FiresEachTimerAtItsTickOnEveryLevel) {
+    TimerWheel wheel(1000);
+    // Within level 0, across each level boundary and deep into level 3
+    std::vector<uint64_t> delays{0,     1,       255,        256,
+                                 257,   65535,   65536,      70000,
+                                 1 << 24, (1 << 24) + 5, 1 << 25};
+    std::vector<TimerNode> nodes(delays.size());
+    std::vector<uint64_t> firedAt(delays.size(), 0);
+    for (size_t i = 0; i < delays.size(); ++i) {
+        nodes[i].owner = reinterpret_cast<void *>(i);
+        wheel.schedule(nodes[i], 1000 + delays[i]);
+    }
+    EXPECT_EQ(wheel.size(), delays.size());
+
+    EXPECT_EQ(advanceTo(wheel, 1000 + (1 << 25), firedAt), delays.size());
+    for (size_t i = 0; i < delays.size(); ++i) {
+        EXPECT_EQ(firedAt[i], 1000 + delays[i]) << "delay " << delays[i];
+        EXPECT_FALSE(nodes[i].scheduled());
+    }
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, MatchesSortedOrderForRandomTimers) {
+    TimerWheel wheel;
+    std::mt19937_64 random(42);
+    constexpr size_t COUNT = 5000;
+    std::vector<TimerNode> nodes(COUNT);
+    std::vector<uint64_t> expiry(COUNT);
+    std::vector<uint64_t> firedAt(COUNT, UINT64_MAX);
+    for (size_t i = 0; i < COUNT; ++i) {
+        nodes[i].owner = reinterpret_cast<void *>(i);
+        expiry[i] = random() % 200000;
+        wheel.schedule(nodes[i], expiry[i]);
+    }
+    // Cancelled and moved timers
+    for (size_t i = 0; i < COUNT; i += 7) {
+        wheel.cancel(nodes[i]);
+        expiry[i] = UINT64_MAX;
+    }
+    for (size_t i = 3; i < COUNT; i += 7) {
+        expiry[i] = random() % 200000;
+        wheel.schedule(nodes[i], expiry[i]);
+    }
+    // Advancing in uneven steps is the same as tick by tick
+    uint64_t at = 0;
+    while (at < 200000) {
+        at += random() % 3000;
+        advanceTo(wheel, at, firedAt);
+    }
+    for (size_t i = 0; i < COUNT; ++i) {
+        EXPECT_EQ(firedAt[i], expiry[i]) << i;
+    }
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, TimersRescheduledWhileFiringRunOnLaterTicks) {
+    TimerWheel wheel;
+    TimerNode periodic;
+    TimerNode late;
+    std::vector<uint64_t> periodicAt;
+    std::vector<uint64_t> lateAt;
+    wheel.schedule(periodic, 10);
+    wheel.schedule(late, 3);
+    wheel.advance(100, [&](TimerNode &node) {
+        uint64_t tick = wheel.now() - 1;
+        if (&node == &periodic) {
+            periodicAt.push_back(tick);
+            wheel.schedule(periodic, tick + 10);
+        } else {
+            lateAt.push_back(tick);
+            if (lateAt.size() == 1) {
+                wheel.schedule(late, 0); // Already past
+            }
+        }
+    });
+    EXPECT_EQ(periodicAt.size(), 10u);
+    EXPECT_EQ(periodicAt.back(), 100u);
+    EXPECT_EQ(lateAt, (std::vector<uint64_t>{3, 4}));
+    EXPECT_EQ(wheel.size(), 1u);
+    EXPECT_EQ(wheel.advance(109, [](TimerNode &) {}), 0u);
+    EXPECT_EQ(wheel.advance(110, [](TimerNode &) {}), 1u);
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, ClampsDelaysBeyondRange) {
+    TimerWheel wheel(5);
+    TimerNode node;
+    wheel.schedule(node, UINT64_MAX);
+    EXPECT_EQ(node.expiry, 5 + TimerWheel::MAX_DELAY);
+}
+
+TEST(TimerWheelTest, TickTimerCountsIntervals) {
+    TickTimer timer;
+    EXPECT_FALSE(timer.running());
+    EXPECT_EQ(timer.read(), 0u);
+    timer.start(std::chrono::milliseconds(5));
+    EXPECT_TRUE(timer.running());
+    pollfd pfd{timer.fd(), POLLIN, 0};
+    ASSERT_EQ(poll(&pfd, 1, 1000), 1);
+    poll(nullptr, 0, 20); // Several more intervals pass unread
+    EXPECT_GE(timer.read(), 3u);
+    timer.stop();
+    EXPECT_FALSE(timer.running());
+    timer.read();
+    EXPECT_EQ(poll(&pfd, 1, 20), 0);
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include "../src/serverconfig.h"
+#include <vector>
+
+TEST(TopologyTest, ParsesCpuLists) {
+    std::vector<int> cpus;
+    ASSERT_TRUE(CpuTopology::parseCpuList("0-3,8,10-11", cpus));
+    EXPECT_EQ(cpus, (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    ASSERT_TRUE(CpuTopology::parseCpuList("5", cpus));
+    EXPECT_EQ(cpus, (std::vector<int>{5}));
+
+    EXPECT_FALSE(CpuTopology::parseCpuList("", cpus));
+    EXPECT_FALSE(CpuTopology::parseCpuList("3-1", cpus));
+    EXPECT_FALSE(CpuTopology::parseCpuList("1,,2", cpus));
+    EXPECT_FALSE(CpuTopology::parseCpuList("1-", cpus));
+    EXPECT_FALSE(CpuTopology::parseCpuList("a", cpus));
+}
+
+TEST(TopologyTest, PinsCallingThread) {
+    std::thread([]() {
+        int cpu = sched_getcpu(); // One the process is allowed to use
+        ASSERT_TRUE(CpuTopology::pinThread(cpu));
+        EXPECT_EQ(sched_getcpu(), cpu);
+    }).join();
+}
+
+TEST(TopologyTest, ConfigAssignsCpusToWorkers) {
+    ServerConfig config;
+    EXPECT_EQ(config.workerCount(), CpuTopology::cpuCount());
+    EXPECT_EQ(config.workerCpu(1), -1);
+
+    // One worker per listed CPU unless the count is given
+    config.workerCpus = {2, 4};
+    EXPECT_EQ(config.workerCount(), 2);
+    config.workers = 3;
+    EXPECT_EQ(config.workerCpu(0), 2);
+    EXPECT_EQ(config.workerCpu(1), 4);
+    EXPECT_EQ(config.workerCpu(2), 2);
+
+    // CPU steering needs worker i on CPU i
+    config.workerCpus.clear();
+    config.acceptMode = AcceptMode::ReusePortCpu;
+    EXPECT_EQ(config.workerCpu(2), 2);
+}
@@ -0,0 +1,1021 @@
+#include <gtest/gtest.h>
+#include "../src/worker.h"
+#include <arpa/inet.h>
+#include <filesystem>
+#include <map>
+#include <poll.h>
+#include <string>
+#include <thread>
+
+// Runs a WorkerThread with the engine under test and talks to it through a
+// socketpair handed over the control queue, the way the acceptor does
+class WorkerTest : public ::testing::TestWithParam<IoEngineType> {
+protected:
+    std::atomic<bool> shutdownFlag{false};
+    std::unique_ptr<WorkerThread> worker;
+    std::jthread thread;
+    int client = -1;
+
+    // Zero-copy threshold handed to the worker
+    virtual size_t zeroCopyMinBytes() const { return 0; }
+    // Connects over TCP loopback instead of a socketpair
+    virtual bool useTcp() const { return false; }
+    // How the worker waits for events
+    virtual PollPolicy pollPolicy() const { return PollPolicy{}; }
+    // How the worker handles clients that do not read their output
+    virtual FlowControl flowControl() const { return FlowControl{}; }
+    // Timer resolution and idle timeout of the worker
+    virtual SessionTimers sessionTimers() const { return SessionTimers{}; }
+
+    static bool tcpPair(int fds[2]) {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        bool ok =
+            bind(listener, reinterpret_cast<sockaddr *>(&addr), len) == 0 &&
+            listen(listener, 1) == 0 &&
+            getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) ==
+                0;
+        fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+        ok = ok && connect(fds[0], reinterpret_cast<sockaddr *>(&addr), len) == 0;
+        fds[1] = ok ? accept(listener, nullptr, nullptr) : -1;
+        close(listener);
+        return fds[1] != -1;
+    }
+
+    void SetUp() override {
+        worker = std::make_unique<WorkerThread>(shutdownFlag, GetParam(),
+                                                zeroCopyMinBytes());
+        worker->setPollPolicy(pollPolicy());
+        worker->setFlowControl(flowControl());
+        worker->setSessionTimers(sessionTimers());
+        thread = std::jthread([this]() { worker->run(); });
+
+        int fds[2];
+        if (useTcp()) {
+            ASSERT_TRUE(tcpPair(fds));
+        } else {
+            ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        }
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        client = fds[0];
+        ASSERT_TRUE(worker->handOff(fds[1]));
+    }
+
+    void TearDown() override {
+        shutdownFlag = true;
+        worker->wake();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        close(client);
+    }
+
+    // Reads until count frames have arrived or nothing more comes
+    std::string receiveFrames(size_t count) {
+        std::string received;
+        while (countFrames(received) < count) {
+            pollfd pfd{client, POLLIN, 0};
+            if (poll(&pfd, 1, 3000) <= 0) {
+                break;
+            }
+            char chunk[65536];
+            ssize_t n = read(client, chunk, sizeof(chunk));
+            if (n <= 0) {
+                break;
+            }
+            received.append(chunk, static_cast<size_t>(n));
+        }
+        return received;
+    }
+
+    static size_t countFrames(const std::string &data) {
+        size_t count = 0;
+        for (size_t pos = data.find("\x01" "10="); pos != std::string::npos;
+             pos = data.find("\x01" "10=", pos + 1)) {
+            ++count;
+        }
+        return count;
+    }
+
+    static constexpr const char *LOGON =
+        "8=FIX.4.2\x01" "9=70\x01" "35=A\x01" "34=1\x01" "49=CLIENT1\x01"
+        "52=20250314-15:24:42.191\x01" "56=EXECUTOR\x01" "98=0\x01"
+        "108=30\x01" "10=088\x01";
+};
+
+TEST_P(WorkerTest, AnswersLogon) {
+    std::string logon = LOGON;
+    ASSERT_EQ(write(client, logon.data(), logon.size()),
+              static_cast<ssize_t>(logon.size()));
+
+    std::string response = receiveFrames(1);
+    EXPECT_NE(response.find("49=EXECUTOR\x01" "56=CLIENT1\x01"),
+              std::string::npos);
+    EXPECT_NE(response.find("108=30\x01"), std::string::npos);
+}
+
+TEST_P(WorkerTest, AnswersPipelinedBurstLargerThanSmallestBuffer) {
+    // Far more than the 4 KB starting class, so both buffers have to grow
+    std::string burst;
+    for (int i = 0; i < 500; ++i) {
+        burst += LOGON;
+    }
+    std::thread writer([&]() {
+        size_t sent = 0;
+        while (sent < burst.size()) {
+            ssize_t n = write(client, burst.data() + sent, burst.size() - sent);
+            if (n <= 0) {
+                break;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    });
+    std::string responses = receiveFrames(500);
+    writer.join();
+    EXPECT_EQ(countFrames(responses), 500u);
+}
+
+TEST_P(WorkerTest, CountsTrafficErrorsAndLatencies) {
+    std::string corrupted = LOGON;
+    corrupted.replace(corrupted.find("10=088"), 6, "10=089");
+    std::string input = std::string(LOGON) + corrupted + LOGON;
+    ASSERT_EQ(write(client, input.data(), input.size()),
+              static_cast<ssize_t>(input.size()));
+    ASSERT_EQ(countFrames(receiveFrames(2)), 2u);
+
+    // The flush is counted once the send has returned in the worker
+    const WorkerMetrics &metrics = worker->getMetrics();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (metrics.parseToFlush.count() < 2 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(metrics.connectionsOpened.load(), 1u);
+    EXPECT_EQ(metrics.bytesIn.load(), input.size());
+    EXPECT_EQ(metrics.messagesIn.load(), 2u);
+    EXPECT_EQ(metrics.checksumErrors.load(), 1u);
+    EXPECT_EQ(metrics.invalidMessages.load(), 0u);
+    EXPECT_EQ(metrics.messagesOut.load(), 2u);
+    EXPECT_EQ(metrics.readToParse.count(), 2u);
+    EXPECT_EQ(metrics.parseToFlush.count(), 2u);
+    EXPECT_GT(metrics.bytesOut.load(), 0u);
+}
+
+TEST_P(WorkerTest, AnswersEveryFrameOfOneWriteAcrossBatches) {
+    // More frames than one parse batch, with an invalid one in between
+    std::string corrupted = LOGON;
+    corrupted.replace(corrupted.find("10=088"), 6, "10=089");
+    std::string input;
+    for (size_t i = 0; i < 3 * PARSE_BATCH; ++i) {
+        input += i == PARSE_BATCH ? corrupted : std::string(LOGON);
+    }
+    ASSERT_EQ(write(client, input.data(), input.size()),
+              static_cast<ssize_t>(input.size()));
+    EXPECT_EQ(countFrames(receiveFrames(3 * PARSE_BATCH - 1)),
+              3 * PARSE_BATCH - 1);
+    EXPECT_EQ(worker->getMetrics().checksumErrors.load(), 1u);
+}
+
+TEST_P(WorkerTest, ClosesOnShutdownRightAfterLastFrame) {
+    // Data and end of file may reach the worker as a single event
+    std::string logon = LOGON;
+    ASSERT_EQ(write(client, logon.data(), logon.size()),
+              static_cast<ssize_t>(logon.size()));
+    shutdown(client, SHUT_WR);
+
+    ssize_t n = 1;
+    while (n > 0) {
+        pollfd pfd{client, POLLIN, 0};
+        ASSERT_EQ(poll(&pfd, 1, 3000), 1) << "connection left open";
+        char chunk[4096];
+        n = read(client, chunk, sizeof(chunk));
+    }
+    EXPECT_EQ(n, 0);
+}
+
+// Same worker with zero-copy sends enabled for anything from 4 KB up
+class WorkerZeroCopyTest : public WorkerTest {
+protected:
+    size_t zeroCopyMinBytes() const override { return 4096; }
+    bool useTcp() const override { return true; }
+};
+
+TEST_P(WorkerZeroCopyTest, AnswersBurstWithZeroCopySends) {
+    std::string burst;
+    for (int i = 0; i < 2000; ++i) {
+        burst += LOGON;
+    }
+    std::thread writer([&]() {
+        size_t sent = 0;
+        while (sent < burst.size()) {
+            ssize_t n = write(client, burst.data() + sent, burst.size() - sent);
+            if (n <= 0) {
+                break;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    });
+    std::string responses = receiveFrames(2000);
+    writer.join();
+    EXPECT_EQ(countFrames(responses), 2000u);
+}
+
+TEST_P(WorkerTest, TakesBatchOfConnectionsInOneHandOff) {
+    // More than one command's worth, so the batch is split
+    std::vector<int> clients, fds;
+    for (size_t i = 0; i < 2 * ControlMessage::MAX_FDS + 3; ++i) {
+        int pair[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+        fcntl(pair[1], F_SETFL, O_NONBLOCK);
+        clients.push_back(pair[0]);
+        fds.push_back(pair[1]);
+    }
+    EXPECT_EQ(worker->handOff(fds), fds.size());
+
+    std::string logon = LOGON;
+    for (int fd : clients) {
+        ASSERT_EQ(write(fd, logon.data(), logon.size()),
+                  static_cast<ssize_t>(logon.size()));
+    }
+    for (int fd : clients) {
+        std::string received;
+        pollfd pfd{fd, POLLIN, 0};
+        while (countFrames(received) < 1 && poll(&pfd, 1, 3000) > 0) {
+            char chunk[4096];
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) {
+                break;
+            }
+            received.append(chunk, static_cast<size_t>(n));
+        }
+        EXPECT_NE(received.find("35=A\x01"), std::string::npos) << fd;
+        close(fd);
+    }
+}
+
+TEST_P(WorkerTest, DrainClosesConnectionsThenTakesNewOnes) {
+    std::string logon = LOGON;
+    ASSERT_EQ(write(client, logon.data(), logon.size()),
+              static_cast<ssize_t>(logon.size()));
+    EXPECT_EQ(countFrames(receiveFrames(1)), 1u);
+
+    ASSERT_TRUE(worker->drain(std::chrono::steady_clock::now() +
+                              std::chrono::seconds(1)));
+    pollfd pfd{client, POLLIN, 0};
+    ASSERT_EQ(poll(&pfd, 1, 3000), 1);
+    char chunk[64];
+    EXPECT_EQ(read(client, chunk, sizeof(chunk)), 0);
+
+    // Once drained, the worker is back in service
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    close(client);
+    client = fds[0];
+    ASSERT_TRUE(worker->handOff(fds[1]));
+    ASSERT_EQ(write(client, logon.data(), logon.size()),
+              static_cast<ssize_t>(logon.size()));
+    EXPECT_EQ(countFrames(receiveFrames(1)), 1u);
+}
+
+// Same worker with watermarks far below the socket buffer sizes, so a
+// client that stops reading hits them quickly
+class WorkerFlowControlTest : public WorkerTest {
+protected:
+    static constexpr size_t FRAMES = 20000; // About 2 MB each way
+
+    virtual FlowControl::Overflow overflow() const {
+        return FlowControl::Overflow::Pause;
+    }
+    FlowControl flowControl() const override {
+        return FlowControl{16 * 1024, 4 * 1024, overflow()};
+    }
+
+    // Writes the burst from another thread, which blocks while the worker
+    // does not read
+    std::jthread sendBurst() {
+        return std::jthread([this]() {
+            std::string burst;
+            for (size_t i = 0; i < FRAMES; ++i) {
+                burst += LOGON;
+            }
+            size_t sent = 0;
+            while (sent < burst.size()) {
+                ssize_t n = send(client, burst.data() + sent,
+                                 burst.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    break;
+                }
+                sent += static_cast<size_t>(n);
+            }
+        });
+    }
+
+    bool waitFor(const MetricCounter &counter) {
+        auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (counter.load() == 0 &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return counter.load() != 0;
+    }
+};
+
+TEST_P(WorkerFlowControlTest, PausesReadingUntilOutputDrains) {
+    std::jthread writer = sendBurst();
+    // The client does not read until the worker has stopped reading
+    const WorkerMetrics &metrics = worker->getMetrics();
+    ASSERT_TRUE(waitFor(metrics.readPauses));
+    EXPECT_LT(metrics.messagesIn.load(), FRAMES);
+
+    std::string responses = receiveFrames(FRAMES);
+    writer.join();
+    EXPECT_EQ(countFrames(responses), FRAMES);
+    EXPECT_EQ(metrics.writeBufferDrops.load(), 0u);
+    EXPECT_EQ(metrics.slowConsumers.load(), 0u);
+}
+
+TEST_P(WorkerFlowControlTest, StopFlushesOutputBeforeReturning) {
+    std::jthread writer = sendBurst();
+    const WorkerMetrics &metrics = worker->getMetrics();
+    ASSERT_TRUE(waitFor(metrics.readPauses));
+    ASSERT_TRUE(worker->stop(std::chrono::steady_clock::now() +
+                             std::chrono::seconds(10)));
+
+    // Every request read is answered before the stream ends
+    std::string received;
+    char chunk[65536];
+    ssize_t n;
+    while ((n = read(client, chunk, sizeof(chunk))) > 0) {
+        received.append(chunk, static_cast<size_t>(n));
+    }
+    EXPECT_EQ(n, 0) << strerror(errno);
+    thread.join();
+    writer.join();
+    EXPECT_EQ(countFrames(received), metrics.messagesIn.load());
+    EXPECT_EQ(metrics.writeBufferDrops.load(), 0u);
+}
+
+TEST_P(WorkerFlowControlTest, StopClosesUnflushedConnectionsAtDeadline) {
+    std::jthread writer = sendBurst();
+    const WorkerMetrics &metrics = worker->getMetrics();
+    ASSERT_TRUE(waitFor(metrics.readPauses));
+
+    // The client never reads, so the worker gives up on its output
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(worker->stop(start + std::chrono::milliseconds(100)));
+    thread.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+    writer.join();
+
+    EXPECT_EQ(metrics.connectionsClosed.load(), 1u);
+    EXPECT_EQ(metrics.writeBufferDrops.load(), 0u);
+}
+
+class WorkerSlowConsumerTest : public WorkerFlowControlTest {
+protected:
+    FlowControl::Overflow overflow() const override {
+        return FlowControl::Overflow::Disconnect;
+    }
+};
+
+TEST_P(WorkerSlowConsumerTest, DisconnectsClientThatDoesNotRead) {
+    std::jthread writer = sendBurst();
+    ASSERT_TRUE(waitFor(worker->getMetrics().slowConsumers));
+    writer.join();
+
+    // The stream ends, with a reset since the worker left input unread
+    std::string received;
+    char chunk[65536];
+    ssize_t n;
+    while ((n = read(client, chunk, sizeof(chunk))) > 0) {
+        received.append(chunk, static_cast<size_t>(n));
+    }
+    EXPECT_TRUE(n == 0 || errno == ECONNRESET) << strerror(errno);
+    EXPECT_LT(countFrames(received), FRAMES);
+    EXPECT_EQ(worker->getMetrics().readPauses.load(), 0u);
+}
+
+// Same worker spinning for 2 ms after each event, with socket busy polling
+class WorkerBusyPollTest : public WorkerTest {
+protected:
+    PollPolicy pollPolicy() const override {
+        return PollPolicy{std::chrono::microseconds(2000), 50};
+    }
+    bool useTcp() const override { return true; }
+};
+
+TEST_P(WorkerBusyPollTest, AnswersWhileSpinningAndAfterBlocking) {
+    std::string logon = LOGON;
+    for (int round = 0; round < 3; ++round) {
+        ASSERT_EQ(write(client, logon.data(), logon.size()),
+                  static_cast<ssize_t>(logon.size()));
+        EXPECT_EQ(countFrames(receiveFrames(1)), 1u) << round;
+        // The second pause outlasts the spin window, so the worker blocks
+        std::this_thread::sleep_for(std::chrono::milliseconds(round * 5));
+    }
+}
+
+TEST_P(WorkerBusyPollTest, WakeEndsBlockingWaitOnShutdown) {
+    // Let the spin window expire so the worker sits in its blocking wait
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto start = std::chrono::steady_clock::now();
+    shutdownFlag = true;
+    worker->wake();
+    thread.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(IDLE_SWEEP_MS / 2));
+}
+
+// Same worker ticking every 10 ms
+class WorkerSessionTimerTest : public WorkerTest {
+protected:
+    SessionTimers sessionTimers() const override {
+        return SessionTimers{std::chrono::milliseconds(10),
+                             std::chrono::milliseconds(0)};
+    }
+
+    static std::string frame(std::string_view msgType, uint64_t seqNum,
+                             std::string_view tag, std::string_view value) {
+        FixSessionHeader header("FIX.4.2", "CLIENT1", "EXECUTOR");
+        char out[256];
+        FixEncoder encoder(out, sizeof(out));
+        encoder.begin(header, msgType, seqNum).field(std::stoi(std::string(tag)),
+                                                     value);
+        return std::string(out, encoder.finish());
+    }
+
+    void logon(std::string_view heartBtInt) {
+        std::string logon = frame("A", 1, "108", heartBtInt);
+        ASSERT_EQ(write(client, logon.data(), logon.size()),
+                  static_cast<ssize_t>(logon.size()));
+        ASSERT_NE(receiveFrames(1).find("35=A\x01"), std::string::npos);
+    }
+};
+
+TEST_P(WorkerSessionTimerTest, AnswersTestRequestWithItsId) {
+    logon("30");
+    std::string request = frame("1", 2, "112", "PING-7");
+    ASSERT_EQ(write(client, request.data(), request.size()),
+              static_cast<ssize_t>(request.size()));
+    std::string response = receiveFrames(1);
+    EXPECT_NE(response.find("35=0\x01"), std::string::npos) << response;
+    EXPECT_NE(response.find("34=2\x01"), std::string::npos);
+    EXPECT_NE(response.find("112=PING-7\x01"), std::string::npos);
+}
+
+TEST_P(WorkerSessionTimerTest, HeartbeatsTestsAndDropsSilentSession) {
+    auto start = std::chrono::steady_clock::now();
+    logon("1");
+    auto elapsed = [&start]() {
+        return std::chrono::steady_clock::now() - start;
+    };
+
+    // Nothing sent for HeartBtInt: a Heartbeat
+    std::string heartbeat = receiveFrames(1);
+    EXPECT_NE(heartbeat.find("35=0\x01"), std::string::npos) << heartbeat;
+    EXPECT_GE(elapsed(), std::chrono::milliseconds(950));
+
+    // Nothing received for HeartBtInt plus 20%: a TestRequest
+    std::string testRequest = receiveFrames(1);
+    EXPECT_NE(testRequest.find("35=1\x01"), std::string::npos) << testRequest;
+    EXPECT_NE(testRequest.find("\x01" "112="), std::string::npos);
+    EXPECT_GE(elapsed(), std::chrono::milliseconds(1150));
+
+    // Unanswered for as long again: the session is closed
+    char chunk[4096];
+    ssize_t n = 1;
+    while (n > 0) {
+        pollfd pfd{client, POLLIN, 0};
+        ASSERT_EQ(poll(&pfd, 1, 3000), 1) << "session left open";
+        n = read(client, chunk, sizeof(chunk));
+    }
+    EXPECT_GE(elapsed(), std::chrono::milliseconds(2350));
+    EXPECT_EQ(worker->getMetrics().heartbeatTimeouts.load(), 1u);
+    EXPECT_GE(worker->getMetrics().heartbeatsSent.load(), 2u);
+}
+
+// Same worker closing connections that send nothing for 50 ms
+class WorkerIdleTimeoutTest : public WorkerTest {
+protected:
+    SessionTimers sessionTimers() const override {
+        return SessionTimers{std::chrono::milliseconds(10),
+                             std::chrono::milliseconds(50)};
+    }
+};
+
+TEST_P(WorkerIdleTimeoutTest, ClosesConnectionThatStaysSilent) {
+    // Traffic keeps the connection open past the timeout
+    std::string logon = LOGON;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(write(client, logon.data(), logon.size()),
+                  static_cast<ssize_t>(logon.size()));
+        ASSERT_EQ(countFrames(receiveFrames(1)), 1u) << i;
+        std::this_thread::sleep_for(std::chrono::milliseconds(25));
+    }
+    EXPECT_EQ(worker->getMetrics().idleTimeouts.load(), 0u);
+
+    auto start = std::chrono::steady_clock::now();
+    pollfd pfd{client, POLLIN, 0};
+    ASSERT_EQ(poll(&pfd, 1, 3000), 1) << "connection left open";
+    char chunk[64];
+    EXPECT_EQ(read(client, chunk, sizeof(chunk)), 0);
+    EXPECT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(20));
+    EXPECT_EQ(worker->getMetrics().idleTimeouts.load(), 1u);
+}
+
+// Two workers sharing a Router, one client session on each
+class RoutingTest : public ::testing::TestWithParam<IoEngineType> {
+protected:
+    std::atomic<bool> shutdownFlag{false};
+    Router router{2};
+    std::unique_ptr<WorkerThread> workers[2];
+    std::jthread threads[2];
+    std::vector<int> clients;
+
+    // Journal settings handed to both workers
+    virtual JournalOptions journalOptions() const { return JournalOptions{}; }
+    // Capture settings handed to both workers
+    virtual CaptureOptions captureOptions() const { return CaptureOptions{}; }
+
+    void SetUp() override {
+        for (uint32_t i = 0; i < 2; ++i) {
+            workers[i] = std::make_unique<WorkerThread>(shutdownFlag, GetParam());
+            workers[i]->attachRouter(router, i);
+            workers[i]->setJournal(journalOptions());
+            workers[i]->setCapture(captureOptions(), i);
+            threads[i] = std::jthread([this, i]() { workers[i]->run(); });
+        }
+    }
+
+    void TearDown() override {
+        shutdownFlag = true;
+        for (auto &worker : workers) {
+            worker->wake();
+        }
+        for (std::jthread &thread : threads) {
+            thread.join();
+        }
+        for (int fd : clients) {
+            close(fd);
+        }
+    }
+
+    // Connects a client to a worker and logs it on as compID
+    int logon(uint32_t worker, std::string_view compID,
+              std::string *response = nullptr,
+              std::string_view fields = "108=30\x01") {
+        int fds[2];
+        EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        clients.push_back(fds[0]);
+        EXPECT_TRUE(workers[worker]->handOff(fds[1]));
+        send(fds[0], encode(compID, "HUB", "A", 1, fields));
+        std::string received = receive(fds[0]);
+        EXPECT_NE(received.find("35=A\x01"), std::string::npos);
+        if (response != nullptr) {
+            *response = received;
+        }
+        return fds[0];
+    }
+
+    static std::string encode(std::string_view sender, std::string_view target,
+                              std::string_view msgType, uint64_t seqNum,
+                              std::string_view body) {
+        FixSessionHeader header("FIX.4.2", sender, target);
+        char out[512];
+        FixEncoder encoder(out, sizeof(out));
+        encoder.begin(header, msgType, seqNum);
+        // body holds complete tag=value<SOH> fields
+        for (size_t pos = 0; pos < body.size();) {
+            size_t eq = body.find('=', pos);
+            size_t end = body.find('\x01', eq);
+            encoder.field(std::stoi(std::string(body.substr(pos, eq - pos))),
+                          body.substr(eq + 1, end - eq - 1));
+            pos = end + 1;
+        }
+        return std::string(out, encoder.finish());
+    }
+
+    static void send(int fd, const std::string &frame) {
+        ASSERT_EQ(write(fd, frame.data(), frame.size()),
+                  static_cast<ssize_t>(frame.size()));
+    }
+
+    // Reads whatever arrives within the timeout
+    static std::string receive(int fd) {
+        std::string received;
+        pollfd pfd{fd, POLLIN, 0};
+        while (poll(&pfd, 1, received.empty() ? 3000 : 100) > 0) {
+            char chunk[4096];
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) {
+                break;
+            }
+            received.append(chunk, static_cast<size_t>(n));
+        }
+        return received;
+    }
+};
+
+TEST_P(RoutingTest, RoutesToSessionOnOtherWorker) {
+    int client1 = logon(0, "CLIENT1");
+    int client2 = logon(1, "CLIENT2");
+
+    send(client1, encode("CLIENT1", "CLIENT2", "D", 2, "11=ORDER-1\x01" "38=100\x01"));
+    // Forwarded unchanged but for the receiving session's MsgSeqNum
+    EXPECT_EQ(receive(client2),
+              encode("CLIENT1", "CLIENT2", "D", 2, "11=ORDER-1\x01" "38=100\x01"));
+
+    send(client2, encode("CLIENT2", "CLIENT1", "8", 2, "11=ORDER-1\x01" "39=0\x01"));
+    EXPECT_EQ(receive(client1),
+              encode("CLIENT2", "CLIENT1", "8", 2, "11=ORDER-1\x01" "39=0\x01"));
+}
+
+TEST_P(RoutingTest, RoutesByRuleOnSameWorker) {
+    int client1 = logon(0, "CLIENT1");
+    int oms = logon(0, "OMS");
+    router.addRule(RouteRule{"D", "", "OMS"});
+
+    for (uint64_t seq = 2; seq < 5; ++seq) {
+        send(client1, encode("CLIENT1", "EXCHANGE", "D", seq, "11=X\x01"));
+    }
+    std::string expected;
+    for (uint64_t seq = 2; seq < 5; ++seq) {
+        expected += encode("CLIENT1", "OMS", "D", seq, "11=X\x01");
+    }
+    std::string received;
+    while (received.size() < expected.size()) {
+        std::string more = receive(oms);
+        if (more.empty()) {
+            break;
+        }
+        received += more;
+    }
+    EXPECT_EQ(received, expected);
+}
+
+TEST_P(RoutingTest, FansOutDropCopiesAcrossWorkers) {
+    int client1 = logon(0, "CLIENT1");
+    int oms = logon(0, "OMS");
+    int audit = logon(0, "AUDIT");
+    int risk = logon(1, "RISK");
+    int archive = logon(1, "ARCHIVE");
+    router.addRule(RouteRule{"D", "", "OMS", {"AUDIT", "RISK", "ARCHIVE"}});
+
+    std::string body = "11=ORDER-1\x01" "55=ABC\x01" "38=100\x01";
+    for (uint64_t seq = 2; seq < 4; ++seq) {
+        send(client1, encode("CLIENT1", "EXCHANGE", "D", seq, body));
+    }
+    // Every session gets its own TargetCompID and MsgSeqNum
+    for (auto [fd, compID] : {std::pair{oms, "OMS"}, std::pair{audit, "AUDIT"},
+                              std::pair{risk, "RISK"},
+                              std::pair{archive, "ARCHIVE"}}) {
+        std::string expected = encode("CLIENT1", compID, "D", 2, body) +
+                               encode("CLIENT1", compID, "D", 3, body);
+        std::string received;
+        while (received.size() < expected.size()) {
+            std::string more = receive(fd);
+            if (more.empty()) {
+                break;
+            }
+            received += more;
+        }
+        EXPECT_EQ(received, expected) << compID;
+    }
+}
+
+TEST_P(RoutingTest, ClosedSessionIsUnregistered) {
+    int client1 = logon(0, "CLIENT1");
+    logon(1, "CLIENT2");
+    SessionAddress address;
+    ASSERT_TRUE(router.lookup("CLIENT1", address));
+
+    shutdown(client1, SHUT_RDWR);
+    for (int i = 0; i < 100 && router.lookup("CLIENT1", address); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_FALSE(router.lookup("CLIENT1", address));
+    EXPECT_TRUE(router.lookup("CLIENT2", address));
+}
+
+TEST_P(RoutingTest, MigratesSessionWithoutLosingFrames) {
+    int client1 = logon(0, "CLIENT1");
+    int client2 = logon(1, "CLIENT2");
+    int oms = logon(0, "OMS");
+    SessionAddress before;
+    ASSERT_TRUE(router.lookup("CLIENT1", before));
+    ASSERT_EQ(before.worker, 0u);
+
+    // Orders keep arriving from both workers while CLIENT1 moves to worker 1
+    constexpr uint64_t ORDERS = 100;
+    for (uint64_t i = 0; i < ORDERS; ++i) {
+        if (i == ORDERS / 2) {
+            ASSERT_TRUE(workers[0]->migrate(1, before.fd));
+        }
+        std::string id = std::to_string(i);
+        send(client2, encode("CLIENT2", "CLIENT1", "D", i + 2, "11=" + id + "\x01"));
+        send(oms, encode("OMS", "CLIENT1", "D", i + 2, "11=" + id + "\x01"));
+    }
+    SessionAddress after;
+    for (int i = 0; i < 200 && router.lookup("CLIENT1", after) &&
+                    after.worker != 1; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(after.worker, 1u);
+    EXPECT_EQ(after.fd, before.fd);
+
+    std::string received;
+    auto frames = [&received]() {
+        size_t count = 0;
+        for (size_t at = 0; (at = received.find("\x01" "10=", at)) != std::string::npos;
+             ++at) {
+            ++count;
+        }
+        return count;
+    };
+    while (frames() < 2 * ORDERS) {
+        std::string more = receive(client1);
+        if (more.empty()) {
+            break;
+        }
+        received += more;
+    }
+    // Every order once, in the order of its sender, under consecutive
+    // MsgSeqNums of the receiving session
+    auto field = [](std::string_view frame, std::string_view tag) {
+        size_t at = frame.find(tag);
+        size_t end = frame.find('\x01', at + tag.size());
+        return std::string(frame.substr(at + tag.size(), end - at - tag.size()));
+    };
+    std::map<std::string, uint64_t> next;
+    uint64_t seqNum = 2;
+    for (size_t pos = 0; pos < received.size();) {
+        size_t end = received.find("8=FIX", pos + 1);
+        std::string_view frame =
+            std::string_view(received).substr(pos, end - pos);
+        EXPECT_EQ(field(frame, "\x01" "34="), std::to_string(seqNum++));
+        std::string sender = field(frame, "\x01" "49=");
+        EXPECT_EQ(field(frame, "\x01" "11="), std::to_string(next[sender]++))
+            << sender;
+        pos = end == std::string::npos ? received.size() : end;
+    }
+    EXPECT_EQ(next["CLIENT2"], ORDERS);
+    EXPECT_EQ(next["OMS"], ORDERS);
+
+    // The moved session keeps reading and routing from its new worker
+    send(client1, encode("CLIENT1", "CLIENT2", "8", 2, "11=0\x01" "39=0\x01"));
+    EXPECT_EQ(receive(client2),
+              encode("CLIENT1", "CLIENT2", "8", 2, "11=0\x01" "39=0\x01"));
+    EXPECT_EQ(workers[0]->getMetrics().migrationsOut.load(), 1u);
+    EXPECT_EQ(workers[1]->getMetrics().migrationsIn.load(), 1u);
+    EXPECT_EQ(workers[0]->getMetrics().routeDrops.load(), 0u);
+    EXPECT_EQ(workers[1]->getMetrics().routeDrops.load(), 0u);
+}
+
+// Routing with every session journaled to a temporary directory
+class JournalRoutingTest : public RoutingTest {
+protected:
+    std::string directory;
+
+    JournalRoutingTest() {
+        char path[] = "/tmp/worker_journal.XXXXXX";
+        directory = mkdtemp(path);
+    }
+    ~JournalRoutingTest() override {
+        SessionJournal::awaitDiscarded();
+        std::filesystem::remove_all(directory);
+    }
+
+    JournalOptions journalOptions() const override {
+        JournalOptions options;
+        options.directory = directory;
+        options.segmentBytes = 1 << 20;
+        options.sync = JournalSync::Async;
+        return options;
+    }
+};
+
+TEST_P(JournalRoutingTest, ResendsJournaledMessagesAsPossDup) {
+    int client1 = logon(0, "CLIENT1");
+    int client2 = logon(1, "CLIENT2");
+    send(client1, encode("CLIENT1", "CLIENT2", "D", 2, "11=ORDER-1\x01" "38=100\x01"));
+    EXPECT_EQ(receive(client2),
+              encode("CLIENT1", "CLIENT2", "D", 2, "11=ORDER-1\x01" "38=100\x01"));
+
+    // The Logon answer is gap filled, the order comes again marked
+    send(client2, encode("CLIENT2", "HUB", "2", 2, "7=1\x01" "16=0\x01"));
+    std::string expected =
+        encode("HUB", "CLIENT2", "4", 1, "43=Y\x01" "123=Y\x01" "36=2\x01") +
+        encode("CLIENT1", "CLIENT2", "D", 2,
+               "43=Y\x01" "11=ORDER-1\x01" "38=100\x01");
+    EXPECT_EQ(receive(client2), expected);
+
+    // Beyond the last message sent there is nothing to resend, so only the
+    // second request is answered
+    send(client2, encode("CLIENT2", "HUB", "2", 3, "7=5\x01" "16=0\x01"));
+    send(client2, encode("CLIENT2", "HUB", "2", 4, "7=2\x01" "16=2\x01"));
+    EXPECT_EQ(receive(client2),
+              encode("CLIENT1", "CLIENT2", "D", 2,
+                     "43=Y\x01" "11=ORDER-1\x01" "38=100\x01"));
+}
+
+TEST_P(JournalRoutingTest, ResendLargerThanWriteBufferCompletes) {
+    int client1 = logon(0, "CLIENT1");
+    int client2 = logon(1, "CLIENT2");
+    constexpr size_t ORDERS = 20000; // Over 1 MB of frames
+    auto countFrames = [](const std::string &data, std::string_view marker) {
+        size_t count = 0;
+        for (size_t pos = data.find(marker); pos != std::string::npos;
+             pos = data.find(marker, pos + 1)) {
+            ++count;
+        }
+        return count;
+    };
+    auto receiveFrames = [&](size_t count) {
+        std::string received;
+        while (countFrames(received, "\x01" "10=") < count) {
+            std::string more = receive(client2);
+            if (more.empty()) {
+                break;
+            }
+            received += more;
+        }
+        return received;
+    };
+    std::jthread writer([&]() {
+        for (size_t i = 0; i < ORDERS; ++i) {
+            send(client1, encode("CLIENT1", "CLIENT2", "D", 2 + i,
+                                 "11=ORDER-1\x01" "38=100\x01"));
+        }
+    });
+    EXPECT_EQ(countFrames(receiveFrames(ORDERS), "\x01" "10="), ORDERS);
+    writer.join();
+
+    send(client2, encode("CLIENT2", "HUB", "2", 2, "7=2\x01" "16=0\x01"));
+    std::string resent = receiveFrames(ORDERS);
+    EXPECT_EQ(countFrames(resent, "\x01" "43=Y\x01"), ORDERS);
+    EXPECT_NE(resent.find("\x01" "34=" + std::to_string(ORDERS + 1) + "\x01"),
+              std::string::npos);
+}
+
+TEST_P(JournalRoutingTest, SeqNumsSurviveReconnectUntilReset) {
+    int client = logon(0, "CLIENT1");
+    shutdown(client, SHUT_RDWR);
+    SessionAddress address;
+    for (int i = 0; i < 100 && router.lookup("CLIENT1", address); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::string response;
+    logon(0, "CLIENT1", &response);
+    EXPECT_NE(response.find("\x01" "34=2\x01"), std::string::npos) << response;
+
+    // ResetSeqNumFlag starts the outbound sequence over
+    logon(0, "CLIENT9", &response, "108=30\x01" "141=Y\x01");
+    EXPECT_NE(response.find("\x01" "34=1\x01"), std::string::npos) << response;
+}
+
+// Routing with each worker capturing its input to a temporary directory
+class CaptureRoutingTest : public RoutingTest {
+protected:
+    std::string directory;
+
+    CaptureRoutingTest() {
+        char path[] = "/tmp/worker_capture.XXXXXX";
+        directory = mkdtemp(path);
+    }
+    ~CaptureRoutingTest() override { std::filesystem::remove_all(directory); }
+
+    CaptureOptions captureOptions() const override {
+        CaptureOptions options;
+        options.directory = directory;
+        options.ringBytes = CaptureLog::MIN_RING_BYTES;
+        return options;
+    }
+};
+
+TEST_P(CaptureRoutingTest, ReplaysCapturedSessionsWithoutSockets) {
+    int client1 = logon(0, "CLIENT1");
+    int oms = logon(0, "OMS");
+    router.addRule(RouteRule{"D", "", "OMS"});
+    std::string sent = encode("CLIENT1", "HUB", "A", 1, "108=30\x01");
+    for (uint64_t seq = 2; seq < 5; ++seq) {
+        std::string order = encode("CLIENT1", "EXCHANGE", "D", seq, "11=X\x01");
+        send(client1, order);
+        sent += order;
+    }
+    std::string expected;
+    for (uint64_t seq = 2; seq < 5; ++seq) {
+        expected += encode("CLIENT1", "OMS", "D", seq, "11=X\x01");
+    }
+    std::string received;
+    while (received.size() < expected.size()) {
+        std::string more = receive(oms);
+        if (more.empty()) {
+            break;
+        }
+        received += more;
+    }
+    ASSERT_EQ(received, expected);
+
+    // Worker 0 captured both streams as read, worker 1 nothing
+    std::map<int, std::string> streams;
+    CaptureFile file(directory + "/worker-0.capture");
+    EXPECT_TRUE(file.forEach([&](const CaptureRecord &record,
+                                 std::string_view bytes) {
+        streams[record.fd] += bytes;
+    }));
+    ASSERT_EQ(streams.size(), 2u);
+    EXPECT_TRUE(streams.begin()->second == sent ||
+                std::next(streams.begin())->second == sent);
+    EXPECT_EQ(CaptureFile(directory + "/worker-1.capture").size(), 0u);
+
+    // The replay logs both sessions on and routes the orders again
+    std::atomic<bool> stop{false};
+    Router replayRouter(1);
+    WorkerThread replayer(stop);
+    replayer.attachRouter(replayRouter, 0);
+    file.forEach([&](const CaptureRecord &record, std::string_view bytes) {
+        EXPECT_TRUE(replayer.replay(record.fd, bytes));
+    });
+    const WorkerMetrics &metrics = replayer.getMetrics();
+    EXPECT_EQ(metrics.messagesIn.load(), 5u);
+    EXPECT_EQ(metrics.routeDrops.load(), 3u); // No rule yet
+    EXPECT_EQ(metrics.messagesOut.load(), 2u); // Logon answers
+    SessionAddress address;
+    EXPECT_TRUE(replayRouter.lookup("OMS", address));
+
+    replayRouter.addRule(RouteRule{"D", "", "OMS"});
+    replayer.endReplay();
+    EXPECT_FALSE(replayRouter.lookup("OMS", address));
+    file.forEach([&](const CaptureRecord &record, std::string_view bytes) {
+        replayer.replay(record.fd, bytes);
+    });
+    EXPECT_EQ(metrics.messagesIn.load(), 10u);
+    EXPECT_EQ(metrics.routeDrops.load(), 3u);
+    EXPECT_EQ(metrics.messagesOut.load(), 2u + 5u);
+    EXPECT_EQ(metrics.writeBufferDrops.load(), 0u);
+    EXPECT_GT(metrics.bytesOut.load(), received.size());
+    replayer.endReplay();
+}
+
+static std::string engineName(const ::testing::TestParamInfo<IoEngineType> &info) {
+    return info.param == IoEngineType::Epoll ? "Epoll" : "IoUring";
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, WorkerTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, WorkerZeroCopyTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, RoutingTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, WorkerFlowControlTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, WorkerSlowConsumerTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, WorkerBusyPollTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, JournalRoutingTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, CaptureRoutingTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, WorkerSessionTimerTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, WorkerIdleTimeoutTest,
+                         ::testing::Values(IoEngineType::Epoll,
+                                           IoEngineType::IoUring),
+                         engineName);